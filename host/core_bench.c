@@ -0,0 +1,227 @@
+/**
+ * Protocol core benchmark
+ *
+ * Times the building blocks of the protocol core on the host: the message constructors, the
+ * message history, the ack list, the neighbour table, the packet pool and the tx queue, and the
+ * receive interrupt with its debug output printed in place or recorded for the UI core.
+ * The debug output of the core is left in, as on the target, and sent to /dev/null.
+ * Every step is also checked to leave the tables the way it found them, the run fails otherwise.
+ *
+ * Usage: core_bench [-n iterations] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "channel.h"
+#include "events.h"
+#include "log.h"
+#include "network.h"
+#include "platform.h"
+#include "radio.h"
+
+#include "host.h"
+#include "vradio.h"
+
+typedef struct {
+  const char *name;
+  // Runs the step `iterations` times, returns false if it left the tables inconsistent.
+  bool (*run)(int iterations);
+} bench_t;
+
+static const uid_t PEER = {.bytes = {0x10, 0x20, 0x30}};
+
+static bool bench_constructors(int iterations) {
+  uint32_t sum = 0;
+  for (int i = 0; i < iterations; i++) {
+    message_t messages[] = {
+        new_hello_message(),
+        new_ping_message(PEER),
+        new_text_message(PEER, TEXT_OK),
+        new_request_message(PEER, INFO_BATTERY),
+        new_ack_message(PEER, i & 0xFF),
+    };
+    for (int m = 0; m < sizeof(messages) / sizeof(messages[0]); m++) {
+      sum += messages[m].id;
+    }
+  }
+  // Keep the constructors from being optimized away.
+  return sum != 0xFFFFFFFF;
+}
+
+// Received packets, every other one a duplicate of the previous one.
+static bool bench_history(int iterations) {
+  uint32_t in_use = packet_stats.in_use;
+  message_t message = new_text_message(get_uid(), TEXT_COPY);
+  for (int i = 0; i < iterations; i++) {
+    packet_t packet = packet_alloc();
+    if (packet == PACKET_NONE) {
+      return false;
+    }
+    message_history_t *entry = packet_get(packet);
+    entry->message = message;
+    entry->message.id = i / 2;
+    entry->time = platform_now();
+    check_message_history(packet);
+    packet_unref(packet);
+  }
+  // The history keeps its own references, only those may be left.
+  return packet_stats.in_use <= in_use + MAX_MESSAGE_HISTORY;
+}
+
+// Outgoing packets waiting for an ack, with the list checked after every one of them.
+static bool bench_acks(int iterations) {
+  uint32_t in_use = packet_stats.in_use;
+  for (int i = 0; i < iterations; i++) {
+    packet_t packet = packet_alloc();
+    if (packet == PACKET_NONE) {
+      return false;
+    }
+    message_history_t *entry = packet_get(packet);
+    entry->message = new_ping_message(PEER);
+    entry->message.flags.ack_req = true;
+    entry->time = platform_now();
+    add_ack(packet);
+    packet_unref(packet);
+    check_ack_list();
+    if (i % 8 == 7) {
+      // Most acks arrive.
+      for (int k = 0; k < 8; k++) {
+        remove_ack((entry->message.id - k) & 0xFF);
+      }
+    }
+  }
+  for (int i = 0; i < MAX_MID; i++) {
+    if (ack_list[i].timeout != 0) {
+      remove_ack(i);
+    }
+  }
+  return packet_stats.in_use == in_use;
+}
+
+// A full neighbour table updated on every packet, with the UI taking a copy every time.
+static bool bench_neighbours(int iterations) {
+  neighbour_table_t copy;
+  core_msg_t msg;
+  for (int i = 0; i < iterations; i++) {
+    uid_t uid = {.bytes = {0x40, 0x50, i % MAX_NEIGHBOURS}};
+    update_neighbour(uid, -40 - i % 60, 0);
+    while (receive_on_ui(&msg)) {
+      copy_neighbour_table(&copy);
+    }
+  }
+  return copy.count == neighbour_table.count &&
+         memcmp(&copy, &neighbour_table, sizeof(neighbour_table_t)) == 0;
+}
+
+// Packets through the tx queue, the way `try_transmit` and the radio loop pass them.
+static bool bench_tx_queue(int iterations) {
+  uint32_t in_use = packet_stats.in_use;
+  packet_t packet;
+  for (int i = 0; i < iterations; i++) {
+    for (int k = 0; k < MESSAGE_QUEUE_SIZE; k++) {
+      try_transmit(new_ping_message(PEER));
+    }
+    while (mpsc_ring_pop(&tx_queue, &packet)) {
+      packet_unref(packet);
+    }
+  }
+  return packet_stats.in_use == in_use;
+}
+
+// Broadcast pings from a neighbour through the receive interrupt, the radio loop and the UI core
+// taking what it left them. Only the records are taken off the log, formatting them is the UI
+// core's time, not the interrupt's.
+static bool bench_rx_isr(int iterations, log_mode_t mode) {
+  uint32_t in_use = packet_stats.in_use;
+  uint32_t dropped = log_stats.dropped;
+  log_mode_t previous = log_mode;
+  log_mode = mode;
+
+  message_t message = new_ping_message(get_broadcast_uid());
+  message.src = PEER;
+  packet_t packet;
+  core_msg_t msg;
+  log_record_t record;
+  for (int i = 0; i < iterations; i++) {
+    message.id = i;
+    vradio_receive((uint8_t *)&message, sizeof(message), -60, 8);
+    while (spsc_ring_pop(&rx_queue, &packet)) {
+      packet_unref(packet);
+    }
+    take_events();
+    while (receive_on_ui(&msg)) {
+    }
+    while (log_take(&record)) {
+    }
+  }
+
+  log_mode = previous;
+  return packet_stats.in_use == in_use && log_stats.dropped == dropped;
+}
+
+static bool bench_rx_isr_direct(int iterations) { return bench_rx_isr(iterations, LOG_DIRECT); }
+
+static bool bench_rx_isr_deferred(int iterations) { return bench_rx_isr(iterations, LOG_TEXT); }
+
+static bench_t benches[] = {
+    {"constructors", bench_constructors},
+    {"history", bench_history},
+    {"acks", bench_acks},
+    {"neighbours", bench_neighbours},
+    {"tx queue", bench_tx_queue},
+    {"rx isr direct", bench_rx_isr_direct},
+    {"rx isr deferred", bench_rx_isr_deferred},
+};
+
+#define NUM_BENCHES (sizeof(benches) / sizeof(benches[0]))
+
+int main(int argc, char **argv) {
+  int iterations = 100000;
+  bool verbose = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else {
+      fprintf(stderr, "usage: %s [-n iterations] [-v]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // The core logs to stdout, keep the report readable.
+  FILE *report = stdout;
+  if (!verbose) {
+    report = host_silence_stdout();
+  }
+
+  setup_log();
+  setup_channel();
+  vradio_attach(NULL);
+  setup_sx126x();
+  setup_network();
+  receive_cont();
+
+  int failures = 0;
+  fprintf(report, "%-16s %12s %8s\n", "step", "ns/iter", "check");
+  for (int b = 0; b < NUM_BENCHES; b++) {
+    uint64_t start = host_now_ns();
+    bool ok = benches[b].run(iterations);
+    uint64_t ns = host_now_ns() - start;
+    if (!ok) {
+      failures++;
+    }
+    fprintf(report, "%-16s %12.1f %8s\n", benches[b].name, (double)ns / iterations,
+            ok ? "ok" : "FAIL");
+  }
+
+  fprintf(report, "packets: %u allocs, %u failures, %u in use, %u peak\n", packet_stats.allocs,
+          packet_stats.failures, packet_stats.in_use, packet_stats.peak);
+
+  fflush(report);
+
+  return failures == 0 ? 0 : 1;
+}
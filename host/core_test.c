@@ -0,0 +1,269 @@
+/**
+ * Protocol core tests
+ *
+ * Checks the building blocks of the protocol core on the host: the fields the message constructors
+ * fill in, duplicate detection by the message history and the window of every source, adding and
+ * removing acks, and neighbour table updates. core_bench times the same code, this checks what it
+ * does. Every test starts from the tables the previous one left, each cleans up after itself.
+ * The debug output of the core goes to /dev/null.
+ *
+ * Usage: core_test [-v]
+ */
+
+// The checks are the tests, keep them in whatever the build type.
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "channel.h"
+#include "log.h"
+#include "network.h"
+#include "platform.h"
+#include "radio.h"
+
+#include "host.h"
+#include "vradio.h"
+
+static const uid_t PEER = {.bytes = {0x10, 0x20, 0x30}};
+
+static bool same_uid(uid_t a, uid_t b) { return memcmp(&a, &b, sizeof(uid_t)) == 0; }
+
+// A message from another node, run through the history as the radio loop does.
+// Returns whether it was taken for a duplicate.
+static bool receive(uid_t src, mtype_t mtype, mid_t id) {
+  packet_t packet = packet_alloc();
+  assert(packet != PACKET_NONE);
+  message_history_t *entry = packet_get(packet);
+  entry->message = new_ping_message(get_uid());
+  entry->message.src = src;
+  entry->message.mtype = mtype;
+  entry->message.id = id;
+  entry->time = platform_now();
+  bool duplicate = check_message_history(packet);
+  packet_unref(packet);
+  return duplicate;
+}
+
+// The neighbour table entry of a node, NULL if it has none.
+static neighbour_t *find_neighbour(uid_t uid) {
+  for (int i = 0; i < neighbour_table.count; i++) {
+    if (same_uid(neighbour_table.neighbours[i].uid, uid)) {
+      return &neighbour_table.neighbours[i];
+    }
+  }
+  return NULL;
+}
+
+static void test_constructors() {
+  message_t hello = new_hello_message();
+  assert(is_broadcast(hello.dst));
+  assert(is_my_uid(hello.src));
+  assert(hello.mtype == MTYPE_HELLO);
+  assert(hello.flags.ack_req && hello.flags.hop_limit == 0);
+
+  // Every message takes the next mid, wrapping around.
+  message_t ping = new_ping_message(PEER);
+  assert(ping.id == (mid_t)(hello.id + 1));
+  assert(same_uid(ping.dst, PEER) && is_my_uid(ping.src));
+  assert(ping.mtype == MTYPE_PING);
+  assert(!ping.flags.ack_req && ping.flags.hop_limit == 0);
+
+  message_t text = new_text_message(PEER, TEXT_COPY);
+  assert(text.id == (mid_t)(ping.id + 1));
+  assert(text.mtype == MTYPE_TEXT && text.data[0] == TEXT_COPY);
+  assert(text.flags.ack_req && text.flags.hop_limit == 3);
+
+  message_t ack = new_ack_message(PEER, 42);
+  assert(ack.mtype == MTYPE_ACK && ack.data[0] == 42);
+  assert(!ack.flags.ack_req);
+
+  message_t request = new_request_message(PEER, INFO_BATTERY);
+  assert(request.mtype == MTYPE_REQ && request.data[0] == INFO_BATTERY);
+
+  message_t response = new_response_message(PEER, INFO_VERSION, 0x1234);
+  assert(response.mtype == MTYPE_RES && response.data[0] == INFO_VERSION);
+  assert(response.data[1] == 0x12 && response.data[2] == 0x34);
+
+  // A frame of the constructors decodes back to the same message.
+  message_t decoded;
+  assert(decode_message(&decoded, (const uint8_t *)&text, sizeof(text)) == DECODE_OK);
+  assert(memcmp(&decoded, &text, sizeof(message_t)) == 0);
+  assert(decode_message(&decoded, (const uint8_t *)&text, sizeof(text) - 1) == DECODE_LENGTH);
+}
+
+// A source without a neighbour entry is only checked against the history.
+static void test_history() {
+  const uid_t stranger = {.bytes = {0x70, 0x71, 0x72}};
+  uint32_t in_use = packet_stats.in_use;
+  uint32_t duplicates = message_history_duplicates;
+
+  assert(!receive(stranger, MTYPE_TEXT, 10));
+  assert(receive(stranger, MTYPE_TEXT, 10));
+  assert(message_history_duplicates == duplicates + 1);
+  // Same mid from another source, or another mid from the same one.
+  assert(!receive(PEER, MTYPE_TEXT, 10));
+  assert(!receive(stranger, MTYPE_TEXT, 11));
+
+  // Pushed out of the history by newer messages, it is new again.
+  for (int i = 0; i < MAX_MESSAGE_HISTORY; i++) {
+    assert(!receive(stranger, MTYPE_TEXT, 100 + i));
+  }
+  assert(!receive(stranger, MTYPE_TEXT, 10));
+
+  // The history holds its own references, nothing else is left.
+  assert(packet_stats.in_use <= in_use + MAX_MESSAGE_HISTORY);
+}
+
+// A source with a neighbour entry is checked against its window as well.
+static void test_window() {
+  const uid_t source = {.bytes = {0x60, 0x61, 0x62}};
+  const uid_t other = {.bytes = {0x60, 0x61, 0x63}};
+  update_neighbour(source, -50, 0);
+  update_neighbour(other, -50, 0);
+  seq_window_t *window = &find_neighbour(source)->window;
+
+  assert(!receive(source, MTYPE_TEXT, 250));
+  assert(!receive(source, MTYPE_TEXT, 251));
+  assert(receive(source, MTYPE_TEXT, 251));
+  assert(window->received == 2 && window->duplicates == 1);
+
+  // Remembered however many messages of other sources came in between.
+  for (int i = 0; i < 2 * MAX_MESSAGE_HISTORY; i++) {
+    assert(!receive(other, MTYPE_TEXT, i));
+  }
+  assert(receive(source, MTYPE_TEXT, 250));
+
+  // Across the wrap of the mids, 252 to 1 missing.
+  assert(!receive(source, MTYPE_TEXT, 2));
+  assert(window->highest == 2 && window->lost == 6);
+  // One of them arrives late.
+  assert(!receive(source, MTYPE_TEXT, 0));
+  assert(window->lost == 5 && window->reordered == 1);
+  assert(receive(source, MTYPE_TEXT, 0));
+
+  // Older than the window, only the history can tell. A source that rebooted without its hello
+  // heard gets its messages through, and the window stays where it was with everything it has seen.
+  mid_t rebooted = (mid_t)(2 - SEQ_WINDOW_SIZE - 10);
+  assert(!receive(source, MTYPE_TEXT, rebooted));
+  assert(receive(source, MTYPE_TEXT, rebooted));
+  assert(!receive(source, MTYPE_TEXT, (mid_t)(rebooted + 1)));
+  assert(window->highest == 2);
+  assert(receive(source, MTYPE_TEXT, 0));
+  assert(receive(source, MTYPE_TEXT, 2));
+  assert(!receive(source, MTYPE_TEXT, 1));
+
+  // A hello behind the window is the source starting over after a reboot.
+  assert(!receive(source, MTYPE_HELLO, 200));
+  assert(window->highest == 200);
+  assert(!receive(source, MTYPE_TEXT, 201));
+
+  // So is a window left alone for longer than a message is retried.
+  host_clock_us += (uint64_t)(SEQ_WINDOW_TIMEOUT + 1) * 1000;
+  assert(!receive(source, MTYPE_TEXT, 150));
+  assert(window->highest == 150);
+}
+
+static void test_acks() {
+  uint32_t in_use = packet_stats.in_use;
+
+  packet_t packet = packet_alloc();
+  assert(packet != PACKET_NONE);
+  packet_get(packet)->message = new_text_message(PEER, TEXT_OK);
+  mid_t mid = packet_get(packet)->message.id;
+
+  absolute_time_t timeout = add_ack(packet);
+  ack_t *ack = &ack_list[mid];
+  assert(timeout > platform_now() && ack->timeout == timeout);
+  assert(ack->packet == packet && ack->retries == ACK_MAX_RETRIES);
+  assert(check_ack_list() == timeout);
+
+  // The list keeps the packet after the sender lets go of it.
+  packet_unref(packet);
+  assert(packet_stats.in_use == in_use + 1);
+
+  // Sent again, one retry less.
+  add_ack(packet);
+  assert(ack->packet == packet && ack->retries == ACK_MAX_RETRIES - 1);
+
+  remove_ack(mid);
+  assert(ack->timeout == 0 && ack->packet == PACKET_NONE);
+  assert(check_ack_list() == PLATFORM_END_OF_TIME);
+  assert(packet_stats.in_use == in_use);
+}
+
+static void test_neighbours() {
+  const uid_t uid = {.bytes = {0x50, 0x51, 0x52}};
+  // Whatever the tests before told the UI core.
+  core_msg_t msg;
+  while (receive_on_ui(&msg)) {
+  }
+  neighbour_table_t copy;
+  copy_neighbour_table(&copy);
+  uint8_t count = neighbour_table.count;
+
+  update_neighbour(uid, -70, 0x0102);
+  assert(neighbour_table.count == count + 1);
+  neighbour_t *neighbour = find_neighbour(uid);
+  assert(neighbour != NULL && neighbour->rssi == -70);
+  assert(neighbour->version_major == 1 && neighbour->version_minor == 2);
+  assert(neighbour->last_seen == platform_now());
+
+  // Updated in place, an rssi or a version of 0 keeps the one known.
+  host_clock_us += 1000;
+  update_neighbour(uid, -60, 0);
+  update_neighbour(uid, 0, 0);
+  assert(neighbour_table.count == count + 1);
+  assert(neighbour->rssi == -60 && neighbour->version_major == 1);
+  assert(neighbour->last_seen == platform_now());
+
+  // The UI core is told once and learns a neighbour was added.
+  int events = 0;
+  while (receive_on_ui(&msg)) {
+    events += msg.type == CORE_EVENT_NEIGHBOURS;
+  }
+  assert(events == 1);
+  assert(copy_neighbour_table(&copy));
+  assert(copy.count == neighbour_table.count);
+  assert(memcmp(&copy, &neighbour_table, sizeof(neighbour_table_t)) == 0);
+  assert(!copy_neighbour_table(&copy));
+}
+
+typedef struct {
+  const char *name;
+  void (*run)();
+} test_t;
+
+static test_t tests[] = {
+    {"constructors", test_constructors},
+    {"history", test_history},
+    {"window", test_window},
+    {"acks", test_acks},
+    {"neighbours", test_neighbours},
+};
+
+#define NUM_TESTS (sizeof(tests) / sizeof(tests[0]))
+
+int main(int argc, char **argv) {
+  bool verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+  // The core logs to stdout, keep the report readable.
+  FILE *report = stdout;
+  if (!verbose) {
+    report = host_silence_stdout();
+  }
+
+  setup_log();
+  setup_channel();
+  vradio_attach(NULL);
+  setup_sx126x();
+  setup_network();
+
+  for (int t = 0; t < NUM_TESTS; t++) {
+    tests[t].run();
+    fprintf(report, "%-16s ok\n", tests[t].name);
+    fflush(report);
+  }
+  return 0;
+}
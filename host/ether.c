@@ -0,0 +1,280 @@
+/**
+ * Ether broker
+ *
+ * The air between firmware processes running on the host (see host/vnode.c). Every node connects
+ * to the broker's socket and says which node of the topology it is, then hands it each frame its
+ * virtual radio sends. The broker keeps the frame on the air for its time on air, in real time,
+ * then tells the sender it is done and passes it on to every node the medium of host/medium.c
+ * lets it through to: in range, not collided and not dropped. The nodes raise DIO1 for both, and
+ * drop what their radio wasn't listening for.
+ *
+ * The topology is a scenario file as the mesh simulator reads it, of which the broker only takes
+ * the medium and the seed. Without one, the nodes are all next to each other.
+ * The broker leaves with a report once the last node has left.
+ *
+ * Usage: ether [-p socket] [-n nodes] [-s seed] [-v] [scenario]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ether.h"
+#include "host.h"
+#include "medium.h"
+
+typedef struct {
+  int fd;
+  // Node of the topology, -1 until it joined.
+  int node;
+} client_t;
+
+static client_t clients[MEDIUM_MAX_NODES];
+static int client_count = 0;
+static int node_client[MEDIUM_MAX_NODES];
+
+// Frames still on the air.
+static uint32_t airing[MEDIUM_MAX_FRAMES];
+static int airing_count = 0;
+
+static uint64_t boot_ns = 0;
+static uint64_t seed = 1;
+static bool verbose = false;
+
+static struct {
+  uint32_t joined;
+  uint32_t frames;
+  uint64_t airtime_us;
+  uint32_t receptions;
+  uint32_t collisions;
+  uint32_t dropped;
+} stats = {0};
+
+static absolute_time_t ether_now() { return (host_now_ns() - boot_ns) / 1000; }
+
+// The broker only needs the seed of the traffic directives.
+static bool parse_directive(int argc, char **argv) {
+  if (strcmp(argv[0], "seed") == 0 && argc == 2) {
+    seed = strtoull(argv[1], NULL, 0);
+  }
+  return true;
+}
+
+static void drop_client(int index) {
+  client_t *client = &clients[index];
+  if (client->node >= 0) {
+    node_client[client->node] = -1;
+    if (verbose) {
+      printf("%.3f node %d left\n", ether_now() / 1e6, client->node);
+    }
+  }
+  host_close(client->fd);
+  clients[index] = clients[--client_count];
+  if (clients[index].node >= 0 && index < client_count) {
+    node_client[clients[index].node] = index;
+  }
+}
+
+static void send_to_node(int node, const ether_msg_t *msg) {
+  int index = node_client[node];
+  if (index >= 0) {
+    host_send(clients[index].fd, msg, sizeof(ether_msg_t));
+  }
+}
+
+// A frame went off the air: done for the sender, received by whoever the medium lets it through to.
+static void finish_frame(uint32_t id) {
+  const medium_frame_t *frame = medium_frame(id);
+  ether_msg_t done = {.type = ETHER_TX_DONE, .node = frame->node};
+  send_to_node(frame->node, &done);
+
+  ether_msg_t rx = {.type = ETHER_RX, .length = frame->length, .node = frame->node,
+                    .air = frame->air};
+  memcpy(rx.data, frame->data, frame->length);
+
+  for (int r = 0; r < medium_node_count; r++) {
+    double rssi;
+    if (r == frame->node || node_client[r] < 0 || !medium_audible(frame, r, &rssi)) {
+      continue;
+    }
+    if (medium_collided(id, r, rssi)) {
+      stats.collisions++;
+      continue;
+    }
+    if (medium_dropped()) {
+      stats.dropped++;
+      continue;
+    }
+    rx.rssi = (int16_t)lround(rssi);
+    rx.snr = medium_snr(frame, rssi);
+    send_to_node(r, &rx);
+    stats.receptions++;
+    if (verbose) {
+      printf("%.3f %d -> %d, %d bytes, %d dBm\n", ether_now() / 1e6, frame->node, r,
+             frame->length, rx.rssi);
+    }
+  }
+}
+
+static void handle_message(int index, const ether_msg_t *msg) {
+  client_t *client = &clients[index];
+  if (msg->type == ETHER_JOIN) {
+    if (client->node >= 0 || msg->node >= medium_node_count || node_client[msg->node] >= 0) {
+      fprintf(stderr, "node %d cannot join, %d nodes in the topology\n", msg->node,
+              medium_node_count);
+      drop_client(index);
+      return;
+    }
+    client->node = msg->node;
+    node_client[msg->node] = index;
+    stats.joined++;
+    if (verbose) {
+      printf("%.3f node %d joined\n", ether_now() / 1e6, msg->node);
+    }
+  } else if (msg->type == ETHER_TX && client->node >= 0) {
+    uint32_t id = medium_transmit(client->node, ether_now(), msg->data, msg->length, &msg->air);
+    airing[airing_count++] = id;
+    stats.frames++;
+    stats.airtime_us += msg->air.time_on_air_us;
+  }
+}
+
+// Time until the next frame goes off the air, -1 if none is on the air.
+static int64_t next_timeout_us() {
+  if (airing_count == 0) {
+    return -1;
+  }
+  absolute_time_t end = PLATFORM_END_OF_TIME;
+  for (int i = 0; i < airing_count; i++) {
+    end = platform_earliest(end, medium_frame(airing[i])->end);
+  }
+  int64_t timeout = platform_diff_us(ether_now(), end);
+  return timeout > 0 ? timeout : 0;
+}
+
+// Finish the frames off the air, in the order they ended.
+static void finish_frames() {
+  absolute_time_t now = ether_now();
+  while (true) {
+    int first = -1;
+    for (int i = 0; i < airing_count; i++) {
+      absolute_time_t end = medium_frame(airing[i])->end;
+      if (end <= now && (first < 0 || end < medium_frame(airing[first])->end)) {
+        first = i;
+      }
+    }
+    if (first < 0) {
+      return;
+    }
+    uint32_t id = airing[first];
+    airing[first] = airing[--airing_count];
+    finish_frame(id);
+  }
+}
+
+static void report() {
+  printf("ether: %u nodes joined, %.0f s\n", stats.joined, ether_now() / 1e6);
+  printf("air: %u frames, %.1f s on air\n", stats.frames, stats.airtime_us / 1e6);
+  printf("radio: %u passed on, %u collisions, %u dropped\n", stats.receptions, stats.collisions,
+         stats.dropped);
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  const char *path = ETHER_PATH;
+  const char *scenario = NULL;
+  int nodes = 8;
+  long long seed_option = -1;
+  bool usage = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      nodes = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seed_option = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else if (argv[i][0] != '-' && scenario == NULL) {
+      scenario = argv[i];
+    } else {
+      usage = true;
+    }
+  }
+  if (usage) {
+    fprintf(stderr, "usage: %s [-p socket] [-n nodes] [-s seed] [-v] [scenario]\n", argv[0]);
+    return 2;
+  }
+
+  if (scenario != NULL) {
+    if (!medium_read_scenario(scenario, parse_directive)) {
+      return 2;
+    }
+  } else {
+    for (int i = 0; i < nodes; i++) {
+      if (medium_add_node(0, 0) < 0) {
+        return 2;
+      }
+    }
+  }
+  if (seed_option >= 0) {
+    seed = seed_option;
+  }
+  medium_seed(seed);
+  medium_setup_links();
+
+  for (int i = 0; i < MEDIUM_MAX_NODES; i++) {
+    node_client[i] = -1;
+  }
+
+  int listener = host_listen(path);
+  if (listener < 0) {
+    fprintf(stderr, "cannot listen on %s\n", path);
+    return 1;
+  }
+  boot_ns = host_now_ns();
+  printf("ether: %d nodes on %s\n", medium_node_count, path);
+  fflush(stdout);
+
+  int fds[MEDIUM_MAX_NODES + 1];
+  bool ready[MEDIUM_MAX_NODES + 1];
+  while (true) {
+    fds[0] = listener;
+    for (int i = 0; i < client_count; i++) {
+      fds[i + 1] = clients[i].fd;
+    }
+    int polled = client_count;
+    host_poll(fds, ready, polled + 1, next_timeout_us());
+
+    finish_frames();
+
+    // Backwards, a client leaving moves the last one into its place.
+    for (int i = polled - 1; i >= 0; i--) {
+      if (!ready[i + 1]) {
+        continue;
+      }
+      ether_msg_t msg;
+      if (host_read(clients[i].fd, &msg, sizeof(msg)) != sizeof(msg)) {
+        drop_client(i);
+      } else {
+        handle_message(i, &msg);
+      }
+    }
+    if (stats.joined > 0 && client_count == 0) {
+      break;
+    }
+
+    if (ready[0] && client_count < MEDIUM_MAX_NODES) {
+      int fd = host_accept(listener);
+      if (fd >= 0) {
+        clients[client_count++] = (client_t){.fd = fd, .node = -1};
+      }
+    }
+  }
+
+  host_close(listener);
+  report();
+  return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef _ETHER_H
+#define _ETHER_H
+
+#include <stdint.h>
+
+#include "vradio.h"
+
+// Socket of the broker, unless told otherwise.
+#define ETHER_PATH "/tmp/voidlink-ether"
+
+// Messages between the ether broker and the firmware processes on it.
+typedef enum {
+  // Node to ether, first thing after connecting: which node of the topology it is.
+  ETHER_JOIN,
+  // Node to ether: the radio started sending a frame.
+  ETHER_TX,
+  // Ether to node: the frame it sent is off the air.
+  ETHER_TX_DONE,
+  // Ether to node: a frame got through to it, the node still has to be listening for it.
+  ETHER_RX,
+} ether_type_t;
+
+// Sent whole every time, both ends are on the same machine.
+typedef struct {
+  uint8_t type;
+  uint8_t length;
+  uint16_t node;
+  int16_t rssi;
+  int8_t snr;
+  vradio_air_t air;
+  uint8_t data[256];
+} ether_msg_t;
+
+#endif // _ETHER_H
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Run a scripted mesh of firmware processes on the ether.
+#
+# Starts the ether broker and one vnode per node, then types the commands of the script into their
+# consoles at the times it gives. Every node and the broker log to a file of their own.
+#
+# Script lines: <time s> <node> <console command>, in order of time, `#` starts a comment.
+#
+# usage: ether_run.sh <build dir> <nodes> <seconds> <script> [log dir] [topology]
+
+set -e
+
+if [ $# -lt 4 ]; then
+  echo "usage: $0 <build dir> <nodes> <seconds> <script> [log dir] [topology]" >&2
+  exit 2
+fi
+
+build=$1
+nodes=$2
+seconds=$3
+script=$4
+logs=${5:-ether-logs}
+topology=$6
+socket=${TMPDIR:-/tmp}/voidlink-ether.$$
+
+mkdir -p "$logs"
+
+# Commands of one node, each after the time it waits for, then quiet until the end of the run.
+feed() {
+  now=0
+  sed -e 's/#.*//' "$script" | {
+    while read -r at node command; do
+      if [ "$node" = "$1" ]; then
+        sleep "$(awk "BEGIN { print $at - $now }")"
+        echo "$command"
+        now=$at
+      fi
+    done
+    sleep "$(awk "BEGIN { t = $seconds - $now; print (t > 0 ? t : 0) }")"
+  }
+}
+
+if [ -n "$topology" ]; then
+  "$build/ether" -p "$socket" -v "$topology" > "$logs/ether.log" 2>&1 &
+else
+  "$build/ether" -p "$socket" -n "$nodes" -v > "$logs/ether.log" 2>&1 &
+fi
+ether=$!
+while [ ! -S "$socket" ]; do
+  sleep 0.1
+done
+
+node=0
+while [ "$node" -lt "$nodes" ]; do
+  feed "$node" | "$build/vnode" -p "$socket" "$node" > "$logs/node$node.log" 2>&1 &
+  node=$((node + 1))
+done
+
+wait "$ether"
+rm -f "$socket"
+tail -n 3 "$logs/ether.log"
@@ -0,0 +1,244 @@
+/**
+ * Fake e-paper backend
+ *
+ * Implements DEV_Config.h for the host. The SPI stream is decoded like the SSD1680 controller
+ * would: commands and data are told apart by DC, RAM writes follow the address window and data
+ * entry mode, and activating a display update copies the new image RAM onto the panel.
+ *
+ * Like the controller, the new image is also copied to the previous image RAM after an update,
+ * which is what partial refreshes compare against. A hardware reset brings the registers back to
+ * their defaults, and after deep sleep mode 2 the RAM content is lost as well.
+ */
+
+#include <string.h>
+
+#include "DEV_Config.h"
+
+#include "fake_epd.h"
+#include "host.h"
+
+int EPD_RST_PIN = 12;
+int EPD_DC_PIN = 8;
+int EPD_CS_PIN = 9;
+int EPD_BUSY_PIN = 13;
+int EPD_CLK_PIN = 10;
+int EPD_MOSI_PIN = 11;
+
+fake_epd_stats_t fake_epd_stats = {0};
+
+// Controller state.
+static struct {
+  UBYTE dc;
+  UBYTE cs;
+  UBYTE rst;
+  UBYTE sleep_mode;
+
+  UBYTE command;
+  uint32_t index;
+
+  UBYTE update_sequence;
+  UBYTE entry_mode;
+  UWORD x_start, x_end, y_start, y_end;
+  UWORD x, y;
+
+  // 0: new image (0x24), 1: previous image (0x26).
+  UBYTE ram[2][FAKE_EPD_RAM_HEIGHT][FAKE_EPD_RAM_WIDTH];
+  UBYTE panel[FAKE_EPD_RAM_HEIGHT][FAKE_EPD_RAM_WIDTH];
+
+  void (*busy_handler)(void);
+  bool busy_armed;
+} epd = {.dc = 1, .cs = 1, .rst = 1, .entry_mode = 0x03};
+
+void fake_epd_reset_stats() { memset(&fake_epd_stats, 0, sizeof(fake_epd_stats)); }
+
+bool fake_epd_sleeping() { return epd.sleep_mode != 0; }
+
+void fake_epd_visible_frame(uint8_t *frame) {
+  for (int y = 0; y < FAKE_EPD_HEIGHT; y++) {
+    memcpy(frame + y * FAKE_EPD_WIDTH_BYTES, epd.panel[y], FAKE_EPD_WIDTH_BYTES);
+  }
+}
+
+// Advance the address counters after a RAM write, following the data entry mode.
+static void advance_address() {
+  bool x_inc = epd.entry_mode & 0x01;
+  bool y_inc = epd.entry_mode & 0x02;
+  bool y_first = epd.entry_mode & 0x04;
+
+  UWORD *first = y_first ? &epd.y : &epd.x;
+  UWORD *second = y_first ? &epd.x : &epd.y;
+  UWORD first_start = y_first ? epd.y_start : epd.x_start;
+  UWORD first_end = y_first ? epd.y_end : epd.x_end;
+  UWORD second_start = y_first ? epd.x_start : epd.y_start;
+  UWORD second_end = y_first ? epd.x_end : epd.y_end;
+  bool first_inc = y_first ? y_inc : x_inc;
+  bool second_inc = y_first ? x_inc : y_inc;
+
+  if (*first != (first_inc ? first_end : first_start)) {
+    *first += first_inc ? 1 : -1;
+    return;
+  }
+  *first = first_inc ? first_start : first_end;
+  if (*second != (second_inc ? second_end : second_start)) {
+    *second += second_inc ? 1 : -1;
+  } else {
+    *second = second_inc ? second_start : second_end;
+  }
+}
+
+static void write_ram(int ram, UBYTE value) {
+  if (epd.x < FAKE_EPD_RAM_WIDTH && epd.y < FAKE_EPD_RAM_HEIGHT) {
+    epd.ram[ram][epd.y][epd.x] = value;
+  }
+  advance_address();
+}
+
+// Run the display update sequence set with 0x22.
+static void activate() {
+  fake_epd_stats.updates[epd.update_sequence]++;
+
+  // Sequences without the display bit only load the temperature or the waveform.
+  if (epd.update_sequence & 0x04) {
+    memcpy(epd.panel, epd.ram[0], sizeof(epd.panel));
+    memcpy(epd.ram[1], epd.ram[0], sizeof(epd.ram[1]));
+  }
+
+  // The update finishes instantly, release BUSY right away.
+  if (epd.busy_armed) {
+    epd.busy_armed = false;
+    epd.busy_handler();
+  }
+}
+
+// Register defaults after a reset.
+static void reset_registers() {
+  epd.entry_mode = 0x03;
+  epd.x_start = 0;
+  epd.x_end = FAKE_EPD_RAM_WIDTH - 1;
+  epd.y_start = 0;
+  epd.y_end = FAKE_EPD_RAM_HEIGHT - 1;
+  epd.x = 0;
+  epd.y = 0;
+}
+
+static void command(UBYTE value) {
+  fake_epd_stats.commands++;
+  epd.command = value;
+  epd.index = 0;
+
+  switch (value) {
+  case 0x12: // SWRESET
+    reset_registers();
+    break;
+  case 0x20: // Master activation
+    activate();
+    break;
+  }
+}
+
+static void data(UBYTE value) {
+  fake_epd_stats.data_bytes++;
+  uint32_t i = epd.index++;
+
+  switch (epd.command) {
+  case 0x10: // Deep sleep
+    epd.sleep_mode = value & 0x03;
+    break;
+  case 0x11: // Data entry mode
+    epd.entry_mode = value & 0x07;
+    break;
+  case 0x22: // Display update sequence
+    epd.update_sequence = value;
+    break;
+  case 0x24: // Write new image RAM
+    write_ram(0, value);
+    break;
+  case 0x26: // Write previous image RAM
+    write_ram(1, value);
+    break;
+  case 0x44: // RAM X start and end
+    if (i == 0) {
+      epd.x_start = value & 0x3F;
+    } else if (i == 1) {
+      epd.x_end = value & 0x3F;
+    }
+    break;
+  case 0x45: // RAM Y start and end
+    if (i == 0) {
+      epd.y_start = value;
+    } else if (i == 1) {
+      epd.y_start |= (value & 0x01) << 8;
+    } else if (i == 2) {
+      epd.y_end = value;
+    } else if (i == 3) {
+      epd.y_end |= (value & 0x01) << 8;
+    }
+    break;
+  case 0x4E: // RAM X counter
+    epd.x = value & 0x3F;
+    break;
+  case 0x4F: // RAM Y counter
+    if (i == 0) {
+      epd.y = value;
+    } else {
+      epd.y |= (value & 0x01) << 8;
+    }
+    break;
+  }
+}
+
+void DEV_Digital_Write(UWORD Pin, UBYTE Value) {
+  if (Pin == EPD_DC_PIN) {
+    epd.dc = Value;
+  } else if (Pin == EPD_CS_PIN) {
+    epd.cs = Value;
+  } else if (Pin == EPD_RST_PIN) {
+    // A hardware reset wakes the controller, deep sleep mode 2 doesn't retain the RAM.
+    if (!epd.rst && Value) {
+      fake_epd_stats.resets++;
+      if (epd.sleep_mode == 2) {
+        memset(epd.ram, 0, sizeof(epd.ram));
+      }
+      epd.sleep_mode = 0;
+      reset_registers();
+    }
+    epd.rst = Value;
+  }
+}
+
+// BUSY is never held, updates finish instantly.
+UBYTE DEV_Digital_Read(UWORD Pin) { return 0; }
+
+void DEV_SPI_WriteByte(UBYTE Value) {
+  // Everything is ignored while asleep or not selected.
+  if (epd.cs || epd.sleep_mode) {
+    return;
+  }
+  if (epd.dc) {
+    data(Value);
+  } else {
+    command(Value);
+  }
+}
+
+void DEV_SPI_Write_nByte(uint8_t *pData, uint32_t Len) {
+  for (uint32_t i = 0; i < Len; i++) {
+    DEV_SPI_WriteByte(pData[i]);
+  }
+}
+
+// Delays advance the simulated clock, so the time spent waiting on the controller shows up.
+void DEV_Delay_ms(UDOUBLE xms) { host_clock_us += (uint64_t)xms * 1000; }
+
+void DEV_Busy_Irq_Init(void (*Handler)(void)) { epd.busy_handler = Handler; }
+
+void DEV_Busy_Irq_Arm(void) { epd.busy_armed = true; }
+
+UBYTE DEV_Module_Init(void) { return 0; }
+
+void DEV_SPI_Init(void) {}
+
+void DEV_SPI_SendData(UBYTE Reg) { DEV_SPI_WriteByte(Reg); }
+
+// The panel bus is write only.
+UBYTE DEV_SPI_ReadData(void) { return 0; }
@@ -0,0 +1,31 @@
+#ifndef _FAKE_EPD_H
+#define _FAKE_EPD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Controller RAM size, the SSD1680 addresses 176 x 296 pixels.
+#define FAKE_EPD_RAM_WIDTH 22
+#define FAKE_EPD_RAM_HEIGHT 296
+
+// Visible part of the RAM on the 2.13" panel, in the layout of the frame buffers.
+#define FAKE_EPD_WIDTH_BYTES 16
+#define FAKE_EPD_HEIGHT 250
+#define FAKE_EPD_FRAME_SIZE (FAKE_EPD_WIDTH_BYTES * FAKE_EPD_HEIGHT)
+
+// Traffic seen by the controller.
+// `updates` is indexed by the display update sequence (command 0x22) that was activated.
+typedef struct {
+  uint32_t resets;
+  uint32_t commands;
+  uint32_t data_bytes;
+  uint32_t updates[256];
+} fake_epd_stats_t;
+
+extern fake_epd_stats_t fake_epd_stats;
+
+void fake_epd_reset_stats();
+bool fake_epd_sleeping();
+void fake_epd_visible_frame(uint8_t *frame);
+
+#endif // _FAKE_EPD_H
@@ -0,0 +1,271 @@
+/**
+ * Receive path fuzzer
+ *
+ * Feeds arbitrary frames to the firmware's receive path, the way the radio hands them over: the
+ * virtual radio raises DIO1 with the frame in its buffer, and the radio loop reads it, decodes it
+ * and runs it through the protocol core until there is nothing left to do. Whatever the node
+ * sends back goes nowhere. The first two bytes of an input are the RSSI and SNR of the frame, the
+ * rest is the frame. The decoder is also run on its own, on a frame of every length.
+ *
+ * Built with clang, this is a libFuzzer target. Otherwise it is a driver for AFL or for replaying
+ * a corpus: it runs every file given, or stdin, and `-m` mutates the inputs at random for a while
+ * on machines without a fuzzer. `-c` writes a seed corpus of valid frames.
+ * Either way, build it with sanitizers (VOIDLINK_FUZZ in CMakeLists.txt) so bad accesses abort.
+ *
+ * Usage: fuzz_rx [-c corpus] [-m iterations] [-s seed] [input]...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+
+#include "channel.h"
+#include "events.h"
+#include "inbox.h"
+#include "network.h"
+#include "radio.h"
+
+#include "host.h"
+#include "vradio.h"
+
+// Radio loop passes per frame, a node asking for more is stuck.
+#define MAX_PASSES 64
+// Time between frames, so the timeouts of the core fire now and then.
+#define FRAME_INTERVAL_US 50000
+#define MAX_INPUT 256
+
+static bool ready = false;
+static bool on_air = false;
+
+// The node talks to no one, a frame it sends is off the air as soon as the loop lets it.
+static void fuzz_transmit(const uint8_t *data, uint8_t length, const vradio_air_t *air) {
+  on_air = true;
+}
+
+static void setup() {
+  host_silence_stdout();
+  memset(host_flash, 0xFF, PICO_FLASH_SIZE_BYTES);
+
+  setup_channel();
+  vradio_attach(fuzz_transmit);
+  setup_sx126x();
+  setup_network();
+  setup_inbox();
+  radio_start();
+  ready = true;
+}
+
+// Run the radio loop until it has nothing left to do now, with the UI core draining the channel.
+static void settle() {
+  for (int pass = 0; pass < MAX_PASSES; pass++) {
+    uint32_t events = take_events();
+    if (events == 0 && !on_air) {
+      break;
+    }
+    radio_step(events);
+    if (on_air) {
+      on_air = false;
+      vradio_tx_done();
+    }
+  }
+
+  core_msg_t msg;
+  while (receive_on_ui(&msg)) {
+  }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  if (!ready) {
+    setup();
+  }
+
+  // The decoder on its own, it reads exactly the length it is given.
+  message_t message;
+  uint8_t *copy = malloc(size);
+  memcpy(copy, data, size);
+  decode_message(&message, copy, size > 255 ? 255 : size);
+  free(copy);
+
+  if (size < 2 || size - 2 > MAX_INPUT - 1) {
+    return 0;
+  }
+  host_clock_us += FRAME_INTERVAL_US;
+  settle();
+  vradio_receive(data + 2, size - 2, -(int16_t)data[0], (int8_t)data[1]);
+  settle();
+  return 0;
+}
+
+#ifndef VOIDLINK_LIBFUZZER
+
+static uint64_t rng_state = 1;
+
+static uint32_t next_random() {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return (rng_state * 0x2545F4914F6CDD1Dull) >> 32;
+}
+
+// Flip or set a few bytes, and now and then insert or remove one: most frames of the wrong length
+// don't get past the decoder.
+static size_t mutate(uint8_t *data, size_t size) {
+  int count = 1 + next_random() % 4;
+  for (int i = 0; i < count; i++) {
+    size_t at = size > 0 ? next_random() % size : 0;
+    switch (next_random() % 16) {
+    case 0:
+    case 1:
+    case 2:
+      if (size > 0) {
+        data[at] = next_random();
+      }
+      break;
+    case 3:
+    case 4:
+      if (size > 0) {
+        static const uint8_t interesting[] = {0x00, 0x01, 0x07, 0x7F, 0x80, 0xFE, 0xFF};
+        data[at] = interesting[next_random() % sizeof(interesting)];
+      }
+      break;
+    case 5:
+      if (size < MAX_INPUT) {
+        memmove(data + at + 1, data + at, size - at);
+        data[at] = next_random();
+        size++;
+      }
+      break;
+    case 6:
+      if (size > 0) {
+        memmove(data + at, data + at + 1, size - at - 1);
+        size--;
+      }
+      break;
+    default:
+      if (size > 0) {
+        data[at] ^= 1 << (next_random() % 8);
+      }
+      break;
+    }
+  }
+  return size;
+}
+
+static size_t read_input(FILE *file, uint8_t *data) { return fread(data, 1, MAX_INPUT, file); }
+
+// Valid frames from and to the node, in every direction the protocol knows.
+static bool write_corpus(const char *path) {
+  if (host_mkdir(path) != 0) {
+    fprintf(stderr, "cannot create %s\n", path);
+    return false;
+  }
+
+  static const uid_t PEER = {.bytes = {0x10, 0x20, 0x30}};
+  message_t messages[] = {
+      new_hello_message(),
+      new_ping_message(get_uid()),
+      new_pong_message(get_uid()),
+      new_text_message(get_uid(), TEXT_OK),
+      new_text_message(get_broadcast_uid(), TEXT_SOS),
+      new_request_message(get_uid(), INFO_BATTERY),
+      new_response_message(get_uid(), INFO_UPTIME, 42),
+      new_ack_message(get_uid(), 1),
+  };
+  for (int i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+    messages[i].src = PEER;
+
+    char name[512];
+    snprintf(name, sizeof(name), "%s/%d-%s", path, i, MTYPE_STR[messages[i].mtype]);
+    FILE *file = fopen(name, "wb");
+    if (file == NULL) {
+      fprintf(stderr, "cannot write %s\n", name);
+      return false;
+    }
+    uint8_t link[2] = {60, 8};
+    fwrite(link, 1, sizeof(link), file);
+    fwrite(&messages[i], 1, sizeof(message_t), file);
+    fclose(file);
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *corpus = NULL;
+  long iterations = 0;
+  int first_input = argc;
+  bool usage = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      corpus = argv[++i];
+    } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      iterations = atol(argv[++i]);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      rng_state = strtoull(argv[++i], NULL, 0) * 0x9E3779B97F4A7C15ull + 1;
+    } else if (argv[i][0] != '-') {
+      first_input = i;
+      break;
+    } else {
+      usage = true;
+    }
+  }
+  if (usage) {
+    fprintf(stderr, "usage: %s [-c corpus] [-m iterations] [-s seed] [input]...\n", argv[0]);
+    return 2;
+  }
+
+  if (corpus != NULL) {
+    setup();
+    return write_corpus(corpus) ? 0 : 1;
+  }
+
+  // The inputs, stdin if none is given.
+  static uint8_t inputs[64][MAX_INPUT];
+  static size_t sizes[64];
+  int count = 0;
+  if (first_input == argc) {
+    sizes[count++] = read_input(stdin, inputs[0]);
+  }
+  for (int i = first_input; i < argc && count < 64; i++) {
+    FILE *file = fopen(argv[i], "rb");
+    if (file == NULL) {
+      fprintf(stderr, "cannot open %s\n", argv[i]);
+      return 1;
+    }
+    sizes[count] = read_input(file, inputs[count]);
+    count++;
+    fclose(file);
+  }
+
+  for (int i = 0; i < count; i++) {
+    LLVMFuzzerTestOneInput(inputs[i], sizes[i]);
+  }
+
+  uint8_t data[MAX_INPUT];
+  long decoded = 0;
+  for (long i = 0; i < iterations; i++) {
+    int from = next_random() % count;
+    memcpy(data, inputs[from], sizes[from]);
+    size_t size = mutate(data, sizes[from]);
+    LLVMFuzzerTestOneInput(data, size);
+    // Without coverage to go by, keep some of the mutants the decoder took to mutate further.
+    message_t message;
+    if (size < 2 || size - 2 > 255 || decode_message(&message, data + 2, size - 2) != DECODE_OK) {
+      continue;
+    }
+    decoded++;
+    if (next_random() % 16 == 0) {
+      memcpy(inputs[from], data, size);
+      sizes[from] = size;
+    }
+  }
+
+  fprintf(stderr, "%d inputs, %ld mutations, %ld decoded, rejected: length %u, src %u, mtype %u, data %u\n",
+          count, iterations, decoded, decode_rejects[DECODE_LENGTH], decode_rejects[DECODE_SRC],
+          decode_rejects[DECODE_MTYPE], decode_rejects[DECODE_DATA]);
+  return 0;
+}
+
+#endif // VOIDLINK_LIBFUZZER
@@ -0,0 +1,184 @@
+/**
+ * Host platform
+ *
+ * Everything that needs POSIX lives here, the firmware headers are built as strict C11
+ * (network.h defines its own `uid_t`).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+
+#include "host.h"
+
+uint64_t host_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void host_sleep_us(uint64_t us) {
+  struct timespec ts = {.tv_sec = us / 1000000, .tv_nsec = (us % 1000000) * 1000};
+  while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+  }
+}
+
+int host_mkdir(const char *path) {
+  if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+    return -1;
+  }
+  return 0;
+}
+
+FILE *host_silence_stdout() {
+  FILE *report = fdopen(dup(fileno(stdout)), "w");
+  if (report == NULL || freopen("/dev/null", "w", stdout) == NULL) {
+    return stdout;
+  }
+  return report;
+}
+
+// Copy a file, returns -1 on failure.
+static int copy_file(const char *from, const char *to) {
+  int in = open(from, O_RDONLY);
+  if (in < 0) {
+    return -1;
+  }
+  int out = open(to, O_WRONLY | O_CREAT | O_TRUNC, 0700);
+  if (out < 0) {
+    close(in);
+    return -1;
+  }
+
+  char buffer[1 << 16];
+  ssize_t n;
+  int result = 0;
+  while ((n = read(in, buffer, sizeof(buffer))) > 0) {
+    if (write(out, buffer, n) != n) {
+      result = -1;
+      break;
+    }
+  }
+  if (n < 0) {
+    result = -1;
+  }
+  close(in);
+  close(out);
+  return result;
+}
+
+// The loader hands out the same instance for the same file, so every copy is loaded from a file of
+// its own. The file is gone again once it is mapped.
+void *host_load_copy(const char *library) {
+  char dir[] = "/tmp/voidlink.XXXXXX";
+  if (mkdtemp(dir) == NULL) {
+    return NULL;
+  }
+  char path[sizeof(dir) + 16];
+  snprintf(path, sizeof(path), "%s/copy.so", dir);
+
+  void *handle = NULL;
+  if (copy_file(library, path) == 0) {
+    handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (handle == NULL) {
+      fprintf(stderr, "%s\n", dlerror());
+    }
+  }
+  unlink(path);
+  rmdir(dir);
+  return handle;
+}
+
+void *host_symbol(void *library, const char *name) { return dlsym(library, name); }
+
+static int unix_address(struct sockaddr_un *address, const char *path) {
+  memset(address, 0, sizeof(*address));
+  address->sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address->sun_path)) {
+    return -1;
+  }
+  strcpy(address->sun_path, path);
+  return 0;
+}
+
+// Sockets of the ether are Unix-domain sequenced packets: reliable, ordered and one message per
+// read, like a serial line that keeps the frames apart.
+int host_listen(const char *path) {
+  struct sockaddr_un address;
+  if (unix_address(&address, path) != 0) {
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  // A socket file left behind by an earlier run.
+  unlink(path);
+  if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 16) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int host_accept(int fd) { return accept(fd, NULL, NULL); }
+
+int host_connect(const char *path) {
+  struct sockaddr_un address;
+  if (unix_address(&address, path) != 0) {
+    return -1;
+  }
+  int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  if (connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// A peer that went away is not worth a SIGPIPE, the caller finds out from the result.
+bool host_send(int fd, const void *data, size_t length) {
+  return send(fd, data, length, MSG_NOSIGNAL) == (ssize_t)length;
+}
+
+long host_read(int fd, void *data, size_t size) {
+  ssize_t n;
+  do {
+    n = read(fd, data, size);
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+void host_close(int fd) { close(fd); }
+
+int host_poll(const int *fds, bool *ready, int count, int64_t timeout_us) {
+  struct pollfd polled[count];
+  for (int i = 0; i < count; i++) {
+    polled[i].fd = fds[i];
+    polled[i].events = POLLIN;
+    polled[i].revents = 0;
+  }
+
+  // Round up, waking up early only to sleep again is a waste.
+  int timeout_ms = timeout_us < 0 ? -1 : timeout_us > INT32_MAX * 1000ll ? INT32_MAX
+                                                                         : (timeout_us + 999) / 1000;
+  int n = poll(polled, count, timeout_ms);
+  for (int i = 0; i < count; i++) {
+    ready[i] = n > 0 && polled[i].revents != 0;
+  }
+  return n < 0 ? 0 : n;
+}
@@ -0,0 +1,49 @@
+#ifndef _HOST_H
+#define _HOST_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Simulated time since boot, kept by the host platform layer.
+// Only advances through `sleep_ms` or when set explicitly, so renders are deterministic.
+extern uint64_t host_clock_us;
+
+// Board id and random numbers of the pico SDK shims, fixed so runs are reproducible.
+// Processes standing in for different boards set their own before the firmware starts.
+extern uint8_t host_board_id[8];
+extern uint32_t host_rand_state;
+
+// Have the simulated clock follow the wall clock from now on, for programs running in real time.
+void host_follow_wall_clock();
+
+// Monotonic wall clock in nanoseconds, for measurements.
+uint64_t host_now_ns();
+void host_sleep_us(uint64_t us);
+
+// Create a directory, succeeds if it already exists.
+int host_mkdir(const char *path);
+
+// Send stdout to /dev/null, returns a stream to the original stdout.
+FILE *host_silence_stdout();
+
+// Load a private copy of a shared library, with globals of its own.
+// Symbols it doesn't define are taken from the program, returns NULL on failure.
+void *host_load_copy(const char *library);
+void *host_symbol(void *library, const char *name);
+
+// Unix-domain sockets keeping message boundaries, -1 on failure.
+int host_listen(const char *path);
+int host_accept(int fd);
+int host_connect(const char *path);
+bool host_send(int fd, const void *data, size_t length);
+// Returns the length read, 0 at the end and -1 on failure.
+long host_read(int fd, void *data, size_t size);
+void host_close(int fd);
+
+// Wait until any of the descriptors can be read, or the timeout passes (negative waits forever).
+// Returns how many are ready, `ready` tells which.
+int host_poll(const int *fds, bool *ready, int count, int64_t timeout_us);
+
+#endif // _HOST_H
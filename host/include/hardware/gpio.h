@@ -0,0 +1,25 @@
+// Host shim for the pico SDK gpio functions.
+#ifndef _HOST_HARDWARE_GPIO_H
+#define _HOST_HARDWARE_GPIO_H
+
+#include "pico/types.h"
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+#define GPIO_IRQ_EDGE_FALL 0x4u
+#define GPIO_IRQ_EDGE_RISE 0x8u
+
+typedef enum {
+  GPIO_FUNC_SPI = 1,
+  GPIO_FUNC_SIO = 5,
+} gpio_function_t;
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+static inline void gpio_init(uint gpio) { (void)gpio; }
+static inline void gpio_set_dir(uint gpio, bool out) { (void)gpio, (void)out; }
+static inline void gpio_put(uint gpio, bool value) { (void)gpio, (void)value; }
+static inline bool gpio_get(uint gpio) { (void)gpio; return false; }
+
+#endif // _HOST_HARDWARE_GPIO_H
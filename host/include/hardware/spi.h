@@ -0,0 +1,11 @@
+// Host shim for the pico SDK spi functions.
+// The panel's SPI traffic is handled by the fake EPD backend instead, and the radio's by the
+// virtual radio.
+#ifndef _HOST_HARDWARE_SPI_H
+#define _HOST_HARDWARE_SPI_H
+
+#include "pico/types.h"
+
+typedef struct spi_inst spi_inst_t;
+
+#endif // _HOST_HARDWARE_SPI_H
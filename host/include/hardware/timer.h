@@ -0,0 +1,11 @@
+// Host shim for the pico SDK timer.
+#ifndef _HOST_HARDWARE_TIMER_H
+#define _HOST_HARDWARE_TIMER_H
+
+#include "pico/types.h"
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+bool time_reached(absolute_time_t t);
+
+#endif // _HOST_HARDWARE_TIMER_H
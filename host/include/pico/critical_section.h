@@ -0,0 +1,16 @@
+// Host shim for the pico SDK critical sections.
+// The host tools run every core's code on a single thread.
+#ifndef _HOST_PICO_CRITICAL_SECTION_H
+#define _HOST_PICO_CRITICAL_SECTION_H
+
+#include "pico/types.h"
+
+typedef struct {
+  int unused;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t *crit_sec) {}
+static inline void critical_section_enter_blocking(critical_section_t *crit_sec) {}
+static inline void critical_section_exit(critical_section_t *crit_sec) {}
+
+#endif // _HOST_PICO_CRITICAL_SECTION_H
@@ -0,0 +1,13 @@
+// Host shim for the pico SDK safe flash access.
+// There is no other core to pause, the function runs right away.
+#ifndef _HOST_PICO_FLASH_H
+#define _HOST_PICO_FLASH_H
+
+#include "pico/types.h"
+
+#define PICO_OK 0
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms);
+bool flash_safe_execute_core_init(void);
+
+#endif // _HOST_PICO_FLASH_H
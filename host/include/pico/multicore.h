@@ -0,0 +1,7 @@
+// Host shim for the pico SDK multicore functions.
+#ifndef _HOST_PICO_MULTICORE_H
+#define _HOST_PICO_MULTICORE_H
+
+#include "pico/types.h"
+
+#endif // _HOST_PICO_MULTICORE_H
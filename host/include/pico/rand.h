@@ -0,0 +1,9 @@
+// Host shim for the pico SDK random numbers.
+#ifndef _HOST_PICO_RAND_H
+#define _HOST_PICO_RAND_H
+
+#include "pico/types.h"
+
+uint32_t get_rand_32(void);
+
+#endif // _HOST_PICO_RAND_H
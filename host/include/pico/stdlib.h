@@ -0,0 +1,9 @@
+// Host shim for the pico SDK standard library.
+#ifndef _HOST_PICO_STDLIB_H
+#define _HOST_PICO_STDLIB_H
+
+#include "hardware/gpio.h"
+#include "pico/time.h"
+#include "pico/types.h"
+
+#endif // _HOST_PICO_STDLIB_H
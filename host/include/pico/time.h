@@ -0,0 +1,28 @@
+// Host shim for the pico SDK time functions.
+// Alarms are recorded but never fire, the host tools drive the screens directly.
+#ifndef _HOST_PICO_TIME_H
+#define _HOST_PICO_TIME_H
+
+#include "hardware/timer.h"
+#include "pico/types.h"
+
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+absolute_time_t get_absolute_time(void);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+uint32_t to_ms_since_boot(absolute_time_t t);
+uint64_t to_us_since_boot(absolute_time_t t);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms);
+
+#define at_the_end_of_time ((absolute_time_t)INT64_MAX)
+
+void sleep_ms(uint32_t ms);
+void busy_wait_ms(uint32_t ms);
+
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data,
+                           bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+#endif // _HOST_PICO_TIME_H
@@ -0,0 +1,12 @@
+// Host shim for the pico SDK types.
+#ifndef _HOST_PICO_TYPES_H
+#define _HOST_PICO_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#endif // _HOST_PICO_TYPES_H
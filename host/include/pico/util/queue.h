@@ -0,0 +1,24 @@
+// Host shim for the pico SDK queue.
+// Single threaded, so no locking.
+#ifndef _HOST_PICO_UTIL_QUEUE_H
+#define _HOST_PICO_UTIL_QUEUE_H
+
+#include "pico/types.h"
+
+typedef struct {
+  uint8_t *data;
+  uint16_t wptr;
+  uint16_t rptr;
+  uint16_t element_size;
+  uint16_t element_count;
+} queue_t;
+
+void queue_init(queue_t *q, uint element_size, uint element_count);
+uint queue_get_level(queue_t *q);
+bool queue_is_empty(queue_t *q);
+bool queue_is_full(queue_t *q);
+bool queue_try_add(queue_t *q, const void *data);
+bool queue_try_remove(queue_t *q, void *data);
+bool queue_try_peek(queue_t *q, void *data);
+
+#endif // _HOST_PICO_UTIL_QUEUE_H
@@ -0,0 +1,160 @@
+/**
+ * Log decoder
+ *
+ * Turns the records of `set log binary` (src/log.c) back into the debug output they stand for.
+ * A record only carries the offset of its format string in the `log_formats` section of the
+ * firmware, the strings themselves are read from the ELF file of the build that logged it, 32 or
+ * 64 bit, so the board or a host build alike. A log from another build decodes to garbage.
+ *
+ * Every line of the console log is passed through, the `log` lines decoded in place with the time
+ * they were logged at, in seconds since boot:
+ *   log 40420f00...  ->  15.000000 <- 12 34 56 ...
+ *
+ * Usage: log_decode firmware.elf [console log]
+ */
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+static char *formats = NULL;
+static size_t formats_size = 0;
+
+// Read a whole file, NULL on failure.
+static uint8_t *read_file(const char *path, size_t *size) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t *data = length > 0 ? malloc(length) : NULL;
+  if (data != NULL && fread(data, 1, length, file) != length) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  *size = length;
+  return data;
+}
+
+// Find a section by its name, gives its offset and size in the file.
+// The fields of a section header are the same in both classes, only their width differs.
+static bool find_section(const uint8_t *elf, size_t size, const char *name, size_t *offset,
+                         size_t *length) {
+  if (size < EI_NIDENT || memcmp(elf, ELFMAG, SELFMAG) != 0 || elf[EI_DATA] != ELFDATA2LSB) {
+    return false;
+  }
+  bool wide = elf[EI_CLASS] == ELFCLASS64;
+
+  size_t sections, count, entry, names;
+  if (wide) {
+    const Elf64_Ehdr *header = (const Elf64_Ehdr *)elf;
+    sections = header->e_shoff;
+    count = header->e_shnum;
+    entry = header->e_shentsize;
+    names = header->e_shstrndx;
+  } else {
+    const Elf32_Ehdr *header = (const Elf32_Ehdr *)elf;
+    sections = header->e_shoff;
+    count = header->e_shnum;
+    entry = header->e_shentsize;
+    names = header->e_shstrndx;
+  }
+  if (sections + count * entry > size || names >= count) {
+    return false;
+  }
+
+  // Name, offset and size of the i-th section header.
+#define SECTION(I, FIELD)                                                                          \
+  (wide ? ((const Elf64_Shdr *)(elf + sections + (I) * entry))->FIELD                              \
+        : ((const Elf32_Shdr *)(elf + sections + (I) * entry))->FIELD)
+
+  size_t strings = SECTION(names, sh_offset);
+  for (size_t i = 0; i < count; i++) {
+    size_t at = strings + SECTION(i, sh_name);
+    if (at < size && strncmp((const char *)elf + at, name, size - at) == 0) {
+      *offset = SECTION(i, sh_offset);
+      *length = SECTION(i, sh_size);
+      return *offset + *length <= size;
+    }
+  }
+#undef SECTION
+  return false;
+}
+
+// A record from the hex of a `log` line.
+static bool parse_record(const char *hex, log_record_t *record) {
+  memset(record, 0, sizeof(*record));
+  size_t header = offsetof(log_record_t, payload);
+  size_t size = 0;
+  unsigned int byte;
+  while (size < sizeof(log_record_t) && sscanf(&hex[2 * size], "%2x", &byte) == 1) {
+    ((uint8_t *)record)[size++] = byte;
+  }
+  return size >= header && record->length <= LOG_PAYLOAD_SIZE &&
+         size == header + record->length && record->format < formats_size;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s firmware.elf [console log]\n", argv[0]);
+    return 2;
+  }
+
+  size_t size;
+  uint8_t *elf = read_file(argv[1], &size);
+  size_t offset;
+  if (elf == NULL || !find_section(elf, size, "log_formats", &offset, &formats_size)) {
+    fprintf(stderr, "no log_formats section in %s\n", argv[1]);
+    return 1;
+  }
+  // Every string is terminated, keep the last one from running off the end anyway.
+  formats = calloc(formats_size + 1, 1);
+  memcpy(formats, elf + offset, formats_size);
+  free(elf);
+
+  FILE *file = stdin;
+  if (argc == 3 && (file = fopen(argv[2], "r")) == NULL) {
+    fprintf(stderr, "cannot open %s\n", argv[2]);
+    return 1;
+  }
+
+  char line[512];
+  char text[256];
+  log_record_t record;
+  int bad = 0;
+  // A line can be logged in pieces, only its first one gets the time.
+  bool line_start = true;
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (strncmp(line, "log ", 4) != 0) {
+      fputs(line, stdout);
+      continue;
+    }
+    if (!parse_record(&line[4], &record)) {
+      bad++;
+      fputs(line, stdout);
+      continue;
+    }
+    int length = log_format(text, sizeof(text), &formats[record.format], record.payload,
+                            record.length);
+    if (line_start) {
+      printf("%u.%06u ", record.time_us / 1000000, record.time_us % 1000000);
+    }
+    fputs(text, stdout);
+    line_start = length > 0 && text[length - 1] == '\n';
+  }
+
+  if (file != stdin) {
+    fclose(file);
+  }
+  free(formats);
+  if (bad > 0) {
+    fprintf(stderr, "%d log lines could not be decoded\n", bad);
+  }
+  return 0;
+}
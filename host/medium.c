@@ -0,0 +1,245 @@
+/**
+ * Radio medium
+ *
+ * The air between virtual radios, shared by the mesh simulator and the ether broker:
+ * - A frame is on the air for the time on air of the sender's modulation parameters.
+ * - The power heard is the sender's power less a log-distance path loss, with an optional fixed
+ *   lognormal shadowing per link. Frames below the sensitivity of the spreading factor and
+ *   bandwidth are not heard at all.
+ * - Any other frame on the air at the same time and channel destroys it, unless it is weaker by
+ *   the capture threshold.
+ * - Frames that got through can still be dropped at random, for links worse than the model.
+ * Whether the receiver was listening is up to the caller, only it can ask the radio.
+ *
+ * Scenario files hold one directive per line, `#` starts a comment. The medium takes:
+ *   pathloss <dB at 1 m> <exponent>        log-distance path loss
+ *   shadowing <sigma dB>                   lognormal shadowing, fixed per link
+ *   drop <probability>                     random loss of frames
+ *   node <x m> <y m>                       a node, numbered from 0 in order
+ *   grid <columns> <rows> <spacing m>      a grid of nodes
+ * and hands the others to the program reading the file.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "medium.h"
+
+#define TWO_PI 6.283185307179586
+
+medium_config_t medium_config = {
+    .loss_1m_db = 40,
+    .loss_exponent = 3.0,
+    .shadowing_db = 0,
+    .drop = 0,
+};
+
+int medium_node_count = 0;
+
+static struct {
+  double x, y;
+} positions[MEDIUM_MAX_NODES];
+
+static double loss_db[MEDIUM_MAX_NODES][MEDIUM_MAX_NODES];
+
+static medium_frame_t frames[MEDIUM_MAX_FRAMES];
+static uint32_t frames_first = 0;
+static uint32_t frames_next = 0;
+static uint32_t max_time_on_air_us = 0;
+
+static uint64_t rng_state = 1;
+
+// Random numbers of the medium, and of the rest of the run.
+void medium_seed(uint64_t seed) { rng_state = seed * 0x9E3779B97F4A7C15ull + 1; }
+
+uint64_t medium_rand() {
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+  return rng_state * 0x2545F4914F6CDD1Dull;
+}
+
+double medium_uniform() { return (medium_rand() >> 11) * (1.0 / 9007199254740992.0); }
+
+double medium_gaussian() {
+  double u = medium_uniform();
+  double v = medium_uniform();
+  return sqrt(-2.0 * log(u + 1e-300)) * cos(TWO_PI * v);
+}
+
+// Place a node, returns its number or -1 if there are too many.
+int medium_add_node(double x, double y) {
+  if (medium_node_count == MEDIUM_MAX_NODES) {
+    fprintf(stderr, "more than %d nodes\n", MEDIUM_MAX_NODES);
+    return -1;
+  }
+  positions[medium_node_count].x = x;
+  positions[medium_node_count].y = y;
+  return medium_node_count++;
+}
+
+// Path loss of every link, the same both ways.
+void medium_setup_links() {
+  for (int i = 0; i < medium_node_count; i++) {
+    for (int j = i; j < medium_node_count; j++) {
+      double distance = hypot(positions[i].x - positions[j].x, positions[i].y - positions[j].y);
+      if (distance < 1) {
+        distance = 1;
+      }
+      double loss = medium_config.loss_1m_db + 10.0 * medium_config.loss_exponent * log10(distance);
+      if (medium_config.shadowing_db > 0 && i != j) {
+        loss += medium_config.shadowing_db * medium_gaussian();
+      }
+      loss_db[i][j] = loss_db[j][i] = i == j ? 0 : loss;
+    }
+  }
+}
+
+// Returns 1 for a directive of the medium, 0 for any other, -1 for a bad one.
+static int medium_directive(int argc, char **argv) {
+  if (strcmp(argv[0], "pathloss") == 0 && argc == 3) {
+    medium_config.loss_1m_db = atof(argv[1]);
+    medium_config.loss_exponent = atof(argv[2]);
+  } else if (strcmp(argv[0], "shadowing") == 0 && argc == 2) {
+    medium_config.shadowing_db = atof(argv[1]);
+  } else if (strcmp(argv[0], "drop") == 0 && argc == 2) {
+    medium_config.drop = atof(argv[1]);
+  } else if (strcmp(argv[0], "node") == 0 && argc == 3) {
+    return medium_add_node(atof(argv[1]), atof(argv[2])) < 0 ? -1 : 1;
+  } else if (strcmp(argv[0], "grid") == 0 && argc == 4) {
+    int columns = atoi(argv[1]);
+    int rows = atoi(argv[2]);
+    double spacing = atof(argv[3]);
+    for (int y = 0; y < rows; y++) {
+      for (int x = 0; x < columns; x++) {
+        if (medium_add_node(x * spacing, y * spacing) < 0) {
+          return -1;
+        }
+      }
+    }
+  } else {
+    return 0;
+  }
+  return 1;
+}
+
+// Read a scenario file, `directive` gets the directives the medium doesn't know and returns
+// false for bad ones.
+bool medium_read_scenario(const char *path, bool (*directive)(int argc, char **argv)) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+
+  char line[256];
+  int number = 0;
+  bool ok = true;
+  while (ok && fgets(line, sizeof(line), file) != NULL) {
+    number++;
+    char *comment = strchr(line, '#');
+    if (comment != NULL) {
+      *comment = '\0';
+    }
+
+    char *argv[8];
+    int argc = 0;
+    for (char *token = strtok(line, " \t\r\n"); token != NULL && argc < 8;
+         token = strtok(NULL, " \t\r\n")) {
+      argv[argc++] = token;
+    }
+    if (argc == 0) {
+      continue;
+    }
+
+    int medium = medium_directive(argc, argv);
+    ok = medium != 0 ? medium > 0 : directive(argc, argv);
+    if (!ok) {
+      fprintf(stderr, "%s:%d: bad directive '%s'\n", path, number, argv[0]);
+    }
+  }
+  fclose(file);
+  return ok;
+}
+
+// Put a frame on the air, returns its id.
+uint32_t medium_transmit(int node, absolute_time_t now, const uint8_t *data, uint8_t length,
+                         const vradio_air_t *air) {
+  // Forget the frames that can no longer overlap one still on the air.
+  while (frames_first != frames_next &&
+         frames[frames_first % MEDIUM_MAX_FRAMES].end + max_time_on_air_us < now) {
+    frames_first++;
+  }
+  if (frames_next - frames_first == MEDIUM_MAX_FRAMES) {
+    fprintf(stderr, "too many frames on the air\n");
+    exit(1);
+  }
+
+  uint32_t id = frames_next++;
+  medium_frame_t *frame = &frames[id % MEDIUM_MAX_FRAMES];
+  frame->node = node;
+  frame->start = now;
+  frame->end = now + air->time_on_air_us;
+  frame->air = *air;
+  frame->length = length;
+  memcpy(frame->data, data, length);
+
+  if (air->time_on_air_us > max_time_on_air_us) {
+    max_time_on_air_us = air->time_on_air_us;
+  }
+  return id;
+}
+
+const medium_frame_t *medium_frame(uint32_t id) { return &frames[id % MEDIUM_MAX_FRAMES]; }
+
+bool medium_same_channel(const vradio_air_t *a, const vradio_air_t *b) {
+  return a->freq_hz == b->freq_hz && a->sf == b->sf && a->bw_hz == b->bw_hz;
+}
+
+// Noise power over the bandwidth, and the weakest frame the spreading factor still decodes.
+static double noise_floor_dbm(uint32_t bw_hz) {
+  return -174.0 + 10.0 * log10(bw_hz) + MEDIUM_NOISE_FIGURE_DB;
+}
+
+static double sensitivity_dbm(const vradio_air_t *air) {
+  double snr_min = air->sf >= 7 ? -7.5 - 2.5 * (air->sf - 7) : -2.5 * (air->sf - 4);
+  return noise_floor_dbm(air->bw_hz) + snr_min;
+}
+
+// Whether a receiver hears a frame at all, and how strong.
+bool medium_audible(const medium_frame_t *frame, int receiver, double *rssi_dbm) {
+  *rssi_dbm = frame->air.power_dbm - loss_db[frame->node][receiver];
+  return *rssi_dbm >= sensitivity_dbm(&frame->air);
+}
+
+// Whether another frame on the air at the receiver destroyed this one.
+bool medium_collided(uint32_t id, int receiver, double rssi_dbm) {
+  const medium_frame_t *frame = medium_frame(id);
+  for (uint32_t other = frames_first; other != frames_next; other++) {
+    const medium_frame_t *q = medium_frame(other);
+    if (other == id || q->node == receiver || q->start >= frame->end || q->end <= frame->start ||
+        !medium_same_channel(&q->air, &frame->air)) {
+      continue;
+    }
+    double interference = q->air.power_dbm - loss_db[q->node][receiver];
+    if (rssi_dbm - interference < MEDIUM_CAPTURE_DB) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Random loss, takes no random number unless enabled so runs without it stay the same.
+bool medium_dropped() { return medium_config.drop > 0 && medium_uniform() < medium_config.drop; }
+
+int8_t medium_snr(const medium_frame_t *frame, double rssi_dbm) {
+  double snr = rssi_dbm - noise_floor_dbm(frame->air.bw_hz);
+  if (snr > MEDIUM_SNR_MAX_DB) {
+    snr = MEDIUM_SNR_MAX_DB;
+  } else if (snr < MEDIUM_SNR_MIN_DB) {
+    snr = MEDIUM_SNR_MIN_DB;
+  }
+  return (int8_t)lround(snr);
+}
@@ -0,0 +1,62 @@
+#ifndef _MEDIUM_H
+#define _MEDIUM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+#include "vradio.h"
+
+#define MEDIUM_MAX_NODES 256
+// Frames kept for the collision checks, more than can ever be on the air at once.
+#define MEDIUM_MAX_FRAMES 8192
+// A frame is lost to an overlapping one unless it is this much stronger.
+#define MEDIUM_CAPTURE_DB 6.0
+#define MEDIUM_NOISE_FIGURE_DB 6.0
+// Packet SNR the SX126x reports, it saturates outside of this range.
+#define MEDIUM_SNR_MIN_DB -32
+#define MEDIUM_SNR_MAX_DB 31
+
+// A frame on the air, or recently.
+typedef struct {
+  int node;
+  absolute_time_t start;
+  absolute_time_t end;
+  vradio_air_t air;
+  uint8_t length;
+  uint8_t data[256];
+} medium_frame_t;
+
+typedef struct {
+  // Log-distance path loss.
+  double loss_1m_db;
+  double loss_exponent;
+  // Lognormal shadowing, fixed per link.
+  double shadowing_db;
+  // Chance of losing a frame that got through otherwise.
+  double drop;
+} medium_config_t;
+
+extern medium_config_t medium_config;
+extern int medium_node_count;
+
+void medium_seed(uint64_t seed);
+uint64_t medium_rand();
+double medium_uniform();
+double medium_gaussian();
+
+int medium_add_node(double x, double y);
+void medium_setup_links();
+bool medium_read_scenario(const char *path, bool (*directive)(int argc, char **argv));
+
+uint32_t medium_transmit(int node, absolute_time_t now, const uint8_t *data, uint8_t length,
+                         const vradio_air_t *air);
+const medium_frame_t *medium_frame(uint32_t id);
+
+bool medium_same_channel(const vradio_air_t *a, const vradio_air_t *b);
+bool medium_audible(const medium_frame_t *frame, int receiver, double *rssi_dbm);
+bool medium_collided(uint32_t id, int receiver, double rssi_dbm);
+bool medium_dropped();
+int8_t medium_snr(const medium_frame_t *frame, double rssi_dbm);
+
+#endif // _MEDIUM_H
@@ -0,0 +1,49 @@
+#!/bin/sh
+# Mesh benchmark suite.
+#
+# Runs the benchmark scenarios through mesh_sim, writes the figures of each run as JSON and
+# compares them against the checked-in baselines of host/baseline. Fails if any figure regressed by
+# more than its threshold, extra options are handed to mesh_sim (`-r [metric=]percent` sets
+# thresholds). With --update, the results become the new baselines instead.
+#
+# usage: mesh_bench.sh <build dir> [results dir] [--update] [mesh_sim options...]
+
+set -e
+
+if [ $# -lt 1 ]; then
+  echo "usage: $0 <build dir> [results dir] [--update] [mesh_sim options...]" >&2
+  exit 2
+fi
+
+build=$1
+shift
+results=mesh-bench
+if [ $# -gt 0 ] && [ "${1#-}" = "$1" ]; then
+  results=$1
+  shift
+fi
+update=false
+if [ "$1" = "--update" ]; then
+  update=true
+  shift
+fi
+
+host=$(dirname "$0")
+mkdir -p "$results"
+
+failed=""
+for scenario in chain5 cluster20 sos_storm ping_load; do
+  echo "== $scenario"
+  if $update; then
+    "$build/mesh_sim" -j "$host/baseline/$scenario.json" "$@" "$host/scenarios/$scenario.sim"
+  elif ! "$build/mesh_sim" -j "$results/$scenario.json" -b "$host/baseline/$scenario.json" "$@" \
+    "$host/scenarios/$scenario.sim"; then
+    failed="$failed $scenario"
+  fi
+  echo
+done
+
+if [ -n "$failed" ]; then
+  echo "regressions in:$failed"
+  exit 1
+fi
@@ -0,0 +1,872 @@
+/**
+ * Mesh simulator
+ *
+ * Discrete-event simulation of a mesh, every node running the firmware's radio loop and protocol
+ * core (radio.c, network.c, the queues and the inbox) against the virtual radio. Each node is a
+ * private copy of the `sim_node` library, so it has globals of its own as if on its own board,
+ * and the simulator plays the parts around it: the clock, the random numbers and the board id of
+ * the platform layer, the medium the radios send on, and the UI core reading the channel.
+ * Time only moves from one event to the next, so a mesh runs much faster than real time.
+ *
+ * The medium is the one of host/medium.c. On top of it, a receiver has to be listening on the same
+ * channel from the start of the frame to its end, the radio is half-duplex and misses everything
+ * while it sends.
+ *
+ * The scenario file, one directive per line, `#` starts a comment. Besides the directives of the
+ * medium (pathloss, shadowing, drop, node and grid):
+ *   preset DEFAULT|FAST|LONGRANGE          modulation parameters of every node
+ *   duration <s>                           simulated time
+ *   seed <n>                               seed of every random number of the run
+ *   boot <s>                               nodes boot at random within this time
+ *   send <time s> <src> <dst|*> [kind]     a message, to a node or broadcast
+ *   flow <src> <dst|*> <start s> <interval s> <count> [kind]
+ *                                          messages at a fixed interval
+ *   random <start s> <interval s> <count> [kind]
+ *                                          messages between random pairs of nodes
+ * The kind of a message is `text` (the default), `sos` for an SOS text, or `ping` to time the
+ * round trip to the pong, pings can't be broadcast.
+ *
+ * The figures of the run can be written as JSON, and compared against those of an earlier run:
+ * a figure that got worse by more than its threshold, in percent of the baseline, is a regression
+ * and fails the run. Thresholds default to those of `metrics`, `-r` sets one or all of them.
+ *
+ * Usage: mesh_sim [-s seed] [-t seconds] [-l node library] [-v] [-j json] [-b baseline]
+ *                 [-r [metric=]percent]... scenario
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+
+#include "channel.h"
+#include "events.h"
+#include "network.h"
+#include "platform.h"
+#include "stats.h"
+#include "utils.h"
+
+#include "host.h"
+#include "medium.h"
+#include "vradio.h"
+
+#define MAX_NODES MEDIUM_MAX_NODES
+// Radio loop passes per wake up, a node asking for more is stuck.
+#define MAX_PASSES 64
+#define BROADCAST -1
+
+// A node and the entry points of its copy of the firmware.
+typedef struct {
+  uint8_t board_id[PLATFORM_BOARD_ID_SIZE];
+  void *lib;
+  absolute_time_t deadline;
+  absolute_time_t scheduled;
+
+  void (*setup_channel)();
+  void (*setup_network)();
+  void (*setup_inbox)();
+  void (*setup_sx126x)();
+  void (*set_range)(mod_params_t);
+  void (*radio_start)();
+  absolute_time_t (*radio_step)(uint32_t);
+  uint32_t (*take_events)();
+  void (*try_transmit)(message_t);
+  message_t (*new_text_message)(uid_t, text_id_t);
+  message_t (*new_ping_message)(uid_t);
+  uid_t (*get_broadcast_uid)();
+  bool (*receive_on_ui)(core_msg_t *);
+  void (*vradio_attach)(vradio_medium_t);
+  bool (*vradio_listening)(vradio_air_t *, absolute_time_t *);
+  void (*vradio_tx_done)();
+  void (*vradio_receive)(const uint8_t *, uint8_t, int16_t, int8_t);
+  uint32_t (*stat_get)(stat_t);
+  event_stats_t *event_stats;
+  packet_stats_t *packet_stats;
+  ack_stats_t *ack_stats;
+  uint32_t *message_history_duplicates;
+  uint8_t *host_flash;
+} node_t;
+
+typedef enum {
+  SIM_BOOT,
+  SIM_WAKE,
+  SIM_SEND,
+  SIM_TX_END,
+} sim_event_type_t;
+
+typedef struct {
+  absolute_time_t time;
+  // Events at the same time run in the order they were scheduled.
+  uint64_t seq;
+  sim_event_type_t type;
+  int node;
+  uint32_t arg;
+} sim_event_t;
+
+typedef enum {
+  KIND_TEXT,
+  KIND_SOS,
+  KIND_PING,
+  KINDS,
+} kind_t;
+
+static const char *KIND_STR[KINDS] = {"text", "sos", "ping"};
+
+// A message the scenario sends.
+typedef struct {
+  absolute_time_t time;
+  int src;
+  int dst;
+  kind_t kind;
+} send_t;
+
+// A message sent, and who got it.
+typedef struct {
+  absolute_time_t time;
+  int src;
+  int dst;
+  kind_t kind;
+  uint32_t delivered;
+  uint64_t heard[MAX_NODES / 64];
+} sent_t;
+
+typedef struct {
+  double start;
+  double interval;
+  int count;
+  kind_t kind;
+} random_traffic_t;
+
+// Times in microseconds, for percentiles.
+typedef struct {
+  uint64_t *values;
+  size_t count;
+} samples_t;
+
+// A figure of the run, as written to JSON and compared against a baseline.
+typedef struct {
+  const char *name;
+  bool higher_is_better;
+  // Change the wrong way that is still fine, in percent of the baseline.
+  double threshold_pct;
+  double value;
+} metric_t;
+
+typedef enum {
+  METRIC_DELIVERED_PER_MIN,
+  METRIC_DELIVERY_RATIO,
+  METRIC_LATENCY_P50,
+  METRIC_LATENCY_P99,
+  METRIC_RTT_P50,
+  METRIC_RTT_P99,
+  METRIC_RETRANSMISSIONS,
+  METRIC_DUPLICATES,
+  METRIC_AIRTIME,
+  METRICS,
+} metric_id_t;
+
+static metric_t metrics[METRICS] = {
+    {"delivered_per_min", true, 5},  {"delivery_ratio", true, 5},  {"latency_p50_ms", false, 10},
+    {"latency_p99_ms", false, 10},   {"rtt_p50_ms", false, 10},    {"rtt_p99_ms", false, 10},
+    {"retransmissions", false, 10},  {"duplicates", false, 10},    {"airtime_s", false, 10},
+};
+
+static struct {
+  mod_params_t preset;
+  double duration_s;
+  uint64_t seed;
+  double boot_s;
+} config = {
+    .preset = DEFAULT,
+    .duration_s = 600,
+    .seed = 1,
+    .boot_s = 1,
+};
+
+static node_t nodes[MAX_NODES];
+static node_t *current = NULL;
+
+static absolute_time_t sim_now = 0;
+static absolute_time_t sim_end = 0;
+
+static sim_event_t *queue = NULL;
+static size_t queue_length = 0;
+static size_t queue_capacity = 0;
+static uint64_t queue_seq = 0;
+
+static send_t *sends = NULL;
+static size_t send_count = 0;
+static random_traffic_t randoms[16];
+static int random_count = 0;
+
+static sent_t *sent = NULL;
+static size_t sent_count = 0;
+// Index + 1 of the last message sent by each node with each id.
+static uint32_t last_sent[MAX_NODES][MAX_MID];
+
+static samples_t latencies = {0};
+static samples_t rtts = {0};
+
+static struct {
+  uint32_t expected;
+  uint32_t delivered;
+  uint32_t duplicates;
+  uint32_t pings;
+  uint32_t pongs;
+  uint32_t frames;
+  uint64_t airtime_us;
+  uint32_t receptions;
+  uint32_t collisions;
+  uint32_t missed;
+  uint32_t dropped;
+} stats = {0};
+
+static absolute_time_t seconds(double s) { return (absolute_time_t)(s * 1e6); }
+
+// Platform layer of the nodes, every node runs on the simulated clock.
+
+absolute_time_t platform_now() { return sim_now; }
+
+// The nodes never hold up the simulation, their sleeps take no time.
+void platform_sleep_ms(uint32_t ms) {}
+
+uint32_t platform_rand() { return (uint32_t)(medium_rand() >> 32); }
+
+void platform_board_id(uint8_t id[PLATFORM_BOARD_ID_SIZE]) {
+  memcpy(id, current->board_id, PLATFORM_BOARD_ID_SIZE);
+}
+
+uint32_t platform_irq_disable() { return 0; }
+void platform_irq_restore(uint32_t state) {}
+
+void platform_notify() {}
+
+// Only the radio halting waits, a node that lost its radio stops the run.
+void platform_wait(absolute_time_t deadline) {
+  fprintf(stderr, "node %d halted at %.3f s\n", (int)(current - nodes), sim_now / 1e6);
+  exit(1);
+}
+
+static void schedule(absolute_time_t time, sim_event_type_t type, int node, uint32_t arg) {
+  if (queue_length == queue_capacity) {
+    queue_capacity = queue_capacity ? queue_capacity * 2 : 1024;
+    queue = realloc(queue, queue_capacity * sizeof(sim_event_t));
+  }
+
+  sim_event_t event = {.time = time, .seq = queue_seq++, .type = type, .node = node, .arg = arg};
+  size_t i = queue_length++;
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    sim_event_t *p = &queue[parent];
+    if (p->time < event.time || (p->time == event.time && p->seq < event.seq)) {
+      break;
+    }
+    queue[i] = *p;
+    i = parent;
+  }
+  queue[i] = event;
+}
+
+static sim_event_t pop_event() {
+  sim_event_t top = queue[0];
+  sim_event_t last = queue[--queue_length];
+  size_t i = 0;
+  while (true) {
+    size_t child = 2 * i + 1;
+    if (child >= queue_length) {
+      break;
+    }
+    if (child + 1 < queue_length &&
+        (queue[child + 1].time < queue[child].time ||
+         (queue[child + 1].time == queue[child].time && queue[child + 1].seq < queue[child].seq))) {
+      child++;
+    }
+    if (last.time < queue[child].time ||
+        (last.time == queue[child].time && last.seq < queue[child].seq)) {
+      break;
+    }
+    queue[i] = queue[child];
+    i = child;
+  }
+  queue[i] = last;
+  return top;
+}
+
+static uid_t node_uid(int index) {
+  node_t *node = &nodes[index];
+  uid_t uid = {.bytes = {node->board_id[5], node->board_id[6], node->board_id[7]}};
+  return uid;
+}
+
+static int uid_node(uid_t uid) {
+  int index = uid.bytes[1] << 8 | uid.bytes[2];
+  return uid.bytes[0] == 0x51 && index < medium_node_count ? index : -1;
+}
+
+static void add_sample(samples_t *samples, uint64_t value) {
+  if (samples->count % 1024 == 0) {
+    samples->values = realloc(samples->values, (samples->count + 1024) * sizeof(uint64_t));
+  }
+  samples->values[samples->count++] = value;
+}
+
+// Texts sent by the scenario, as the UI core of the receiver is told about them.
+static void record_delivery(node_t *node, const core_msg_t *msg) {
+  int src = uid_node(msg->message.src);
+  if (src < 0 || last_sent[src][msg->message.id] == 0) {
+    return;
+  }
+  sent_t *s = &sent[last_sent[src][msg->message.id] - 1];
+  int receiver = node - nodes;
+  if (s->kind == KIND_PING || (s->dst != BROADCAST && s->dst != receiver)) {
+    return;
+  }
+
+  uint64_t bit = 1ull << (receiver % 64);
+  if (s->heard[receiver / 64] & bit) {
+    stats.duplicates++;
+    return;
+  }
+  s->heard[receiver / 64] |= bit;
+  s->delivered++;
+  stats.delivered++;
+  add_sample(&latencies, msg->time - s->time);
+}
+
+// A pong back at the node that pinged, answers its oldest ping to that node still unanswered.
+static void record_pong(node_t *node, const core_msg_t *msg) {
+  int src = node - nodes;
+  int dst = uid_node(msg->message.src);
+  for (size_t i = 0; dst >= 0 && i < sent_count; i++) {
+    sent_t *s = &sent[i];
+    if (s->kind == KIND_PING && s->src == src && s->dst == dst && s->delivered == 0) {
+      s->delivered = 1;
+      stats.pongs++;
+      add_sample(&rtts, msg->time - s->time);
+      return;
+    }
+  }
+}
+
+// Run the radio loop of a node until it has nothing left to do now, and play its UI core.
+static void run_node(node_t *node) {
+  current = node;
+  for (int pass = 0; pass < MAX_PASSES; pass++) {
+    uint32_t events = node->take_events();
+    if (events == 0 && sim_now < node->deadline) {
+      break;
+    }
+    node->deadline = node->radio_step(events);
+  }
+
+  core_msg_t msg;
+  while (node->receive_on_ui(&msg)) {
+    if (msg.type == CORE_EVENT_MESSAGE && msg.message.mtype == MTYPE_TEXT) {
+      record_delivery(node, &msg);
+    } else if (msg.type == CORE_EVENT_MESSAGE && msg.message.mtype == MTYPE_PONG) {
+      record_pong(node, &msg);
+    }
+  }
+
+  if (node->deadline < sim_end && node->deadline != node->scheduled) {
+    node->scheduled = node->deadline;
+    schedule(node->deadline, SIM_WAKE, node - nodes, 0);
+  }
+}
+
+// The medium of every node: a frame goes on the air.
+static void node_transmit(const uint8_t *data, uint8_t length, const vradio_air_t *air) {
+  uint32_t id = medium_transmit(current - nodes, sim_now, data, length, air);
+  stats.frames++;
+  stats.airtime_us += air->time_on_air_us;
+  schedule(medium_frame(id)->end, SIM_TX_END, current - nodes, id);
+}
+
+// Decide whether a receiver got a frame that just went off the air.
+static void deliver(const medium_frame_t *frame, uint32_t id, node_t *receiver) {
+  int r = receiver - nodes;
+  double rssi;
+  if (!medium_audible(frame, r, &rssi)) {
+    return;
+  }
+
+  current = receiver;
+  vradio_air_t air;
+  absolute_time_t since;
+  if (!receiver->vradio_listening(&air, &since) || since > frame->start ||
+      !medium_same_channel(&air, &frame->air)) {
+    stats.missed++;
+    return;
+  }
+  if (medium_collided(id, r, rssi)) {
+    stats.collisions++;
+    return;
+  }
+  if (medium_dropped()) {
+    stats.dropped++;
+    return;
+  }
+
+  receiver->vradio_receive(frame->data, frame->length, (int16_t)lround(rssi),
+                           medium_snr(frame, rssi));
+  stats.receptions++;
+  run_node(receiver);
+}
+
+static void handle_tx_end(uint32_t id) {
+  const medium_frame_t *frame = medium_frame(id);
+  node_t *sender = &nodes[frame->node];
+
+  current = sender;
+  sender->vradio_tx_done();
+  run_node(sender);
+
+  for (int i = 0; i < medium_node_count; i++) {
+    if (i != frame->node) {
+      deliver(frame, id, &nodes[i]);
+    }
+  }
+}
+
+static void handle_send(const send_t *send) {
+  node_t *node = &nodes[send->src];
+  current = node;
+
+  uid_t dst = send->dst == BROADCAST ? node->get_broadcast_uid() : node_uid(send->dst);
+  message_t message = send->kind == KIND_PING  ? node->new_ping_message(dst)
+                      : send->kind == KIND_SOS ? node->new_text_message(dst, TEXT_SOS)
+                                               : node->new_text_message(dst, TEXT_OK);
+
+  if (sent_count % 1024 == 0) {
+    sent = realloc(sent, (sent_count + 1024) * sizeof(sent_t));
+  }
+  sent_t *s = &sent[sent_count++];
+  memset(s, 0, sizeof(sent_t));
+  s->time = sim_now;
+  s->src = send->src;
+  s->dst = send->dst;
+  s->kind = send->kind;
+  last_sent[send->src][message.id] = sent_count;
+  if (send->kind == KIND_PING) {
+    stats.pings++;
+  } else {
+    stats.expected += send->dst == BROADCAST ? medium_node_count - 1 : 1;
+  }
+
+  node->try_transmit(message);
+  run_node(node);
+}
+
+#define LOAD(node, name)                                                                           \
+  do {                                                                                             \
+    *(void **)&(node)->name = host_symbol((node)->lib, #name);                                     \
+    if ((node)->name == NULL) {                                                                    \
+      fprintf(stderr, "node library has no %s\n", #name);                                          \
+      return false;                                                                                \
+    }                                                                                              \
+  } while (0)
+
+// Load a node's copy of the firmware and set it up, as `main` does on the board.
+static bool load_node(node_t *node, const char *library) {
+  node->lib = host_load_copy(library);
+  if (node->lib == NULL) {
+    fprintf(stderr, "cannot load %s\n", library);
+    return false;
+  }
+
+  LOAD(node, setup_channel);
+  LOAD(node, setup_network);
+  LOAD(node, setup_inbox);
+  LOAD(node, setup_sx126x);
+  LOAD(node, set_range);
+  LOAD(node, radio_start);
+  LOAD(node, radio_step);
+  LOAD(node, take_events);
+  LOAD(node, try_transmit);
+  LOAD(node, new_text_message);
+  LOAD(node, new_ping_message);
+  LOAD(node, get_broadcast_uid);
+  LOAD(node, receive_on_ui);
+  LOAD(node, vradio_attach);
+  LOAD(node, vradio_listening);
+  LOAD(node, vradio_tx_done);
+  LOAD(node, vradio_receive);
+  LOAD(node, stat_get);
+  LOAD(node, event_stats);
+  LOAD(node, packet_stats);
+  LOAD(node, ack_stats);
+  LOAD(node, message_history_duplicates);
+  LOAD(node, host_flash);
+
+  int index = node - nodes;
+  uint8_t id[PLATFORM_BOARD_ID_SIZE] = {0xE6, 0x61, 0x64, 0x08, 0x43, 0x51, index >> 8, index};
+  memcpy(node->board_id, id, sizeof(id));
+  node->deadline = PLATFORM_END_OF_TIME;
+  node->scheduled = PLATFORM_END_OF_TIME;
+
+  // A new board, with its flash erased.
+  memset(node->host_flash, 0xFF, PICO_FLASH_SIZE_BYTES);
+
+  current = node;
+  node->setup_channel();
+  node->vradio_attach(node_transmit);
+  node->setup_sx126x();
+  node->setup_network();
+  node->setup_inbox();
+  if (config.preset != DEFAULT) {
+    node->set_range(config.preset);
+  }
+  return true;
+}
+
+static void add_send(double time, int src, int dst, kind_t kind) {
+  if (send_count % 1024 == 0) {
+    sends = realloc(sends, (send_count + 1024) * sizeof(send_t));
+  }
+  sends[send_count++] = (send_t){.time = seconds(time), .src = src, .dst = dst, .kind = kind};
+}
+
+// The kind of message of an optional last argument, KINDS if it is none.
+static kind_t parse_kind(int argc, char **argv, int index) {
+  if (argc <= index) {
+    return KIND_TEXT;
+  }
+  for (int kind = 0; kind < KINDS; kind++) {
+    if (strcmp(argv[index], KIND_STR[kind]) == 0) {
+      return kind;
+    }
+  }
+  return KINDS;
+}
+
+static int parse_dst(const char *token) { return strcmp(token, "*") == 0 ? BROADCAST : atoi(token); }
+
+// The directives of the simulator, the medium takes the rest.
+static bool parse_directive(int argc, char **argv) {
+  if (strcmp(argv[0], "preset") == 0 && argc == 2) {
+    if (strcmp(argv[1], "FAST") == 0) {
+      config.preset = FAST;
+    } else if (strcmp(argv[1], "LONGRANGE") == 0) {
+      config.preset = LONGRANGE;
+    } else if (strcmp(argv[1], "DEFAULT") == 0) {
+      config.preset = DEFAULT;
+    } else {
+      return false;
+    }
+  } else if (strcmp(argv[0], "duration") == 0 && argc == 2) {
+    config.duration_s = atof(argv[1]);
+  } else if (strcmp(argv[0], "seed") == 0 && argc == 2) {
+    config.seed = strtoull(argv[1], NULL, 0);
+  } else if (strcmp(argv[0], "boot") == 0 && argc == 2) {
+    config.boot_s = atof(argv[1]);
+  } else if (strcmp(argv[0], "send") == 0 && (argc == 4 || argc == 5)) {
+    kind_t kind = parse_kind(argc, argv, 4);
+    if (kind == KINDS) {
+      return false;
+    }
+    add_send(atof(argv[1]), atoi(argv[2]), parse_dst(argv[3]), kind);
+  } else if (strcmp(argv[0], "flow") == 0 && (argc == 6 || argc == 7)) {
+    kind_t kind = parse_kind(argc, argv, 6);
+    if (kind == KINDS) {
+      return false;
+    }
+    for (int i = 0; i < atoi(argv[5]); i++) {
+      add_send(atof(argv[3]) + i * atof(argv[4]), atoi(argv[1]), parse_dst(argv[2]), kind);
+    }
+  } else if (strcmp(argv[0], "random") == 0 && (argc == 4 || argc == 5) && random_count < 16) {
+    kind_t kind = parse_kind(argc, argv, 4);
+    if (kind == KINDS) {
+      return false;
+    }
+    randoms[random_count++] =
+        (random_traffic_t){atof(argv[1]), atof(argv[2]), atoi(argv[3]), kind};
+  } else {
+    return false;
+  }
+  return true;
+}
+
+static bool parse_scenario(const char *path) {
+  bool ok = medium_read_scenario(path, parse_directive);
+
+  for (size_t i = 0; ok && i < send_count; i++) {
+    if (sends[i].src < 0 || sends[i].src >= medium_node_count || sends[i].dst >= medium_node_count ||
+        sends[i].dst == sends[i].src || (sends[i].kind == KIND_PING && sends[i].dst == BROADCAST)) {
+      fprintf(stderr, "%s: message from %d to %d between unknown nodes\n", path, sends[i].src,
+              sends[i].dst);
+      ok = false;
+    }
+  }
+  if (ok && medium_node_count < 2) {
+    fprintf(stderr, "%s: a mesh needs two nodes at least\n", path);
+    ok = false;
+  }
+  return ok;
+}
+
+static int compare_latency(const void *a, const void *b) {
+  uint64_t x = *(const uint64_t *)a;
+  uint64_t y = *(const uint64_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+// Percentile of sorted samples.
+static double percentile_ms(const samples_t *samples, double p) {
+  if (samples->count == 0) {
+    return 0;
+  }
+  return samples->values[(size_t)(p * (samples->count - 1))] / 1000.0;
+}
+
+static void compute_metrics() {
+  qsort(latencies.values, latencies.count, sizeof(uint64_t), compare_latency);
+  qsort(rtts.values, rtts.count, sizeof(uint64_t), compare_latency);
+
+  uint32_t retries = 0, duplicates = 0;
+  for (int i = 0; i < medium_node_count; i++) {
+    retries += nodes[i].ack_stats->retries;
+    duplicates += *nodes[i].message_history_duplicates;
+  }
+
+  metrics[METRIC_DELIVERED_PER_MIN].value = stats.delivered / (config.duration_s / 60);
+  metrics[METRIC_DELIVERY_RATIO].value =
+      stats.expected ? (double)stats.delivered / stats.expected : 0;
+  metrics[METRIC_LATENCY_P50].value = percentile_ms(&latencies, 0.50);
+  metrics[METRIC_LATENCY_P99].value = percentile_ms(&latencies, 0.99);
+  metrics[METRIC_RTT_P50].value = percentile_ms(&rtts, 0.50);
+  metrics[METRIC_RTT_P99].value = percentile_ms(&rtts, 0.99);
+  metrics[METRIC_RETRANSMISSIONS].value = retries;
+  metrics[METRIC_DUPLICATES].value = duplicates;
+  metrics[METRIC_AIRTIME].value = stats.airtime_us / 1e6;
+}
+
+static void report(FILE *out, const char *scenario, uint64_t wall_ns) {
+  uint32_t rx_drops = 0, tx_drops = 0, pool_failures = 0, forwards = 0;
+  for (int i = 0; i < medium_node_count; i++) {
+    rx_drops += nodes[i].event_stats->rx_drops;
+    tx_drops += nodes[i].stat_get(STAT_TX_QUEUE_FULL);
+    forwards += nodes[i].event_stats->forwards;
+    pool_failures += nodes[i].packet_stats->failures;
+  }
+
+  double wall_s = wall_ns / 1e9;
+  fprintf(out, "scenario: %s, %d nodes, %s, seed %llu\n", scenario, medium_node_count,
+          MOD_PARAM_STR[config.preset], (unsigned long long)config.seed);
+  fprintf(out, "time: %.0f s simulated in %.2f s (%.0fx real time)\n", config.duration_s, wall_s,
+          wall_s > 0 ? config.duration_s / wall_s : 0);
+  fprintf(out, "messages: %zu sent, %u expected, %u delivered (%.1f%%), %u duplicates\n",
+          sent_count - stats.pings, stats.expected, stats.delivered,
+          100.0 * metrics[METRIC_DELIVERY_RATIO].value, stats.duplicates);
+  fprintf(out, "latency: p50 %.0f ms, p90 %.0f ms, p99 %.0f ms, max %.0f ms\n",
+          percentile_ms(&latencies, 0.50), percentile_ms(&latencies, 0.90),
+          percentile_ms(&latencies, 0.99), percentile_ms(&latencies, 1.0));
+  if (stats.pings > 0) {
+    fprintf(out, "pings: %u sent, %u answered, rtt p50 %.0f ms, p99 %.0f ms, max %.0f ms\n",
+            stats.pings, stats.pongs, percentile_ms(&rtts, 0.50), percentile_ms(&rtts, 0.99),
+            percentile_ms(&rtts, 1.0));
+  }
+  fprintf(out, "air: %u frames, %.1f s on air, %.0f ms per delivered message\n", stats.frames,
+          stats.airtime_us / 1e6,
+          stats.delivered ? stats.airtime_us / 1000.0 / stats.delivered : 0);
+  fprintf(out, "radio: %u received, %u collisions, %u missed while not listening, %u dropped\n",
+          stats.receptions, stats.collisions, stats.missed, stats.dropped);
+  fprintf(out, "nodes: %u forwards, queue drops: rx %u, tx %u, packet pool failures %u\n",
+          forwards, rx_drops, tx_drops, pool_failures);
+  fprintf(out, "protocol: %.0f retransmissions, %.0f duplicates heard\n",
+          metrics[METRIC_RETRANSMISSIONS].value, metrics[METRIC_DUPLICATES].value);
+}
+
+static bool write_json(const char *path, const char *scenario) {
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return false;
+  }
+  fprintf(file, "{\n");
+  fprintf(file, "  \"scenario\": \"%s\",\n", scenario);
+  fprintf(file, "  \"nodes\": %d,\n", medium_node_count);
+  fprintf(file, "  \"seed\": %llu,\n", (unsigned long long)config.seed);
+  fprintf(file, "  \"duration_s\": %.0f,\n", config.duration_s);
+  for (int i = 0; i < METRICS; i++) {
+    fprintf(file, "  \"%s\": %.3f%s\n", metrics[i].name, metrics[i].value,
+            i < METRICS - 1 ? "," : "");
+  }
+  fprintf(file, "}\n");
+  return fclose(file) == 0;
+}
+
+// Set the threshold of a metric, or of all of them, from `[metric=]percent`.
+static bool set_threshold(const char *option) {
+  const char *equals = strchr(option, '=');
+  double percent = atof(equals != NULL ? equals + 1 : option);
+  bool found = false;
+  for (int i = 0; i < METRICS; i++) {
+    if (equals == NULL || (strncmp(option, metrics[i].name, equals - option) == 0 &&
+                           metrics[i].name[equals - option] == '\0')) {
+      metrics[i].threshold_pct = percent;
+      found = true;
+    }
+  }
+  return found;
+}
+
+// Compare the run against a baseline written by `write_json`, returns false on a regression.
+// Metrics the baseline doesn't have are skipped.
+static bool compare_baseline(FILE *out, const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+  char json[4096];
+  size_t length = fread(json, 1, sizeof(json) - 1, file);
+  json[length] = '\0';
+  fclose(file);
+
+  bool ok = true;
+  fprintf(out, "%-20s %12s %12s %9s\n", "baseline", "was", "now", "change");
+  for (int i = 0; i < METRICS; i++) {
+    metric_t *metric = &metrics[i];
+    char key[64];
+    snprintf(key, sizeof(key), "\"%s\":", metric->name);
+    char *found = strstr(json, key);
+    if (found == NULL) {
+      continue;
+    }
+    double was = strtod(found + strlen(key), NULL);
+    double change = metric->value - was;
+    // The baseline keeps three decimals.
+    if (fabs(change) < 0.0005) {
+      change = 0;
+    }
+    double worse = metric->higher_is_better ? -change : change;
+    bool regression = worse > fabs(was) * metric->threshold_pct / 100;
+    ok = ok && !regression;
+
+    fprintf(out, "%-20s %12.3f %12.3f %+8.1f%% %s\n", metric->name, was, metric->value,
+            was != 0 ? 100 * change / fabs(was) : 0,
+            regression ? "REGRESSION" : worse < 0 ? "better" : "ok");
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  const char *library = MESH_SIM_NODE_LIBRARY;
+  const char *scenario = NULL;
+  const char *json = NULL;
+  const char *baseline = NULL;
+  bool verbose = false;
+  long long seed = -1;
+  double duration = -1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seed = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      duration = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      library = argv[++i];
+    } else if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      json = argv[++i];
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      baseline = argv[++i];
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc && set_threshold(argv[i + 1])) {
+      i++;
+    } else if (argv[i][0] != '-' && scenario == NULL) {
+      scenario = argv[i];
+    } else {
+      scenario = NULL;
+      break;
+    }
+  }
+  if (scenario == NULL) {
+    fprintf(stderr,
+            "usage: %s [-s seed] [-t seconds] [-l node library] [-v] [-j json] [-b baseline]\n"
+            "       [-r [metric=]percent]... scenario\n",
+            argv[0]);
+    return 2;
+  }
+
+  if (!parse_scenario(scenario)) {
+    return 2;
+  }
+  if (seed >= 0) {
+    config.seed = seed;
+  }
+  if (duration >= 0) {
+    config.duration_s = duration;
+  }
+  medium_seed(config.seed);
+  sim_end = seconds(config.duration_s);
+
+  for (int r = 0; r < random_count; r++) {
+    for (int i = 0; i < randoms[r].count; i++) {
+      int src = medium_rand() % medium_node_count;
+      int dst = (src + 1 + medium_rand() % (medium_node_count - 1)) % medium_node_count;
+      add_send(randoms[r].start + i * randoms[r].interval, src, dst, randoms[r].kind);
+    }
+  }
+  medium_setup_links();
+
+  // The nodes log to stdout, keep the report readable.
+  FILE *out = stdout;
+  if (!verbose) {
+    out = host_silence_stdout();
+  }
+
+  uint64_t start = host_now_ns();
+
+  for (int i = 0; i < medium_node_count; i++) {
+    if (!load_node(&nodes[i], library)) {
+      return 1;
+    }
+    schedule(seconds(config.boot_s * medium_uniform()), SIM_BOOT, i, 0);
+  }
+  for (size_t i = 0; i < send_count; i++) {
+    schedule(sends[i].time, SIM_SEND, sends[i].src, i);
+  }
+
+  while (queue_length > 0 && queue[0].time <= sim_end) {
+    sim_event_t event = pop_event();
+    sim_now = event.time;
+    node_t *node = &nodes[event.node];
+
+    switch (event.type) {
+    case SIM_BOOT:
+      current = node;
+      node->radio_start();
+      run_node(node);
+      break;
+    case SIM_WAKE:
+      if (event.time == node->scheduled) {
+        node->scheduled = PLATFORM_END_OF_TIME;
+      }
+      run_node(node);
+      break;
+    case SIM_SEND:
+      handle_send(&sends[event.arg]);
+      break;
+    case SIM_TX_END:
+      handle_tx_end(event.arg);
+      break;
+    }
+  }
+  sim_now = sim_end;
+
+  compute_metrics();
+  report(out, scenario, host_now_ns() - start);
+
+  bool ok = true;
+  if (json != NULL) {
+    ok = write_json(json, scenario);
+  }
+  if (baseline != NULL) {
+    ok = compare_baseline(out, baseline) && ok;
+  }
+  fflush(out);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,123 @@
+/**
+ * Pico SDK shims
+ *
+ * Just enough of the SDK for the display stack and the network tables to run on a host.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+#include "hardware/timer.h"
+#include "pico/flash.h"
+#include "pico/rand.h"
+#include "pico/time.h"
+#include "pico/unique_id.h"
+#include "pico/util/queue.h"
+
+#include "platform.h"
+
+#include "host.h"
+
+// Time is kept by the platform layer, so the SDK and the protocol core agree on it.
+uint64_t time_us_64() { return platform_now(); }
+uint32_t time_us_32() { return (uint32_t)platform_now(); }
+
+absolute_time_t get_absolute_time() { return platform_now(); }
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+  return (int64_t)(to - from);
+}
+uint32_t to_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+uint64_t to_us_since_boot(absolute_time_t t) { return t; }
+absolute_time_t make_timeout_time_ms(uint32_t ms) { return platform_timeout_ms(ms); }
+absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) { return t + (uint64_t)ms * 1000; }
+bool time_reached(absolute_time_t t) { return platform_reached(t); }
+
+void sleep_ms(uint32_t ms) { platform_sleep_ms(ms); }
+void busy_wait_ms(uint32_t ms) { sleep_ms(ms); }
+
+// Alarms never fire, ids are only handed out so they can be cancelled.
+alarm_id_t add_alarm_in_ms(uint32_t ms, alarm_callback_t callback, void *user_data,
+                           bool fire_if_past) {
+  static alarm_id_t next_id = 1;
+  return next_id++;
+}
+bool cancel_alarm(alarm_id_t alarm_id) { return true; }
+
+// Fixed seed and board id, so runs are reproducible.
+uint32_t host_rand_state = 0x56AD11C;
+uint8_t host_board_id[PICO_UNIQUE_BOARD_ID_SIZE_BYTES] = {0xE6, 0x61, 0x64, 0x08,
+                                                          0x43, 0x12, 0x34, 0x56};
+
+uint32_t get_rand_32() {
+  host_rand_state ^= host_rand_state << 13;
+  host_rand_state ^= host_rand_state >> 17;
+  host_rand_state ^= host_rand_state << 5;
+  return host_rand_state;
+}
+
+void pico_get_unique_board_id(pico_unique_board_id_t *id_out) {
+  memcpy(id_out->id, host_board_id, sizeof(host_board_id));
+}
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+  memset(&host_flash[flash_offs], 0xFF, count);
+}
+
+// Programming can only clear bits, like on the flash chip.
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    host_flash[flash_offs + i] &= data[i];
+  }
+}
+
+int flash_safe_execute(void (*func)(void *), void *param, uint32_t enter_exit_timeout_ms) {
+  func(param);
+  return PICO_OK;
+}
+
+bool flash_safe_execute_core_init(void) { return true; }
+
+// Queue with one spare slot to tell full from empty.
+void queue_init(queue_t *q, uint element_size, uint element_count) {
+  q->data = calloc(element_count + 1, element_size);
+  q->element_size = element_size;
+  q->element_count = element_count + 1;
+  q->wptr = 0;
+  q->rptr = 0;
+}
+
+uint queue_get_level(queue_t *q) {
+  return (q->wptr + q->element_count - q->rptr) % q->element_count;
+}
+
+bool queue_is_empty(queue_t *q) { return q->wptr == q->rptr; }
+
+bool queue_is_full(queue_t *q) { return (q->wptr + 1) % q->element_count == q->rptr; }
+
+bool queue_try_add(queue_t *q, const void *data) {
+  if (queue_is_full(q)) {
+    return false;
+  }
+  memcpy(q->data + q->wptr * q->element_size, data, q->element_size);
+  q->wptr = (q->wptr + 1) % q->element_count;
+  return true;
+}
+
+bool queue_try_peek(queue_t *q, void *data) {
+  if (queue_is_empty(q)) {
+    return false;
+  }
+  memcpy(data, q->data + q->rptr * q->element_size, q->element_size);
+  return true;
+}
+
+bool queue_try_remove(queue_t *q, void *data) {
+  if (!queue_try_peek(q, data)) {
+    return false;
+  }
+  q->rptr = (q->rptr + 1) % q->element_count;
+  return true;
+}
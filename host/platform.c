@@ -0,0 +1,66 @@
+/**
+ * Host platform
+ *
+ * The platform layer of the protocol core on the host, on a simulated clock. The pico SDK shims
+ * take their time from here too, so both halves of a host build agree on it.
+ * Everything runs on a single thread: there are no interrupts to keep off and no other core to
+ * wake up, waiting skips straight to the deadline.
+ * Programs running in real time, like the firmware on the ether, have the clock follow the wall
+ * clock instead, and then sleeping and waiting take their time.
+ */
+
+#include "pico/rand.h"
+#include "pico/unique_id.h"
+
+#include "platform.h"
+
+#include "host.h"
+
+uint64_t host_clock_us = 0;
+
+// Wall clock time of boot, 0 while on the simulated clock.
+static uint64_t wall_clock_boot_ns = 0;
+
+void host_follow_wall_clock() { wall_clock_boot_ns = host_now_ns() - host_clock_us * 1000; }
+
+absolute_time_t platform_now() {
+  if (wall_clock_boot_ns != 0) {
+    host_clock_us = (host_now_ns() - wall_clock_boot_ns) / 1000;
+  }
+  return host_clock_us;
+}
+
+void platform_sleep_ms(uint32_t ms) {
+  if (wall_clock_boot_ns != 0) {
+    host_sleep_us((uint64_t)ms * 1000);
+  } else {
+    host_clock_us += (uint64_t)ms * 1000;
+  }
+}
+
+uint32_t platform_rand() { return get_rand_32(); }
+
+void platform_board_id(uint8_t id[PLATFORM_BOARD_ID_SIZE]) {
+  pico_unique_board_id_t board_id;
+  pico_get_unique_board_id(&board_id);
+  for (int i = 0; i < PLATFORM_BOARD_ID_SIZE; i++) {
+    id[i] = board_id.id[i];
+  }
+}
+
+uint32_t platform_irq_disable() { return 0; }
+void platform_irq_restore(uint32_t state) {}
+
+void platform_notify() {}
+
+void platform_wait(absolute_time_t deadline) {
+  if (wall_clock_boot_ns != 0) {
+    // Nothing wakes up a sleeping thread, look again every so often.
+    absolute_time_t now = platform_now();
+    if (deadline > now) {
+      host_sleep_us(platform_earliest(deadline - now, 100000));
+    }
+  } else if (deadline > host_clock_us) {
+    host_clock_us = deadline;
+  }
+}
@@ -0,0 +1,410 @@
+/**
+ * Capture replay
+ *
+ * Feeds a capture of the radio traffic of a node (src/capture.c) back through the firmware's radio
+ * loop and protocol core, on the virtual radio, as that node: every received frame is handed to
+ * the radio at the time it was captured, if the radio is listening then. Messages the node sent of
+ * its own accord, from the console or the buttons, go back into the tx queue when they first went
+ * on the air; what the protocol sends by itself, the node works out again. The clock only moves
+ * from one frame or deadline to the next and the random numbers come from the seed, so the same
+ * capture and seed always replay the same way, much faster than real time.
+ *
+ * The capture is the output of `get capture` on the console, any other lines of the log around it
+ * are skipped, so a log of a whole session can be given as it is. Several `get capture` in a row
+ * are one capture. The report gives the figures of the capture itself, the traffic the node saw
+ * in the field, and those of the replay next to them.
+ *
+ * The node boots at time 0 with an empty flash, as the captured one did unless told otherwise:
+ * `-t` moves the capture against the boot of the node, `-u` and `-r` replace the uid and the
+ * modulation parameters of the capture.
+ *
+ * Usage: replay [-s seed] [-t offset ms] [-d drain s] [-u uid] [-r DEFAULT|FAST|LONGRANGE] [-v]
+ *               capture
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+
+#include "capture.h"
+#include "channel.h"
+#include "events.h"
+#include "inbox.h"
+#include "network.h"
+#include "radio.h"
+#include "utils.h"
+
+#include "host.h"
+#include "vradio.h"
+
+// Radio loop passes per wake up, a node asking for more is stuck.
+#define MAX_PASSES 64
+#define MAX_RECORDS 65536
+// Sends of a message id this close together are retries of one message.
+#define RETRY_WINDOW_US 60000000
+
+static capture_record_t records[MAX_RECORDS];
+static int record_count = 0;
+
+static uid_t uid;
+static bool have_uid = false;
+static mod_params_t preset = DEFAULT;
+static bool verbose = false;
+
+// Frame of the replayed node on the air, and when it comes off it.
+static absolute_time_t tx_end = PLATFORM_END_OF_TIME;
+
+static struct {
+  uint32_t rx;
+  uint32_t tx;
+  uint32_t irqs;
+  uint32_t by_mtype[MTYPES + 1];
+  int rssi_min;
+  int rssi_max;
+  double rssi_sum;
+  double snr_sum;
+  uint64_t airtime_us;
+} field = {.rssi_min = 0, .rssi_max = -200};
+
+static struct {
+  uint32_t injected;
+  // Frames the radio wasn't listening for, it was sending its own.
+  uint32_t missed;
+  uint32_t tx;
+  // Messages of the node's own, sent again.
+  uint32_t originated;
+  uint64_t airtime_us;
+  uint32_t messages;
+} replayed = {0};
+
+// When every message id of the node was last sent, a retry is not a message of its own.
+static absolute_time_t sent_at[MAX_MID];
+static bool sent[MAX_MID];
+
+static mod_params_t parse_preset(const char *name) {
+  return strcmp(name, "FAST") == 0        ? FAST
+         : strcmp(name, "LONGRANGE") == 0 ? LONGRANGE
+                                          : DEFAULT;
+}
+
+static bool parse_uid(const char *string, uid_t *parsed) {
+  return sscanf(string, "%02hhx:%02hhx:%02hhx", &parsed->bytes[0], &parsed->bytes[1],
+                &parsed->bytes[2]) == 3;
+}
+
+static bool parse_record(const char *hex, capture_record_t *record) {
+  if (strspn(hex, "0123456789abcdefABCDEF") < 2 * sizeof(capture_record_t)) {
+    return false;
+  }
+  for (int i = 0; i < sizeof(capture_record_t); i++) {
+    unsigned int byte;
+    sscanf(&hex[2 * i], "%2x", &byte);
+    ((uint8_t *)record)[i] = byte;
+  }
+  return true;
+}
+
+// Read the capture lines out of a console log.
+static bool read_capture(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (file == NULL) {
+    fprintf(stderr, "cannot open %s\n", path);
+    return false;
+  }
+
+  char line[512];
+  while (fgets(line, sizeof(line), file) != NULL) {
+    char *capture = strstr(line, "capture ");
+    if (capture == NULL) {
+      continue;
+    }
+    capture += strlen("capture ");
+
+    char name[16];
+    char mode[16];
+    if (sscanf(capture, "begin %15s %15s", name, mode) == 2) {
+      have_uid = parse_uid(name, &uid) || have_uid;
+      preset = parse_preset(mode);
+    } else if (strncmp(capture, "end", 3) != 0) {
+      if (record_count == MAX_RECORDS) {
+        fprintf(stderr, "more than %d records\n", MAX_RECORDS);
+        break;
+      }
+      if (parse_record(capture, &records[record_count])) {
+        record_count++;
+      }
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+// Records are in the order they were committed, an interrupt can commit before the loop.
+static int compare_records(const void *a, const void *b) {
+  const capture_record_t *x = a;
+  const capture_record_t *y = b;
+  return x->time < y->time ? -1 : x->time > y->time;
+}
+
+static uint32_t time_on_air_us() {
+  sx126x_pkt_params_lora_t pkt = {
+      .preamble_len_in_symb = 0x10,
+      .header_type = SX126X_LORA_PKT_EXPLICIT,
+      .pld_len_in_bytes = sizeof(message_t),
+      .crc_is_on = true,
+  };
+  sx126x_mod_params_lora_t mod = preset == FAST        ? MOD_PARAMS_FAST
+                                 : preset == LONGRANGE ? MOD_PARAMS_LONGRANGE
+                                                       : MOD_PARAMS_DEFAULT;
+  return vradio_time_on_air_us(&pkt, &mod);
+}
+
+static void analyse_capture() {
+  uint32_t air_us = time_on_air_us();
+  for (int i = 0; i < record_count; i++) {
+    const capture_record_t *record = &records[i];
+    const message_t *message = (const message_t *)record->data;
+    if (record->kind == CAPTURE_RX) {
+      field.rx++;
+      field.rssi_min = record->rssi < field.rssi_min ? record->rssi : field.rssi_min;
+      field.rssi_max = record->rssi > field.rssi_max ? record->rssi : field.rssi_max;
+      field.rssi_sum += record->rssi;
+      field.snr_sum += record->snr;
+    } else if (record->kind == CAPTURE_TX) {
+      field.tx++;
+      field.airtime_us += air_us;
+    } else {
+      field.irqs++;
+      continue;
+    }
+    bool valid = record->length == sizeof(message_t) && message->mtype < MTYPES;
+    field.by_mtype[valid ? message->mtype : MTYPES]++;
+  }
+}
+
+// The replayed node sends into the void, the frame is off the air after its time on air.
+static void replay_transmit(const uint8_t *data, uint8_t length, const vradio_air_t *air) {
+  tx_end = platform_now() + air->time_on_air_us;
+  replayed.tx++;
+  replayed.airtime_us += air->time_on_air_us;
+  if (verbose) {
+    printf("%10.3f tx %s\n", platform_now() / 1e6, MTYPE_STR[((message_t *)data)->mtype]);
+  }
+}
+
+// Run the radio loop until it has nothing left to do now, the UI core only counts the messages.
+static absolute_time_t run_radio(absolute_time_t deadline) {
+  for (int pass = 0; pass < MAX_PASSES; pass++) {
+    uint32_t events = take_events();
+    if (events == 0 && !platform_reached(deadline)) {
+      break;
+    }
+    deadline = radio_step(events);
+  }
+
+  core_msg_t msg;
+  while (receive_on_ui(&msg)) {
+    if (msg.type == CORE_EVENT_MESSAGE) {
+      replayed.messages++;
+    }
+  }
+  return deadline;
+}
+
+// Move the clock up to `time`, running the loop at every deadline and frame end on the way.
+static absolute_time_t run_until(absolute_time_t time, absolute_time_t deadline) {
+  while (true) {
+    absolute_time_t next = platform_earliest(deadline, tx_end);
+    if (next > time) {
+      break;
+    }
+    if (next > host_clock_us) {
+      host_clock_us = next;
+    }
+    if (platform_reached(tx_end)) {
+      tx_end = PLATFORM_END_OF_TIME;
+      vradio_tx_done();
+    }
+    deadline = run_radio(deadline);
+  }
+  if (time > host_clock_us) {
+    host_clock_us = time;
+  }
+  return deadline;
+}
+
+// Whether a captured frame is a message the node sent of its own accord, the first time.
+static bool originated(const capture_record_t *record) {
+  const message_t *message = (const message_t *)record->data;
+  if (!is_my_uid(message->src) || !(message->mtype == MTYPE_PING || message->mtype == MTYPE_TEXT ||
+                                    message->mtype == MTYPE_REQ || message->mtype == MTYPE_RAW)) {
+    return false;
+  }
+  bool retry = sent[message->id] && record->time - sent_at[message->id] < RETRY_WINDOW_US;
+  sent[message->id] = true;
+  sent_at[message->id] = record->time;
+  return !retry;
+}
+
+static absolute_time_t replay_record(const capture_record_t *record, absolute_time_t deadline) {
+  if (record->kind == CAPTURE_TX && originated(record)) {
+    message_t message;
+    memcpy(&message, record->data, sizeof(message_t));
+    try_transmit(message);
+    replayed.originated++;
+    return run_radio(deadline);
+  }
+  if (record->kind != CAPTURE_RX) {
+    return deadline;
+  }
+
+  vradio_air_t air;
+  absolute_time_t since;
+  if (!vradio_listening(&air, &since)) {
+    replayed.missed++;
+    return deadline;
+  }
+
+  // Frames longer than a message were only captured in part, the rest reads as zeros.
+  uint8_t frame[256] = {0};
+  memcpy(frame, record->data, sizeof(record->data));
+  vradio_receive(frame, record->length, record->rssi, record->snr);
+  replayed.injected++;
+  if (verbose) {
+    const message_t *message = (const message_t *)record->data;
+    printf("%10.3f rx %d bytes, %s from %s, %d dBm\n", record->time / 1e6, record->length,
+           message->mtype < MTYPES ? MTYPE_STR[message->mtype] : "?", uid_to_string(message->src),
+           record->rssi);
+  }
+  return run_radio(deadline);
+}
+
+static void report(FILE *out, double span_s) {
+  double minutes = span_s > 0 ? span_s / 60 : 1;
+  double rx = field.rx > 0 ? field.rx : 1;
+  fprintf(out, "capture: %d records over %.1f s, uid %s, %s\n", record_count, span_s,
+          uid_to_string(get_uid()), MOD_PARAM_STR[preset]);
+  fprintf(out, "field rx: %u frames, %.1f/min, rssi %d/%.1f/%d dBm (min/avg/max), snr %.1f dB\n",
+          field.rx, field.rx / minutes, field.rx > 0 ? field.rssi_min : 0, field.rssi_sum / rx,
+          field.rx > 0 ? field.rssi_max : 0, field.snr_sum / rx);
+  fprintf(out, "field tx: %u frames, %.1f/min, %.1f s on air, %u other irqs\n", field.tx,
+          field.tx / minutes, field.airtime_us / 1e6, field.irqs);
+  fprintf(out, "frames:");
+  for (int i = 0; i < MTYPES; i++) {
+    fprintf(out, " %s %u,", MTYPE_STR[i], field.by_mtype[i]);
+  }
+  fprintf(out, " invalid %u\n", field.by_mtype[MTYPES]);
+
+  uint32_t rejected = 0;
+  for (int i = DECODE_OK + 1; i < DECODE_RESULTS; i++) {
+    rejected += decode_rejects[i];
+  }
+  fprintf(out, "replay rx: %u injected, %u missed while sending, %u rejected, %u duplicates\n",
+          replayed.injected, replayed.missed, rejected, message_history_duplicates);
+  fprintf(out, "replay tx: %u frames, %u its own, %.1f s on air, %u retries, %u expired\n",
+          replayed.tx, replayed.originated, replayed.airtime_us / 1e6, ack_stats.retries,
+          ack_stats.expired);
+  fprintf(out, "replay inbox: %u messages\n", replayed.messages);
+}
+
+int main(int argc, char **argv) {
+  long long seed = 1;
+  double offset_ms = 0;
+  double drain_s = 10;
+  const char *uid_option = NULL;
+  const char *preset_option = NULL;
+  const char *path = NULL;
+  bool usage = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seed = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      offset_ms = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+      drain_s = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-u") == 0 && i + 1 < argc) {
+      uid_option = argv[++i];
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      preset_option = argv[++i];
+    } else if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else if (argv[i][0] != '-' && path == NULL) {
+      path = argv[i];
+    } else {
+      usage = true;
+    }
+  }
+  if (usage || path == NULL) {
+    fprintf(stderr,
+            "usage: %s [-s seed] [-t offset ms] [-d drain s] [-u uid] "
+            "[-r DEFAULT|FAST|LONGRANGE] [-v] capture\n",
+            argv[0]);
+    return 2;
+  }
+
+  if (!read_capture(path)) {
+    return 1;
+  }
+  if (uid_option != NULL) {
+    have_uid = parse_uid(uid_option, &uid);
+    if (!have_uid) {
+      fprintf(stderr, "bad uid %s\n", uid_option);
+      return 2;
+    }
+  }
+  if (preset_option != NULL) {
+    preset = parse_preset(preset_option);
+  }
+  if (record_count == 0) {
+    fprintf(stderr, "no capture records in %s\n", path);
+    return 1;
+  }
+
+  qsort(records, record_count, sizeof(capture_record_t), compare_records);
+  int64_t offset_us = llround(offset_ms * 1000);
+  for (int i = 0; i < record_count; i++) {
+    int64_t time = (int64_t)records[i].time + offset_us;
+    records[i].time = time > 0 ? time : 0;
+  }
+  double span_s = (records[record_count - 1].time - records[0].time) / 1e6;
+  analyse_capture();
+
+  // The node the capture was taken on.
+  FILE *out = stdout;
+  if (!verbose) {
+    out = host_silence_stdout();
+  }
+  if (have_uid) {
+    memcpy(&host_board_id[5], uid.bytes, sizeof(uid.bytes));
+  }
+  host_rand_state = (uint32_t)(seed * 0x9E3779B9u);
+  if (host_rand_state == 0) {
+    host_rand_state = 1;
+  }
+  memset(host_flash, 0xFF, PICO_FLASH_SIZE_BYTES);
+
+  setup_channel();
+  vradio_attach(replay_transmit);
+  setup_sx126x();
+  setup_network();
+  setup_inbox();
+  if (preset != DEFAULT) {
+    set_range(preset);
+  }
+  radio_start();
+
+  absolute_time_t deadline = run_radio(PLATFORM_END_OF_TIME);
+  for (int i = 0; i < record_count; i++) {
+    deadline = run_until(records[i].time, deadline);
+    deadline = replay_record(&records[i], deadline);
+  }
+  run_until(host_clock_us + (absolute_time_t)(drain_s * 1e6), deadline);
+
+  fflush(stdout);
+  report(out, span_s);
+  return 0;
+}
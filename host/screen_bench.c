@@ -0,0 +1,391 @@
+/**
+ * Screen benchmark
+ *
+ * Renders every display state of the UI on the host, against the fake e-paper backend.
+ * Each state is pushed through the panel driver and the image that ends up on the panel can be
+ * dumped as PBM or compared against a directory of golden images. States are reached
+ * incrementally from the previous one, and checked against the same screen drawn from scratch.
+ * Every screen is then timed drawn from scratch, and with its cursors moving back and forth, where
+ * only the changed widgets are redrawn and uploaded.
+ *
+ * Usage: screen_bench [-n iterations] [--dump dir] [--check dir] [-v]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "EPD_2in13_V4.h"
+#include "GUI_Paint.h"
+
+#include "channel.h"
+#include "inbox.h"
+#include "network.h"
+#include "panel.h"
+#include "screen.h"
+#include "text.h"
+
+#include "fake_epd.h"
+#include "host.h"
+
+// Landscape size of the panel, as the screens draw it.
+#define PBM_WIDTH EPD_2in13_V4_HEIGHT
+#define PBM_HEIGHT EPD_2in13_V4_WIDTH
+#define PBM_ROW_BYTES ((PBM_WIDTH + 7) / 8)
+#define PBM_DATA_SIZE (PBM_ROW_BYTES * PBM_HEIGHT)
+
+// A display state to render, with up to two cursors moved away from the start.
+typedef struct {
+  const char *name;
+  display_t display;
+  uint8_t *cursor[2];
+  uint8_t value[2];
+} scenario_t;
+
+static scenario_t scenarios[] = {
+    {"home", DISPLAY_HOME},
+    {"home_settings", DISPLAY_HOME, {&home_Cursor}, {1}},
+    {"home_neighbours", DISPLAY_HOME, {&home_Cursor}, {2}},
+    {"send_to", DISPLAY_SEND_TO},
+    {"send_to_neighbour", DISPLAY_SEND_TO, {&send_to_Cursor}, {1}},
+    {"send_to_request", DISPLAY_SEND_TO, {&msg_Type, &neighbour_Request_Cursor}, {1, 1}},
+    {"send_to_ping", DISPLAY_SEND_TO, {&msg_Type, &send_to_Cursor}, {2, 2}},
+    {"msg", DISPLAY_MSG},
+    {"msg_cursor", DISPLAY_MSG, {&message_Cursor}, {2}},
+    {"msg_page", DISPLAY_MSG, {&msg_received_Page, &message_Cursor}, {5, 1}},
+    {"rxmsg", DISPLAY_RXMSG},
+    {"rxmsg_cursor", DISPLAY_RXMSG, {&received_Cursor}, {1}},
+    {"rxmsg_details", DISPLAY_RXMSG_DETAILS, {&received_Cursor}, {1}},
+    {"rxmsg_details_action", DISPLAY_RXMSG_DETAILS, {&msg_Action_Cursor}, {1}},
+    {"neighbours_table", DISPLAY_NEIGHBOURS_TABLE},
+    {"neighbours_table_cursor", DISPLAY_NEIGHBOURS_TABLE, {&neighbour_Table_Cursor}, {2}},
+    {"broadcast", DISPLAY_BROADCAST},
+    {"broadcast_request", DISPLAY_BROADCAST, {&broadcast_Action_Cursor}, {2}},
+    {"neighbours_action", DISPLAY_NEIGHBOURS_ACTION},
+    {"neighbours_action_ping", DISPLAY_NEIGHBOURS_ACTION, {&neighbour_Action_Cursor}, {1}},
+    {"neighbours_request", DISPLAY_NEIGHBOURS_REQUEST},
+    {"neighbours_request_uptime", DISPLAY_NEIGHBOURS_REQUEST, {&neighbour_Request_Cursor}, {1}},
+    {"neighbours", DISPLAY_NEIGHBOURS},
+    {"neighbours_broadcast", DISPLAY_NEIGHBOURS, {&neighbour_Cursor}, {1}},
+    {"settings", DISPLAY_SETTINGS},
+    {"settings_mode", DISPLAY_SETTINGS, {&settings_Cursor}, {1}},
+    {"settings_info_timeout", DISPLAY_SETTINGS_INFO, {&set_Info_Cursor}, {3}},
+    {"settings_info_mode", DISPLAY_SETTINGS_INFO, {&settings_Cursor, &set_Info_Cursor}, {1, 1}},
+};
+
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+// Put every cursor and page back to where the UI starts.
+static void reset_cursors() {
+  message_Cursor = 0;
+  send_to_Cursor = 0;
+  neighbour_Cursor = 0;
+  neighbour_Table_Cursor = 0;
+  broadcast_Action_Cursor = 0;
+  neighbour_Action_Cursor = 0;
+  neighbour_Request_Cursor = 0;
+  home_Cursor = 0;
+  settings_Cursor = 0;
+  set_Info_Cursor = 0;
+  msg_Action_Cursor = 0;
+  received_Cursor = 0;
+  received_Page = 1;
+  msg_received_Page = 1;
+  neighbour_received_Page = 1;
+  msg_Type = 0;
+}
+
+// Fill the network tables with a few neighbours and received messages.
+static void seed_network() {
+  static const mtype_t mtypes[] = {MTYPE_TEXT, MTYPE_PING, MTYPE_TEXT, MTYPE_RES, MTYPE_HELLO};
+
+  setup_channel();
+  setup_network();
+
+  // An hour after boot, so the tables can have some history.
+  host_clock_us = 3600ull * 1000 * 1000;
+
+  for (int i = 0; i < 4; i++) {
+    neighbour_t *neighbour = &neighbour_table.neighbours[i];
+    neighbour->uid = (uid_t){.bytes = {0x10, 0x20, 0x30 + i}};
+    neighbour->rssi = -40 - i * 17;
+    neighbour->version_major = 0;
+    neighbour->version_minor = 1 + i;
+    neighbour->last_seen = host_clock_us - (uint64_t)i * 45 * 1000 * 1000;
+  }
+  neighbour_table.count = 4;
+  copy_neighbour_table(&ui_neighbours);
+
+  // Oldest first, the hello is kept out of the inbox.
+  setup_inbox();
+  for (int i = 4; i >= 0; i--) {
+    message_history_t entry = {
+        .message =
+            {
+                .dst = get_uid(),
+                .src = neighbour_table.neighbours[i % 4].uid,
+                .id = 0x40 + i,
+                .mtype = mtypes[i],
+                .flags = {.ack_req = false, .hop_limit = 3},
+                .data = {i, 0, 0},
+            },
+        .time = host_clock_us - (uint64_t)(i + 1) * 70 * 1000 * 1000,
+    };
+    inbox_add(&entry);
+  }
+
+  // Every message was seen already.
+  inbox_entry_t entry;
+  for (uint32_t i = 0; i < inbox_count(); i++) {
+    if (inbox_get(i, &entry)) {
+      inbox_mark_read(&entry);
+    }
+  }
+}
+
+// Convert the visible panel RAM to a landscape PBM bitmap.
+// Screens draw rotated by 90 degrees, pixel (x, y) lives at (WIDTH - 1 - y, x) in memory.
+static void frame_to_pbm(const uint8_t *frame, uint8_t *pbm) {
+  memset(pbm, 0, PBM_DATA_SIZE);
+  for (int y = 0; y < PBM_HEIGHT; y++) {
+    for (int x = 0; x < PBM_WIDTH; x++) {
+      int mx = EPD_2in13_V4_WIDTH - 1 - y;
+      int my = x;
+      bool white = frame[my * FAKE_EPD_WIDTH_BYTES + mx / 8] & (0x80 >> (mx % 8));
+      // PBM uses 1 for black.
+      if (!white) {
+        pbm[y * PBM_ROW_BYTES + x / 8] |= 0x80 >> (x % 8);
+      }
+    }
+  }
+}
+
+static bool write_pbm(const char *path, const uint8_t *pbm) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  fprintf(file, "P4\n%d %d\n", PBM_WIDTH, PBM_HEIGHT);
+  size_t written = fwrite(pbm, 1, PBM_DATA_SIZE, file);
+  fclose(file);
+  return written == PBM_DATA_SIZE;
+}
+
+// Returns the number of differing pixels, or -1 if the golden image can't be read.
+static int compare_pbm(const char *path, const uint8_t *pbm) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return -1;
+  }
+
+  int width, height;
+  uint8_t golden[PBM_DATA_SIZE];
+  if (fscanf(file, "P4 %d %d", &width, &height) != 2 || width != PBM_WIDTH ||
+      height != PBM_HEIGHT || fgetc(file) == EOF ||
+      fread(golden, 1, PBM_DATA_SIZE, file) != PBM_DATA_SIZE) {
+    fclose(file);
+    return -1;
+  }
+  fclose(file);
+
+  int diff = 0;
+  for (int i = 0; i < PBM_DATA_SIZE; i++) {
+    diff += __builtin_popcount(golden[i] ^ pbm[i]);
+  }
+  return diff;
+}
+
+// Put the UI in the scenario's state, or in the starting state of its screen.
+static void apply(scenario_t *scenario, bool moved) {
+  reset_cursors();
+  display = scenario->display;
+  for (int i = 0; moved && i < 2; i++) {
+    if (scenario->cursor[i] != NULL) {
+      *scenario->cursor[i] = scenario->value[i];
+    }
+  }
+}
+
+// Render the current state and push the changed area to the panel with a partial refresh.
+static rect_t show() {
+  rect_t dirty = render_display();
+  present_frame_rect(dirty);
+  start_refresh(REFRESH_PARTIAL);
+  wait_for_refresh();
+  return dirty;
+}
+
+static uint32_t rect_area(rect_t r) {
+  return r.x0 > r.x1 ? 0 : (uint32_t)(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+}
+
+int main(int argc, char **argv) {
+  int iterations = 5000;
+  const char *dump_dir = NULL;
+  const char *check_dir = NULL;
+  bool verbose = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+      dump_dir = argv[++i];
+    } else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+      check_dir = argv[++i];
+    } else if (strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    } else {
+      fprintf(stderr, "usage: %s [-n iterations] [--dump dir] [--check dir] [-v]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  // The renderers log to stdout, keep the report readable.
+  FILE *report = stdout;
+  if (!verbose) {
+    report = host_silence_stdout();
+  }
+
+  if (dump_dir != NULL && host_mkdir(dump_dir) != 0) {
+    fprintf(stderr, "cannot create %s\n", dump_dir);
+    return 2;
+  }
+
+  DEV_Module_Init();
+  EPD_2in13_V4_Init_Async();
+  EPD_2in13_V4_Init();
+  seed_network();
+
+  int failures = 0;
+  uint8_t frame[FAKE_EPD_FRAME_SIZE];
+  uint8_t pbm[PBM_DATA_SIZE];
+  uint8_t incremental[IMAGE_SIZE];
+  char path[256];
+
+  fprintf(report, "%-26s %10s %10s %10s %8s %8s\n", "screen", "full us", "redraw us",
+          "upload us", "area", "golden");
+  for (int s = 0; s < NUM_SCENARIOS; s++) {
+    scenario_t *scenario = &scenarios[s];
+
+    // Coming from the previous scenario, only the changed widgets are redrawn and uploaded.
+    apply(scenario, true);
+    show();
+    fake_epd_visible_frame(frame);
+    frame_to_pbm(frame, pbm);
+
+    // The incremental frame has to match the screen drawn from scratch.
+    bool consistent = true;
+    memcpy(incremental, image, IMAGE_SIZE);
+    invalidate_widgets();
+    render_display();
+    if (memcmp(incremental, image, IMAGE_SIZE) != 0) {
+      consistent = false;
+      failures++;
+    }
+
+    if (dump_dir != NULL) {
+      snprintf(path, sizeof(path), "%s/%s.pbm", dump_dir, scenario->name);
+      if (!write_pbm(path, pbm)) {
+        fprintf(stderr, "cannot write %s\n", path);
+        return 2;
+      }
+    }
+
+    const char *result = consistent ? "-" : "INCONSISTENT";
+    if (check_dir != NULL && consistent) {
+      snprintf(path, sizeof(path), "%s/%s.pbm", check_dir, scenario->name);
+      int diff = compare_pbm(path, pbm);
+      if (diff == 0) {
+        result = "ok";
+      } else {
+        result = diff < 0 ? "missing" : "FAIL";
+        failures++;
+      }
+    }
+
+    // Time drawing the screen from scratch.
+    uint64_t start = host_now_ns();
+    for (int i = 0; i < iterations; i++) {
+      invalidate_widgets();
+      render_display();
+    }
+    uint64_t full_ns = host_now_ns() - start;
+
+    // Then moving the cursors back and forth, redrawing and uploading only what changed.
+    uint64_t redraw_ns = 0, upload_ns = 0;
+    uint64_t area = 0;
+    for (int i = 0; i < iterations; i++) {
+      apply(scenario, i % 2 == 1);
+      start = host_now_ns();
+      rect_t dirty = render_display();
+      redraw_ns += host_now_ns() - start;
+
+      start = host_now_ns();
+      present_frame_rect(dirty);
+      start_refresh(REFRESH_PARTIAL);
+      wait_for_refresh();
+      upload_ns += host_now_ns() - start;
+      area += rect_area(dirty);
+    }
+
+    fprintf(report, "%-26s %10.2f %10.2f %10.2f %8llu %8s\n", scenario->name,
+            full_ns / 1000.0 / iterations, redraw_ns / 1000.0 / iterations,
+            upload_ns / 1000.0 / iterations, (unsigned long long)(area / iterations), result);
+  }
+
+  // Navigate through every state a few times, as a user would, to see how the text run cache does.
+  text_stats = (text_stats_t){0};
+  for (int round = 0; round < 3; round++) {
+    for (int s = 0; s < NUM_SCENARIOS; s++) {
+      apply(&scenarios[s], true);
+      show();
+    }
+  }
+  fprintf(report, "text cache: %u lookups, %.1f%% hits, %u evictions\n", text_stats.lookups,
+          text_stats.lookups ? 100.0 * text_stats.hits / text_stats.lookups : 0.0,
+          text_stats.evictions);
+
+  fprintf(report, "panel: %u resets, %u commands, %u data bytes, %u refreshes skipped\n",
+          fake_epd_stats.resets, fake_epd_stats.commands, fake_epd_stats.data_bytes,
+          refresh_stats.skipped);
+
+  // Put the panel to sleep and wake it up on the home screen, the way the UI does. Once with the
+  // controller keeping its session, and once initialized again from scratch.
+  apply(&scenarios[0], false);
+  render_display();
+  present_frame();
+  start_refresh(REFRESH_FULL);
+  for (int cold = 0; cold < 2; cold++) {
+    go_to_Sleep();
+    bool slept = fake_epd_sleeping();
+    fake_epd_reset_stats();
+    uint64_t start = host_now_ns();
+
+    wake_panel();
+    if (cold) {
+      EPD_2in13_V4_Init_Fast();
+    }
+    rect_t dirty = render_display();
+    present_frame_rect(dirty);
+    refresh_mode_t mode = cold ? REFRESH_FAST : choose_refresh();
+    start_refresh(mode);
+    wait_for_refresh();
+
+    uint64_t wake_ns = host_now_ns() - start;
+    fake_epd_visible_frame(frame);
+    bool shown = memcmp(frame, image, FAKE_EPD_FRAME_SIZE) == 0;
+    if (!slept || !shown) {
+      failures++;
+    }
+    fprintf(report,
+            "%s wake: %s refresh, %u resets, %u commands, %u data bytes, %.1f ms to visible, "
+            "%.2f us%s\n",
+            cold ? "cold" : "warm", REFRESH_MODE_STR[mode], fake_epd_stats.resets,
+            fake_epd_stats.commands, fake_epd_stats.data_bytes, refresh_stats.wake_us_last / 1000.0,
+            wake_ns / 1000.0, slept && shown ? "" : " FAIL");
+  }
+
+  fflush(report);
+
+  return failures == 0 ? 0 : 1;
+}
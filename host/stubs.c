@@ -0,0 +1,18 @@
+/**
+ * Firmware stubs
+ *
+ * Stand-ins for the parts of voidlink.c and io.c the display stack and the protocol core
+ * reference, without the ADC or the buttons.
+ */
+
+#include "io.h"
+#include "voidlink.h"
+
+// Fixed readings, so renders are reproducible.
+float read_voltage() { return 3.7f; }
+float read_temperature() { return 25.0f; }
+
+// There are no buttons, the host tools set the UI state directly.
+bool post_ui_event(ui_event_t event) { return true; }
+bool ui_event_pending() { return false; }
+void handle_ui_events() {}
@@ -0,0 +1,210 @@
+/**
+ * Firmware on the ether
+ *
+ * One node of a mesh as a Linux process: the firmware's radio loop, protocol core, inbox and
+ * console, in real time on a virtual radio whose frames go through the ether broker
+ * (host/ether.c) to the other processes. The console reads its commands from stdin, a line at a
+ * time, and prints to stdout, so a mesh of them can be scripted end to end.
+ * There is no display: the UI core only takes the console, and drops what the radio core tells it.
+ * The node leaves when stdin ends or the ether goes away.
+ *
+ * Usage: vnode [-p socket] [-s seed] [-r DEFAULT|FAST|LONGRANGE] node
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+
+#include "bench.h"
+#include "channel.h"
+#include "console.h"
+#include "events.h"
+#include "inbox.h"
+#include "log.h"
+#include "network.h"
+#include "radio.h"
+#include "utils.h"
+#include "voidlink.h"
+
+#include "ether.h"
+#include "host.h"
+#include "medium.h"
+#include "vradio.h"
+
+// Radio loop passes per wake up, a node asking for more is stuck.
+#define MAX_PASSES 64
+
+irq_stats_t button_irq_stats = {0};
+irq_stats_t dio1_irq_stats = {0};
+
+static int ether = -1;
+static uint16_t node = 0;
+
+// The ring benchmark counts cycles on the systick of the core.
+void bench_rings(uint32_t iterations) { error("bench rings needs the board\n"); }
+
+// The medium of the virtual radio: hand the frame to the ether.
+static void ether_transmit(const uint8_t *data, uint8_t length, const vradio_air_t *air) {
+  ether_msg_t msg = {.type = ETHER_TX, .length = length, .node = node, .air = *air};
+  memcpy(msg.data, data, length);
+  if (!host_send(ether, &msg, sizeof(msg))) {
+    error("ether is gone\n");
+    exit(1);
+  }
+}
+
+// The ether only knows what is on the air, the radio knows whether it listened for all of it.
+static void handle_ether(const ether_msg_t *msg) {
+  if (msg->type == ETHER_TX_DONE) {
+    vradio_tx_done();
+  } else if (msg->type == ETHER_RX) {
+    vradio_air_t air;
+    absolute_time_t since;
+    absolute_time_t start = platform_now() - msg->air.time_on_air_us;
+    if (vradio_listening(&air, &since) && since <= start &&
+        medium_same_channel(&air, &msg->air)) {
+      vradio_receive(msg->data, msg->length, msg->rssi, msg->snr);
+    }
+  }
+}
+
+// Read stdin into the console buffer and run the complete lines, like the serial callbacks.
+// Returns false once stdin ended.
+static bool read_console() {
+  char input[CONSOLE_BUFFER_SIZE];
+  long count = host_read(0, input, sizeof(input));
+  if (count <= 0) {
+    return false;
+  }
+
+  for (long i = 0; i < count; i++) {
+    if (input[i] == '\n' || input[i] == '\r') {
+      console_buffer[console_buffer_offset] = '\0';
+      bool empty = console_buffer_offset == 0;
+      console_buffer_offset = 0;
+      if (!empty) {
+        console_line_ready();
+        handle_console();
+      }
+    } else if (console_buffer_offset < CONSOLE_BUFFER_SIZE - 1) {
+      console_buffer[console_buffer_offset++] = input[i];
+    }
+  }
+  return true;
+}
+
+// Run the radio loop until it has nothing left to do now.
+static absolute_time_t run_radio(absolute_time_t deadline) {
+  for (int pass = 0; pass < MAX_PASSES; pass++) {
+    uint32_t events = take_events();
+    if (events == 0 && !platform_reached(deadline)) {
+      break;
+    }
+    deadline = radio_step(events);
+  }
+  return deadline;
+}
+
+int main(int argc, char **argv) {
+  const char *path = ETHER_PATH;
+  long long seed = 1;
+  mod_params_t preset = DEFAULT;
+  int index = -1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+      path = argv[++i];
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seed = atoll(argv[++i]);
+    } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+      i++;
+      preset = strcmp(argv[i], "FAST") == 0        ? FAST
+               : strcmp(argv[i], "LONGRANGE") == 0 ? LONGRANGE
+                                                   : DEFAULT;
+    } else if (argv[i][0] != '-' && index < 0) {
+      index = atoi(argv[i]);
+    } else {
+      index = -1;
+      break;
+    }
+  }
+  if (index < 0 || index >= MEDIUM_MAX_NODES) {
+    fprintf(stderr, "usage: %s [-p socket] [-s seed] [-r DEFAULT|FAST|LONGRANGE] node\n", argv[0]);
+    return 2;
+  }
+  node = index;
+
+  // The console is read by scripts, line by line.
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  ether = host_connect(path);
+  ether_msg_t join = {.type = ETHER_JOIN, .node = node};
+  if (ether < 0 || !host_send(ether, &join, sizeof(join))) {
+    fprintf(stderr, "cannot join the ether on %s\n", path);
+    return 1;
+  }
+
+  // A board of its own: the uid 51:hi:lo of the mesh simulator, its own random numbers and a flash
+  // fresh from the factory.
+  host_board_id[5] = 0x51;
+  host_board_id[6] = node >> 8;
+  host_board_id[7] = node;
+  host_rand_state = (uint32_t)(seed * 0x9E3779B9u) ^ (node + 1) * 0x85EBCA6Bu;
+  if (host_rand_state == 0) {
+    host_rand_state = 1;
+  }
+  memset(host_flash, 0xFF, PICO_FLASH_SIZE_BYTES);
+  host_follow_wall_clock();
+
+  // Debug output goes through the log as on the board, `set log` switches it like there.
+  setup_log();
+  log_mode = LOG_TEXT;
+  setup_channel();
+  vradio_attach(ether_transmit);
+  setup_sx126x();
+  setup_network();
+  setup_inbox();
+  if (preset != DEFAULT) {
+    set_range(preset);
+  }
+
+  info("VoidLink %d.%d, %s is ready on %s\n", VERSION_MAJOR, VERSION_MINOR,
+       uid_to_string(get_uid()), path);
+  radio_start();
+
+  absolute_time_t deadline = run_radio(PLATFORM_END_OF_TIME);
+  while (true) {
+    int fds[2] = {ether, 0};
+    bool ready[2];
+    int64_t timeout = -1;
+    if (deadline != PLATFORM_END_OF_TIME) {
+      timeout = platform_diff_us(platform_now(), deadline);
+      timeout = timeout > 0 ? timeout : 0;
+    }
+    host_poll(fds, ready, 2, timeout);
+
+    if (ready[0]) {
+      ether_msg_t msg;
+      if (host_read(ether, &msg, sizeof(msg)) != sizeof(msg)) {
+        error("ether is gone\n");
+        break;
+      }
+      handle_ether(&msg);
+    }
+    if (ready[1] && !read_console()) {
+      break;
+    }
+    deadline = run_radio(deadline);
+
+    // Nothing to draw on.
+    core_msg_t msg;
+    while (receive_on_ui(&msg)) {
+    }
+    log_drain();
+  }
+
+  host_close(ether);
+  return 0;
+}
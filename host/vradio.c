@@ -0,0 +1,300 @@
+/**
+ * Virtual radio
+ *
+ * The sx126x driver API on a model of the chip, for host builds without the radio: the modes,
+ * the command status, the irq flags, the data buffer and the packet status, as far as the
+ * firmware uses them. Frames sent are handed to a medium, which decides who hears them and
+ * comes back with `vradio_tx_done` and `vradio_receive`. Both raise DIO1 like the chip does,
+ * by calling the firmware's interrupt handler, when the irq is routed to it.
+ *
+ * Without a medium attached, frames are sent into the void and never finish.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "pico_config.h"
+
+#include "radio.h"
+
+#include "vradio.h"
+
+// Reset value of the LoRa sync word register, the firmware reads it as a sanity check.
+#define VRADIO_SYNC_WORD_ADDRESS 0x0740
+#define VRADIO_SYNC_WORD_RESET 0x14
+
+static struct {
+  sx126x_chip_modes_t mode;
+  sx126x_cmd_status_t cmd_status;
+  sx126x_irq_mask_t irq;
+  sx126x_irq_mask_t irq_enabled;
+  sx126x_irq_mask_t dio1_mask;
+  uint32_t freq_hz;
+  int8_t power_dbm;
+  sx126x_mod_params_lora_t mod;
+  sx126x_pkt_params_lora_t pkt;
+  uint8_t buffer[256];
+  uint8_t rx_length;
+  int16_t rssi;
+  int8_t snr;
+  // Time the radio last went into receive.
+  absolute_time_t rx_since;
+} chip = {
+    .mode = SX126X_CHIP_MODE_STBY_RC,
+    .cmd_status = SX126X_CMD_STATUS_RFU,
+};
+
+static vradio_medium_t medium = NULL;
+
+// Send frames to the medium.
+void vradio_attach(vradio_medium_t attached) { medium = attached; }
+
+uint32_t vradio_bandwidth_hz(sx126x_lora_bw_t bw) {
+  switch (bw) {
+  case SX126X_LORA_BW_007:
+    return 7810;
+  case SX126X_LORA_BW_010:
+    return 10420;
+  case SX126X_LORA_BW_015:
+    return 15630;
+  case SX126X_LORA_BW_020:
+    return 20830;
+  case SX126X_LORA_BW_031:
+    return 31250;
+  case SX126X_LORA_BW_041:
+    return 41670;
+  case SX126X_LORA_BW_062:
+    return 62500;
+  case SX126X_LORA_BW_125:
+    return 125000;
+  case SX126X_LORA_BW_250:
+    return 250000;
+  case SX126X_LORA_BW_500:
+    return 500000;
+  }
+  return 125000;
+}
+
+// Time on air of a LoRa frame, from the formula of the SX126x datasheet (6.1.4).
+uint32_t vradio_time_on_air_us(const sx126x_pkt_params_lora_t *pkt,
+                               const sx126x_mod_params_lora_t *mod) {
+  int sf = mod->sf;
+  int cr = mod->cr;
+  double symbol_us = (double)(1 << sf) * 1e6 / vradio_bandwidth_hz(mod->bw);
+
+  // SF5 and SF6 take a longer sync word and no low data rate optimization.
+  bool short_sf = sf < 7;
+  int ldro = mod->ldro ? 1 : 0;
+  int header = pkt->header_type == SX126X_LORA_PKT_EXPLICIT ? 20 : 0;
+  int crc = pkt->crc_is_on ? 16 : 0;
+
+  int bits = 8 * pkt->pld_len_in_bytes + crc - 4 * sf + header + (short_sf ? 0 : 8);
+  int per_block = 4 * (sf - (short_sf ? 0 : 2 * ldro));
+  int blocks = bits > 0 ? (bits + per_block - 1) / per_block : 0;
+
+  double symbols = pkt->preamble_len_in_symb + (short_sf ? 6.25 : 4.25) + 8 + blocks * (cr + 4);
+  return (uint32_t)ceil(symbols * symbol_us);
+}
+
+// The settings of the radio, as a frame sent or heard now would go on the air.
+static vradio_air_t current_air(uint32_t time_on_air_us) {
+  vradio_air_t air = {
+      .freq_hz = chip.freq_hz,
+      .sf = chip.mod.sf,
+      .bw_hz = vradio_bandwidth_hz(chip.mod.bw),
+      .cr = chip.mod.cr,
+      .power_dbm = chip.power_dbm,
+      .time_on_air_us = time_on_air_us,
+  };
+  return air;
+}
+
+// Raise an irq, and DIO1 with it when it is routed there.
+static void raise_irq(sx126x_irq_mask_t irq) {
+  if (!(chip.irq_enabled & irq)) {
+    return;
+  }
+  chip.irq |= irq;
+  if (chip.dio1_mask & irq) {
+    handle_dio1_callback(PIN_DIO1, GPIO_IRQ_EDGE_RISE);
+  }
+}
+
+// Returns whether the radio is receiving, with the settings it receives with and since when.
+bool vradio_listening(vradio_air_t *air, absolute_time_t *since) {
+  *air = current_air(0);
+  *since = chip.rx_since;
+  return chip.mode == SX126X_CHIP_MODE_RX;
+}
+
+// The frame being sent is off the air.
+void vradio_tx_done() {
+  if (chip.mode != SX126X_CHIP_MODE_TX) {
+    return;
+  }
+  chip.mode = SX126X_CHIP_MODE_STBY_RC;
+  chip.cmd_status = SX126X_CMD_STATUS_CMD_TX_DONE;
+  raise_irq(SX126X_IRQ_TX_DONE);
+}
+
+// A frame was received, the medium already decided it got through.
+void vradio_receive(const uint8_t *data, uint8_t length, int16_t rssi, int8_t snr) {
+  if (chip.mode != SX126X_CHIP_MODE_RX) {
+    return;
+  }
+  memcpy(chip.buffer, data, length);
+  chip.rx_length = length;
+  chip.rssi = rssi;
+  chip.snr = snr;
+  chip.cmd_status = SX126X_CMD_STATUS_DATA_AVAILABLE;
+  raise_irq(SX126X_IRQ_RX_DONE);
+}
+
+// Every command but the getters leaves the command status cleared.
+static sx126x_status_t command_done() {
+  chip.cmd_status = SX126X_CMD_STATUS_RFU;
+  return SX126X_STATUS_OK;
+}
+
+sx126x_status_t sx126x_read_register(const void *context, const uint16_t address,
+                                     uint8_t *buffer, const uint8_t size) {
+  memset(buffer, 0, size);
+  if (address == VRADIO_SYNC_WORD_ADDRESS && size > 0) {
+    buffer[0] = VRADIO_SYNC_WORD_RESET;
+  }
+  return SX126X_STATUS_OK;
+}
+
+sx126x_status_t sx126x_clear_device_errors(const void *context) { return command_done(); }
+
+sx126x_status_t sx126x_get_device_errors(const void *context, sx126x_errors_mask_t *errors) {
+  *errors = 0;
+  return SX126X_STATUS_OK;
+}
+
+sx126x_status_t sx126x_set_dio3_as_tcxo_ctrl(const void *context,
+                                             const sx126x_tcxo_ctrl_voltages_t tcxo_voltage,
+                                             const uint32_t timeout) {
+  return command_done();
+}
+
+sx126x_status_t sx126x_cal(const void *context, const sx126x_cal_mask_t param) {
+  return command_done();
+}
+
+sx126x_status_t sx126x_get_status(const void *context, sx126x_chip_status_t *radio_status) {
+  radio_status->chip_mode = chip.mode;
+  radio_status->cmd_status = chip.cmd_status;
+  return SX126X_STATUS_OK;
+}
+
+sx126x_status_t sx126x_set_standby(const void *context, const sx126x_standby_cfg_t cfg) {
+  chip.mode = cfg == SX126X_STANDBY_CFG_RC ? SX126X_CHIP_MODE_STBY_RC : SX126X_CHIP_MODE_STBY_XOSC;
+  return command_done();
+}
+
+sx126x_status_t sx126x_set_pkt_type(const void *context, const sx126x_pkt_type_t pkt_type) {
+  return command_done();
+}
+
+sx126x_status_t sx126x_set_rf_freq(const void *context, const uint32_t freq_in_hz) {
+  chip.freq_hz = freq_in_hz;
+  return command_done();
+}
+
+sx126x_status_t sx126x_set_pa_cfg(const void *context, const sx126x_pa_cfg_params_t *params) {
+  return command_done();
+}
+
+sx126x_status_t sx126x_set_tx_params(const void *context, const int8_t pwr_in_dbm,
+                                     const sx126x_ramp_time_t ramp_time) {
+  chip.power_dbm = pwr_in_dbm;
+  return command_done();
+}
+
+sx126x_status_t sx126x_set_lora_mod_params(const void *context,
+                                           const sx126x_mod_params_lora_t *params) {
+  chip.mod = *params;
+  return command_done();
+}
+
+sx126x_status_t sx126x_set_lora_pkt_params(const void *context,
+                                           const sx126x_pkt_params_lora_t *params) {
+  chip.pkt = *params;
+  return command_done();
+}
+
+sx126x_status_t sx126x_set_dio_irq_params(const void *context, const uint16_t irq_mask,
+                                          const uint16_t dio1_mask, const uint16_t dio2_mask,
+                                          const uint16_t dio3_mask) {
+  chip.irq_enabled = irq_mask;
+  chip.dio1_mask = dio1_mask;
+  return command_done();
+}
+
+sx126x_status_t sx126x_get_and_clear_irq_status(const void *context, sx126x_irq_mask_t *irq) {
+  *irq = chip.irq;
+  chip.irq = 0;
+  return SX126X_STATUS_OK;
+}
+
+sx126x_status_t sx126x_write_buffer(const void *context, const uint8_t offset,
+                                    const uint8_t *buffer, const uint8_t size) {
+  memcpy(chip.buffer + offset, buffer, size <= 256 - offset ? size : 256 - offset);
+  return command_done();
+}
+
+sx126x_status_t sx126x_read_buffer(const void *context, const uint8_t offset, uint8_t *buffer,
+                                   const uint8_t size) {
+  memcpy(buffer, chip.buffer + offset, size <= 256 - offset ? size : 256 - offset);
+  return SX126X_STATUS_OK;
+}
+
+sx126x_status_t sx126x_get_rx_buffer_status(const void *context,
+                                            sx126x_rx_buffer_status_t *rx_buffer_status) {
+  rx_buffer_status->pld_len_in_bytes = chip.rx_length;
+  rx_buffer_status->buffer_start_pointer = 0;
+  return SX126X_STATUS_OK;
+}
+
+sx126x_status_t sx126x_get_lora_pkt_status(const void *context,
+                                           sx126x_pkt_status_lora_t *pkt_status) {
+  pkt_status->rssi_pkt_in_dbm = chip.rssi;
+  pkt_status->snr_pkt_in_db = chip.snr;
+  pkt_status->signal_rssi_pkt_in_dbm = chip.rssi;
+  return SX126X_STATUS_OK;
+}
+
+sx126x_status_t sx126x_set_tx(const void *context, const uint32_t timeout_in_ms) {
+  chip.mode = SX126X_CHIP_MODE_TX;
+  command_done();
+
+  vradio_air_t air = current_air(vradio_time_on_air_us(&chip.pkt, &chip.mod));
+  if (medium != NULL) {
+    medium(chip.buffer, chip.pkt.pld_len_in_bytes, &air);
+  }
+  return SX126X_STATUS_OK;
+}
+
+// Receive continuously, whatever the timeout, which is all the firmware uses.
+static sx126x_status_t start_rx() {
+  if (chip.mode != SX126X_CHIP_MODE_RX) {
+    chip.mode = SX126X_CHIP_MODE_RX;
+    chip.rx_since = platform_now();
+  }
+  return command_done();
+}
+
+sx126x_status_t sx126x_set_rx(const void *context, const uint32_t timeout_in_ms) {
+  return start_rx();
+}
+
+sx126x_status_t sx126x_set_rx_with_timeout_in_rtc_step(const void *context,
+                                                       const uint32_t timeout_in_rtc_step) {
+  return start_rx();
+}
+
+uint32_t sx126x_get_lora_time_on_air_in_ms(const sx126x_pkt_params_lora_t *pkt_p,
+                                           const sx126x_mod_params_lora_t *mod_p) {
+  return (vradio_time_on_air_us(pkt_p, mod_p) + 999) / 1000;
+}
@@ -0,0 +1,37 @@
+#ifndef _VRADIO_H
+#define _VRADIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sx126x.h"
+
+#include "platform.h"
+
+// How a frame goes on the air, a receiver only hears frames sent on its own frequency, spreading
+// factor and bandwidth.
+typedef struct {
+  uint32_t freq_hz;
+  uint8_t sf;
+  uint32_t bw_hz;
+  // Coding rate 4/(4 + cr).
+  uint8_t cr;
+  int8_t power_dbm;
+  uint32_t time_on_air_us;
+} vradio_air_t;
+
+// Called with every frame the radio starts sending.
+// The medium calls `vradio_tx_done` once the frame is off the air.
+typedef void (*vradio_medium_t)(const uint8_t *data, uint8_t length, const vradio_air_t *air);
+
+void vradio_attach(vradio_medium_t medium);
+
+bool vradio_listening(vradio_air_t *air, absolute_time_t *since);
+void vradio_tx_done();
+void vradio_receive(const uint8_t *data, uint8_t length, int16_t rssi, int8_t snr);
+
+uint32_t vradio_time_on_air_us(const sx126x_pkt_params_lora_t *pkt,
+                               const sx126x_mod_params_lora_t *mod);
+uint32_t vradio_bandwidth_hz(sx126x_lora_bw_t bw);
+
+#endif // _VRADIO_H
@@ -29,6 +29,7 @@
 ******************************************************************************/
 #include "DEV_Config.h"
 #include "../../../src/pico/pico_config.h"
+#include "hardware/irq.h"
 
 /**
  * GPIO
@@ -68,6 +69,36 @@ void DEV_GPIO_Mode(UWORD Pin, UWORD Mode) {
   }
 }
 
+/**
+ * BUSY pin interrupt
+ *
+ * The handler runs on the core that called DEV_Busy_Irq_Init, once per armed
+ * falling edge of the BUSY pin.
+ **/
+static void (*DEV_Busy_Handler)(void) = NULL;
+
+static void DEV_Busy_Irq(void) {
+  if (gpio_get_irq_event_mask(EPD_BUSY_PIN) & GPIO_IRQ_EDGE_FALL) {
+    gpio_acknowledge_irq(EPD_BUSY_PIN, GPIO_IRQ_EDGE_FALL);
+    gpio_set_irq_enabled(EPD_BUSY_PIN, GPIO_IRQ_EDGE_FALL, false);
+    if (DEV_Busy_Handler != NULL) {
+      DEV_Busy_Handler();
+    }
+  }
+}
+
+void DEV_Busy_Irq_Init(void (*Handler)(void)) {
+  DEV_Busy_Handler = Handler;
+  gpio_add_raw_irq_handler(EPD_BUSY_PIN, DEV_Busy_Irq);
+  irq_set_enabled(IO_IRQ_BANK0, true);
+}
+
+void DEV_Busy_Irq_Arm(void) {
+  // Drop any edge latched while the interrupt was disarmed.
+  gpio_acknowledge_irq(EPD_BUSY_PIN, GPIO_IRQ_EDGE_FALL);
+  gpio_set_irq_enabled(EPD_BUSY_PIN, GPIO_IRQ_EDGE_FALL, true);
+}
+
 /**
  * delay x ms
  **/
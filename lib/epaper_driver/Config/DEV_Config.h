@@ -80,6 +80,9 @@ void DEV_SPI_WriteByte(UBYTE Value);
 void DEV_SPI_Write_nByte(uint8_t *pData, uint32_t Len);
 void DEV_Delay_ms(UDOUBLE xms);
 
+void DEV_Busy_Irq_Init(void (*Handler)(void));
+void DEV_Busy_Irq_Arm(void);
+
 UBYTE DEV_Module_Init(void);
 void DEV_SPI_Init(void);
 void DEV_SPI_SendData(UBYTE Reg);
@@ -28,6 +28,8 @@
 # THE SOFTWARE.
 #
 ******************************************************************************/
+#include <string.h>
+
 #include "EPD_2in13_V4.h"
 #include "Debug.h"
 
@@ -83,6 +85,28 @@ void EPD_2in13_V4_ReadBusy(void) {
   Debug("e-Paper busy release\r\n");
 }
 
+/******************************************************************************
+Controller session
+Info:
+  The controller keeps its registers and both RAMs until it is reset, and deep
+  sleep mode 1 keeps the RAMs as well. Only a hardware reset wakes it up, which
+  brings the registers back to their defaults. The session tracks what is
+  loaded, so that every update only sends the reset and the registers it is
+  missing.
+******************************************************************************/
+static EPD_2in13_V4_Session EPD_2in13_V4_State = {
+    .Sleeping = 1,
+    .Config = EPD_2in13_V4_CONFIG_NONE,
+};
+// RAM window last set, invalid after a reset
+static UWORD EPD_2in13_V4_Window[4];
+
+static void EPD_2in13_V4_ForgetWindow(void) {
+  memset(EPD_2in13_V4_Window, 0xFF, sizeof(EPD_2in13_V4_Window));
+}
+
+const EPD_2in13_V4_Session *EPD_2in13_V4_GetSession(void) { return &EPD_2in13_V4_State; }
+
 /******************************************************************************
 function :	Setting the display window
 parameter:
@@ -92,6 +116,16 @@ parameter:
         Yend : End position of Y-axis
 ******************************************************************************/
 static void EPD_2in13_V4_SetWindows(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend) {
+  if (EPD_2in13_V4_Window[0] == Xstart && EPD_2in13_V4_Window[1] == Ystart &&
+      EPD_2in13_V4_Window[2] == Xend && EPD_2in13_V4_Window[3] == Yend) {
+    EPD_2in13_V4_State.Skipped++;
+    return;
+  }
+  EPD_2in13_V4_Window[0] = Xstart;
+  EPD_2in13_V4_Window[1] = Ystart;
+  EPD_2in13_V4_Window[2] = Xend;
+  EPD_2in13_V4_Window[3] = Yend;
+
   EPD_2in13_V4_SendCommand(0x44); // SET_RAM_X_ADDRESS_START_END_POSITION
   EPD_2in13_V4_SendData((Xstart >> 3) & 0xFF);
   EPD_2in13_V4_SendData((Xend >> 3) & 0xFF);
@@ -118,94 +152,204 @@ static void EPD_2in13_V4_SetCursor(UWORD Xstart, UWORD Ystart) {
   EPD_2in13_V4_SendData((Ystart >> 8) & 0xFF);
 }
 
+/******************************************************************************
+function :	Asynchronous refresh state
+Info:
+  A refresh started with one of the *_Async functions returns as soon as the
+  image is in the controller RAM. The BUSY falling edge interrupt clears the
+  busy flag and calls the completion callback from interrupt context.
+******************************************************************************/
+static volatile UBYTE EPD_2in13_V4_Busy = 0;
+static EPD_2in13_V4_Callback EPD_2in13_V4_Done = NULL;
+
+static void EPD_2in13_V4_BusyRelease(void) {
+  EPD_2in13_V4_Callback Done = EPD_2in13_V4_Done;
+  EPD_2in13_V4_Done = NULL;
+  EPD_2in13_V4_Busy = 0;
+  if (Done != NULL) {
+    Done();
+  }
+}
+
 /******************************************************************************
 function :	Turn On Display
 parameter:
+    Mode  : Display update sequence (0x22 option)
+    Async : Return right after starting the update instead of waiting on BUSY
+    Done  : Completion callback for asynchronous updates, may be NULL
 ******************************************************************************/
-static void EPD_2in13_V4_TurnOnDisplay(void) {
+static void EPD_2in13_V4_Activate(UBYTE Mode, UBYTE Async, EPD_2in13_V4_Callback Done) {
   EPD_2in13_V4_SendCommand(0x22); // Display Update Control
-  EPD_2in13_V4_SendData(0xf7);
+  EPD_2in13_V4_SendData(Mode);
+
+  if (!Async) {
+    EPD_2in13_V4_SendCommand(0x20); // Activate Display Update Sequence
+    EPD_2in13_V4_ReadBusy();
+    return;
+  }
+
+  // Arm the interrupt before activating, BUSY rises right after the command.
+  EPD_2in13_V4_Done = Done;
+  EPD_2in13_V4_Busy = 1;
+  DEV_Busy_Irq_Arm();
   EPD_2in13_V4_SendCommand(0x20); // Activate Display Update Sequence
-  EPD_2in13_V4_ReadBusy();
 }
 
+static void EPD_2in13_V4_TurnOnDisplay(void) { EPD_2in13_V4_Activate(0xf7, 0, NULL); }
+
 static void EPD_2in13_V4_TurnOnDisplay_Fast(void) {
-  EPD_2in13_V4_SendCommand(0x22); // Display Update Control
-  EPD_2in13_V4_SendData(0xc7);    // fast:0x0c, quality:0x0f, 0xcf
-  EPD_2in13_V4_SendCommand(0x20); // Activate Display Update Sequence
-  EPD_2in13_V4_ReadBusy();
+  EPD_2in13_V4_Activate(0xc7, 0, NULL); // fast:0x0c, quality:0x0f, 0xcf
 }
 
-static void EPD_2in13_V4_TurnOnDisplay_Partial(void) {
-  EPD_2in13_V4_SendCommand(0x22); // Display Update Control
-  EPD_2in13_V4_SendData(0xff);    // fast:0x0c, quality:0x0f, 0xcf
-  EPD_2in13_V4_SendCommand(0x20); // Activate Display Update Sequence
-  EPD_2in13_V4_ReadBusy();
-}
+/******************************************************************************
+function :	Register the BUSY interrupt on the calling core
+Info:
+  Must be called once from the core that runs the *_Async functions.
+******************************************************************************/
+void EPD_2in13_V4_Init_Async(void) { DEV_Busy_Irq_Init(EPD_2in13_V4_BusyRelease); }
 
 /******************************************************************************
-function :	Initialize the e-Paper register
+function :	Check if an asynchronous refresh is still running
+******************************************************************************/
+UBYTE EPD_2in13_V4_IsBusy(void) { return EPD_2in13_V4_Busy; }
+
+/******************************************************************************
+function :	Write a full frame into one of the controller RAMs
 parameter:
+        Reg   : 0x24 (new image) or 0x26 (previous image)
+        Image : Image data
+Info:
+  The frame is streamed in a single SPI transfer with CS held low instead of
+  toggling DC/CS for every byte.
 ******************************************************************************/
-void EPD_2in13_V4_Init(void) {
-  EPD_2in13_V4_Reset();
+static void EPD_2in13_V4_WriteRam(UBYTE Reg, UBYTE *Image) {
+  UWORD Width, Height;
+  Width = (EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1);
+  Height = EPD_2in13_V4_HEIGHT;
 
-  EPD_2in13_V4_ReadBusy();
-  EPD_2in13_V4_SendCommand(0x12); // SWRESET
-  EPD_2in13_V4_ReadBusy();
+  // A windowed partial refresh may have left a smaller window behind.
+  EPD_2in13_V4_SetWindows(0, 0, EPD_2in13_V4_WIDTH - 1, EPD_2in13_V4_HEIGHT - 1);
+  EPD_2in13_V4_SetCursor(0, 0);
 
-  EPD_2in13_V4_SendCommand(0x01); // Driver output control
-  EPD_2in13_V4_SendData(0xF9);
-  EPD_2in13_V4_SendData(0x00);
-  EPD_2in13_V4_SendData(0x00);
+  EPD_2in13_V4_SendCommand(Reg);
+  DEV_Digital_Write(EPD_DC_PIN, 1);
+  DEV_Digital_Write(EPD_CS_PIN, 0);
+  DEV_SPI_Write_nByte(Image, (UDOUBLE)Width * Height);
+  DEV_Digital_Write(EPD_CS_PIN, 1);
+}
 
-  EPD_2in13_V4_SendCommand(0x11); // data entry mode
-  EPD_2in13_V4_SendData(0x03);
+/******************************************************************************
+function :	Wake the controller up from deep sleep
+Info:
+  The short reset pulse is enough to leave deep sleep, the RAMs are kept.
+******************************************************************************/
+static void EPD_2in13_V4_Wake(void) {
+  DEV_Digital_Write(EPD_RST_PIN, 0);
+  DEV_Delay_ms(2);
+  DEV_Digital_Write(EPD_RST_PIN, 1);
 
-  EPD_2in13_V4_SetWindows(0, 0, EPD_2in13_V4_WIDTH - 1, EPD_2in13_V4_HEIGHT - 1);
-  EPD_2in13_V4_SetCursor(0, 0);
+  EPD_2in13_V4_State.Sleeping = 0;
+  EPD_2in13_V4_State.Config = EPD_2in13_V4_CONFIG_NONE;
+  EPD_2in13_V4_State.Resets++;
+  EPD_2in13_V4_ForgetWindow();
+}
 
-  EPD_2in13_V4_SendCommand(0x3C); // BorderWavefrom
-  EPD_2in13_V4_SendData(0x05);
+/******************************************************************************
+function :	Load the registers an update needs
+parameter:
+    Config : Waveform setup of the update
+Info:
+  Wakes the controller if needed and only sends what the session is missing.
+  A partial update reloads the waveform, so the fast one is loaded again
+  after it.
+******************************************************************************/
+static void EPD_2in13_V4_Prepare(EPD_2in13_V4_Config Config) {
+  if (EPD_2in13_V4_State.Sleeping) {
+    EPD_2in13_V4_Wake();
+  }
+  if (EPD_2in13_V4_State.Config == Config) {
+    EPD_2in13_V4_State.Skipped++;
+    return;
+  }
 
-  EPD_2in13_V4_SendCommand(0x21); //  Display update control
-  EPD_2in13_V4_SendData(0x00);
-  EPD_2in13_V4_SendData(0x80);
+  if (EPD_2in13_V4_State.Config == EPD_2in13_V4_CONFIG_NONE) {
+    EPD_2in13_V4_SendCommand(0x01); // Driver output control
+    EPD_2in13_V4_SendData(0xF9);
+    EPD_2in13_V4_SendData(0x00);
+    EPD_2in13_V4_SendData(0x00);
 
-  EPD_2in13_V4_SendCommand(0x18); // Read built-in temperature sensor
-  EPD_2in13_V4_SendData(0x80);
-  EPD_2in13_V4_ReadBusy();
+    EPD_2in13_V4_SendCommand(0x11); // data entry mode
+    EPD_2in13_V4_SendData(0x03);
+  }
+
+  switch (Config) {
+  case EPD_2in13_V4_CONFIG_FULL:
+    EPD_2in13_V4_SendCommand(0x3C); // BorderWavefrom
+    EPD_2in13_V4_SendData(0x05);
+
+    EPD_2in13_V4_SendCommand(0x21); //  Display update control
+    EPD_2in13_V4_SendData(0x00);
+    EPD_2in13_V4_SendData(0x80);
+
+    EPD_2in13_V4_SendCommand(0x18); // Read built-in temperature sensor
+    EPD_2in13_V4_SendData(0x80);
+    break;
+  case EPD_2in13_V4_CONFIG_FAST:
+    EPD_2in13_V4_SendCommand(0x18); // Read built-in temperature sensor
+    EPD_2in13_V4_SendData(0x80);
+
+    EPD_2in13_V4_SendCommand(0x22); // Load temperature value
+    EPD_2in13_V4_SendData(0xB1);
+    EPD_2in13_V4_SendCommand(0x20);
+    EPD_2in13_V4_ReadBusy();
+
+    EPD_2in13_V4_SendCommand(0x1A); // Write to temperature register
+    EPD_2in13_V4_SendData(0x64);
+    EPD_2in13_V4_SendData(0x00);
+
+    EPD_2in13_V4_SendCommand(0x22); // Load temperature value
+    EPD_2in13_V4_SendData(0x91);
+    EPD_2in13_V4_SendCommand(0x20);
+    EPD_2in13_V4_ReadBusy();
+    break;
+  case EPD_2in13_V4_CONFIG_PARTIAL:
+    EPD_2in13_V4_SendCommand(0x3C); // BorderWavefrom
+    EPD_2in13_V4_SendData(0x80);
+    break;
+  default:
+    break;
+  }
+  EPD_2in13_V4_State.Config = Config;
 }
 
-void EPD_2in13_V4_Init_Fast(void) {
+/******************************************************************************
+function :	Initialize the e-Paper register
+parameter:
+Info:
+  Starts a new session from a full reset, the RAMs hold no image after it.
+******************************************************************************/
+static void EPD_2in13_V4_Start(EPD_2in13_V4_Config Config) {
   EPD_2in13_V4_Reset();
 
+  EPD_2in13_V4_ReadBusy();
   EPD_2in13_V4_SendCommand(0x12); // SWRESET
   EPD_2in13_V4_ReadBusy();
 
-  EPD_2in13_V4_SendCommand(0x18); // Read built-in temperature sensor
-  EPD_2in13_V4_SendData(0x80);
-
-  EPD_2in13_V4_SendCommand(0x11); // data entry mode
-  EPD_2in13_V4_SendData(0x03);
+  EPD_2in13_V4_State.Sleeping = 0;
+  EPD_2in13_V4_State.Config = EPD_2in13_V4_CONFIG_NONE;
+  EPD_2in13_V4_State.RamValid = 0;
+  EPD_2in13_V4_State.Resets++;
+  EPD_2in13_V4_ForgetWindow();
 
+  EPD_2in13_V4_Prepare(Config);
   EPD_2in13_V4_SetWindows(0, 0, EPD_2in13_V4_WIDTH - 1, EPD_2in13_V4_HEIGHT - 1);
   EPD_2in13_V4_SetCursor(0, 0);
-
-  EPD_2in13_V4_SendCommand(0x22); // Load temperature value
-  EPD_2in13_V4_SendData(0xB1);
-  EPD_2in13_V4_SendCommand(0x20);
   EPD_2in13_V4_ReadBusy();
+}
 
-  EPD_2in13_V4_SendCommand(0x1A); // Write to temperature register
-  EPD_2in13_V4_SendData(0x64);
-  EPD_2in13_V4_SendData(0x00);
+void EPD_2in13_V4_Init(void) { EPD_2in13_V4_Start(EPD_2in13_V4_CONFIG_FULL); }
 
-  EPD_2in13_V4_SendCommand(0x22); // Load temperature value
-  EPD_2in13_V4_SendData(0x91);
-  EPD_2in13_V4_SendCommand(0x20);
-  EPD_2in13_V4_ReadBusy();
-}
+void EPD_2in13_V4_Init_Fast(void) { EPD_2in13_V4_Start(EPD_2in13_V4_CONFIG_FAST); }
 
 /******************************************************************************
 function :	Clear screen
@@ -216,6 +360,9 @@ void EPD_2in13_V4_Clear(void) {
   Width = (EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1);
   Height = EPD_2in13_V4_HEIGHT;
 
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_FULL);
+  EPD_2in13_V4_SetWindows(0, 0, EPD_2in13_V4_WIDTH - 1, EPD_2in13_V4_HEIGHT - 1);
+  EPD_2in13_V4_SetCursor(0, 0);
   EPD_2in13_V4_SendCommand(0x24);
   for (UWORD j = 0; j < Height; j++) {
     for (UWORD i = 0; i < Width; i++) {
@@ -231,6 +378,9 @@ void EPD_2in13_V4_Clear_Black(void) {
   Width = (EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1);
   Height = EPD_2in13_V4_HEIGHT;
 
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_FULL);
+  EPD_2in13_V4_SetWindows(0, 0, EPD_2in13_V4_WIDTH - 1, EPD_2in13_V4_HEIGHT - 1);
+  EPD_2in13_V4_SetCursor(0, 0);
   EPD_2in13_V4_SendCommand(0x24);
   for (UWORD j = 0; j < Height; j++) {
     for (UWORD i = 0; i < Width; i++) {
@@ -247,104 +397,133 @@ parameter:
         Image : Image data
 ******************************************************************************/
 void EPD_2in13_V4_Display(UBYTE *Image) {
-  UWORD Width, Height;
-  Width = (EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1);
-  Height = EPD_2in13_V4_HEIGHT;
-
-  EPD_2in13_V4_SendCommand(0x24);
-  for (UWORD j = 0; j < Height; j++) {
-    for (UWORD i = 0; i < Width; i++) {
-      EPD_2in13_V4_SendData(Image[i + j * Width]);
-    }
-  }
-
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_FULL);
+  EPD_2in13_V4_WriteRam(0x24, Image);
   EPD_2in13_V4_TurnOnDisplay();
 }
 
 void EPD_2in13_V4_Display_Fast(UBYTE *Image) {
-  UWORD Width, Height;
-  Width = (EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1);
-  Height = EPD_2in13_V4_HEIGHT;
-
-  EPD_2in13_V4_SendCommand(0x24);
-  for (UWORD j = 0; j < Height; j++) {
-    for (UWORD i = 0; i < Width; i++) {
-      EPD_2in13_V4_SendData(Image[i + j * Width]);
-    }
-  }
-
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_FAST);
+  EPD_2in13_V4_WriteRam(0x24, Image);
   EPD_2in13_V4_TurnOnDisplay_Fast();
 }
 
+void EPD_2in13_V4_Display_Fast_Async(UBYTE *Image, EPD_2in13_V4_Callback Done) {
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_FAST);
+  EPD_2in13_V4_WriteRam(0x24, Image);
+  EPD_2in13_V4_Activate(0xc7, 1, Done);
+}
+
 /******************************************************************************
 function :	Refresh a base image
 parameter:
         Image : Image data
 ******************************************************************************/
-void EPD_2in13_V4_Display_Base(UBYTE *Image) {
-  UWORD Width, Height;
-  Width = (EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1);
-  Height = EPD_2in13_V4_HEIGHT;
+static void EPD_2in13_V4_WriteBase(UBYTE *Image) {
+  EPD_2in13_V4_WriteRam(0x24, Image); // Write Black and White image to RAM
+  EPD_2in13_V4_WriteRam(0x26, Image); // Write Black and White image to RAM
+  EPD_2in13_V4_State.RamValid = 1;
+}
 
-  EPD_2in13_V4_SendCommand(0x24); // Write Black and White image to RAM
-  for (UWORD j = 0; j < Height; j++) {
-    for (UWORD i = 0; i < Width; i++) {
-      EPD_2in13_V4_SendData(Image[i + j * Width]);
-    }
-  }
-  EPD_2in13_V4_SendCommand(0x26); // Write Black and White image to RAM
-  for (UWORD j = 0; j < Height; j++) {
-    for (UWORD i = 0; i < Width; i++) {
-      EPD_2in13_V4_SendData(Image[i + j * Width]);
-    }
-  }
+void EPD_2in13_V4_Display_Base(UBYTE *Image) {
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_FULL);
+  EPD_2in13_V4_WriteBase(Image);
   EPD_2in13_V4_TurnOnDisplay();
 }
 
+void EPD_2in13_V4_Display_Base_Async(UBYTE *Image, EPD_2in13_V4_Callback Done) {
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_FULL);
+  EPD_2in13_V4_WriteBase(Image);
+  EPD_2in13_V4_Activate(0xf7, 1, Done);
+}
+
 /******************************************************************************
-function :	Sends the image buffer in RAM to e-Paper and partial refresh
+function :	Refresh a base image with the fast waveform
 parameter:
         Image : Image data
+        Done  : Called from the BUSY interrupt once the refresh finished
+info:
+  Unlike Display_Fast, both RAMs are written, so partial refreshes can
+  follow without another update of the same image.
 ******************************************************************************/
-void EPD_2in13_V4_Display_Partial(UBYTE *Image) {
-  UWORD Width, Height;
-  Width = (EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1);
-  Height = EPD_2in13_V4_HEIGHT;
+void EPD_2in13_V4_Display_Fast_Base_Async(UBYTE *Image, EPD_2in13_V4_Callback Done) {
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_FAST);
+  EPD_2in13_V4_WriteBase(Image);
+  EPD_2in13_V4_Activate(0xc7, 1, Done);
+}
 
-  // Reset
-  DEV_Digital_Write(EPD_RST_PIN, 0);
-  DEV_Delay_ms(2);
-  DEV_Digital_Write(EPD_RST_PIN, 1);
+/******************************************************************************
+function :	Sends the image buffer in RAM to e-Paper and partial refresh
+parameter:
+        Image : Image data
+Info:
+  The controller is only reset when it is asleep, and the partial setup is
+  only sent when the previous update used another waveform.
+******************************************************************************/
+static void EPD_2in13_V4_WritePartial(UBYTE *Image) {
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_PARTIAL);
+  EPD_2in13_V4_WriteRam(0x24, Image); // Write Black and White image to RAM
+}
 
-  EPD_2in13_V4_SendCommand(0x3C); // BorderWavefrom
-  EPD_2in13_V4_SendData(0x80);
+void EPD_2in13_V4_Display_Partial(UBYTE *Image) {
+  EPD_2in13_V4_WritePartial(Image);
+  EPD_2in13_V4_Activate(0xff, 0, NULL); // fast:0x0c, quality:0x0f, 0xcf
+}
 
-  EPD_2in13_V4_SendCommand(0x01); // Driver output control
-  EPD_2in13_V4_SendData(0xF9);
-  EPD_2in13_V4_SendData(0x00);
-  EPD_2in13_V4_SendData(0x00);
+void EPD_2in13_V4_Display_Partial_Async(UBYTE *Image, EPD_2in13_V4_Callback Done) {
+  EPD_2in13_V4_WritePartial(Image);
+  EPD_2in13_V4_Activate(0xff, 1, Done);
+}
 
-  EPD_2in13_V4_SendCommand(0x11); // data entry mode
-  EPD_2in13_V4_SendData(0x03);
+/******************************************************************************
+function :	Sends a window of the image buffer to e-Paper and partial refresh
+parameter:
+        Image  : Image data, the whole frame
+        Xstart : First byte of the window in a line
+        Ystart : First line of the window
+        Xend   : Last byte of the window in a line
+        Yend   : Last line of the window
+        Done   : Called from the BUSY interrupt once the refresh finished
+info:
+  Only the window is written to the RAM, the rest of it still holds the
+  previous frame.
+******************************************************************************/
+void EPD_2in13_V4_Display_Partial_Window_Async(UBYTE *Image, UWORD Xstart, UWORD Ystart,
+                                               UWORD Xend, UWORD Yend,
+                                               EPD_2in13_V4_Callback Done) {
+  UWORD Width;
+  Width = (EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1);
 
-  EPD_2in13_V4_SetWindows(0, 0, EPD_2in13_V4_WIDTH - 1, EPD_2in13_V4_HEIGHT - 1);
-  EPD_2in13_V4_SetCursor(0, 0);
+  EPD_2in13_V4_Prepare(EPD_2in13_V4_CONFIG_PARTIAL);
+  EPD_2in13_V4_SetWindows(Xstart * 8, Ystart, Xend * 8 + 7, Yend);
+  EPD_2in13_V4_SetCursor(Xstart, Ystart);
 
-  EPD_2in13_V4_SendCommand(0x24); // Write Black and White image to RAM
-  for (UWORD j = 0; j < Height; j++) {
-    for (UWORD i = 0; i < Width; i++) {
-      EPD_2in13_V4_SendData(Image[i + j * Width]);
-    }
+  EPD_2in13_V4_SendCommand(0x24);
+  DEV_Digital_Write(EPD_DC_PIN, 1);
+  DEV_Digital_Write(EPD_CS_PIN, 0);
+  for (UWORD j = Ystart; j <= Yend; j++) {
+    DEV_SPI_Write_nByte(Image + j * Width + Xstart, Xend - Xstart + 1);
   }
-  EPD_2in13_V4_TurnOnDisplay_Partial();
+  DEV_Digital_Write(EPD_CS_PIN, 1);
+
+  EPD_2in13_V4_Activate(0xff, 1, Done);
 }
 
 /******************************************************************************
 function :	Enter sleep mode
 parameter:
+Info:
+  Deep sleep mode 1 keeps both RAMs, so the image on the panel is still there
+  to compare against and the first update after waking up can be partial.
 ******************************************************************************/
 void EPD_2in13_V4_Sleep(void) {
+  if (EPD_2in13_V4_State.Sleeping) {
+    return;
+  }
   EPD_2in13_V4_SendCommand(0x10); // enter deep sleep
   EPD_2in13_V4_SendData(0x01);
   DEV_Delay_ms(100);
+
+  EPD_2in13_V4_State.Sleeping = 1;
+  EPD_2in13_V4_State.Config = EPD_2in13_V4_CONFIG_NONE;
 }
@@ -37,6 +37,26 @@
 #define EPD_2in13_V4_WIDTH 122
 #define EPD_2in13_V4_HEIGHT 250
 
+// Called from the BUSY interrupt once an asynchronous refresh is done
+typedef void (*EPD_2in13_V4_Callback)(void);
+
+// Waveform setup loaded in the controller
+typedef enum {
+  EPD_2in13_V4_CONFIG_NONE, // Registers at their reset defaults
+  EPD_2in13_V4_CONFIG_FULL,
+  EPD_2in13_V4_CONFIG_FAST,
+  EPD_2in13_V4_CONFIG_PARTIAL,
+} EPD_2in13_V4_Config;
+
+// Power and configuration state of the controller
+typedef struct {
+  UBYTE Sleeping;             // In deep sleep, a reset is needed before the next command
+  UBYTE RamValid;             // Both RAMs hold the image on the panel
+  EPD_2in13_V4_Config Config; // Setup loaded since the last reset
+  UDOUBLE Resets;             // Hardware resets sent
+  UDOUBLE Skipped;            // Setups and windows not sent again
+} EPD_2in13_V4_Session;
+
 void EPD_2in13_V4_Init(void);
 void EPD_2in13_V4_Init_Fast(void);
 void EPD_2in13_V4_Init_GUI(void);
@@ -47,5 +67,16 @@ void EPD_2in13_V4_Display_Fast(UBYTE *Image);
 void EPD_2in13_V4_Display_Base(UBYTE *Image);
 void EPD_2in13_V4_Display_Partial(UBYTE *Image);
 void EPD_2in13_V4_Sleep(void);
+const EPD_2in13_V4_Session *EPD_2in13_V4_GetSession(void);
+
+void EPD_2in13_V4_Init_Async(void);
+UBYTE EPD_2in13_V4_IsBusy(void);
+void EPD_2in13_V4_Display_Fast_Async(UBYTE *Image, EPD_2in13_V4_Callback Done);
+void EPD_2in13_V4_Display_Base_Async(UBYTE *Image, EPD_2in13_V4_Callback Done);
+void EPD_2in13_V4_Display_Fast_Base_Async(UBYTE *Image, EPD_2in13_V4_Callback Done);
+void EPD_2in13_V4_Display_Partial_Async(UBYTE *Image, EPD_2in13_V4_Callback Done);
+void EPD_2in13_V4_Display_Partial_Window_Async(UBYTE *Image, UWORD Xstart, UWORD Ystart,
+                                               UWORD Xend, UWORD Yend,
+                                               EPD_2in13_V4_Callback Done);
 
 #endif
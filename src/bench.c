@@ -0,0 +1,112 @@
+/**
+ * Benchmarks
+ *
+ * Timing of the building blocks on the target, started from the console.
+ * Every step is timed in cycles with the SysTick counter, with the interrupts disabled.
+ */
+
+#define LOG_CATEGORY LOG_CONSOLE
+
+#include <stdio.h>
+
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "hardware/sync.h"
+#include "pico/util/queue.h"
+
+#include "bench.h"
+#include "network.h"
+#include "ring.h"
+#include "utils.h"
+
+// SysTick is a 24-bit down counter.
+#define SYSTICK_MASK 0xFFFFFF
+
+// Cycles of an add and a remove, summed over all the batches.
+typedef struct {
+  const char *name;
+  uint64_t add;
+  uint64_t remove;
+} bench_result_t;
+
+// Run `BODY` for a batch of items and add the cycles it took to `TOTAL`.
+#define BENCH_BATCH(TOTAL, BODY)                                                                   \
+  do {                                                                                             \
+    uint32_t irq = save_and_disable_interrupts();                                                  \
+    uint32_t start = systick_hw->cvr;                                                              \
+    for (int item = 0; item < BENCH_RING_SIZE; item++) {                                           \
+      BODY;                                                                                        \
+    }                                                                                              \
+    TOTAL += (start - systick_hw->cvr) & SYSTICK_MASK;                                             \
+    restore_interrupts(irq);                                                                       \
+  } while (0)
+
+static void report(bench_result_t *result, uint32_t items) {
+  reply("%-12s add: %4llu cycles, remove: %4llu cycles\n", result->name, result->add / items,
+        result->remove / items);
+}
+
+// Move messages through the SDK queue and the rings, copying them in and out as the queue does and
+// in place.
+void bench_rings(uint32_t iterations) {
+  MPSC_RING_STORAGE(mpsc_slots, message_history_t, BENCH_RING_SIZE);
+  SPSC_RING_STORAGE(spsc_slots, message_history_t, BENCH_RING_SIZE);
+  static spsc_ring_t spsc = SPSC_RING(spsc_slots);
+  static mpsc_ring_t mpsc;
+  MPSC_RING_INIT(&mpsc, mpsc_slots);
+  queue_t queue;
+  queue_init(&queue, sizeof(message_history_t), BENCH_RING_SIZE);
+
+  // Count processor cycles.
+  systick_hw->rvr = SYSTICK_MASK;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5;
+
+  bench_result_t results[] = {
+      {"queue_t"}, {"spsc copy"}, {"spsc"}, {"mpsc copy"}, {"mpsc"},
+  };
+  message_history_t message = {0};
+  volatile uint64_t sink = 0;
+  for (uint32_t i = 0; i < iterations; i++) {
+    BENCH_BATCH(results[0].add, queue_try_add(&queue, &message));
+    BENCH_BATCH(results[0].remove, queue_try_remove(&queue, &message));
+
+    BENCH_BATCH(results[1].add, spsc_ring_push(&spsc, &message));
+    BENCH_BATCH(results[1].remove, spsc_ring_pop(&spsc, &message));
+
+    BENCH_BATCH(results[2].add, {
+      message_history_t *slot = spsc_ring_reserve(&spsc);
+      slot->time = i;
+      spsc_ring_commit(&spsc);
+    });
+    BENCH_BATCH(results[2].remove, {
+      message_history_t *slot = spsc_ring_peek(&spsc);
+      sink += slot->time;
+      spsc_ring_release(&spsc);
+    });
+
+    BENCH_BATCH(results[3].add, mpsc_ring_push(&mpsc, &message));
+    BENCH_BATCH(results[3].remove, {
+      message = *(message_history_t *)mpsc_ring_peek(&mpsc);
+      mpsc_ring_release(&mpsc);
+    });
+
+    BENCH_BATCH(results[4].add, {
+      message_history_t *slot = mpsc_ring_reserve(&mpsc);
+      slot->time = i;
+      mpsc_ring_commit(&mpsc, slot);
+    });
+    BENCH_BATCH(results[4].remove, {
+      message_history_t *slot = mpsc_ring_peek(&mpsc);
+      sink += slot->time;
+      mpsc_ring_release(&mpsc);
+    });
+  }
+  queue_free(&queue);
+
+  reply("%d x %d messages of %d bytes at %d MHz\n", iterations, BENCH_RING_SIZE,
+        sizeof(message_history_t), clock_get_hz(clk_sys) / 1000000);
+  for (int i = 0; i < sizeof(results) / sizeof(results[0]); i++) {
+    report(&results[i], iterations * BENCH_RING_SIZE);
+  }
+}
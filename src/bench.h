@@ -0,0 +1,13 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+
+// Items moved through a ring in one timed batch, also the size of the rings.
+#define BENCH_RING_SIZE 8
+// Batches timed by default.
+#define BENCH_RING_ITERATIONS 1000
+
+void bench_rings(uint32_t iterations);
+
+#endif // _BENCH_H
@@ -0,0 +1,98 @@
+/**
+ * Radio capture
+ *
+ * Records every frame the radio receives or sends, and the interrupts it raises otherwise, with
+ * the time, the signal strength and the interrupt flags, so traffic seen in the field can be
+ * replayed on the host later (host/replay.c). Records are fixed size and go into a ring from the
+ * DIO1 interrupt and the radio loop, the console streams them out from the UI core with
+ * `get capture`. A full ring drops the record and counts it.
+ *
+ * The console prints every record as a line of hex, the record as it is in memory (little endian),
+ * between a line naming the node and its modulation parameters and a line with the counts:
+ *   capture begin 12:34:56 DEFAULT
+ *   capture 40420f0000000000000014...
+ *   capture end 1 records, 1 recorded, 0 dropped
+ *
+ * Capturing is off until `set capture true`, a record costs nothing but a flag check until then.
+ */
+
+#define LOG_CATEGORY LOG_CONSOLE
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "capture.h"
+#include "radio.h"
+#include "ring.h"
+#include "utils.h"
+
+capture_stats_t capture_stats = {0};
+
+MPSC_RING_STORAGE(capture_slots, capture_record_t, CAPTURE_SIZE);
+static mpsc_ring_t capture_ring;
+static bool capture_ready = false;
+
+static atomic_bool capture_on = false;
+
+// Start recording, from the UI core. The ring is kept from one capture to the next.
+void capture_start() {
+  if (!capture_ready) {
+    MPSC_RING_INIT(&capture_ring, capture_slots);
+    capture_ready = true;
+  }
+  atomic_store_explicit(&capture_on, true, memory_order_release);
+}
+
+void capture_stop() { atomic_store_explicit(&capture_on, false, memory_order_release); }
+
+bool capture_running() { return atomic_load_explicit(&capture_on, memory_order_acquire); }
+
+// Record a frame or an interrupt, from the DIO1 interrupt or the radio loop.
+void capture_frame(capture_kind_t kind, absolute_time_t time, const uint8_t *data, uint8_t length,
+                   uint16_t irq, int16_t rssi, int8_t snr) {
+  if (!capture_running()) {
+    return;
+  }
+
+  capture_record_t *record = mpsc_ring_reserve(&capture_ring);
+  if (record == NULL) {
+    capture_stats.dropped++;
+    return;
+  }
+  record->time = time;
+  record->kind = kind;
+  record->length = length;
+  record->irq = irq;
+  record->rssi = rssi < INT8_MIN ? INT8_MIN : rssi > INT8_MAX ? INT8_MAX : rssi;
+  record->snr = snr;
+  memset(record->data, 0, sizeof(record->data));
+  if (data != NULL) {
+    memcpy(record->data, data, length < sizeof(record->data) ? length : sizeof(record->data));
+  }
+  mpsc_ring_commit(&capture_ring, record);
+  capture_stats.records++;
+}
+
+// Take the oldest record, from the console.
+bool capture_take(capture_record_t *record) {
+  return capture_ready && mpsc_ring_pop(&capture_ring, record);
+}
+
+// Stream the records out over the console, from the UI core.
+void print_capture() {
+  reply("capture begin %s %s\n", uid_to_string(get_uid()), MOD_PARAM_STR[get_range()]);
+
+  capture_record_t record;
+  uint32_t count = 0;
+  char line[2 * sizeof(capture_record_t) + 1];
+  while (capture_take(&record)) {
+    for (int i = 0; i < sizeof(capture_record_t); i++) {
+      sprintf(&line[2 * i], "%02x", ((uint8_t *)&record)[i]);
+    }
+    reply("capture %s\n", line);
+    count++;
+  }
+
+  reply("capture end %d records, %d recorded, %d dropped\n", count, capture_stats.records,
+        capture_stats.dropped);
+}
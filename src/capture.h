@@ -0,0 +1,52 @@
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "network.h"
+#include "platform.h"
+
+// Records kept until the console streams them out, must be a power of two.
+#define CAPTURE_SIZE 128
+
+// What a capture record saw.
+typedef enum __attribute__((__packed__)) {
+  // A frame was received, before the decoder looked at it.
+  CAPTURE_RX,
+  // A frame went on the air.
+  CAPTURE_TX,
+  // An interrupt the radio loop has no use for, like a CRC or header error. No data.
+  CAPTURE_IRQ,
+} capture_kind_t;
+
+// A frame or an interrupt of the radio, as the capture keeps and streams it.
+// Frames longer than a message keep their length but only the start of their data.
+typedef struct __attribute__((__packed__)) {
+  absolute_time_t time;
+  capture_kind_t kind;
+  uint8_t length;
+  uint16_t irq;
+  int8_t rssi;
+  int8_t snr;
+  uint8_t data[sizeof(message_t)];
+} capture_record_t;
+
+typedef struct {
+  uint32_t records;
+  // Records lost to a full ring, the console didn't stream them out in time.
+  uint32_t dropped;
+} capture_stats_t;
+
+extern capture_stats_t capture_stats;
+
+void capture_start();
+void capture_stop();
+bool capture_running();
+
+void capture_frame(capture_kind_t kind, absolute_time_t time, const uint8_t *data, uint8_t length,
+                   uint16_t irq, int16_t rssi, int8_t snr);
+bool capture_take(capture_record_t *record);
+void print_capture();
+
+#endif // _CAPTURE_H
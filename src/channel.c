@@ -0,0 +1,84 @@
+/**
+ * Inter-core channel
+ *
+ * Typed records between the radio core and the UI core, one ring in each direction. Records are
+ * copied in and out whole, so neither side ever sees the other's state half written and neither
+ * side waits for the other: a full ring drops the record and counts it.
+ *
+ * Records towards the UI come from the radio loop, the rx interrupt and the console, so that ring
+ * takes several producers. Records towards the radio only come from the UI loop.
+ *
+ * Tables too big for a record, like the neighbour table, are not copied through the channel: the
+ * record says the table changed and the UI takes its own copy. Changes made before the UI gets to
+ * it share a single record.
+ */
+
+#define LOG_CATEGORY LOG_UI
+
+#include "channel.h"
+#include "events.h"
+#include "ring.h"
+#include "utils.h"
+
+channel_stats_t channel_stats = {0};
+
+MPSC_RING_STORAGE(to_ui_slots, core_msg_t, CHANNEL_SIZE);
+static mpsc_ring_t to_ui;
+
+SPSC_RING_STORAGE(to_radio_slots, core_msg_t, CHANNEL_SIZE);
+static spsc_ring_t to_radio = SPSC_RING(to_radio_slots);
+
+// Must be called before either side sends anything.
+void setup_channel() { MPSC_RING_INIT(&to_ui, to_ui_slots); }
+
+// Send a record to the UI core and wake it up.
+bool send_to_ui(const core_msg_t *msg) {
+  if (!mpsc_ring_push(&to_ui, msg)) {
+    atomic_fetch_add_explicit(&channel_stats.dropped, 1, memory_order_relaxed);
+    return false;
+  }
+  atomic_fetch_add_explicit(&channel_stats.to_ui, 1, memory_order_relaxed);
+  platform_notify();
+  return true;
+}
+
+bool receive_on_ui(core_msg_t *msg) { return mpsc_ring_pop(&to_ui, msg); }
+
+bool ui_channel_pending() { return mpsc_ring_level(&to_ui) != 0; }
+
+// Send a record to the radio core and wake up its loop.
+bool send_to_radio(const core_msg_t *msg) {
+  if (!spsc_ring_push(&to_radio, msg)) {
+    atomic_fetch_add_explicit(&channel_stats.dropped, 1, memory_order_relaxed);
+    return false;
+  }
+  atomic_fetch_add_explicit(&channel_stats.to_radio, 1, memory_order_relaxed);
+  post_event(EVENT_CHANNEL);
+  return true;
+}
+
+bool receive_on_radio(core_msg_t *msg) { return spsc_ring_pop(&to_radio, msg); }
+
+// Ask the radio core to send a message.
+void request_transmit(message_t message) {
+  core_msg_t msg = {.type = CORE_CMD_TRANSMIT, .time = platform_now(), .transmit = message};
+  if (!send_to_radio(&msg)) {
+    error("radio channel is full, dropping message\n");
+  }
+}
+
+// Ask the radio core to change the modulation parameters.
+void request_range(mod_params_t param) {
+  core_msg_t msg = {.type = CORE_CMD_RANGE, .time = platform_now(), .range = param};
+  if (!send_to_radio(&msg)) {
+    error("radio channel is full, dropping range change\n");
+  }
+}
+
+// Ask the radio core to print one of its tables.
+void request_print(print_table_t table) {
+  core_msg_t msg = {.type = CORE_CMD_PRINT, .time = platform_now(), .print = table};
+  if (!send_to_radio(&msg)) {
+    error("radio channel is full, dropping print\n");
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef _CHANNEL_H
+#define _CHANNEL_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "platform.h"
+
+#include "network.h"
+#include "utils.h"
+
+// Maximum number of records waiting in each direction, must be a power of two.
+#define CHANNEL_SIZE 16
+
+// Records passed between the radio core and the UI core, see `RADIO_CORE`.
+typedef enum {
+  // Radio to UI: something shown on the screen changed.
+  CORE_EVENT_REDRAW,
+  // Radio to UI: a message was added to the inbox.
+  CORE_EVENT_MESSAGE,
+  // Radio to UI: the neighbour table changed, read it with `copy_neighbour_table`.
+  // Only one is sent until the UI takes its copy, whatever changed in between.
+  CORE_EVENT_NEIGHBOURS,
+  // UI to radio: send a message.
+  CORE_CMD_TRANSMIT,
+  // UI to radio: change the modulation parameters.
+  CORE_CMD_RANGE,
+  // UI to radio: print a table of the radio core for the console.
+  CORE_CMD_PRINT,
+} core_msg_type_t;
+
+// Tables the radio core and its interrupt change, printed on that core rather than read across.
+typedef enum {
+  PRINT_MESSAGES,
+  PRINT_NEIGHBOURS,
+  PRINT_ACKS,
+} print_table_t;
+
+// A record of the channel, copied in and out as a whole.
+typedef struct {
+  core_msg_type_t type;
+  // Time of what the record is about, the time a message was received.
+  absolute_time_t time;
+  union {
+    // CORE_EVENT_MESSAGE
+    struct {
+      uid_t src;
+      mid_t id;
+      mtype_t mtype;
+    } message;
+    // CORE_CMD_TRANSMIT
+    message_t transmit;
+    // CORE_CMD_RANGE
+    mod_params_t range;
+    // CORE_CMD_PRINT
+    print_table_t print;
+  };
+} core_msg_t;
+
+// Channel statistics.
+// Records are sent from the rx interrupt and both cores, so the counts only change with atomics.
+typedef struct {
+  atomic_uint_least32_t to_ui;
+  atomic_uint_least32_t to_radio;
+  atomic_uint_least32_t dropped;
+  // Time from receiving a message to the frame showing it being sent to the display.
+  uint32_t notify_us_last;
+  uint32_t notify_us_max;
+} channel_stats_t;
+
+extern channel_stats_t channel_stats;
+
+void setup_channel();
+
+bool send_to_ui(const core_msg_t *msg);
+bool receive_on_ui(core_msg_t *msg);
+bool ui_channel_pending();
+
+bool send_to_radio(const core_msg_t *msg);
+bool receive_on_radio(core_msg_t *msg);
+void request_transmit(message_t message);
+void request_range(mod_params_t param);
+void request_print(print_table_t table);
+
+#endif // _CHANNEL_H
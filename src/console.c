@@ -1,22 +1,48 @@
+#define LOG_CATEGORY LOG_CONSOLE
+
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "hardware/sync.h"
+
+#include "bench.h"
+#include "capture.h"
+#include "channel.h"
 #include "console.h"
+#include "events.h"
+#include "histogram.h"
+#include "inbox.h"
+#include "log.h"
 #include "network.h"
+#include "screen.h"
+#include "stats.h"
+#include "text.h"
 #include "utils.h"
 #include "voidlink.h"
 
 char console_buffer[CONSOLE_BUFFER_SIZE];
 uint8_t console_buffer_offset;
 
-// Split a message into parts.
+typedef enum {
+  CONSOLE_IDLE,
+  CONSOLE_READY,
+} console_t;
+
+// Set by the serial interrupts once a line is complete, cleared by the UI loop once it is handled.
+static volatile console_t console = CONSOLE_IDLE;
+
+// Split a message into parts, the ones it doesn't have are NULL.
 void parse_message(char **parts, char *message) {
   uint8_t i = 0;
   parts[i] = strtok(message, " ");
-  while (parts[i] != NULL) {
+  while (parts[i] != NULL && i < CONSOLE_PARTS - 1) {
     parts[++i] = strtok(NULL, " ");
   }
+  while (++i < CONSOLE_PARTS) {
+    parts[i] = NULL;
+  }
 }
 
 // Parse a uid from a string.
@@ -33,9 +59,65 @@ void parse_uid_or_broadcast(uid_t *uid, char *string) {
   }
 }
 
+// Hand a complete line to the UI loop, called from the serial interrupts.
+void console_line_ready() {
+  console = CONSOLE_READY;
+  __sev();
+}
+
+bool console_pending() { return console == CONSOLE_READY; }
+
+// Handle the console input if a line is ready, from the UI loop.
+// Commands touching the radio are sent to the radio core through the channel.
+void handle_console() {
+  if (console == CONSOLE_READY) {
+    handle_console_input();
+    console = CONSOLE_IDLE;
+  }
+}
+
+// Index of a name in a table of names, `count` if it is not there.
+static int find_name(const char **names, int count, const char *name) {
+  for (int i = 0; i < count; i++) {
+    if (name != NULL && strcmp(name, names[i]) == 0) {
+      return i;
+    }
+  }
+  return count;
+}
+
+// `set log <mode>` or `set log <category|all> <level>`.
+static void set_log(char *what, char *level) {
+  int mode = find_name(LOG_MODE_STR, LOG_MODES, what);
+  if (mode < LOG_MODES && level == NULL) {
+    log_mode = mode;
+    // The interrupt figures start over, so `get irq` shows what the new mode costs.
+    dio1_irq_stats.max_us = 0;
+    return;
+  }
+
+  bool all = what != NULL && strcmp(what, "all") == 0;
+  int category = find_name(LOG_CATEGORY_STR, LOG_CATEGORIES, what);
+  int value = find_name(LOG_LEVEL_STR, LOG_LEVELS, level);
+  if ((!all && category == LOG_CATEGORIES) || value == LOG_LEVELS) {
+    reply("set log requires direct, text or binary, or a category and a level\n");
+    return;
+  }
+  if (value < LOG_FLOOR) {
+    reply("%s lines are not built in, logging from %s\n", LOG_LEVEL_STR[value],
+          LOG_LEVEL_STR[LOG_FLOOR]);
+  }
+
+  for (int i = 0; i < LOG_CATEGORIES; i++) {
+    if (all || i == category) {
+      log_levels[i] = value;
+    }
+  }
+}
+
 // Handle the console input.
 void handle_console_input() {
-  char *parts[3];
+  char *parts[CONSOLE_PARTS];
   parse_message(parts, console_buffer);
 
   if (strcmp(parts[0], "hello") == 0) {
@@ -43,32 +125,41 @@ void handle_console_input() {
     if (strcmp(parts[1], "ack") == 0) {
       hello.flags.ack_req = true;
     }
-    try_transmit(hello);
+    request_transmit(hello);
 
   } else if (strcmp(parts[0], "ping") == 0) {
     uid_t dst;
     parse_uid_or_broadcast(&dst, parts[1]);
-    try_transmit(new_ping_message(dst));
+    request_transmit(new_ping_message(dst));
 
   } else if (strcmp(parts[0], "text") == 0) {
     if (parts[1] == NULL) {
-      error("text message requires an id\n");
+      reply("text message requires an id\n");
       return;
     }
     text_id_t id = atoi(parts[1]);
     uid_t dst;
     parse_uid_or_broadcast(&dst, parts[2]);
-    try_transmit(new_text_message(dst, id));
+    request_transmit(new_text_message(dst, id));
 
   } else if (strcmp(parts[0], "request") == 0) {
     if (parts[1] == NULL) {
-      error("request message requires a key\n");
+      reply("request message requires a key\n");
       return;
     }
     info_key_t key = atoi(parts[1]);
     uid_t dst;
     parse_uid_or_broadcast(&dst, parts[2]);
-    try_transmit(new_request_message(dst, key));
+    message_t request = new_request_message(dst, key);
+    // `request 4 <uid> <counter>` asks for one of the counters of `get stats`.
+    if (key == INFO_STATS && parts[3] != NULL) {
+      request.data[1] = atoi(parts[3]);
+    }
+    request_transmit(request);
+
+  } else if (strcmp(parts[0], "redraw") == 0) {
+    core_msg_t redraw = {.type = CORE_EVENT_REDRAW, .time = get_absolute_time()};
+    send_to_ui(&redraw);
 
   } else if (strcmp(parts[0], "set") == 0) {
     if (strcmp(parts[1], "stop") == 0) {
@@ -76,39 +167,128 @@ void handle_console_input() {
         STOP_PROCESSING = true;
       } else if (strcmp(parts[2], "false") == 0) {
         STOP_PROCESSING = false;
+        // Pick up the messages held back in the meantime.
+        post_event(EVENT_RX);
       } else {
-        error("set stop requires a boolean value\n");
+        reply("set stop requires a boolean value\n");
       }
     } else if (strcmp(parts[1], "range") == 0) {
       if (strcmp(parts[2], "default") == 0) {
-        set_range(DEFAULT);
+        request_range(DEFAULT);
       } else if (strcmp(parts[2], "fast") == 0) {
-        set_range(FAST);
+        request_range(FAST);
       } else if (strcmp(parts[2], "longrange") == 0) {
-        set_range(LONGRANGE);
+        request_range(LONGRANGE);
+      } else {
+        reply("set range requires a valid range\n");
+      }
+    } else if (strcmp(parts[1], "log") == 0) {
+      set_log(parts[2], parts[3]);
+    } else if (strcmp(parts[1], "timing") == 0) {
+      if (parts[2] != NULL && strcmp(parts[2], "reset") == 0) {
+        histograms_reset();
       } else {
-        error("set range requires a valid range\n");
+        reply("set timing requires reset\n");
+      }
+    } else if (strcmp(parts[1], "stats") == 0) {
+      if (parts[2] != NULL && strcmp(parts[2], "reset") == 0) {
+        stats_reset();
+      } else {
+        reply("set stats requires reset\n");
+      }
+    } else if (strcmp(parts[1], "capture") == 0) {
+      if (parts[2] != NULL && strcmp(parts[2], "true") == 0) {
+        capture_start();
+      } else if (parts[2] != NULL && strcmp(parts[2], "false") == 0) {
+        capture_stop();
+      } else {
+        reply("set capture requires a boolean value\n");
       }
     } else {
-      error("unknown set command\n");
+      reply("unknown set command\n");
     }
 
   } else if (strcmp(parts[0], "get") == 0) {
     if (strcmp(parts[1], "messages") == 0) {
-      print_message_history();
+      request_print(PRINT_MESSAGES);
+    } else if (strcmp(parts[1], "inbox") == 0) {
+      print_inbox();
     } else if (strcmp(parts[1], "neighbours") == 0) {
-      print_neighbours();
+      request_print(PRINT_NEIGHBOURS);
     } else if (strcmp(parts[1], "acks") == 0) {
-      print_acks();
+      request_print(PRINT_ACKS);
+    } else if (strcmp(parts[1], "packets") == 0) {
+      print_packets();
+    } else if (strcmp(parts[1], "capture") == 0) {
+      print_capture();
+    } else if (strcmp(parts[1], "log") == 0) {
+      reply("log: %s, %d written, %d dropped, %d truncated\n", LOG_MODE_STR[log_mode],
+            log_stats.written, log_stats.dropped, log_stats.truncated);
+      for (int i = 0; i < LOG_CATEGORIES; i++) {
+        reply("%s: %s\n", LOG_CATEGORY_STR[i], LOG_LEVEL_STR[log_levels[i]]);
+      }
+      reply("built from: %s\n", LOG_LEVEL_STR[LOG_FLOOR]);
     } else if (strcmp(parts[1], "uptime") == 0) {
-      info("uptime: %ds\n", to_ms_since_boot(get_absolute_time()) / 1000);
+      reply("uptime: %ds\n", to_ms_since_boot(get_absolute_time()) / 1000);
     } else if (strcmp(parts[1], "voltage") == 0) {
-      info("voltage: %f V\n", read_voltage());
+      reply("voltage: %f V\n", read_voltage());
+    } else if (strcmp(parts[1], "display") == 0) {
+      uint64_t busy_us = 0;
+      for (int i = 0; i < REFRESH_MODES; i++) {
+        reply("%s refreshes: %d, busy: %" PRIu64 " ms\n", REFRESH_MODE_STR[i],
+              refresh_stats.count[i], refresh_stats.busy_us[i] / 1000);
+        busy_us += refresh_stats.busy_us[i];
+      }
+      reply("busy: %" PRIu64 " ms, ui core idle: %" PRIu64 " ms, ghosting: %d px, skipped: %d\n",
+            busy_us / 1000, refresh_stats.idle_us / 1000, refresh_stats.ghosting,
+            refresh_stats.skipped);
+      reply("wakes: %d, last: %d us, max: %d us\n", refresh_stats.wakes, refresh_stats.wake_us_last,
+            refresh_stats.wake_us_max);
+      reply("renders: %d, last: %d us (%d widgets, %d px), max: %d us\n", render_stats.count,
+            render_stats.last_us, render_stats.last_widgets, render_stats.last_area,
+            render_stats.max_us);
+      reply("text runs: %d lookups, %d hits, %d evictions\n", text_stats.lookups, text_stats.hits,
+            text_stats.evictions);
+    } else if (strcmp(parts[1], "irq") == 0) {
+      reply("button irq: %d, last: %d us, max: %d us\n", button_irq_stats.count,
+            button_irq_stats.last_us, button_irq_stats.max_us);
+      reply("dio1 irq: %d, last: %d us, max: %d us\n", dio1_irq_stats.count,
+            dio1_irq_stats.last_us, dio1_irq_stats.max_us);
+    } else if (strcmp(parts[1], "channel") == 0) {
+      reply("to ui: %d, to radio: %d, dropped: %d\n", channel_stats.to_ui, channel_stats.to_radio,
+            channel_stats.dropped);
+      reply("rx to screen: last: %d us, max: %d us\n", channel_stats.notify_us_last,
+            channel_stats.notify_us_max);
+    } else if (strcmp(parts[1], "stats") == 0) {
+      print_stats();
+    } else if (strcmp(parts[1], "timing") == 0) {
+      print_histograms();
+    } else if (strcmp(parts[1], "loop") == 0) {
+      uint64_t uptime_us = to_us_since_boot(get_absolute_time());
+      reply("wakes: %d events, %d deadlines, %d idle\n", event_stats.events,
+            event_stats.deadlines, event_stats.idle_wakes);
+      reply("asleep: %" PRIu64 " ms of %" PRIu64 " ms\n", event_stats.sleep_us / 1000,
+            uptime_us / 1000);
+      reply("rx latency: last: %d us, max: %d us\n", event_stats.rx_latency_us_last,
+            event_stats.rx_latency_us_max);
+      reply("forwards: %d, last: %d us, max: %d us (radio core: %d)\n", event_stats.forwards,
+            event_stats.forward_us_last, event_stats.forward_us_max, RADIO_CORE);
+      reply("queue drops: rx: %d, tx: %d\n", event_stats.rx_drops, stat_get(STAT_TX_QUEUE_FULL));
+      reply("rejected frames: length: %d, src: %d, mtype: %d, data: %d\n",
+            decode_rejects[DECODE_LENGTH], decode_rejects[DECODE_SRC], decode_rejects[DECODE_MTYPE],
+            decode_rejects[DECODE_DATA]);
+    } else {
+      reply("unknown get command\n");
+    }
+
+  } else if (strcmp(parts[0], "bench") == 0) {
+    if (parts[1] != NULL && strcmp(parts[1], "rings") == 0) {
+      bench_rings(parts[2] != NULL ? atoi(parts[2]) : BENCH_RING_ITERATIONS);
     } else {
-      error("unknown get command\n");
+      reply("unknown bench command\n");
     }
 
   } else {
-    error("unknown command\n");
+    reply("unknown command\n");
   }
 }
@@ -1,11 +1,14 @@
 #ifndef _CONSOLE_H
 #define _CONSOLE_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "network.h"
 
 #define CONSOLE_BUFFER_SIZE 128
+// Words of a command, any after them are ignored.
+#define CONSOLE_PARTS 4
 
 extern char console_buffer[CONSOLE_BUFFER_SIZE];
 extern uint8_t console_buffer_offset;
@@ -13,6 +16,9 @@ extern uint8_t console_buffer_offset;
 void parse_message(char **parts, char *message);
 void parse_uid(uid_t *uid, char *string);
 void parse_uid_or_broadcast(uid_t *uid, char *string);
+void console_line_ready();
+bool console_pending();
+void handle_console();
 void handle_console_input();
 
 #endif // _CONSOLE_H
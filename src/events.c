@@ -0,0 +1,53 @@
+/**
+ * Radio loop events
+ *
+ * The radio loop sleeps until there is something to do. Whatever hands it work sets a bit
+ * in the pending events and sends an event with `__sev`, which wakes the core from `__wfe`, and
+ * timed work is handed in as the deadline to wait for.
+ *
+ * The event register of the core remembers an event sent before it went to sleep, so an event
+ * posted between checking the bits and `__wfe` is not lost. Every interrupt wakes the core too,
+ * those are counted as idle wakes when they leave nothing for the radio loop.
+ */
+
+#include <stdatomic.h>
+
+#include "events.h"
+#include "platform.h"
+
+event_stats_t event_stats = {0};
+
+static atomic_uint_least32_t pending = 0;
+
+// Hand work to the radio loop, from any core or interrupt.
+void post_event(event_t event) {
+  atomic_fetch_or_explicit(&pending, event, memory_order_release);
+  platform_notify();
+}
+
+// Take the posted events without waiting, for a loop driven from outside, like a simulation.
+uint32_t take_events() { return atomic_exchange_explicit(&pending, 0, memory_order_acquire); }
+
+// Sleep until an event is posted or the deadline is reached, returns the posted events.
+// Only called from the radio loop.
+uint32_t wait_for_events(absolute_time_t deadline) {
+  absolute_time_t start = platform_now();
+  uint32_t events;
+
+  while ((events = take_events()) == 0) {
+    if (platform_reached(deadline)) {
+      event_stats.deadlines++;
+      break;
+    }
+    platform_wait(deadline);
+    if (atomic_load_explicit(&pending, memory_order_relaxed) == 0 && !platform_reached(deadline)) {
+      event_stats.idle_wakes++;
+    }
+  }
+
+  if (events != 0) {
+    event_stats.events++;
+  }
+  event_stats.sleep_us += platform_diff_us(start, platform_now());
+  return events;
+}
@@ -0,0 +1,48 @@
+#ifndef _EVENTS_H
+#define _EVENTS_H
+
+#include <stdint.h>
+
+#include "platform.h"
+
+// Work for the radio loop, posted from interrupts and from both cores.
+typedef enum {
+  // A received packet is waiting in the rx queue.
+  EVENT_RX = 1 << 0,
+  // A packet is waiting in the tx queue.
+  EVENT_TX = 1 << 1,
+  // The radio finished transmitting.
+  EVENT_TX_DONE = 1 << 2,
+  // A record arrived from the UI core.
+  EVENT_CHANNEL = 1 << 3,
+  // A message was marked read, the inbox has flags to write.
+  EVENT_INBOX = 1 << 4,
+} event_t;
+
+// Radio loop statistics.
+typedef struct {
+  // Wake ups with work to do, either events or a deadline.
+  uint32_t events;
+  uint32_t deadlines;
+  // Wake ups without anything to do, by an interrupt meant for something else.
+  uint32_t idle_wakes;
+  // Time spent waiting for events.
+  uint64_t sleep_us;
+  // Time between receiving a packet and the radio loop picking it up.
+  uint32_t rx_latency_us_last;
+  uint32_t rx_latency_us_max;
+  // Time between receiving a packet to forward and the radio loop starting to send it.
+  uint32_t forwards;
+  uint32_t forward_us_last;
+  uint32_t forward_us_max;
+  // Packets dropped on a full rx queue, those on a full tx queue count as STAT_TX_QUEUE_FULL.
+  uint32_t rx_drops;
+} event_stats_t;
+
+extern event_stats_t event_stats;
+
+void post_event(event_t event);
+uint32_t take_events();
+uint32_t wait_for_events(absolute_time_t deadline);
+
+#endif // _EVENTS_H
@@ -0,0 +1,80 @@
+/**
+ * Latency histograms
+ *
+ * How long packets wait in the queues, back off and stay on the air, how long the DIO1 interrupt
+ * and the SPI commands to the radio take, and how long acks take to come back. Each is a fixed set
+ * of log-scale buckets: the bucket of a value comes from its highest bit and the two bits below
+ * it, adding one is a few instructions whatever the value, and percentiles are read back to within
+ * a quarter of their value.
+ *
+ * The histograms are written from the radio core alone. Its interrupts are kept off while adding,
+ * the DIO1 interrupt talks to the radio over SPI as well. `get timing` prints them and
+ * `set timing reset` empties them, a value added meanwhile may be lost.
+ */
+
+#define LOG_CATEGORY LOG_CONSOLE
+
+#include <string.h>
+
+#include "histogram.h"
+#include "platform.h"
+#include "utils.h"
+
+histogram_t histograms[HISTOGRAMS] = {0};
+
+static uint32_t bucket_of(uint32_t value) {
+  if (value < (1u << HISTOGRAM_SUB_BITS)) {
+    return value;
+  }
+  uint32_t exponent = 31 - __builtin_clz(value);
+  uint32_t sub = (value >> (exponent - HISTOGRAM_SUB_BITS)) & ((1u << HISTOGRAM_SUB_BITS) - 1);
+  return (exponent - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS | sub;
+}
+
+// Largest value of a bucket.
+static uint32_t bucket_top(uint32_t bucket) {
+  if (bucket < (1u << HISTOGRAM_SUB_BITS)) {
+    return bucket;
+  }
+  uint32_t exponent = (bucket >> HISTOGRAM_SUB_BITS) + HISTOGRAM_SUB_BITS - 1;
+  uint32_t sub = bucket & ((1u << HISTOGRAM_SUB_BITS) - 1);
+  uint64_t bottom = (uint64_t)((1u << HISTOGRAM_SUB_BITS) | sub) << (exponent - HISTOGRAM_SUB_BITS);
+  return bottom + (1ull << (exponent - HISTOGRAM_SUB_BITS)) - 1;
+}
+
+void histogram_add(histogram_id_t id, uint32_t value) {
+  histogram_t *histogram = &histograms[id];
+  uint32_t irq = platform_irq_disable();
+  histogram->buckets[bucket_of(value)]++;
+  histogram->count++;
+  if (value > histogram->max) {
+    histogram->max = value;
+  }
+  platform_irq_restore(irq);
+}
+
+// The value `percent` of the values are at or below, rounded up to the top of its bucket.
+uint32_t histogram_percentile(const histogram_t *histogram, uint32_t percent) {
+  uint64_t rank = ((uint64_t)histogram->count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    seen += histogram->buckets[i];
+    if (seen >= rank && seen > 0) {
+      uint32_t top = bucket_top(i);
+      return top < histogram->max ? top : histogram->max;
+    }
+  }
+  return histogram->max;
+}
+
+void histograms_reset() { memset(histograms, 0, sizeof(histograms)); }
+
+void print_histograms() {
+  for (int i = 0; i < HISTOGRAMS; i++) {
+    const histogram_t *histogram = &histograms[i];
+    reply("%s: %u samples, p50: %u us, p90: %u us, p99: %u us, max: %u us\n", HISTOGRAM_STR[i],
+          histogram->count, histogram_percentile(histogram, 50),
+          histogram_percentile(histogram, 90), histogram_percentile(histogram, 99),
+          histogram->max);
+  }
+}
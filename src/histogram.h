@@ -0,0 +1,41 @@
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+#include <stdint.h>
+
+// Four buckets for every power of two, the values below four have one each, so a bucket is never
+// wider than a quarter of the values in it. Every 32-bit value has a bucket.
+#define HISTOGRAM_SUB_BITS 2
+#define HISTOGRAM_BUCKETS ((32 - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+// Durations kept as histograms, all in microseconds.
+typedef enum {
+  // Received packets waiting for the radio loop.
+  HIST_RX_QUEUE,
+  // Packets to send waiting for the radio loop, the backoff comes after.
+  HIST_TX_QUEUE,
+  HIST_BACKOFF,
+  HIST_AIRTIME,
+  // The DIO1 interrupt handler.
+  HIST_DIO1,
+  // A command to the radio over SPI, waiting for it to be ready included.
+  HIST_SPI,
+  // From taking a message that wants an ack off the tx queue to its ack, backoff included.
+  HIST_ACK_RTT,
+  HISTOGRAMS,
+} histogram_id_t;
+
+typedef struct {
+  uint32_t buckets[HISTOGRAM_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+} histogram_t;
+
+extern histogram_t histograms[HISTOGRAMS];
+
+void histogram_add(histogram_id_t id, uint32_t value);
+uint32_t histogram_percentile(const histogram_t *histogram, uint32_t percent);
+void histograms_reset();
+void print_histograms();
+
+#endif // _HISTOGRAM_H
@@ -0,0 +1,380 @@
+/**
+ * Inbox
+ *
+ * Received messages are kept in a ring of fixed size records at the end of the flash, so they
+ * survive a reboot. Records are only ever appended: the ring moves through the sectors in turn and
+ * erases the sector ahead of it once it gets there, which spreads the wear over all of them. The
+ * oldest messages are dropped a sector at a time.
+ *
+ * The record with sequence number `seq` is always in slot `seq % INBOX_SLOTS`. Only the next
+ * sequence number and the number of messages are kept in RAM, finding the n-th newest message is
+ * a single read. Unread messages are kept in a bitmap by slot. A message is marked read in RAM
+ * right away, and later in the flash by programming its unread byte to zero, the flags of a whole
+ * page at once.
+ *
+ * The flash is only written from the radio core. The UI core reads the records through XIP, and
+ * is paused while the flash is written to.
+ */
+
+#define LOG_CATEGORY LOG_NET
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "pico/critical_section.h"
+#include "pico/flash.h"
+#include "pico/time.h"
+
+#include "events.h"
+#include "inbox.h"
+#include "network.h"
+#include "utils.h"
+
+// Offset of the inbox from the start of the flash.
+#define INBOX_OFFSET (PICO_FLASH_SIZE_BYTES - INBOX_SECTORS * FLASH_SECTOR_SIZE)
+// Unread byte of a message, as programmed. It reads zero once the message is read.
+#define INBOX_UNREAD 0xFF
+// Longest time to wait for the other core to pause for a flash write.
+#define INBOX_FLASH_TIMEOUT_MS 100
+
+// A stored message.
+// The unread byte is left out of the crc, it is programmed again once the message is read.
+typedef struct __attribute__((__packed__)) {
+  uint32_t seq;      // 4
+  message_t message; // 20 24
+  uint32_t time_ms;  // 4 28
+  uint8_t boot;      // 1 29
+  uint8_t unread;    // 1 30
+  uint16_t crc;      // 2 32
+} inbox_record_t;
+
+_Static_assert(sizeof(inbox_record_t) == INBOX_RECORD_SIZE, "inbox record must fill its slot");
+
+// Address and data of a flash write.
+typedef struct {
+  uint32_t offset;
+  const uint8_t *data;
+} flash_write_t;
+
+inbox_stats_t inbox_stats = {0};
+
+// Sequence number of the next message, only written by the radio core.
+static volatile uint32_t head_seq = 0;
+// Number of messages, the oldest one has sequence number `head_seq - count`.
+static volatile uint32_t count = 0;
+// Boot number stored with the messages, one more than the newest message at boot.
+static uint8_t boot = 0;
+
+// Unread messages, and messages read since the last sync, one bit per slot.
+static uint32_t unread_bits[INBOX_SLOTS / 32];
+static uint32_t pending_bits[INBOX_SLOTS / 32];
+static volatile uint32_t unread_count = 0;
+static volatile uint32_t pending_count = 0;
+static absolute_time_t last_read = 0;
+// Guards the bitmaps, both cores update them.
+static critical_section_t lock;
+
+static inline bool test_bit(const uint32_t *bits, uint32_t slot) {
+  return bits[slot / 32] & (1u << (slot % 32));
+}
+
+static inline void set_bit(uint32_t *bits, uint32_t slot) { bits[slot / 32] |= 1u << (slot % 32); }
+
+static inline void clear_bit(uint32_t *bits, uint32_t slot) {
+  bits[slot / 32] &= ~(1u << (slot % 32));
+}
+
+// CRC-16/CCITT of a record, up to the unread byte.
+static uint16_t record_crc(const inbox_record_t *record) {
+  const uint8_t *bytes = (const uint8_t *)record;
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < offsetof(inbox_record_t, unread); i++) {
+    crc ^= bytes[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static const uint8_t *slot_address(uint32_t slot) {
+  return (const uint8_t *)(uintptr_t)(XIP_BASE + INBOX_OFFSET + slot * INBOX_RECORD_SIZE);
+}
+
+// Copy the record in a slot, returns false if the slot doesn't hold one.
+static bool read_record(uint32_t slot, inbox_record_t *record) {
+  memcpy(record, slot_address(slot), sizeof(*record));
+  return record->crc == record_crc(record) && record->seq % INBOX_SLOTS == slot;
+}
+
+// Check if `slots` slots starting from `slot` are erased.
+static bool is_erased(uint32_t slot, uint32_t slots) {
+  const uint8_t *bytes = slot_address(slot);
+  for (uint32_t i = 0; i < slots * INBOX_RECORD_SIZE; i++) {
+    if (bytes[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void erase_sector(void *param) {
+  flash_write_t *write = param;
+  flash_range_erase(write->offset, FLASH_SECTOR_SIZE);
+}
+
+static void program_page(void *param) {
+  flash_write_t *write = param;
+  flash_range_program(write->offset, write->data, FLASH_PAGE_SIZE);
+}
+
+// Run a flash write, with the other core paused and the interrupts disabled.
+// The offset is from the start of the inbox.
+static bool write_flash(void (*func)(void *), uint32_t offset, const uint8_t *data) {
+  flash_write_t write = {INBOX_OFFSET + offset, data};
+  int result = flash_safe_execute(func, &write, INBOX_FLASH_TIMEOUT_MS);
+  if (result != PICO_OK) {
+    inbox_stats.failures++;
+    error("inbox flash write at %x failed: %d\n", write.offset, result);
+    return false;
+  }
+  return true;
+}
+
+// Only the messages meant for the user are kept, not the ones running the network.
+static bool is_kept(message_t *message) {
+  return message->mtype != MTYPE_ACK && message->mtype != MTYPE_HELLO;
+}
+
+// Rebuild the index from the flash.
+void setup_inbox() {
+  critical_section_init(&lock);
+  head_seq = 0;
+  count = 0;
+  unread_count = 0;
+  pending_count = 0;
+  memset(unread_bits, 0, sizeof(unread_bits));
+  memset(pending_bits, 0, sizeof(pending_bits));
+
+  // Find the newest message.
+  inbox_record_t record;
+  bool found = false;
+  uint32_t newest = 0;
+  for (uint32_t slot = 0; slot < INBOX_SLOTS; slot++) {
+    if (read_record(slot, &record) && (!found || (int32_t)(record.seq - newest) > 0)) {
+      found = true;
+      newest = record.seq;
+      boot = record.boot + 1;
+    }
+  }
+
+  if (found) {
+    head_seq = newest + 1;
+    // Walk back through the messages that follow each other.
+    while (count < INBOX_SLOTS && read_record((newest - count) % INBOX_SLOTS, &record) &&
+           record.seq == newest - count) {
+      if (record.unread == INBOX_UNREAD) {
+        set_bit(unread_bits, record.seq % INBOX_SLOTS);
+        unread_count++;
+      }
+      count++;
+    }
+
+    // A write cut short can leave the next slot programmed, it can only be skipped until the
+    // next sector is erased.
+    while (head_seq % INBOX_SLOTS_PER_SECTOR != 0 && !is_erased(head_seq % INBOX_SLOTS, 1)) {
+      head_seq++;
+      if (count < INBOX_SLOTS) {
+        count++;
+      }
+    }
+  }
+
+  info("inbox: %d messages, %d unread, boot %d\n", count, unread_count, boot);
+}
+
+// Store a received message, returns false if it wasn't stored.
+// Only called from the radio core.
+bool inbox_add(message_history_t *message) {
+  if (!is_kept(&message->message)) {
+    return false;
+  }
+
+  uint32_t seq = head_seq;
+  uint32_t slot = seq % INBOX_SLOTS;
+
+  // Every sector is erased when the ring gets to it, dropping the oldest messages.
+  if (slot % INBOX_SLOTS_PER_SECTOR == 0) {
+    if (count > INBOX_SLOTS - INBOX_SLOTS_PER_SECTOR) {
+      count = INBOX_SLOTS - INBOX_SLOTS_PER_SECTOR;
+    }
+
+    critical_section_enter_blocking(&lock);
+    for (uint32_t i = slot / 32; i < (slot + INBOX_SLOTS_PER_SECTOR) / 32; i++) {
+      unread_count -= __builtin_popcount(unread_bits[i]);
+      pending_count -= __builtin_popcount(pending_bits[i]);
+      unread_bits[i] = 0;
+      pending_bits[i] = 0;
+    }
+    critical_section_exit(&lock);
+
+    if (!is_erased(slot, INBOX_SLOTS_PER_SECTOR)) {
+      if (!write_flash(erase_sector, slot * INBOX_RECORD_SIZE, NULL)) {
+        return false;
+      }
+      inbox_stats.erases++;
+    }
+  }
+
+  inbox_record_t record = {
+      .seq = seq,
+      .message = message->message,
+      .time_ms = to_ms_since_boot(message->time),
+      .boot = boot,
+      .unread = INBOX_UNREAD,
+  };
+  record.crc = record_crc(&record);
+
+  // The rest of the page is left erased.
+  uint8_t page[FLASH_PAGE_SIZE];
+  memset(page, 0xFF, sizeof(page));
+  memcpy(&page[(slot % INBOX_SLOTS_PER_PAGE) * INBOX_RECORD_SIZE], &record, sizeof(record));
+  uint32_t first = slot - slot % INBOX_SLOTS_PER_PAGE;
+  bool written = write_flash(program_page, first * INBOX_RECORD_SIZE, page);
+
+  // Move on even if the write failed, the slot can't be written over.
+  __dmb();
+  head_seq = seq + 1;
+  if (count < INBOX_SLOTS) {
+    count++;
+  }
+  if (!written) {
+    return false;
+  }
+  inbox_stats.programs++;
+
+  critical_section_enter_blocking(&lock);
+  set_bit(unread_bits, slot);
+  unread_count++;
+  critical_section_exit(&lock);
+
+  debug("message %d from %s added to inbox\n", record.message.id,
+        uid_to_string(record.message.src));
+  return true;
+}
+
+// Number of messages, some of them may be lost to failed writes.
+uint32_t inbox_count() { return count; }
+
+uint32_t inbox_unread() { return unread_count; }
+
+// Get a message, counting from the newest one.
+// Returns false if there is no such message.
+bool inbox_get(uint32_t index, inbox_entry_t *entry) {
+  if (index >= count) {
+    return false;
+  }
+
+  // The message may have been dropped for a new one meanwhile, the sequence number tells.
+  inbox_record_t record;
+  uint32_t seq = head_seq - 1 - index;
+  if (!read_record(seq % INBOX_SLOTS, &record) || record.seq != seq) {
+    return false;
+  }
+
+  entry->seq = seq;
+  entry->message = record.message;
+  entry->time = (absolute_time_t)record.time_ms * 1000;
+  entry->this_boot = record.boot == boot;
+  entry->unread = test_bit(unread_bits, seq % INBOX_SLOTS);
+  return true;
+}
+
+// Mark a message read, it is written to the flash by the next `inbox_sync`.
+void inbox_mark_read(inbox_entry_t *entry) {
+  if (head_seq - entry->seq > count) {
+    return;
+  }
+
+  uint32_t slot = entry->seq % INBOX_SLOTS;
+  critical_section_enter_blocking(&lock);
+  if (test_bit(unread_bits, slot)) {
+    clear_bit(unread_bits, slot);
+    unread_count--;
+    set_bit(pending_bits, slot);
+    pending_count++;
+    last_read = get_absolute_time();
+  }
+  critical_section_exit(&lock);
+  entry->unread = false;
+
+  post_event(EVENT_INBOX);
+}
+
+// Write the read flags to the flash, called from the radio loop.
+// Flags are collected until the inbox was left alone for a while, a page is programmed only once
+// for all the messages read in it.
+// Returns the time to call it again, once there are flags waiting to be written.
+absolute_time_t inbox_sync() {
+  if (pending_count == 0) {
+    return at_the_end_of_time;
+  }
+  critical_section_enter_blocking(&lock);
+  absolute_time_t due = delayed_by_ms(last_read, INBOX_SYNC_DELAY_MS);
+  critical_section_exit(&lock);
+  if (!time_reached(due)) {
+    return due;
+  }
+
+  uint8_t page[FLASH_PAGE_SIZE];
+  for (uint32_t i = 0; i < INBOX_SLOTS / 32; i++) {
+    critical_section_enter_blocking(&lock);
+    uint32_t bits = pending_bits[i];
+    pending_bits[i] = 0;
+    pending_count -= __builtin_popcount(bits);
+    critical_section_exit(&lock);
+
+    for (uint32_t first = 0; first < 32; first += INBOX_SLOTS_PER_PAGE) {
+      uint32_t page_bits = (bits >> first) & ((1u << INBOX_SLOTS_PER_PAGE) - 1);
+      if (page_bits == 0) {
+        continue;
+      }
+
+      memset(page, 0xFF, sizeof(page));
+      for (uint32_t s = 0; s < INBOX_SLOTS_PER_PAGE; s++) {
+        if (page_bits & (1u << s)) {
+          page[s * INBOX_RECORD_SIZE + offsetof(inbox_record_t, unread)] = 0;
+        }
+      }
+      if (write_flash(program_page, (i * 32 + first) * INBOX_RECORD_SIZE, page)) {
+        inbox_stats.programs++;
+      }
+    }
+  }
+  return at_the_end_of_time;
+}
+
+// Print the inbox, newest message first.
+void print_inbox() {
+  reply("inbox: %d messages, %d unread, boot %d\n", count, unread_count, boot);
+  reply("erases: %d, programs: %d, failures: %d\n", inbox_stats.erases, inbox_stats.programs,
+        inbox_stats.failures);
+
+  inbox_entry_t entry;
+  for (uint32_t i = 0; i < count; i++) {
+    if (!inbox_get(i, &entry)) {
+      continue;
+    }
+    message_t *msg = &entry.message;
+    reply("- [%d]: %s %s %d%s", i, uid_to_string(msg->src), MTYPE_STR[msg->mtype], msg->id,
+          entry.unread ? " new" : "");
+    if (entry.this_boot) {
+      reply(" (%ds)\r\n", to_ms_since_boot(entry.time) / 1000);
+    } else {
+      reply(" (earlier)\r\n");
+    }
+  }
+}
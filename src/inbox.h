@@ -0,0 +1,52 @@
+#ifndef _INBOX_H
+#define _INBOX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/flash.h"
+#include "pico/time.h"
+
+#include "network.h"
+
+// Erase sectors at the end of the flash kept for the inbox.
+#define INBOX_SECTORS 16
+// Size of a stored message, a flash page holds several of them.
+#define INBOX_RECORD_SIZE 32
+#define INBOX_SLOTS_PER_SECTOR (FLASH_SECTOR_SIZE / INBOX_RECORD_SIZE)
+#define INBOX_SLOTS_PER_PAGE (FLASH_PAGE_SIZE / INBOX_RECORD_SIZE)
+#define INBOX_SLOTS (INBOX_SECTORS * INBOX_SLOTS_PER_SECTOR)
+// Read flags are written to the flash once the inbox was left alone for this long.
+#define INBOX_SYNC_DELAY_MS 10000
+
+// A message in the inbox.
+typedef struct {
+  uint32_t seq;
+  message_t message;
+  // Time the message was received, only known for the messages received since the last boot.
+  absolute_time_t time;
+  bool this_boot;
+  bool unread;
+} inbox_entry_t;
+
+// Inbox statistics.
+typedef struct {
+  uint32_t erases;
+  uint32_t programs;
+  uint32_t failures;
+} inbox_stats_t;
+
+extern inbox_stats_t inbox_stats;
+
+void setup_inbox();
+
+bool inbox_add(message_history_t *message);
+uint32_t inbox_count();
+uint32_t inbox_unread();
+bool inbox_get(uint32_t index, inbox_entry_t *entry);
+void inbox_mark_read(inbox_entry_t *entry);
+absolute_time_t inbox_sync();
+
+void print_inbox();
+
+#endif // _INBOX_H
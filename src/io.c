@@ -1,57 +1,119 @@
+#define LOG_CATEGORY LOG_UI
+
 #include <stdio.h>
 #include <string.h>
 
+#include "hardware/sync.h"
 #include "pico/stdlib.h"
 
+#include "channel.h"
+#include "console.h"
+#include "inbox.h"
 #include "io.h"
+#include "log.h"
 #include "pico_config.h"
+#include "ring.h"
 #include "screen.h"
 #include "utils.h"
 #include "voidlink.h"
 
+// Pending UI events.
+// Events are produced by the button interrupts and the display timeout alarm, and consumed by the
+// UI loop. The alarm interrupt is taken by core0 whichever core runs the UI.
+MPSC_RING_STORAGE(ui_event_slots, ui_event_t, UI_EVENT_QUEUE_SIZE);
+static mpsc_ring_t ui_events;
+
+// Must be called before the interrupts are enabled.
+void setup_ui_events() { MPSC_RING_INIT(&ui_events, ui_event_slots); }
+
+// Add an event to the UI ring and wake up the UI core.
+// Called from the button interrupts and the display timeout alarm.
+bool post_ui_event(ui_event_t event) {
+  if (!mpsc_ring_push(&ui_events, &event)) {
+    return false;
+  }
+  __sev();
+
+  return true;
+}
+
+// Check if there is any event waiting to be handled, from the buttons, the console or the radio
+// core.
+bool ui_event_pending() {
+  return mpsc_ring_level(&ui_events) != 0 || ui_channel_pending() || console_pending() ||
+         log_pending();
+}
+
+// Button GPIO interrupt handler.
+// This only queues the press, all the work happens on the UI core.
 void handle_button_callback(uint gpio, uint32_t events) {
-  // if (screen != SCREEN_IDLE || (state != STATE_IDLE && state != STATE_RX))
-  //if (screen != SCREEN_IDLE)
-    //return;
+  if (gpio == PIN_BUTTON_NEXT) {
+    post_ui_event(UI_EVENT_NEXT);
+  } else if (gpio == PIN_BUTTON_PREV) {
+    post_ui_event(UI_EVENT_PREV);
+  } else if (gpio == PIN_BUTTON_OK) {
+    post_ui_event(UI_EVENT_OK);
+  } else if (gpio == PIN_BUTTON_BACK) {
+    post_ui_event(UI_EVENT_BACK);
+  } else if (gpio == PIN_BUTTON_HOME) {
+    post_ui_event(UI_EVENT_HOME);
+  } else if (gpio == PIN_BUTTON_SLEEP) {
+    post_ui_event(UI_EVENT_SLEEP);
+  }
+}
 
-  if (gpio == PIN_BUTTON_NEXT) { // add switch cases for each state
+// Update the UI state for a record from the radio core.
+static void handle_radio_event(const core_msg_t *msg) {
+  if (msg->type == CORE_EVENT_MESSAGE) {
+    notify_message(msg->time);
+  } else if (msg->type == CORE_EVENT_NEIGHBOURS) {
+    // Signal strength and last seen times change with every packet, only a new node is worth a
+    // refresh of its own.
+    if (copy_neighbour_table(&ui_neighbours)) {
+      screen = SCREEN_DRAW_READY;
+    }
+  } else if (msg->type == CORE_EVENT_REDRAW) {
+    screen = SCREEN_DRAW_READY;
+  }
+}
+
+// Update the UI state for a single event.
+// Rendering is left to the UI loop, so that several events can be coalesced into a single frame.
+static void handle_ui_event(ui_event_t event) {
+  if (event == UI_EVENT_NEXT) { // add switch cases for each state
     switch (display) {
     case DISPLAY_HOME:
-      printf("On Home Screen.\n"); // For testing purposes
+      debug("On Home Screen.\n"); // For testing purposes
       // Add selection drawings for home screen
       home_Cursor = (home_Cursor - 1 + 3) % 3;
-      home_Screen();
-      printf("new msgs: %d\n", new_Msg); // For testing purposes
+      debug("new msgs: %d\n", inbox_unread()); // For testing purposes
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_RXMSG:
-      printf("On Received Messages Screen.\n"); // For testing purposes
+      debug("On Received Messages Screen.\n"); // For testing purposes
       // Reset cursor if moving to new page
-      if (received_Cursor == 2 && (message_history_count - (received_Page - 1) * 3) > 3) {
+      if (received_Cursor == 2 && ((int)inbox_count() - (received_Page - 1) * 3) > 3) {
         received_Page++;
         received_Cursor = 0;
       } else {
-        if (neighbour_table.count == 0){
+        if (inbox_count() == 0){
           received_Cursor = 0;
         } else {
-          received_Cursor = (received_Cursor + 1) % (message_history_count - (received_Page - 1) * 3);
+          received_Cursor = (received_Cursor + 1) % ((int)inbox_count() - (received_Page - 1) * 3);
         }
       }
       // Display cursor
-      received_Msgs();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_RXMSG_DETAILS:
       msg_Action_Cursor = (msg_Action_Cursor + 1) % 2;
-      received_msg_Details();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SEND_TO:
-      send_to_Cursor = (send_to_Cursor + 1) % (neighbour_table.count+1);
-      send_To_Screen();
+      send_to_Cursor = (send_to_Cursor + 1) % (ui_neighbours.count+1);
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -65,107 +127,95 @@ void handle_button_callback(uint gpio, uint32_t events) {
         message_Cursor = (message_Cursor + 1) % (MAX_MSG_SEND - (msg_received_Page - 1) * 3);
       }
       // Display cursor
-      msg_Screen();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SETTINGS:
-      printf("On Settings Screen.\n"); // For testing purposes
+      debug("On Settings Screen.\n"); // For testing purposes
       // Add selection drawings for settings screen
       settings_Cursor = (settings_Cursor + 1) % 2;
-      settings_Screen();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SETTINGS_INFO:
-      printf("On Settings Info Screen.\n"); // For testing purposes
+      debug("On Settings Info Screen.\n"); // For testing purposes
       // Add selection drawings for settings screen
       set_Info_Cursor = (set_Info_Cursor + 1) % 6;
-      settings_Info();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_TABLE:
-      printf("On Neighbours Table.\n"); //For testing purposes
-      if (neighbour_Table_Cursor == 2 && (neighbour_table.count - (neighbour_Table_Cursor - 1) * 3) > 3) {
+      debug("On Neighbours Table.\n"); //For testing purposes
+      if (neighbour_Table_Cursor == 2 && (ui_neighbours.count - (neighbour_Table_Cursor - 1) * 3) > 3) {
         neighbour_received_Page++;
         neighbour_Table_Cursor = 0;
       } else {
-        if (neighbour_table.count == 0){
+        if (ui_neighbours.count == 0){
           neighbour_Table_Cursor = 0;
         } else {
-        neighbour_Table_Cursor = (neighbour_Table_Cursor + 1) % (neighbour_table.count - (neighbour_Table_Cursor - 1) * 3);
+        neighbour_Table_Cursor = (neighbour_Table_Cursor + 1) % (ui_neighbours.count - (neighbour_Table_Cursor - 1) * 3);
         }
       }
-      neighbours_Table();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_BROADCAST:
       broadcast_Action_Cursor = (broadcast_Action_Cursor + 1) % 3;
-      broadcast();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_ACTION:
       neighbour_Action_Cursor = (neighbour_Action_Cursor + 1) % 3;
-      neighbours_Action();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_REQUEST:
       neighbour_Request_Cursor = (neighbour_Request_Cursor + 1) % 2;
-      neighbours_Request();
       screen = SCREEN_DRAW_READY;
     break;
 
     case DISPLAY_NEIGHBOURS:
-      printf("On Neighbours Screen.\n"); // For testing purposes
+      debug("On Neighbours Screen.\n"); // For testing purposes
       // Add selection drawings for neighbours screen
       neighbour_Cursor = (neighbour_Cursor + 1) % 2;
-      neighbours_Screen();
       screen = SCREEN_DRAW_READY;
       break;
     }
 
-  } else if (gpio == PIN_BUTTON_PREV) { // add switch cases for each state
+  } else if (event == UI_EVENT_PREV) { // add switch cases for each state
     switch (display) {
     case DISPLAY_HOME:
-      printf("On Home Screen.\n"); // For testing purposes
+      debug("On Home Screen.\n"); // For testing purposes
       // Add selection drawings for home screen
       home_Cursor = (home_Cursor + 1) % 3;
-      home_Screen();
-      printf("new msgs: %d\n", new_Msg); // For testing purposes
+      debug("new msgs: %d\n", inbox_unread()); // For testing purposes
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_RXMSG:
-      printf("On Received Messages Screen.\n"); // For testing purposes
+      debug("On Received Messages Screen.\n"); // For testing purposes
       // Reset cursor if moving to new page
       if (received_Cursor == 0 && received_Page > 1) {
         received_Page--;
         received_Cursor = 2;
       } else {
-        if (neighbour_table.count == 0){
+        if (inbox_count() == 0){
           received_Cursor = 0;
         } else {
-          received_Cursor = (received_Cursor - 1 + (message_history_count - (received_Page - 1) * 3)) % (message_history_count - (received_Page - 1) * 3);
+          received_Cursor = (received_Cursor - 1 + ((int)inbox_count() - (received_Page - 1) * 3)) % ((int)inbox_count() - (received_Page - 1) * 3);
         }
       }
       // Display cursor
-      received_Msgs();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_RXMSG_DETAILS:
       msg_Action_Cursor = (msg_Action_Cursor - 1 + 2) % 2;
-      received_msg_Details();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SEND_TO:
-      send_to_Cursor = (send_to_Cursor - 1 + (neighbour_table.count+1)) % (neighbour_table.count+1);
-      send_To_Screen();
+      send_to_Cursor = (send_to_Cursor - 1 + (ui_neighbours.count+1)) % (ui_neighbours.count+1);
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -184,70 +234,62 @@ void handle_button_callback(uint gpio, uint32_t events) {
         }
     }
       // Display cursor
-      msg_Screen();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SETTINGS:
-      printf("On Settings Screen.\n"); // For testing purposes
+      debug("On Settings Screen.\n"); // For testing purposes
       // Add selection drawings for settings screen
       settings_Cursor = (settings_Cursor - 1 + 2) % 2;
-      settings_Screen();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SETTINGS_INFO:
-      printf("On Settings Info Screen.\n"); // For testing purposes
+      debug("On Settings Info Screen.\n"); // For testing purposes
       // Add selection drawings for settings screen
       set_Info_Cursor = (set_Info_Cursor - 1 + 6) % 6;
-      settings_Info();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_TABLE:
-      printf("On Neighbours Table.\n"); //For testing purposes
+      debug("On Neighbours Table.\n"); //For testing purposes
       if (neighbour_Table_Cursor == 0 && neighbour_received_Page >= 1) {
         neighbour_received_Page--;
         neighbour_Table_Cursor = 2;
       } else {
-        if (neighbour_table.count == 0){
+        if (ui_neighbours.count == 0){
           neighbour_Table_Cursor = 0;
         } else {
-        neighbour_Table_Cursor = (neighbour_Table_Cursor - 1 + (neighbour_table.count - (neighbour_received_Page - 1) * 3)) % (neighbour_table.count - (neighbour_received_Page - 1) * 3);
+        neighbour_Table_Cursor = (neighbour_Table_Cursor - 1 + (ui_neighbours.count - (neighbour_received_Page - 1) * 3)) % (ui_neighbours.count - (neighbour_received_Page - 1) * 3);
         }
       }
-      neighbours_Table();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_BROADCAST:
       broadcast_Action_Cursor = (broadcast_Action_Cursor - 1 + 3) % 3;
-      broadcast();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_ACTION:
       neighbour_Action_Cursor = (neighbour_Action_Cursor - 1 + 3) % 3;
-      neighbours_Action();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_REQUEST:
       neighbour_Request_Cursor = (neighbour_Request_Cursor - 1 + 2) % 2;
-      neighbours_Request();
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS:
-      printf("On Neighbours Screen.\n"); // For testing purposes
+      debug("On Neighbours Screen.\n"); // For testing purposes
       // Add selection drawings for neighbours screen
       neighbour_Cursor = (neighbour_Cursor - 1 + 2) % 2;
-      neighbours_Screen();
       screen = SCREEN_DRAW_READY;
       break;
     }
 
-  } else if (gpio == PIN_BUTTON_OK) {
+  } else if (event == UI_EVENT_OK) {
 
     switch (display) {
     case DISPLAY_HOME:
@@ -256,23 +298,17 @@ void handle_button_callback(uint gpio, uint32_t events) {
       if (home_Cursor == 0) { // Go to msg screen
         display = DISPLAY_RXMSG;
         received_Cursor = 0;
-        received_Msgs();
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
 
       if (home_Cursor == 1) { // Go to settings screen
         display = DISPLAY_SETTINGS;
-        settings_Screen();
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
 
       if (home_Cursor == 2) { // Go to neighbours screen
-        neighbours_Screen();
         display = DISPLAY_NEIGHBOURS;
         neighbour_Cursor = 0;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
 
@@ -280,11 +316,9 @@ void handle_button_callback(uint gpio, uint32_t events) {
 
     case DISPLAY_RXMSG:
       // Add selection drawings for received messages screen
-      if (neighbour_table.count > 0){
-        received_msg_Details();
+      if (ui_neighbours.count > 0){
         display = DISPLAY_RXMSG_DETAILS;
         msg_Action_Cursor = 0;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
       break;
@@ -293,15 +327,11 @@ void handle_button_callback(uint gpio, uint32_t events) {
       if (msg_Action_Cursor == 0) {
         // Text Reply to message
         display = DISPLAY_MSG;
-        msg_Screen();
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
 
       if (msg_Action_Cursor == 1) { // Go to Neighbours screen
-        neighbours_Table();
         display = DISPLAY_NEIGHBOURS_TABLE;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
       break;
@@ -311,27 +341,25 @@ void handle_button_callback(uint gpio, uint32_t events) {
       info_key_t key;
       text_id_t id;
       if (send_to_Cursor == 1) {
-        dst = neighbour_table.neighbours[send_to_Cursor - 1].uid;
+        dst = ui_neighbours.neighbours[send_to_Cursor - 1].uid;
       } else {
         dst = get_broadcast_uid();
       }
       if (msg_Type == 0){
         id = (text_id_t)(message_Cursor + ((msg_received_Page - 1) * 3));
-        try_transmit(new_text_message(dst, id));
+        request_transmit(new_text_message(dst, id));
       } else if (msg_Type == 1){
         if (neighbour_Request_Cursor == 0){ // Version
           key = 0;
         } else if (neighbour_Request_Cursor == 1){ // Uptime
           key = 2;
         }
-        try_transmit(new_request_message(dst, key));
+        request_transmit(new_request_message(dst, key));
       } else if (msg_Type == 2){
-        try_transmit(new_ping_message(dst));
+        request_transmit(new_ping_message(dst));
       }
       // Possibly add animation to show message is being sent
       send_Animation();
-      send_To_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -339,9 +367,7 @@ void handle_button_callback(uint gpio, uint32_t events) {
       // printf("Send Msg."); //For testing purposes
       // state = STATE_TX_READY;
       msg_Type = 0;
-      send_To_Screen();
       display = DISPLAY_SEND_TO;
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -350,16 +376,12 @@ void handle_button_callback(uint gpio, uint32_t events) {
       //  Add selection drawings for settings screen
       temp_Cursor = set_Info_Cursor;
       display = DISPLAY_SETTINGS_INFO;
-      settings_Info();
-      // refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SETTINGS_INFO:
       // Set display timeout
-      settings_Screen();
       display = DISPLAY_SETTINGS;
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       if (settings_Cursor == 0){
         if (set_Info_Cursor == 0) {
@@ -383,24 +405,22 @@ void handle_button_callback(uint gpio, uint32_t events) {
       }
       else if (settings_Cursor == 1){
         if (set_Info_Cursor == 0) {
-          set_range(DEFAULT);
+          request_range(DEFAULT);
         }
         if (set_Info_Cursor == 1) {
-          set_range(FAST);
+          request_range(FAST);
         }
         if (set_Info_Cursor > 1) {
-          set_range(LONGRANGE);
+          request_range(LONGRANGE);
         }
       }
       break;
 
     case DISPLAY_NEIGHBOURS_TABLE:
-      if (neighbour_table.count > 0){
-        printf("On Neighbours Table.\n"); //For testing purposes
-        neighbours_Action();
+      if (ui_neighbours.count > 0){
+        debug("On Neighbours Table.\n"); //For testing purposes
         display = DISPLAY_NEIGHBOURS_ACTION;
         neighbour_Action_Cursor = 0;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
       break;
@@ -408,26 +428,20 @@ void handle_button_callback(uint gpio, uint32_t events) {
     case DISPLAY_BROADCAST:
       if (broadcast_Action_Cursor == 0) {
         // Send a text msg
-        printf("text.\n");
-        msg_Screen();
+        debug("text.\n");
         display = DISPLAY_MSG;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       } else if (broadcast_Action_Cursor == 1) {
         // Send Ping message
-        printf("ping.\n");
+        debug("ping.\n");
         //try_transmit(new_ping_message(neighbour_table.neighbours[neighbour_Table_Cursor + ((neighbour_received_Page - 1) * 3)].uid));
         msg_Type = 2;
-        send_To_Screen();
         display = DISPLAY_SEND_TO;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       } else if (broadcast_Action_Cursor == 2) {
         // Send Request message
-        printf("request.\n");
-        neighbours_Request();
+        debug("request.\n");
         display = DISPLAY_NEIGHBOURS_REQUEST;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
       break;
@@ -435,64 +449,52 @@ void handle_button_callback(uint gpio, uint32_t events) {
     case DISPLAY_NEIGHBOURS_ACTION:
       if (neighbour_Action_Cursor == 0) {
         // Send a text msg
-        printf("text.\n");
-        msg_Screen();
+        debug("text.\n");
         display = DISPLAY_MSG;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       } else if (neighbour_Action_Cursor == 1) {
         // Send Ping message
-        printf("ping.\n");
+        debug("ping.\n");
         //try_transmit(new_ping_message(neighbour_table.neighbours[neighbour_Table_Cursor + ((neighbour_received_Page - 1) * 3)].uid));
         msg_Type = 2;
-        send_To_Screen();
         display = DISPLAY_SEND_TO;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       } else if (neighbour_Action_Cursor == 2) {
         // Send Request message
-        printf("request.\n");
-        neighbours_Request();
+        debug("request.\n");
         display = DISPLAY_NEIGHBOURS_REQUEST;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
       break;
 
     case DISPLAY_NEIGHBOURS_REQUEST:
       msg_Type = 1;
-      send_To_Screen();
       display = DISPLAY_SEND_TO;
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS:
-      printf("On Neighbours Screen."); //For testing purposes
+      debug("On Neighbours Screen."); //For testing purposes
       //  Add selection drawings for neighbours screen
       if (neighbour_Cursor == 0) {
         // Go to neighbours table screen
-        neighbours_Table();
         display = DISPLAY_NEIGHBOURS_TABLE;
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
      // Go to msg screen
       if (neighbour_Cursor == 1) {
         // Broadcast
         display = DISPLAY_BROADCAST;
-        broadcast();
-        refresh_Counter = 15;
         screen = SCREEN_DRAW_READY;
       }
       break;
     }
 
-  } else if (gpio == PIN_BUTTON_BACK) {
+  } else if (event == UI_EVENT_BACK) {
 
     switch (display) {
     case DISPLAY_HOME:
-      printf("Already at home\n"); // For testing purposes
+      debug("Already at home\n"); // For testing purposes
       // Add selection drawings for home screen
       //sprintf(test, "TEST %d", message_history_count);
       //strcpy(saved_Messages[message_history_count], test);
@@ -505,34 +507,26 @@ void handle_button_callback(uint gpio, uint32_t events) {
 
     case DISPLAY_RXMSG:
       // Add selection drawings for received messages screen
-      printf("Going home.\n"); // For testing purposes
+      debug("Going home.\n"); // For testing purposes
       display = DISPLAY_HOME;
       received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_RXMSG_DETAILS:
       // Add selection drawings for received messages screen
       display = DISPLAY_RXMSG;
-      received_Msgs();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SEND_TO:
       if (msg_Type == 0){
         display = DISPLAY_MSG;
-        msg_Screen();
       } else if (msg_Type == 1){
         display = DISPLAY_NEIGHBOURS_REQUEST;
-        neighbours_Request();
       } else if (msg_Type == 2){
         display = DISPLAY_NEIGHBOURS_ACTION;
-        neighbours_Action();
       }
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -540,8 +534,6 @@ void handle_button_callback(uint gpio, uint32_t events) {
       // printf("Send Msg."); //For testing purposes
       display = DISPLAY_NEIGHBOURS_ACTION;
       msg_received_Page = 1;
-      neighbours_Action();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -549,70 +541,54 @@ void handle_button_callback(uint gpio, uint32_t events) {
       // printf("On Settings Screen."); //For testing purposes
       //  Add selection drawings for settings screen
       display = DISPLAY_HOME;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SETTINGS_INFO:
       set_Info_Cursor = temp_Cursor;
-      settings_Screen();
       display = DISPLAY_SETTINGS;
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_TABLE:
       display = DISPLAY_NEIGHBOURS;
       neighbour_received_Page = 1;
-      neighbours_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_BROADCAST:
       display = DISPLAY_NEIGHBOURS;
       neighbour_received_Page = 1;
-      neighbours_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_ACTION:
       display = DISPLAY_NEIGHBOURS_TABLE;
-      neighbours_Table();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_REQUEST:
       display = DISPLAY_NEIGHBOURS_ACTION;
-      neighbours_Action();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS:
       display = DISPLAY_HOME;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
     }
-  } else if (gpio == PIN_BUTTON_HOME) {
+  } else if (event == UI_EVENT_HOME) {
 
     switch (display) {
     case DISPLAY_HOME:
-      printf("Already at home\n"); // For testing purposes
+      debug("Already at home\n"); // For testing purposes
       break;
 
     case DISPLAY_RXMSG:
       // Add selection drawings for received messages screen
-      printf("Going home.\n"); // For testing purposes
+      debug("Going home.\n"); // For testing purposes
       display = DISPLAY_HOME;
       received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -620,8 +596,6 @@ void handle_button_callback(uint gpio, uint32_t events) {
       // Add selection drawings for received messages screen
       display = DISPLAY_HOME;
       received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -630,8 +604,6 @@ void handle_button_callback(uint gpio, uint32_t events) {
       msg_received_Page = 1;
       received_Page = 1;
       neighbour_received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
  
       break;
@@ -640,8 +612,6 @@ void handle_button_callback(uint gpio, uint32_t events) {
       // printf("Send Msg."); //For testing purposes
       display = DISPLAY_HOME;
       msg_received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
@@ -649,64 +619,74 @@ void handle_button_callback(uint gpio, uint32_t events) {
       // printf("On Settings Screen."); //For testing purposes
       //  Add selection drawings for settings screen
       display = DISPLAY_HOME;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_SETTINGS_INFO:
       set_Info_Cursor = temp_Cursor;
-      home_Screen();
       display = DISPLAY_HOME;
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_TABLE:
       display = DISPLAY_HOME;
       neighbour_received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_BROADCAST:
       display = DISPLAY_HOME;
       neighbour_received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_ACTION:
       display = DISPLAY_HOME;
       neighbour_received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS_REQUEST:
       display = DISPLAY_HOME;
       neighbour_received_Page = 1;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
 
     case DISPLAY_NEIGHBOURS:
       display = DISPLAY_HOME;
-      home_Screen();
-      refresh_Counter = 15;
       screen = SCREEN_DRAW_READY;
       break;
     }
-  } else if (gpio == PIN_BUTTON_SLEEP) {
+  } else if (event == UI_EVENT_SLEEP) {
     if (five_Seconds == true){ // Currently Sleeping, wake up
       screen = SCREEN_DRAW_READY;
     }
     if (five_Seconds == false){ // Currently awake, Go To Sleep
       go_to_Sleep();
     }
+  } else if (event == UI_EVENT_TIMEOUT) {
+    if (five_Seconds == false) {
+      debug("%d Seconds of inactivity, sleeping display.\n", display_Timeout / 1000);
+      go_to_Sleep();
+    }
+  }
+}
+
+// Handle all pending UI events.
+// Must only be called from the UI core.
+void handle_ui_events() {
+  ui_event_t event;
+  while (mpsc_ring_pop(&ui_events, &event)) {
+    handle_ui_event(event);
   }
+
+  core_msg_t msg;
+  while (receive_on_ui(&msg)) {
+    handle_radio_event(&msg);
+  }
+
+  handle_console();
+
+  // Whatever the cores logged meanwhile.
+  log_drain();
 }
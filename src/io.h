@@ -1,10 +1,31 @@
 #ifndef _IO_H
 #define _IO_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "pico/stdlib.h"
 
+// Maximum number of UI events waiting to be handled.
+#define UI_EVENT_QUEUE_SIZE 16
+
+// Events handled by the UI loop.
+typedef enum {
+  UI_EVENT_NEXT,
+  UI_EVENT_PREV,
+  UI_EVENT_OK,
+  UI_EVENT_BACK,
+  UI_EVENT_HOME,
+  UI_EVENT_SLEEP,
+  // Display inactivity timeout.
+  UI_EVENT_TIMEOUT,
+} ui_event_t;
+
+void setup_ui_events();
+bool post_ui_event(ui_event_t event);
+bool ui_event_pending();
+void handle_ui_events();
+
 void handle_button_callback(uint gpio, uint32_t events);
 
 #endif // _IO_H
@@ -0,0 +1,287 @@
+/**
+ * Deferred debug output
+ *
+ * printf blocks until the serial output took the line, which is too long for the DIO1 interrupt
+ * and the radio loop. Instead, `debug` writes a fixed size record into a ring: where its format
+ * string is and its arguments as raw values. The format strings stay in a section of their own in
+ * the flash (`log_formats`), a record only keeps the offset of its own, so nothing is formatted
+ * and nothing is copied but the arguments. Strings are copied, the buffers they come from are
+ * often reused right after.
+ *
+ * Every record wakes the UI core up, like a record of the core channel, and the UI core drains the
+ * ring whenever it wakes. It either formats the records and prints them as they would have been
+ * printed, or prints them as lines of hex for host/log_decode.c, which takes the format strings
+ * from the firmware's ELF file. A full ring drops the record and counts it. `set log direct` goes
+ * back to printing in place.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "log.h"
+#include "platform.h"
+#include "ring.h"
+
+log_stats_t log_stats = {0};
+
+#ifdef VOIDLINK_HOST
+// Host programs print in order with the rest of their output, and most never drain the ring.
+volatile log_mode_t log_mode = LOG_DIRECT;
+#else
+volatile log_mode_t log_mode = LOG_TEXT;
+#endif
+
+// The section is there even in a program that logs nothing, for its start and stop symbols.
+static const char log_format_none[] __attribute__((section("log_formats"), used)) = "";
+
+// Everything built in is logged until the console says otherwise.
+uint8_t log_levels[LOG_CATEGORIES] = {LOG_LEVEL_DEBUG};
+
+MPSC_RING_STORAGE(log_slots, log_record_t, LOG_SIZE);
+static mpsc_ring_t log_ring;
+static bool log_ready = false;
+
+// Must be called before anything is logged, lines logged before are dropped.
+void setup_log() {
+  MPSC_RING_INIT(&log_ring, log_slots);
+  log_ready = true;
+}
+
+// Claim a record for a line, NULL if the ring is full.
+log_record_t *log_begin(const char *format) {
+  if (!log_ready) {
+    return NULL;
+  }
+
+  log_record_t *record = mpsc_ring_reserve(&log_ring);
+  if (record == NULL) {
+    log_stats.dropped++;
+    return NULL;
+  }
+  record->time_us = platform_now();
+  record->format = format - __start_log_formats;
+  record->length = 0;
+  return record;
+}
+
+// Publish a record and wake up the UI core to print it, like a record of the core channel.
+void log_commit(log_record_t *record) {
+  mpsc_ring_commit(&log_ring, record);
+  log_stats.written++;
+  platform_notify();
+}
+
+// Whether `size` more bytes fit, ends the arguments of the record otherwise.
+static bool log_room(log_record_t *record, uint8_t size) {
+  if (record->length + size <= LOG_PAYLOAD_SIZE) {
+    return true;
+  }
+  if (record->length < LOG_PAYLOAD_SIZE) {
+    // Not a type, nothing after it is read back.
+    record->payload[record->length] = 0xFF;
+    record->length = LOG_PAYLOAD_SIZE;
+    log_stats.truncated++;
+  }
+  return false;
+}
+
+// Append a value with its type.
+static void log_put(log_record_t *record, log_arg_t type, const void *value, uint8_t size) {
+  if (!log_room(record, 1 + size)) {
+    return;
+  }
+  record->payload[record->length++] = type;
+  memcpy(&record->payload[record->length], value, size);
+  record->length += size;
+}
+
+void log_put_signed(log_record_t *record, long long value) {
+  if (value >= INT32_MIN && value <= INT32_MAX) {
+    int32_t narrow = value;
+    log_put(record, LOG_ARG_I32, &narrow, sizeof(narrow));
+  } else {
+    int64_t wide = value;
+    log_put(record, LOG_ARG_I64, &wide, sizeof(wide));
+  }
+}
+
+void log_put_unsigned(log_record_t *record, unsigned long long value) {
+  if (value <= UINT32_MAX) {
+    uint32_t narrow = value;
+    log_put(record, LOG_ARG_U32, &narrow, sizeof(narrow));
+  } else {
+    uint64_t wide = value;
+    log_put(record, LOG_ARG_U64, &wide, sizeof(wide));
+  }
+}
+
+void log_put_double(log_record_t *record, double value) {
+  log_put(record, LOG_ARG_DOUBLE, &value, sizeof(value));
+}
+
+void log_put_pointer(log_record_t *record, const void *value) {
+  uint64_t address = (uintptr_t)value;
+  log_put(record, LOG_ARG_POINTER, &address, sizeof(address));
+}
+
+// A length byte and the data, cut short to what is left of the record.
+static void log_put_data(log_record_t *record, log_arg_t type, const void *data, size_t length) {
+  if (!log_room(record, 2)) {
+    return;
+  }
+  size_t room = LOG_PAYLOAD_SIZE - record->length - 2;
+  if (length > room) {
+    length = room;
+    log_stats.truncated++;
+  }
+  record->payload[record->length++] = type;
+  record->payload[record->length++] = length;
+  memcpy(&record->payload[record->length], data, length);
+  record->length += length;
+}
+
+void log_put_string(log_record_t *record, const char *value) {
+  if (value == NULL) {
+    value = "(null)";
+  }
+  log_put_data(record, LOG_ARG_STRING, value, strlen(value));
+}
+
+void log_put_bytes(log_record_t *record, const uint8_t *data, uint8_t length) {
+  log_put_data(record, LOG_ARG_BYTES, data, length);
+}
+
+bool log_pending() { return log_ready && mpsc_ring_level(&log_ring) > 0; }
+
+bool log_take(log_record_t *record) { return log_ready && mpsc_ring_pop(&log_ring, record); }
+
+// Print what was logged since the last time, from the UI core.
+void log_drain() {
+  log_record_t record;
+  while (log_take(&record)) {
+    if (log_mode == LOG_BINARY) {
+      char line[2 * sizeof(log_record_t) + 1];
+      int size = offsetof(log_record_t, payload) + record.length;
+      for (int i = 0; i < size; i++) {
+        sprintf(&line[2 * i], "%02x", ((uint8_t *)&record)[i]);
+      }
+      printf("log %s\n", line);
+    } else {
+      char line[256];
+      log_format(line, sizeof(line), &__start_log_formats[record.format], record.payload,
+                 record.length);
+      fputs(line, stdout);
+    }
+  }
+}
+
+// The next argument of a payload, returns its type or -1 at the end.
+static int log_next(const uint8_t *payload, uint8_t length, uint8_t *offset, uint64_t *value,
+                    const uint8_t **data) {
+  if (*offset >= length) {
+    return -1;
+  }
+  int type = payload[(*offset)++];
+  uint8_t size = type == LOG_ARG_I32 || type == LOG_ARG_U32 ? 4
+                 : type <= LOG_ARG_POINTER                  ? 8
+                 : type <= LOG_ARG_BYTES && *offset < length ? 1 + payload[*offset]
+                                                             : 0;
+  if (size == 0 || *offset + size > length) {
+    return -1;
+  }
+
+  *value = 0;
+  if (type == LOG_ARG_STRING || type == LOG_ARG_BYTES) {
+    *value = payload[*offset];
+    *data = &payload[*offset + 1];
+  } else if (type == LOG_ARG_I32) {
+    int32_t narrow;
+    memcpy(&narrow, &payload[*offset], 4);
+    *value = (int64_t)narrow;
+  } else {
+    memcpy(value, &payload[*offset], size);
+  }
+  *offset += size;
+  return type;
+}
+
+// Format a record the way printf would have, one conversion at a time.
+// Length modifiers of the format don't matter, every integer is passed on as a long long.
+int log_format(char *out, size_t size, const char *format, const uint8_t *payload,
+               uint8_t length) {
+  size_t used = 0;
+  uint8_t offset = 0;
+  out[0] = '\0';
+
+  for (const char *c = format; *c != '\0' && used + 1 < size;) {
+    if (*c != '%' || c[1] == '%') {
+      out[used++] = *c;
+      c += *c == '%' ? 2 : 1;
+      out[used] = '\0';
+      continue;
+    }
+
+    // Flags, width and precision are kept, the length modifiers dropped.
+    char spec[16] = "%";
+    size_t spec_length = 1;
+    const char *start = c++;
+    while (*c != '\0' && strchr("-+ #0123456789.", *c) != NULL && spec_length < 12) {
+      spec[spec_length++] = *c++;
+    }
+    while (*c != '\0' && strchr("hlLqjzt", *c) != NULL) {
+      c++;
+    }
+    char conversion = *c;
+    if (conversion == '\0') {
+      break;
+    }
+    c++;
+
+    uint64_t value;
+    const uint8_t *data = NULL;
+    int type = log_next(payload, length, &offset, &value, &data);
+    size_t room = size - used;
+    int written;
+    if (type < 0) {
+      // Nothing left to print for it, show the conversion as it is.
+      written = snprintf(&out[used], room, "%.*s", (int)(c - start), start);
+    } else if (conversion == 'H' && type == LOG_ARG_BYTES) {
+      written = 0;
+      for (int i = 0; i < value && written + 3 < room; i++) {
+        written += snprintf(&out[used + written], room - written, " %02x", data[i]);
+      }
+    } else if (conversion == 's' && type == LOG_ARG_STRING) {
+      strcpy(&spec[spec_length], ".*s");
+      written = snprintf(&out[used], room, spec, (int)value, (const char *)data);
+    } else if (strchr("fFeEgGaA", conversion) != NULL && type == LOG_ARG_DOUBLE) {
+      double real;
+      memcpy(&real, &value, sizeof(real));
+      spec[spec_length++] = conversion;
+      spec[spec_length] = '\0';
+      written = snprintf(&out[used], room, spec, real);
+    } else if (conversion == 'p') {
+      written = snprintf(&out[used], room, "0x%llx", (unsigned long long)value);
+    } else if (strchr("diouxXc", conversion) != NULL && type <= LOG_ARG_U64) {
+      spec[spec_length++] = conversion == 'c' ? 'c' : 'l';
+      if (conversion != 'c') {
+        spec[spec_length++] = 'l';
+        spec[spec_length++] = conversion;
+      }
+      spec[spec_length] = '\0';
+      if (conversion == 'c') {
+        written = snprintf(&out[used], room, spec, (int)value);
+      } else if (conversion == 'd' || conversion == 'i') {
+        written = snprintf(&out[used], room, spec, (long long)value);
+      } else {
+        // Signed values printed unsigned wrap at the width they were logged with.
+        uint64_t wrapped = type == LOG_ARG_I32 ? (uint32_t)value : value;
+        written = snprintf(&out[used], room, spec, (unsigned long long)wrapped);
+      }
+    } else {
+      written = snprintf(&out[used], room, "<%c?>", conversion);
+    }
+
+    used += written < 0 ? 0 : written < room ? written : room - 1;
+  }
+  return used;
+}
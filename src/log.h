@@ -0,0 +1,169 @@
+#ifndef _LOG_H
+#define _LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Records waiting for the UI core to print them, must be a power of two.
+#define LOG_SIZE 128
+// Room for the arguments of a record, longer strings are cut short.
+#define LOG_PAYLOAD_SIZE 40
+
+// Where the debug output goes.
+typedef enum {
+  // Printed where it is logged, as printf always did. Blocks on the serial output.
+  LOG_DIRECT,
+  // Recorded in a ring, the UI core formats and prints it.
+  LOG_TEXT,
+  // Recorded in a ring, the UI core prints the records as hex for host/log_decode.c.
+  LOG_BINARY,
+  LOG_MODES,
+} log_mode_t;
+
+// Levels of a log line, numbers so the build floor can be checked by the preprocessor.
+#define LOG_LEVEL_DEBUG 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_ERROR 2
+// Only as the level of a category, nothing is logged at it.
+#define LOG_LEVEL_OFF 3
+#define LOG_LEVELS 4
+
+// Lines below the floor are not built in at all, whatever their category is set to.
+#ifndef LOG_FLOOR
+#define LOG_FLOOR LOG_LEVEL_DEBUG
+#endif
+
+// Part of the firmware a line comes from, every category has a level of its own.
+typedef enum {
+  LOG_RADIO,
+  LOG_NET,
+  LOG_ACK,
+  LOG_UI,
+  LOG_CONSOLE,
+  LOG_CATEGORIES,
+} log_category_t;
+
+// Type of an argument in a record, followed by its value.
+typedef enum {
+  LOG_ARG_I32,
+  LOG_ARG_U32,
+  LOG_ARG_I64,
+  LOG_ARG_U64,
+  LOG_ARG_DOUBLE,
+  LOG_ARG_POINTER,
+  // A length byte and the characters, without the terminator.
+  LOG_ARG_STRING,
+  // A length byte and the bytes, printed as hex by `%H`.
+  LOG_ARG_BYTES,
+} log_arg_t;
+
+// A logged line: the offset of its format string in the `log_formats` section and its arguments.
+typedef struct {
+  uint32_t time_us;
+  uint16_t format;
+  uint8_t length;
+  uint8_t payload[LOG_PAYLOAD_SIZE];
+} log_record_t;
+
+typedef struct {
+  uint32_t written;
+  // Records lost to a full ring.
+  uint32_t dropped;
+  // Arguments cut short or left out, the record didn't have room for them.
+  uint32_t truncated;
+} log_stats_t;
+
+extern log_stats_t log_stats;
+extern volatile log_mode_t log_mode;
+// Lowest level logged per category, set from the console.
+extern uint8_t log_levels[LOG_CATEGORIES];
+
+// Whether a line is logged, a load and a compare.
+#define log_enabled(CATEGORY, LEVEL) ((LEVEL) >= log_levels[CATEGORY])
+
+// Format strings of the records, put in a section of their own by the linker.
+extern const char __start_log_formats[];
+extern const char __stop_log_formats[];
+
+void setup_log();
+
+log_record_t *log_begin(const char *format);
+void log_commit(log_record_t *record);
+
+void log_put_signed(log_record_t *record, long long value);
+void log_put_unsigned(log_record_t *record, unsigned long long value);
+void log_put_double(log_record_t *record, double value);
+void log_put_pointer(log_record_t *record, const void *value);
+void log_put_string(log_record_t *record, const char *value);
+void log_put_bytes(log_record_t *record, const uint8_t *data, uint8_t length);
+
+bool log_pending();
+bool log_take(log_record_t *record);
+void log_drain();
+int log_format(char *out, size_t size, const char *format, const uint8_t *payload, uint8_t length);
+
+// An argument of a record, stored by its type. Adding 0 promotes the small integers and the
+// bit-fields, which have no type of their own to select on.
+#define LOG_PUT(RECORD, ARG)                                                                       \
+  _Generic((ARG) + 0,                                                                              \
+      int: log_put_signed,                                                                         \
+      long: log_put_signed,                                                                        \
+      long long: log_put_signed,                                                                   \
+      unsigned int: log_put_unsigned,                                                              \
+      unsigned long: log_put_unsigned,                                                             \
+      unsigned long long: log_put_unsigned,                                                        \
+      float: log_put_double,                                                                       \
+      double: log_put_double,                                                                      \
+      char *: log_put_string,                                                                      \
+      const char *: log_put_string,                                                                \
+      default: log_put_pointer)(RECORD, ARG)
+
+// The format string of a record stays in the flash, the record only keeps its offset.
+#define LOG_BEGIN(FORMAT)                                                                          \
+  do {                                                                                             \
+    static const char log_format_[] __attribute__((section("log_formats"), used)) = FORMAT;       \
+    log_record_t *log_record_ = log_begin(log_format_);                                            \
+    if (log_record_ != NULL) {
+
+#define LOG_END                                                                                    \
+  log_commit(log_record_);                                                                         \
+  }                                                                                                \
+  }                                                                                                \
+  while (0)
+
+#define LOG_ARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, N, ...) N
+#define LOG_ARGS(...) LOG_ARGS_(__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_CAT_(A, B) A##B
+#define LOG_CAT(A, B) LOG_CAT_(A, B)
+
+// Every argument of a record, in order.
+#define LOG_PUTS_1(A) LOG_PUT(log_record_, A);
+#define LOG_PUTS_2(A, ...) LOG_PUT(log_record_, A); LOG_PUTS_1(__VA_ARGS__)
+#define LOG_PUTS_3(A, ...) LOG_PUT(log_record_, A); LOG_PUTS_2(__VA_ARGS__)
+#define LOG_PUTS_4(A, ...) LOG_PUT(log_record_, A); LOG_PUTS_3(__VA_ARGS__)
+#define LOG_PUTS_5(A, ...) LOG_PUT(log_record_, A); LOG_PUTS_4(__VA_ARGS__)
+#define LOG_PUTS_6(A, ...) LOG_PUT(log_record_, A); LOG_PUTS_5(__VA_ARGS__)
+#define LOG_PUTS_7(A, ...) LOG_PUT(log_record_, A); LOG_PUTS_6(__VA_ARGS__)
+#define LOG_PUTS_8(A, ...) LOG_PUT(log_record_, A); LOG_PUTS_7(__VA_ARGS__)
+
+// Counted with the format string, a record without arguments still has one.
+#define LOG_RECORD_1(F) LOG_BEGIN(F) LOG_END
+#define LOG_RECORD_2(F, ...) LOG_BEGIN(F) LOG_PUTS_1(__VA_ARGS__) LOG_END
+#define LOG_RECORD_3(F, ...) LOG_BEGIN(F) LOG_PUTS_2(__VA_ARGS__) LOG_END
+#define LOG_RECORD_4(F, ...) LOG_BEGIN(F) LOG_PUTS_3(__VA_ARGS__) LOG_END
+#define LOG_RECORD_5(F, ...) LOG_BEGIN(F) LOG_PUTS_4(__VA_ARGS__) LOG_END
+#define LOG_RECORD_6(F, ...) LOG_BEGIN(F) LOG_PUTS_5(__VA_ARGS__) LOG_END
+#define LOG_RECORD_7(F, ...) LOG_BEGIN(F) LOG_PUTS_6(__VA_ARGS__) LOG_END
+#define LOG_RECORD_8(F, ...) LOG_BEGIN(F) LOG_PUTS_7(__VA_ARGS__) LOG_END
+#define LOG_RECORD_9(F, ...) LOG_BEGIN(F) LOG_PUTS_8(__VA_ARGS__) LOG_END
+
+// Record a line of debug output, up to eight arguments.
+#define LOG_RECORD(...) LOG_CAT(LOG_RECORD_, LOG_ARGS(__VA_ARGS__))(__VA_ARGS__)
+
+// Record bytes printed as hex after a label, like the frame dumps of the radio.
+#define LOG_RECORD_BYTES(LABEL, DATA, LENGTH)                                                      \
+  LOG_BEGIN(LABEL "%H\n") log_put_bytes(log_record_, (const uint8_t *)(DATA), LENGTH);             \
+  LOG_END
+
+#endif // _LOG_H
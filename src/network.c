@@ -4,22 +4,36 @@
  * This protocol uses big-endian encoding for multi-byte fields.
  */
 
+#define LOG_CATEGORY LOG_NET
+
+#include <inttypes.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <string.h>
 
-#include "pico/rand.h"
-#include "pico/time.h"
-#include "pico/types.h"
-#include "pico/unique_id.h"
-#include "pico/util/queue.h"
-
+#include "channel.h"
+#include "events.h"
+#include "histogram.h"
+#include "inbox.h"
 #include "network.h"
-#include "screen.h"
+#include "platform.h"
+#include "stats.h"
 #include "utils.h"
 #include "voidlink.h"
 
-queue_t tx_queue;
-queue_t rx_queue;
+MPSC_RING_STORAGE(tx_slots, packet_t, MESSAGE_QUEUE_SIZE);
+SPSC_RING_STORAGE(rx_slots, packet_t, MESSAGE_QUEUE_SIZE);
+mpsc_ring_t tx_queue;
+spsc_ring_t rx_queue = SPSC_RING(rx_slots);
+
+// Packet buffers.
+// Packets are allocated from the rx interrupt and both cores, so the free buffers are tracked in a
+// bitmap that is only changed with atomics.
+static message_history_t packets[PACKET_POOL_SIZE];
+static atomic_uint_least8_t packet_refs[PACKET_POOL_SIZE];
+static atomic_uint_least32_t packet_free[PACKET_POOL_SIZE / 32];
+
+packet_stats_t packet_stats = {0};
 
 // Unique identifier for this device.
 // MUST be set in setup_network() before use.
@@ -27,35 +41,101 @@ static uid_t MY_UID = {.bytes = {0x00, 0x00, 0x00}};
 // Broadcast identifier.
 static const uid_t BROADCAST_UID = {.bytes = {0xFF, 0xFF, 0xFF}};
 // Set neighbour table to empty.
-neighbour_table_t neighbour_table = {.neighbours = {0}, .count = 0};
+neighbour_table_t neighbour_table = {0};
+// Sequence number of the neighbour table, odd while it is being written.
+static atomic_uint_least32_t neighbour_table_seq = 0;
+// Changes to the neighbour table the UI core hasn't copied yet.
+#define NEIGHBOURS_CHANGED 1
+#define NEIGHBOURS_ADDED 2
+static atomic_uint_least8_t neighbour_changes = 0;
 
 static mid_t MID = 0;
 
 // Setup the network.
 void setup_network() {
   // It seems trying to read the unique id too early causes a crash.
-  sleep_ms(100);
+  platform_sleep_ms(100);
 
   // Use last 3 bytes of the unique id as the device id.
-  pico_unique_board_id_t board_id;
-  pico_get_unique_board_id(&board_id);
-  MY_UID.bytes[0] = board_id.id[5];
-  MY_UID.bytes[1] = board_id.id[6];
-  MY_UID.bytes[2] = board_id.id[7];
+  uint8_t board_id[PLATFORM_BOARD_ID_SIZE];
+  platform_board_id(board_id);
+  MY_UID.bytes[0] = board_id[5];
+  MY_UID.bytes[1] = board_id[6];
+  MY_UID.bytes[2] = board_id[7];
 
   // Set starting message id to a random value.
   // This is done to reduce the risk of getting our message ignored due to resetting the mid counter
   // back to 0 on restart. There is still a chance to randomly pick the same number where we left
   // off but this good tradeoff to keep the message small.
-  MID = get_rand_32() & 0xFF;
+  MID = platform_rand() & 0xFF;
 
-  // Setup the queues.
-  queue_init(&tx_queue, sizeof(message_history_t), MESSAGE_QUEUE_SIZE);
-  queue_init(&rx_queue, sizeof(message_history_t), MESSAGE_QUEUE_SIZE);
+  // Setup the queues and the packet buffers.
+  MPSC_RING_INIT(&tx_queue, tx_slots);
+  for (int i = 0; i < PACKET_POOL_SIZE / 32; i++) {
+    atomic_init(&packet_free[i], 0xFFFFFFFF);
+  }
+  memset(message_history, PACKET_NONE, sizeof(message_history));
+  for (int i = 0; i < MAX_MID; i++) {
+    ack_list[i].packet = PACKET_NONE;
+  }
 
   debug("network setup done\n");
 }
 
+// Take a free packet buffer, with a single reference.
+// Returns PACKET_NONE if every buffer is in use.
+packet_t packet_alloc() {
+  for (int i = 0; i < PACKET_POOL_SIZE / 32; i++) {
+    uint32_t free = atomic_load_explicit(&packet_free[i], memory_order_relaxed);
+    while (free != 0) {
+      uint32_t bit = __builtin_ctz(free);
+      if (atomic_compare_exchange_weak_explicit(&packet_free[i], &free, free & ~(1u << bit),
+                                                memory_order_acquire, memory_order_relaxed)) {
+        packet_t packet = i * 32 + bit;
+        atomic_store_explicit(&packet_refs[packet], 1, memory_order_relaxed);
+
+        atomic_fetch_add_explicit(&packet_stats.allocs, 1, memory_order_relaxed);
+        uint32_t in_use =
+            atomic_fetch_add_explicit(&packet_stats.in_use, 1, memory_order_relaxed) + 1;
+        uint32_t peak = atomic_load_explicit(&packet_stats.peak, memory_order_relaxed);
+        while (in_use > peak &&
+               !atomic_compare_exchange_weak_explicit(&packet_stats.peak, &peak, in_use,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+        }
+        return packet;
+      }
+    }
+  }
+
+  atomic_fetch_add_explicit(&packet_stats.failures, 1, memory_order_relaxed);
+  return PACKET_NONE;
+}
+
+// Returns the buffer of a packet.
+message_history_t *packet_get(packet_t packet) { return &packets[packet]; }
+
+// Add a reference to a packet, for a new holder.
+void packet_ref(packet_t packet) {
+  atomic_fetch_add_explicit(&packet_refs[packet], 1, memory_order_relaxed);
+}
+
+// Drop a reference to a packet, the buffer is freed with the last one.
+void packet_unref(packet_t packet) {
+  if (packet == PACKET_NONE) {
+    return;
+  }
+  if (atomic_fetch_sub_explicit(&packet_refs[packet], 1, memory_order_acq_rel) == 1) {
+    atomic_fetch_sub_explicit(&packet_stats.in_use, 1, memory_order_relaxed);
+    atomic_fetch_or_explicit(&packet_free[packet / 32], 1u << (packet % 32), memory_order_release);
+  }
+}
+
+// Print the packet buffer usage.
+void print_packets() {
+  reply("packets: %d/%d in use, peak: %d, allocs: %d, failures: %d\n", packet_stats.in_use,
+        PACKET_POOL_SIZE, packet_stats.peak, packet_stats.allocs, packet_stats.failures);
+}
+
 // Returns the unique id of the device.
 uid_t get_uid() { return MY_UID; }
 
@@ -88,6 +168,37 @@ bool compare_messages(message_t *a, message_t *b) {
   return memcmp(&(a->src), &(b->src), sizeof(uid_t)) == 0 && a->id == b->id;
 }
 
+uint32_t decode_rejects[DECODE_RESULTS] = {0};
+
+// Decode a received frame into a message, checking every field later used as an index.
+// Flag bits this version doesn't know are cleared rather than rejected, newer senders may use them.
+// The frame may be the message itself, read into a packet buffer and decoded in place.
+decode_t decode_message(message_t *message, const uint8_t *frame, uint8_t length) {
+  if (length != sizeof(message_t)) {
+    return DECODE_LENGTH;
+  }
+  if ((const uint8_t *)message != frame) {
+    memcpy(message, frame, sizeof(message_t));
+  }
+  message->flags = (flags_t){.ack_req = message->flags.ack_req,
+                             .hop_limit = message->flags.hop_limit};
+
+  if (is_broadcast(message->src)) {
+    return DECODE_SRC;
+  }
+  if (message->mtype >= MTYPES) {
+    return DECODE_MTYPE;
+  }
+  if ((message->mtype == MTYPE_TEXT && message->data[0] >= TEXT_IDS) ||
+      ((message->mtype == MTYPE_REQ || message->mtype == MTYPE_RES) &&
+       message->data[0] >= INFO_KEYS) ||
+      (message->mtype == MTYPE_REQ && message->data[0] == INFO_STATS &&
+       message->data[1] >= STATS)) {
+    return DECODE_DATA;
+  }
+  return DECODE_OK;
+}
+
 // Forms a new ack message.
 message_t new_ack_message(uid_t dst, mid_t mid) {
   message_t msg = {
@@ -194,8 +305,25 @@ message_t new_raw_message(uid_t dst, uint8_t *data[3]) {
   return msg;
 }
 
+// Mark the table as changing, a copy taken by the UI core meanwhile is taken again.
+// The interrupts must be off.
+static uint32_t neighbour_table_write_begin() {
+  uint32_t seq = atomic_load_explicit(&neighbour_table_seq, memory_order_relaxed);
+  atomic_store_explicit(&neighbour_table_seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  return seq;
+}
+
+static void neighbour_table_write_end(uint32_t seq) {
+  atomic_store_explicit(&neighbour_table_seq, seq + 2, memory_order_release);
+}
+
 // Update (or add) a neighbour to the table.
+// Called from the rx interrupt and the radio loop, the interrupts are kept off so they don't
+// interleave, and the UI core reads it through the sequence number.
 void update_neighbour(uid_t uid, int8_t rssi, uint16_t version) {
+  uint32_t irq = platform_irq_disable();
+
   // Check if we can find the neighbour in the list
   int8_t index = -1;
   for (int i = 0; i < neighbour_table.count; i++) {
@@ -209,14 +337,20 @@ void update_neighbour(uid_t uid, int8_t rssi, uint16_t version) {
   if (index == -1) {
     // Check if we have space for a new neighbour
     if (neighbour_table.count >= MAX_NEIGHBOURS) {
+      platform_irq_restore(irq);
+      stat_inc(STAT_NEIGHBOURS_FULL);
       // TODO: periodic cleanup of the neighbour table
       error("neighbour table full\n");
       return;
     }
+  }
+
+  uint32_t seq = neighbour_table_write_begin();
 
+  bool added = index == -1;
+  if (added) {
     index = neighbour_table.count++;
   }
-
   neighbour_table.neighbours[index].uid = uid;
   if (rssi != 0) {
     neighbour_table.neighbours[index].rssi = rssi;
@@ -225,14 +359,49 @@ void update_neighbour(uid_t uid, int8_t rssi, uint16_t version) {
     neighbour_table.neighbours[index].version_major = version >> 8;
     neighbour_table.neighbours[index].version_minor = version & 0xFF;
   }
-  neighbour_table.neighbours[index].last_seen = get_absolute_time();
+  neighbour_table.neighbours[index].last_seen = platform_now();
+
+  neighbour_table_write_end(seq);
+  platform_irq_restore(irq);
+
+  // Every frame heard updates the table, the UI core is only told once until it takes its copy.
+  // Otherwise the records would fill the channel and push out the ones about new messages.
+  uint8_t change = added ? NEIGHBOURS_CHANGED | NEIGHBOURS_ADDED : NEIGHBOURS_CHANGED;
+  if (!(atomic_fetch_or_explicit(&neighbour_changes, change, memory_order_relaxed) &
+        NEIGHBOURS_CHANGED)) {
+    core_msg_t changed = {
+        .type = CORE_EVENT_NEIGHBOURS,
+        .time = neighbour_table.neighbours[index].last_seen,
+    };
+    if (!send_to_ui(&changed)) {
+      // Sent with the next change instead.
+      atomic_fetch_and_explicit(&neighbour_changes, ~NEIGHBOURS_CHANGED, memory_order_relaxed);
+    }
+  }
 
   debug("neighbour %s updated (rssi: %d, ts: %dms, vs: %d.%d)\n", uid_to_string(uid), rssi,
-        to_ms_since_boot(neighbour_table.neighbours[index].last_seen), version >> 8,
+        platform_ms_since_boot(neighbour_table.neighbours[index].last_seen), version >> 8,
         version & 0xFF);
 }
 
-// Print the neighbours list.
+// Copy the neighbour table from the other core, without stopping the writer.
+// The copy is taken again if the table changed while it was being copied.
+// Returns whether a neighbour was added since the last copy.
+bool copy_neighbour_table(neighbour_table_t *copy) {
+  // Taken before copying, a change made meanwhile is told about again.
+  bool added = atomic_exchange_explicit(&neighbour_changes, 0, memory_order_relaxed) &
+               NEIGHBOURS_ADDED;
+  uint32_t before, after;
+  do {
+    before = atomic_load_explicit(&neighbour_table_seq, memory_order_acquire);
+    memcpy(copy, &neighbour_table, sizeof(neighbour_table_t));
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&neighbour_table_seq, memory_order_relaxed);
+  } while (before != after || (before & 1));
+  return added;
+}
+
+// Print the neighbours list, from the radio core.
 void print_neighbours() {
   for (int i = 0; i < neighbour_table.count; i++) {
     neighbour_t *neighbour = &neighbour_table.neighbours[i];
@@ -241,124 +410,265 @@ void print_neighbours() {
       continue;
     }
     char *uid = uid_to_string(neighbour->uid);
-    printf("- [%s]: %ddBm, %dms, v%d.%d\r\n", uid, neighbour->rssi,
-           to_ms_since_boot(neighbour->last_seen), neighbour->version_major,
-           neighbour->version_minor);
+    seq_window_t *window = &neighbour->window;
+    reply("- [%s]: %ddBm, %dms, v%d.%d, %d received, %d lost, %d reordered, %d duplicates\r\n",
+          uid, neighbour->rssi, platform_ms_since_boot(neighbour->last_seen),
+          neighbour->version_major, neighbour->version_minor, window->received, window->lost,
+          window->reordered, window->duplicates);
   }
 }
 
-// Cyclic buffer of received messages.
-message_history_t message_history[MAX_MESSAGE_HISTORY] = {0};
+// Cyclic buffer of received packets.
+// Every entry holds a reference to its packet.
+packet_t message_history[MAX_MESSAGE_HISTORY];
 // Index of the next message to be added.
 uint8_t message_history_head = 0;
 uint8_t message_history_count = 0;
+uint32_t message_history_duplicates = 0;
+
+// Whether a mid was already seen in the window of its source, marks it seen otherwise.
+// A mid ahead of the window moves it, the ones skipped count as lost until they arrive. A mid older
+// than the window is taken for a duplicate and leaves the window as it is. Only a hello behind the
+// window or a window gone quiet for too long starts over, the source rebooted with a new random
+// mid. `known` is a duplicate the window may have forgotten, found in the history.
+static bool seq_window_check(seq_window_t *window, mid_t mid, bool hello, bool known,
+                             absolute_time_t now) {
+  int ahead = (int8_t)(mid_t)(mid - window->highest);
+  bool stale = window->received == 0 ||
+               platform_diff_us(window->updated, now) / 1000 > SEQ_WINDOW_TIMEOUT;
+
+  if (!stale && ahead <= 0) {
+    if (-ahead < SEQ_WINDOW_SIZE) {
+      uint64_t bit = 1ull << -ahead;
+      if (known || (window->seen & bit)) {
+        window->seen |= bit;
+        window->duplicates++;
+        return true;
+      }
+      if (!hello) {
+        window->seen |= bit;
+        window->reordered++;
+        if (window->lost > 0) {
+          window->lost--;
+        }
+        window->received++;
+        window->updated = now;
+        return false;
+      }
+    } else if (!hello) {
+      // Too old for the window to tell, an old retry or a source that rebooted without its hello
+      // heard. Only the history decides, the window stays where it was and goes stale if the
+      // source really started over.
+      if (known) {
+        window->duplicates++;
+      } else {
+        window->received++;
+      }
+      return known;
+    }
+  }
+  if (known) {
+    window->duplicates++;
+    return true;
+  }
+
+  if (!stale && ahead > 0) {
+    window->lost += ahead - 1;
+    window->seen = ahead < SEQ_WINDOW_SIZE ? window->seen << ahead | 1 : 1;
+  } else {
+    // Starts over, taken as new like the first message of a source.
+    window->seen = 1;
+  }
+  window->highest = mid;
+  window->received++;
+  window->updated = now;
+  return false;
+}
+
+// Check the message against the window of its source, if it has an entry in the neighbour table.
+static bool check_sequence(message_t *msg, bool known) {
+  uint32_t irq = platform_irq_disable();
+  for (int i = 0; i < neighbour_table.count; i++) {
+    neighbour_t *neighbour = &neighbour_table.neighbours[i];
+    if (memcmp(&neighbour->uid, &msg->src, sizeof(uid_t)) == 0) {
+      uint32_t seq = neighbour_table_write_begin();
+      known = seq_window_check(&neighbour->window, msg->id, msg->mtype == MTYPE_HELLO, known,
+                               platform_now());
+      neighbour_table_write_end(seq);
+      break;
+    }
+  }
+  platform_irq_restore(irq);
+  return known;
+}
 
 // Check if a message is already received.
 // If not, add it to the history.
-bool check_message_history(message_t msg) {
-  for (int i = 0; i < MAX_MESSAGE_HISTORY; i++) {
-    if (compare_messages(&message_history[i].message, &msg)) {
-      debug("message %d from %s already received\n", msg.id, uid_to_string(msg.src));
-      return true;
-    }
+// The history only holds the last few messages of every source together, the window of the
+// source remembers its last `SEQ_WINDOW_SIZE` mids on top, however many others came in between.
+bool check_message_history(packet_t packet) {
+  message_t *msg = &packet_get(packet)->message;
+  bool known = false;
+  for (int i = 0; i < MAX_MESSAGE_HISTORY && !known; i++) {
+    known = message_history[i] != PACKET_NONE &&
+            compare_messages(&packet_get(message_history[i])->message, msg);
+  }
+  if (check_sequence(msg, known)) {
+    debug("message %d from %s already received\n", msg->id, uid_to_string(msg->src));
+    message_history_duplicates++;
+    stat_inc(STAT_DUPLICATES);
+    return true;
   }
 
-  message_history[message_history_head].message = msg;
-  message_history[message_history_head].time = get_absolute_time();
+  packet_unref(message_history[message_history_head]);
+  packet_ref(packet);
+  message_history[message_history_head] = packet;
   message_history_head = (message_history_head + 1) % MAX_MESSAGE_HISTORY;
   message_history_count++;
-  debug("message %d from %s added to history\n", msg.id, uid_to_string(msg.src));
+  debug("message %d from %s added to history\n", msg->id, uid_to_string(msg->src));
 
   return false;
 }
 
-// Print the message history.
+// Print the message history, from the radio core.
 void print_message_history() {
   for (int i = 0; i < MAX_MESSAGE_HISTORY; i++) {
-    if (message_history[i].message.src.bytes[0] == 0) {
+    if (message_history[i] == PACKET_NONE) {
       continue;
     }
-    message_t *msg = &message_history[i].message;
+    message_history_t *entry = packet_get(message_history[i]);
+    message_t *msg = &entry->message;
     char *src = uid_to_string(msg->src);
-    printf("- [%d]: %s %s %d (%ds)\r\n", i, src, MTYPE_STR[msg->mtype], msg->id,
-           to_ms_since_boot(message_history[i].time) / 1000);
+    reply("- [%d]: %s %s %d (%ds)\r\n", i, src, MTYPE_STR[msg->mtype], msg->id,
+          platform_ms_since_boot(entry->time) / 1000);
   }
+  reply("duplicates: %d\n", message_history_duplicates);
 }
 
 // Ack list to keep track of messages that need to be acked.
 // Each message is indexed by its mid.
 // TODO: probably use a linked list here
 ack_t ack_list[MAX_MID] = {0};
+ack_stats_t ack_stats = {0};
 
-// Add an ack to the list.
-void add_ack(message_t *message) {
+// Add an ack to the list, holding a reference to the packet until it is acked.
+// Returns the time it times out.
+absolute_time_t add_ack(packet_t packet) {
+  message_t *message = &packet_get(packet)->message;
   ack_t *ack = &ack_list[message->id];
 
-  // Check if this is a new ack entry.
-  if (ack->timeout == 0) {
-    ack->retries = ACK_MAX_RETRIES;
-  } else {
+  // Check if this is a new ack entry or a retry of the same packet.
+  if (ack->timeout != 0 && ack->packet == packet) {
     ack->retries--;
+  } else {
+    packet_unref(ack->packet);
+    packet_ref(packet);
+    ack->packet = packet;
+    ack->retries = ACK_MAX_RETRIES;
   }
 
-  ack->message = *message;
-  ack->timeout = make_timeout_time_ms(ACK_TIMEOUT);
+  ack->timeout = platform_timeout_ms(ACK_TIMEOUT);
+  ack->sent = platform_now();
 
-  debug("ack added %d\n", message->id);
+  log_debug(LOG_ACK, "ack added %d\n", message->id);
+  return ack->timeout;
 }
 
 // Remove an ack from the list, marking it as acked.
 void remove_ack(mid_t mid) {
-  ack_list[mid].timeout = 0;
-  debug("ack removed %d\n", mid);
+  ack_t *ack = &ack_list[mid];
+  ack->timeout = 0;
+  packet_unref(ack->packet);
+  ack->packet = PACKET_NONE;
+  log_debug(LOG_ACK, "ack removed %d\n", mid);
 }
 
 // Check the ack list for timed out messages.
 // If an ack timed out, retransmit the corresponding message.
-void check_ack_list() {
+// Returns the time the next ack times out, the list doesn't need checking before that.
+absolute_time_t check_ack_list() {
+  absolute_time_t next = PLATFORM_END_OF_TIME;
   for (int i = 0; i < MAX_MID; i++) {
     ack_t *ack = &ack_list[i];
-    if (ack->timeout == 0 || ack->timeout > get_absolute_time()) {
+    if (ack->timeout == 0) {
+      continue;
+    }
+    if (ack->timeout > platform_now()) {
+      if (ack->timeout < next) {
+        next = ack->timeout;
+      }
       continue;
     }
 
-    // Add the message back to the transmit queue
-    debug("ack timeout %d (%d retries left)\n", ack->message.id, ack->retries);
+    // Add the packet back to the transmit queue
+    message_history_t *retry = packet_get(ack->packet);
+    log_debug(LOG_ACK, "ack timeout %d (%d retries left)\n", retry->message.id, ack->retries);
 
     if (ack->retries < 1) {
-      debug("maximum number of retries (%d) reached for ack, dropping", ACK_MAX_RETRIES);
-      remove_ack(ack->message.id);
+      log_debug(LOG_ACK, "maximum number of retries (%d) reached for ack, dropping\n",
+                ACK_MAX_RETRIES);
+      ack_stats.expired++;
+      stat_inc(STAT_GIVEN_UP);
+      remove_ack(retry->message.id);
       continue;
     }
 
-    if (queue_try_add(&tx_queue, &ack->message)) {
-      debug("tx enqueue (from ack timeout) %d\n", ack->message.id);
+    // Wait for the retry to be sent before timing out again, the timeout restarts once it is.
+    ack->timeout = platform_timeout_ms(ACK_TIMEOUT);
+    if (ack->timeout < next) {
+      next = ack->timeout;
+    }
+    retry->time = platform_now();
+    ack_stats.retries++;
+    stat_inc(STAT_RETRIES);
+    packet_ref(ack->packet);
+    if (mpsc_ring_push(&tx_queue, &ack->packet)) {
+      log_debug(LOG_ACK, "tx enqueue (from ack timeout) %d\n", retry->message.id);
+      post_event(EVENT_TX);
     } else {
-      error("tx queue is full (from ack timeout)\n");
+      packet_unref(ack->packet);
+      stat_inc(STAT_TX_QUEUE_FULL);
+      log_error(LOG_ACK, "tx queue is full (from ack timeout)\n");
     }
   }
+  return next;
 }
 
-// Print the ack list.
+// Print the ack list, from the radio core.
 void print_acks() {
   for (int i = 0; i < MAX_MID; i++) {
     ack_t *ack = &ack_list[i];
-    if (ack->timeout == 0) {
+    packet_t packet = ack->packet;
+    if (ack->timeout == 0 || packet == PACKET_NONE) {
       continue;
     }
-    char *dst = uid_to_string(ack->message.dst);
-    printf("- [%d]: %s %s (%d/%d retries | %llusec)\r\n", i, dst, MTYPE_STR[ack->message.mtype],
-           ack->retries, ACK_MAX_RETRIES,
-           absolute_time_diff_us(get_absolute_time(), ack->timeout) / 1000 / 1000);
+    message_t *msg = &packet_get(packet)->message;
+    char *dst = uid_to_string(msg->dst);
+    reply("- [%d]: %s %s (%d/%d retries | %" PRId64 "sec)\r\n", i, dst, MTYPE_STR[msg->mtype],
+          ack->retries, ACK_MAX_RETRIES,
+          platform_diff_us(platform_now(), ack->timeout) / 1000 / 1000);
   }
+  reply("retries: %d, expired: %d\n", ack_stats.retries, ack_stats.expired);
 }
 
 // Try to add a message to the transit queue to be sent.
 void try_transmit(message_t message) {
-  message_history_t message_with_time = {.time = get_absolute_time(), .message = message};
-  if (queue_try_add(&tx_queue, &message_with_time)) {
-    debug("tx enqueue %d\n", message_with_time.message.id);
+  packet_t packet = packet_alloc();
+  if (packet == PACKET_NONE) {
+    stat_inc(STAT_NO_PACKET);
+    error("no packet buffer left\n");
+    return;
+  }
+
+  message_history_t *outgoing = packet_get(packet);
+  outgoing->message = message;
+  outgoing->time = platform_now();
+  if (mpsc_ring_push(&tx_queue, &packet)) {
+    debug("tx enqueue %d\n", message.id);
+    post_event(EVENT_TX);
   } else {
+    packet_unref(packet);
+    stat_inc(STAT_TX_QUEUE_FULL);
     error("tx queue is full\n");
   }
 }
@@ -377,24 +687,35 @@ void try_transmit(message_t message) {
  */
 void handle_message(message_history_t *message) {
   message_t *incoming = &message->message;
-  int64_t rx_delta = absolute_time_diff_us(message->time, get_absolute_time());
-
-  // new msg notification
-  new_Messages[message_history_head-1] = 1;
-  new_Msg++;
+  int64_t rx_delta = platform_diff_us(message->time, platform_now());
+  stat_inc(STAT_DELIVERED);
+
+  // Keep it in the inbox, the UI shows it as a new message.
+  if (inbox_add(message)) {
+    core_msg_t notify = {
+        .type = CORE_EVENT_MESSAGE,
+        .time = message->time,
+        .message = {.src = incoming->src, .id = incoming->id, .mtype = incoming->mtype},
+    };
+    send_to_ui(&notify);
+  }
 
-  printf("message received from %s", uid_to_string(incoming->src));
-  printf(" to %s\n", uid_to_string(incoming->dst));
-  debug("rx queue delta %llu us\n", rx_delta);
+  info("message received from %s", uid_to_string(incoming->src));
+  info(" to %s\n", uid_to_string(incoming->dst));
+  debug("rx queue delta %" PRId64 " us\n", rx_delta);
 
   if (incoming->mtype == MTYPE_ACK) {
-    printf("rx: ack: %d\n", incoming->data[0]);
+    info("rx: ack: %d\n", incoming->data[0]);
+    stat_inc(STAT_ACKS_RECEIVED);
     mid_t mid = {incoming->data[0]};
+    if (ack_list[mid].timeout != 0) {
+      histogram_add(HIST_ACK_RTT, platform_diff_us(ack_list[mid].sent, platform_now()));
+    }
     remove_ack(mid);
   } else if (incoming->mtype == MTYPE_HELLO) {
-    printf("rx: hello\n");
+    info("rx: hello\n");
   } else if (incoming->mtype == MTYPE_PING) {
-    printf("rx: ping: %llu\n", incoming->time);
+    info("rx: ping: %" PRIu64 "\n", incoming->time);
     message_t pong = new_pong_message(incoming->src);
     // Add elapsed time in rx queue.
     // This moves the reference to the future, making the time difference smaller.
@@ -410,39 +731,45 @@ void handle_message(message_history_t *message) {
     ping_time += last_tx_delta * 2;
 
     // Calculate the time it took since we transmitted the ping message.
-    int64_t delta = absolute_time_diff_us(ping_time, get_absolute_time());
+    int64_t delta = platform_diff_us(ping_time, platform_now());
     // Divide by two for round-trip.
     delta /= 2;
 
-    printf("rx: pong: %lld us\n", delta);
+    info("rx: pong: %" PRId64 " us\n", delta);
   } else if (incoming->mtype == MTYPE_TEXT) {
-    printf("rx: text: %s\n", TEXT_MESSAGE_STR[incoming->data[0]]);
+    info("rx: text: %s\n", TEXT_MESSAGE_STR[incoming->data[0]]);
   } else if (incoming->mtype == MTYPE_REQ) {
-    printf("rx: request: %d\n", incoming->data[0]);
+    info("rx: request: %d\n", incoming->data[0]);
     if (incoming->data[0] == INFO_VERSION) {
       try_transmit(
           new_response_message(incoming->src, INFO_VERSION, VERSION_MAJOR << 8 | VERSION_MINOR));
     } else if (incoming->data[0] == INFO_UPTIME) {
       // Convert time in milliseconds to seconds.
-      uint32_t time_in_sec = to_ms_since_boot(get_absolute_time()) / 1000;
+      uint32_t time_in_sec = platform_ms_since_boot(platform_now()) / 1000;
       // Only send the lower 16 bits to save space.
       try_transmit(new_response_message(incoming->src, INFO_UPTIME, time_in_sec & 0xFFFF));
     } else if (incoming->data[0] == INFO_BATTERY) {
       try_transmit(new_response_message(incoming->src, INFO_BATTERY, read_voltage()));
+    } else if (incoming->data[0] == INFO_STATS) {
+      // The counter asked for, the lower 16 bits of it like the uptime.
+      uint32_t count = stat_get(incoming->data[1]);
+      try_transmit(new_response_message(incoming->src, INFO_STATS, count & 0xFFFF));
     } else {
       try_transmit(new_response_message(incoming->src, incoming->data[0], 0));
     }
   } else if (incoming->mtype == MTYPE_RES) {
-    printf("rx: response: %d %d %d\n", incoming->data[0], incoming->data[1], incoming->data[2]);
+    info("rx: response: %d %d %d\n", incoming->data[0], incoming->data[1], incoming->data[2]);
     if (incoming->data[0] == INFO_VERSION) {
-      printf("version: %d.%d\n", incoming->data[1], incoming->data[2]);
+      reply("version: %d.%d\n", incoming->data[1], incoming->data[2]);
       update_neighbour(incoming->src, 0, (incoming->data[1] << 8) | incoming->data[2]);
     } else if (incoming->data[0] == INFO_UPTIME) {
-      printf("uptime: %d\n", (incoming->data[1] << 8) | incoming->data[2]);
+      reply("uptime: %d\n", (incoming->data[1] << 8) | incoming->data[2]);
     } else if (incoming->data[0] == INFO_BATTERY) {
-      printf("battery: %f\n", (float)((incoming->data[1] << 8) | incoming->data[2]));
+      reply("battery: %f\n", (float)((incoming->data[1] << 8) | incoming->data[2]));
+    } else if (incoming->data[0] == INFO_STATS) {
+      reply("stats: %d\n", (incoming->data[1] << 8) | incoming->data[2]);
     }
   } else if (incoming->mtype == MTYPE_RAW) {
-    printf("rx: raw: %d %d %d\n", incoming->data[0], incoming->data[1], incoming->data[2]);
+    info("rx: raw: %d %d %d\n", incoming->data[0], incoming->data[1], incoming->data[2]);
   }
 }
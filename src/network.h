@@ -1,10 +1,13 @@
 #ifndef _NETWORK_H
 #define _NETWORK_H
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
 
-#include "pico/util/queue.h"
+#include "platform.h"
+
+#include "ring.h"
 
 // Bump these versions according to the changes made.
 #define VERSION_MAJOR 1
@@ -17,12 +20,20 @@
 #define ACK_TIMEOUT 1000 * 30 // 30 seconds
 // Number of tries before we give up on the message.
 #define ACK_MAX_RETRIES 5
+// Messages of a source told apart by their mid, the bits of `seq_window_t.seen`.
+#define SEQ_WINDOW_SIZE 64
+// A source silent for longer than a message is retried starts a new window, it may have rebooted.
+#define SEQ_WINDOW_TIMEOUT (ACK_TIMEOUT * (ACK_MAX_RETRIES + 1))
 // Maximum number of messages that can be buffered in the queue (both rx and tx).
+// Must be a power of two.
 #define MESSAGE_QUEUE_SIZE 8
-// Outgoing message queue.
-extern queue_t tx_queue;
-// Incoming message queue.
-extern queue_t rx_queue;
+// Number of packet buffers, shared by the queues, the message history and the ack list.
+// Must be a multiple of 32.
+#define PACKET_POOL_SIZE 64
+// Outgoing packet queue, filled from both cores and the rx interrupt.
+extern mpsc_ring_t tx_queue;
+// Incoming packet queue, filled by the rx interrupt.
+extern spsc_ring_t rx_queue;
 
 // 16 predefined text messages.
 typedef enum __attribute__((__packed__)) {
@@ -41,6 +52,7 @@ typedef enum __attribute__((__packed__)) {
   TEXT_BAD_RECEPTION = 12,
   TEXT_STAY_PUT = 13,
   TEXT_MOVE = 14,
+  TEXT_IDS,
 } text_id_t;
 
 // Unique identifier for a device.
@@ -73,6 +85,7 @@ typedef enum __attribute__((__packed__)) {
   MTYPE_REQ = 5,
   MTYPE_RES = 6,
   MTYPE_RAW = 7,
+  MTYPES,
 } mtype_t;
 
 // Message flags.
@@ -89,6 +102,9 @@ typedef enum __attribute__((__packed__)) {
   INFO_BATTERY = 1,
   INFO_UPTIME = 2,
   INFO_CALLSIGN = 3,
+  // A counter of `get stats`, its index in the second byte of the request.
+  INFO_STATS = 4,
+  INFO_KEYS,
 } info_key_t;
 
 // Information payload.
@@ -97,6 +113,23 @@ typedef struct {
   uint8_t value;
 } info_t;
 
+// Mids heard from a source, for telling its duplicates apart and counting what went missing.
+// Mids are shared by every destination of the source, messages to other nodes count as lost when
+// they don't reach this one, so `lost` is an upper bound.
+typedef struct {
+  mid_t highest;
+  // Bit i is set once message `highest - i` arrived.
+  uint64_t seen;
+  absolute_time_t updated;
+  // Empty while 0.
+  uint32_t received;
+  uint16_t duplicates;
+  // Gaps in the mids, taken back when the message comes after all.
+  uint16_t lost;
+  // Arrived after a later one.
+  uint16_t reordered;
+} seq_window_t;
+
 // Neighbour information.
 typedef struct {
   uid_t uid;
@@ -104,6 +137,7 @@ typedef struct {
   uint8_t version_major;
   uint8_t version_minor;
   absolute_time_t last_seen;
+  seq_window_t window;
 } neighbour_t;
 
 // Neighbour table.
@@ -132,27 +166,85 @@ typedef struct {
   absolute_time_t time;
 } message_history_t;
 
-// Cyclic buffer of received messages.
-extern message_history_t message_history[MAX_MESSAGE_HISTORY];
+// Outcome of decoding a received frame, every value but DECODE_OK rejects it.
+typedef enum {
+  DECODE_OK,
+  // Not the size of a message.
+  DECODE_LENGTH,
+  // Sent from the broadcast uid.
+  DECODE_SRC,
+  // Unknown message type.
+  DECODE_MTYPE,
+  // Text id, info key or counter out of range.
+  DECODE_DATA,
+  DECODE_RESULTS,
+} decode_t;
+
+// Frames rejected by the decoder, by reason.
+extern uint32_t decode_rejects[DECODE_RESULTS];
+
+// Handle of a packet buffer.
+// A packet is written once, when it is received or built, and then passed around by its handle.
+// Every holder keeps a reference, the buffer is free again once the last one is dropped.
+typedef uint8_t packet_t;
+
+// Handle of no packet.
+#define PACKET_NONE 0xFF
+
+// Packet buffer statistics.
+// Changed by whoever allocates or frees a packet, the rx interrupt and both cores, so only with
+// atomics like the buffers themselves.
+typedef struct {
+  atomic_uint_least32_t allocs;
+  atomic_uint_least32_t failures;
+  atomic_uint_least32_t in_use;
+  atomic_uint_least32_t peak;
+} packet_stats_t;
+
+extern packet_stats_t packet_stats;
+
+// Cyclic buffer of received packets.
+extern packet_t message_history[MAX_MESSAGE_HISTORY];
 // Index of the next message to be added.
 extern uint8_t message_history_head;
 extern uint8_t message_history_count;
+// Messages heard again after they were handled, from retries or from more than one forwarder.
+extern uint32_t message_history_duplicates;
 
 // Messages with timeout and retry values for ack.
 // Entry is invalid if `timeout` == 0.
 typedef struct {
-  message_t message;
   absolute_time_t timeout;
+  packet_t packet;
   uint8_t retries;
+  // When the last attempt was taken off the tx queue.
+  absolute_time_t sent;
 } ack_t;
 
 // Ack list to keep track of messages that need to be acked.
 // Each message is indexed by its mid.
 extern ack_t ack_list[MAX_MID];
 
+// Ack list statistics.
+typedef struct {
+  // Messages sent again after their ack timed out.
+  uint32_t retries;
+  // Messages given up on after the last retry.
+  uint32_t expired;
+} ack_stats_t;
+
+extern ack_stats_t ack_stats;
+
 void setup_network();
 
+packet_t packet_alloc();
+message_history_t *packet_get(packet_t packet);
+void packet_ref(packet_t packet);
+void packet_unref(packet_t packet);
+void print_packets();
+
 bool compare_messages(message_t *a, message_t *b);
+decode_t decode_message(message_t *message, const uint8_t *frame, uint8_t length);
 
 message_t new_ack_message(uid_t dst, mid_t mid);
 message_t new_hello_message();
@@ -164,14 +256,15 @@ message_t new_response_message(uid_t dst, info_key_t key, uint16_t value);
 message_t new_raw_message(uid_t dst, uint8_t *data[3]);
 
 void update_neighbour(uid_t uid, int8_t rssi, uint16_t version);
+bool copy_neighbour_table(neighbour_table_t *copy);
 void print_neighbours();
 
-bool check_message_history(message_t msg);
+bool check_message_history(packet_t packet);
 void print_message_history();
 
-void add_ack(message_t *message);
+absolute_time_t add_ack(packet_t packet);
 void remove_ack(mid_t mid);
-void check_ack_list();
+absolute_time_t check_ack_list();
 void print_acks();
 
 void try_transmit(message_t message);
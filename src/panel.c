@@ -0,0 +1,229 @@
+/**
+ * Display panel
+ *
+ * Owns the frame buffers and drives the e-paper refreshes. Screens are rendered into the back
+ * buffer (`image`) and handed over with `present_frame`. Uploads only ever read the front buffer,
+ * so the panel always receives a complete frame.
+ *
+ * Partial refreshes are quick but leave ghosting behind, which only a full refresh clears. The
+ * refresh policy keeps track of how many pixels changed since the last full refresh and picks the
+ * cheapest mode that keeps the panel clean.
+ */
+
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+#include "EPD_2in13_V4.h"
+#include "GUI_Paint.h"
+
+#include "panel.h"
+#include "voidlink.h"
+
+// Bytes in a line of the frame, a column of the screen.
+#define FRAME_WIDTH_BYTES ((EPD_2in13_V4_WIDTH + 7) / 8)
+// Number of pixels on the panel.
+#define PANEL_PIXELS (IMAGE_SIZE * 8)
+// Changed pixels partial and fast refreshes may accumulate before a full refresh, about three
+// whole screens worth.
+#define GHOSTING_BUDGET (PANEL_PIXELS * 3)
+// A frame changing more than a quarter of the panel is a screen change, a partial refresh would
+// leave the previous screen visible.
+#define FAST_THRESHOLD (PANEL_PIXELS / 4)
+// Longest time between full refreshes.
+#define FULL_INTERVAL_US (10 * 60 * 1000 * 1000ull)
+// Partial waveforms ghost more in the cold, below this the budget is halved.
+#define COLD_TEMPERATURE 10
+// Below this partial refreshes are not used at all.
+#define FREEZING_TEMPERATURE 0
+// How long a temperature reading is used for.
+#define TEMPERATURE_INTERVAL_US (60 * 1000 * 1000ull)
+
+// Front and back buffers.
+// The second buffer used to be the boot splash buffer, so this costs no extra RAM.
+// Word aligned, so frames can be compared a word at a time.
+static uint8_t framebuffer[2][IMAGE_SIZE] __attribute__((aligned(4)));
+// Index of the front buffer, the last presented frame.
+static volatile uint32_t front = 0;
+
+uint8_t *image = framebuffer[1];
+
+refresh_stats_t refresh_stats = {0};
+
+// Start time and mode of the refresh currently running on the panel.
+static uint64_t refresh_start = 0;
+static refresh_mode_t refresh_mode;
+// Time of the last full refresh.
+static uint64_t last_full_refresh = 0;
+// Pixels changed by the frames presented since the last refresh started.
+static uint32_t changed_pixels = 0;
+// Time the panel was woken up, until the first frame after it is visible.
+static volatile uint64_t wake_start = 0;
+// Area of the screen changed since the last refresh started.
+static rect_t upload_rect = {1, 1, 0, 0};
+
+static const rect_t SCREEN_RECT = {0, 0, EPD_2in13_V4_HEIGHT - 1, EPD_2in13_V4_WIDTH - 1};
+
+// Count the pixels that differ between two frames, within the given screen columns.
+// Screens are drawn rotated, a column of the screen is a line of the frame.
+static uint32_t count_changed_pixels(const uint8_t *a, const uint8_t *b, uint16_t x0,
+                                     uint16_t x1) {
+  const uint32_t *x = (const uint32_t *)(a + x0 * FRAME_WIDTH_BYTES);
+  const uint32_t *y = (const uint32_t *)(b + x0 * FRAME_WIDTH_BYTES);
+  uint32_t words = (x1 - x0 + 1) * FRAME_WIDTH_BYTES / 4;
+  uint32_t changed = 0;
+  for (int i = 0; i < words; i++) {
+    changed += __builtin_popcount(x[i] ^ y[i]);
+  }
+  return changed;
+}
+
+// Hand the back buffer over to the uploader and continue drawing into the other buffer.
+void present_frame() { present_frame_rect(SCREEN_RECT); }
+
+// Same as `present_frame`, but only the `dirty` area of the frame changed.
+void present_frame_rect(rect_t dirty) {
+  uint32_t back = front ^ 1;
+
+  if (dirty.x0 <= dirty.x1 && dirty.y0 <= dirty.y1) {
+    changed_pixels += count_changed_pixels(framebuffer[back], framebuffer[front], dirty.x0,
+                                           dirty.x1);
+    if (upload_rect.x0 > upload_rect.x1) {
+      upload_rect = dirty;
+    } else {
+      upload_rect.x0 = dirty.x0 < upload_rect.x0 ? dirty.x0 : upload_rect.x0;
+      upload_rect.y0 = dirty.y0 < upload_rect.y0 ? dirty.y0 : upload_rect.y0;
+      upload_rect.x1 = dirty.x1 > upload_rect.x1 ? dirty.x1 : upload_rect.x1;
+      upload_rect.y1 = dirty.y1 > upload_rect.y1 ? dirty.y1 : upload_rect.y1;
+    }
+  }
+
+  // Make sure every write to the frame is visible before it gets published.
+  __dmb();
+  front = back;
+
+  // Screens may redraw only part of the frame, so start from the presented one.
+  image = framebuffer[back ^ 1];
+  memcpy(image, framebuffer[back], IMAGE_SIZE);
+  Paint_SelectImage(image);
+}
+
+// Called from the BUSY interrupt when the panel finished a refresh.
+static void refresh_done() {
+  uint64_t now = time_us_64();
+  refresh_stats.busy_us[refresh_mode] += now - refresh_start;
+  refresh_stats.count[refresh_mode]++;
+
+  // The first frame after waking up is visible now.
+  if (wake_start != 0) {
+    refresh_stats.wake_us_last = now - wake_start;
+    if (refresh_stats.wake_us_last > refresh_stats.wake_us_max) {
+      refresh_stats.wake_us_max = refresh_stats.wake_us_last;
+    }
+    refresh_stats.wakes++;
+    wake_start = 0;
+  }
+}
+
+// Returns the ambient temperature, read at most once every `TEMPERATURE_INTERVAL_US`.
+// The panel bus is write only, so the controller's sensor can't be read back. The MCU sits right
+// behind the panel and is close enough.
+static float panel_temperature() {
+  static float temperature;
+  static uint64_t last_read = 0;
+
+  uint64_t now = time_us_64();
+  if (last_read == 0 || now - last_read > TEMPERATURE_INTERVAL_US) {
+    temperature = read_temperature();
+    last_read = now;
+  }
+  return temperature;
+}
+
+// Pick the refresh mode for the presented frame.
+// Partial refreshes need the controller RAM to hold the image on the panel, which deep sleep keeps
+// but a reset or power loss doesn't.
+refresh_mode_t choose_refresh() {
+  float temperature = panel_temperature();
+  uint32_t budget = temperature < COLD_TEMPERATURE ? GHOSTING_BUDGET / 2 : GHOSTING_BUDGET;
+
+  if (refresh_stats.ghosting + changed_pixels > budget ||
+      time_us_64() - last_full_refresh > FULL_INTERVAL_US) {
+    return REFRESH_FULL;
+  }
+  if (!EPD_2in13_V4_GetSession()->RamValid || changed_pixels > FAST_THRESHOLD ||
+      temperature < FREEZING_TEMPERATURE) {
+    return REFRESH_FAST;
+  }
+  return REFRESH_PARTIAL;
+}
+
+// Block until the running refresh is done.
+// The core sleeps until the BUSY interrupt fires, that time is counted as idle.
+void wait_for_refresh() {
+  while (EPD_2in13_V4_IsBusy()) {
+    uint64_t start = time_us_64();
+    __wfe();
+    refresh_stats.idle_us += time_us_64() - start;
+  }
+}
+
+// Upload the front buffer and start a refresh without waiting for the waveform to finish.
+void start_refresh(refresh_mode_t mode) {
+  wait_for_refresh();
+
+  // Nothing to show.
+  rect_t rect = upload_rect;
+  upload_rect = (rect_t){1, 1, 0, 0};
+  if (mode == REFRESH_PARTIAL && rect.x0 > rect.x1) {
+    refresh_stats.skipped++;
+    return;
+  }
+
+  refresh_start = time_us_64();
+  refresh_mode = mode;
+
+  if (mode == REFRESH_FULL) {
+    refresh_stats.ghosting = 0;
+    last_full_refresh = refresh_start;
+  } else {
+    refresh_stats.ghosting += changed_pixels;
+  }
+  changed_pixels = 0;
+
+  uint8_t *frame = framebuffer[front];
+  switch (mode) {
+  case REFRESH_PARTIAL:
+    // Only the changed lines and bytes of the frame are sent, the screen is rotated so its y axis
+    // runs backwards along the frame lines.
+    EPD_2in13_V4_Display_Partial_Window_Async(
+        frame, (EPD_2in13_V4_WIDTH - 1 - rect.y1) / 8, rect.x0,
+        (EPD_2in13_V4_WIDTH - 1 - rect.y0) / 8, rect.x1, refresh_done);
+    break;
+  case REFRESH_FAST:
+    // Both RAMs are written, partial refreshes can follow right away.
+    EPD_2in13_V4_Display_Fast_Base_Async(frame, refresh_done);
+    break;
+  case REFRESH_FULL:
+    EPD_2in13_V4_Display_Base_Async(frame, refresh_done);
+    break;
+  default:
+    break;
+  }
+}
+
+// Put the panel into deep sleep once the running refresh is done.
+// The controller keeps its RAM, so the image on the panel can still be updated partially.
+void sleep_panel() {
+  wait_for_refresh();
+  EPD_2in13_V4_Sleep();
+}
+
+// Start measuring the wake up latency, until the next refresh is done.
+// The controller itself is woken up by the next refresh.
+void wake_panel() {
+  if (EPD_2in13_V4_GetSession()->Sleeping) {
+    wake_start = time_us_64();
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef _PANEL_H
+#define _PANEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// ((EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1)) *
+// EPD_2in13_V4_HEIGHT = 4080
+#define IMAGE_SIZE 4080
+
+// Panel refresh modes, from the slowest and cleanest to the quickest.
+typedef enum {
+  REFRESH_FULL,
+  REFRESH_FAST,
+  REFRESH_PARTIAL,
+  REFRESH_MODES,
+} refresh_mode_t;
+
+static const char *REFRESH_MODE_STR[] = {
+    [REFRESH_FULL] = "full",
+    [REFRESH_FAST] = "fast",
+    [REFRESH_PARTIAL] = "partial",
+};
+
+// Rectangle in screen coordinates, corners included. Empty if `x0 > x1`.
+typedef struct {
+  uint16_t x0;
+  uint16_t y0;
+  uint16_t x1;
+  uint16_t y1;
+} rect_t;
+
+// Panel refresh statistics, indexed by refresh mode.
+// `busy_us` is the time the panel spent refreshing, `idle_us` is the part of the total the UI core
+// spent sleeping while waiting for a refresh to finish. `ghosting` is the number of pixels changed
+// since the last full refresh. `skipped` counts partial refreshes dropped because nothing changed.
+// `wake_us_*` is the time from waking the panel up until the first frame after it was visible.
+typedef struct {
+  uint32_t count[REFRESH_MODES];
+  uint32_t skipped;
+  uint32_t wakes;
+  uint32_t wake_us_last;
+  uint32_t wake_us_max;
+  uint64_t busy_us[REFRESH_MODES];
+  uint64_t idle_us;
+  uint32_t ghosting;
+} refresh_stats_t;
+
+extern refresh_stats_t refresh_stats;
+
+// Back buffer, the frame being rendered.
+// Only valid until the next `present_frame`.
+extern uint8_t *image;
+
+void present_frame();
+void present_frame_rect(rect_t dirty);
+
+refresh_mode_t choose_refresh();
+void wait_for_refresh();
+void start_refresh(refresh_mode_t mode);
+
+void sleep_panel();
+void wake_panel();
+
+#endif // _PANEL_H
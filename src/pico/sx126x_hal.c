@@ -5,6 +5,7 @@
 #include "hardware/timer.h"
 #include "pico/critical_section.h"
 
+#include "histogram.h"
 #include "sx126x_hal.h"
 #include "sx126x_hal_context.h"
 
@@ -37,6 +38,7 @@ sx126x_hal_status_t sx126x_hal_write(const void *context, const uint8_t *command
                                      const uint16_t command_length, const uint8_t *data,
                                      const uint16_t data_length) {
   const sx126x_hal_context_t *sx126x_context = (const sx126x_hal_context_t *)context;
+  uint32_t start = time_us_32();
 
   sx126x_hal_wait_on_busy(sx126x_context);
 
@@ -47,6 +49,8 @@ sx126x_hal_status_t sx126x_hal_write(const void *context, const uint8_t *command
 
   pico_gpio_write(sx126x_context->nss.pin, 1);
 
+  histogram_add(HIST_SPI, time_us_32() - start);
+
   return SX126X_HAL_STATUS_OK;
 }
 
@@ -67,6 +71,7 @@ sx126x_hal_status_t sx126x_hal_read(const void *context, const uint8_t *command,
                                     const uint16_t command_length, uint8_t *data,
                                     const uint16_t data_length) {
   const sx126x_hal_context_t *sx126x_context = (const sx126x_hal_context_t *)context;
+  uint32_t start = time_us_32();
 
   sx126x_hal_wait_on_busy(sx126x_context);
 
@@ -77,6 +82,8 @@ sx126x_hal_status_t sx126x_hal_read(const void *context, const uint8_t *command,
 
   pico_gpio_write(sx126x_context->nss.pin, 1);
 
+  histogram_add(HIST_SPI, time_us_32() - start);
+
   return SX126X_HAL_STATUS_OK;
 }
 
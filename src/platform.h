@@ -0,0 +1,88 @@
+#ifndef _PLATFORM_H
+#define _PLATFORM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Platform services of the protocol core: time, randomness, the board id, interrupt masking,
+// waking up a sleeping core and telling the running contexts apart. The firmware maps them
+// straight onto the pico SDK here, host builds define VOIDLINK_HOST and link their own (see
+// host/platform.c).
+
+// Size of the unique board id, the node uid is taken from its last bytes.
+#define PLATFORM_BOARD_ID_SIZE 8
+
+#ifdef VOIDLINK_HOST
+
+// Microseconds since boot, as the SDK keeps it.
+typedef uint64_t absolute_time_t;
+
+absolute_time_t platform_now();
+void platform_sleep_ms(uint32_t ms);
+uint32_t platform_rand();
+void platform_board_id(uint8_t id[PLATFORM_BOARD_ID_SIZE]);
+uint32_t platform_irq_disable();
+void platform_irq_restore(uint32_t state);
+void platform_notify();
+void platform_wait(absolute_time_t deadline);
+
+// Everything runs on a single thread.
+static inline uint32_t platform_context() { return 0; }
+
+#else
+
+#include "hardware/sync.h"
+#include "pico/platform.h"
+#include "pico/rand.h"
+#include "pico/time.h"
+#include "pico/unique_id.h"
+
+static inline absolute_time_t platform_now() { return get_absolute_time(); }
+static inline void platform_sleep_ms(uint32_t ms) { sleep_ms(ms); }
+static inline uint32_t platform_rand() { return get_rand_32(); }
+
+static inline void platform_board_id(uint8_t id[PLATFORM_BOARD_ID_SIZE]) {
+  pico_unique_board_id_t board_id;
+  pico_get_unique_board_id(&board_id);
+  for (int i = 0; i < PLATFORM_BOARD_ID_SIZE; i++) {
+    id[i] = board_id.id[i];
+  }
+}
+
+// Keep the interrupts of the calling core off, for data shared with its interrupt handlers.
+static inline uint32_t platform_irq_disable() { return save_and_disable_interrupts(); }
+static inline void platform_irq_restore(uint32_t state) { restore_interrupts(state); }
+
+// Wake up the other core, or this core's next `platform_wait`.
+static inline void platform_notify() { __sev(); }
+
+// Sleep until notified, an interrupt, or the deadline, whichever comes first.
+static inline void platform_wait(absolute_time_t deadline) { best_effort_wfe_or_timeout(deadline); }
+
+// Which code of which core is running: twice the core, plus one in an interrupt handler.
+static inline uint32_t platform_context() {
+  return get_core_num() << 1 | (__get_current_exception() != 0);
+}
+
+#endif // VOIDLINK_HOST
+
+// Time arithmetic, the same everywhere.
+#define PLATFORM_END_OF_TIME ((absolute_time_t)INT64_MAX)
+
+static inline absolute_time_t platform_timeout_ms(uint32_t ms) {
+  return platform_now() + (uint64_t)ms * 1000;
+}
+
+static inline int64_t platform_diff_us(absolute_time_t from, absolute_time_t to) {
+  return (int64_t)(to - from);
+}
+
+static inline absolute_time_t platform_earliest(absolute_time_t a, absolute_time_t b) {
+  return a < b ? a : b;
+}
+
+static inline bool platform_reached(absolute_time_t t) { return platform_now() >= t; }
+
+static inline uint32_t platform_ms_since_boot(absolute_time_t t) { return (uint32_t)(t / 1000); }
+
+#endif // _PLATFORM_H
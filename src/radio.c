@@ -0,0 +1,549 @@
+/**
+ * Radio
+ *
+ * The SX126x, its DIO1 interrupt and the radio loop: receiving, forwarding, the random backoff
+ * before sending and the timed work of the protocol. Everything here goes through the sx126x
+ * driver and the platform layer only, so the same code runs on the host against a virtual radio.
+ *
+ * The loop itself is `radio_step`, one pass for the events posted since the last one. The radio
+ * core calls it from `radio_entry`, sleeping in between until the next event or the deadline it
+ * returns; a simulation calls it whenever it delivers an event to a node.
+ */
+
+#define LOG_CATEGORY LOG_RADIO
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pico_config.h"
+#include "sx126x.h"
+
+#include "capture.h"
+#include "channel.h"
+#include "events.h"
+#include "histogram.h"
+#include "inbox.h"
+#include "network.h"
+#include "platform.h"
+#include "radio.h"
+#include "stats.h"
+#include "utils.h"
+
+absolute_time_t last_tx_start;
+absolute_time_t last_tx_delta;
+
+// Debug flag to stop processing of received messages.
+bool STOP_PROCESSING = false;
+
+// Main state machine.
+typedef enum {
+  STATE_IDLE,
+  STATE_TX,
+  STATE_TX_DONE,
+  STATE_RX,
+} state_t;
+
+// Current state of the main state machine.
+static state_t state = STATE_IDLE;
+
+sx126x_hal_context_t radio_context;
+static sx126x_mod_params_lora_t mod_params;
+static sx126x_pkt_params_lora_t packet_params;
+static mod_params_t mod_params_local = DEFAULT;
+
+// Timed work of the radio loop, nothing else wakes it up for it.
+static absolute_time_t ack_deadline = PLATFORM_END_OF_TIME;
+static absolute_time_t inbox_deadline = PLATFORM_END_OF_TIME;
+
+// Packet waiting out its random backoff, and when it is due to be sent.
+static packet_t tx_pending = PACKET_NONE;
+static absolute_time_t tx_due = PLATFORM_END_OF_TIME;
+
+void set_range(mod_params_t param) {
+  switch (param) {
+  case DEFAULT:
+    mod_params = MOD_PARAMS_DEFAULT;
+    mod_params_local = DEFAULT;
+    break;
+  case FAST:
+    mod_params = MOD_PARAMS_FAST;
+    mod_params_local = FAST;
+    break;
+  case LONGRANGE:
+    mod_params = MOD_PARAMS_LONGRANGE;
+    mod_params_local = LONGRANGE;
+    break;
+  }
+
+  sx126x_set_lora_mod_params(&radio_context, &mod_params);
+
+  debug("modulation parameters set to %s (ToA: %u ms)\n", MOD_PARAM_STR[param],
+        get_time_on_air_in_ms());
+}
+
+mod_params_t get_range() { return mod_params_local; }
+
+uint32_t get_time_on_air_in_ms() {
+  return sx126x_get_lora_time_on_air_in_ms(&packet_params, &mod_params);
+}
+
+// Random time to wait before sending, scaled with the time on air of the modulation parameters.
+uint32_t get_backoff_ms() {
+  uint32_t timeout = platform_rand();
+
+  if (mod_params_local == FAST) {
+    timeout %= 300;
+  } else if (mod_params_local == LONGRANGE) {
+    timeout %= 1000;
+  } else {
+    timeout %= 500;
+  }
+
+  return timeout;
+}
+
+void handle_tx_callback() {
+  last_tx_delta = platform_diff_us(last_tx_start, platform_now());
+  stat_add(STAT_AIRTIME_MS, (last_tx_delta + 500) / 1000);
+  histogram_add(HIST_AIRTIME, last_tx_delta);
+  debug("last tx took %" PRIu64 " us\n", last_tx_delta);
+
+  sx126x_chip_status_t status = {.chip_mode = 0, .cmd_status = 0};
+  sx126x_get_status(&radio_context, &status);
+  if (status.cmd_status != SX126X_CMD_STATUS_CMD_TX_DONE) {
+    error("tx callback status error (mode: %d | cmd: %d)\n", status.chip_mode, status.cmd_status);
+    return;
+  }
+
+  if (state != STATE_TX) {
+    error("TX IRQ triggered while not in TX state\n");
+  }
+  state = STATE_TX_DONE;
+  debug("STATE = TX_DONE\n");
+  post_event(EVENT_TX_DONE);
+}
+
+void handle_rx_callback() {
+  absolute_time_t rx_time = platform_now();
+
+  // Make sure the data available status is set before reading the rx buffer.
+  sx126x_chip_status_t status = {.chip_mode = 0, .cmd_status = 0};
+  sx126x_get_status(&radio_context, &status);
+  if (status.cmd_status != SX126X_CMD_STATUS_DATA_AVAILABLE) {
+    stat_inc(STAT_RX_ERRORS);
+    error("rx status error (mode: %d | cmd: %d)\n", status.chip_mode, status.cmd_status);
+    return;
+  }
+
+  // Get length and the start address of the received message.
+  sx126x_rx_buffer_status_t buffer_status = {.buffer_start_pointer = 0, .pld_len_in_bytes = 0};
+  sx126x_get_rx_buffer_status(&radio_context, &buffer_status);
+  debug("payload received: %d @ %d\n", buffer_status.pld_len_in_bytes,
+        buffer_status.buffer_start_pointer);
+
+  // Get the packet status to learn the signal strength of the received message.
+  sx126x_pkt_status_lora_t pkt_status = {0};
+  sx126x_get_lora_pkt_status(&radio_context, &pkt_status);
+  stat_inc(STAT_RX_FRAMES);
+
+  // Make sure the buffer has enough space to read the message.
+  if (buffer_status.pld_len_in_bytes > sizeof(message_t)) {
+    capture_frame(CAPTURE_RX, rx_time, NULL, buffer_status.pld_len_in_bytes, SX126X_IRQ_RX_DONE,
+                  pkt_status.signal_rssi_pkt_in_dbm, pkt_status.snr_pkt_in_db);
+    decode_rejects[DECODE_LENGTH]++;
+    stat_inc(STAT_RX_REJECTED);
+    error("payload is bigger than the buffer (%d)\n", (int)sizeof(message_t));
+    return;
+  }
+
+  // The frame is read straight into a packet buffer and decoded in place, it is written once and
+  // passed on by its handle from here on.
+  packet_t packet = packet_alloc();
+  if (packet == PACKET_NONE) {
+    // Nowhere to read it to, the capture only has the interrupt.
+    capture_frame(CAPTURE_IRQ, rx_time, NULL, 0, SX126X_IRQ_RX_DONE,
+                  pkt_status.signal_rssi_pkt_in_dbm, pkt_status.snr_pkt_in_db);
+    stat_inc(STAT_NO_PACKET);
+    error("no packet buffer left, dropping message\n");
+    return;
+  }
+  message_history_t *rx_payload = packet_get(packet);
+  uint8_t *frame = (uint8_t *)&rx_payload->message;
+  sx126x_read_buffer(&radio_context, buffer_status.buffer_start_pointer, frame,
+                     buffer_status.pld_len_in_bytes);
+  rx_payload->time = rx_time;
+
+  debug_bytes("<-", frame, buffer_status.pld_len_in_bytes);
+
+  capture_frame(CAPTURE_RX, rx_time, frame, buffer_status.pld_len_in_bytes, SX126X_IRQ_RX_DONE,
+                pkt_status.signal_rssi_pkt_in_dbm, pkt_status.snr_pkt_in_db);
+
+  // Nothing past here trusts a frame the decoder didn't check.
+  decode_t result = decode_message(&rx_payload->message, frame, buffer_status.pld_len_in_bytes);
+  if (result != DECODE_OK) {
+    packet_unref(packet);
+    decode_rejects[result]++;
+    stat_inc(STAT_RX_REJECTED);
+    error("frame rejected (%s)\n", DECODE_STR[result]);
+    return;
+  }
+
+  if (is_my_uid(rx_payload->message.src)) {
+    stat_inc(STAT_RX_OWN);
+    debug("message from myself\n");
+    packet_unref(packet);
+    return;
+  }
+
+  // Update the neighbour table with the information from received message.
+  // TODO: ignore rssi for hopped messages
+  update_neighbour(rx_payload->message.src, pkt_status.signal_rssi_pkt_in_dbm, 0);
+
+  // Check if the received message is for us.
+  if (!is_my_uid(rx_payload->message.dst) && !is_broadcast(rx_payload->message.dst)) {
+    debug("message is not for me\n");
+
+    // Check if the message has remaining hops.
+    if (rx_payload->message.flags.hop_limit > 0) {
+      rx_payload->message.flags.hop_limit--;
+      debug("forwarding message (%d hops remaining)\n", rx_payload->message.flags.hop_limit);
+      if (mpsc_ring_push(&tx_queue, &packet)) {
+        debug("tx enqueue %d\n", rx_payload->message.id);
+        stat_inc(STAT_FORWARDED);
+        post_event(EVENT_TX);
+        return;
+      }
+      stat_inc(STAT_TX_QUEUE_FULL);
+      error("tx queue is full\n");
+    } else {
+      stat_inc(STAT_HOP_LIMIT);
+      debug("not forwarding message, hop limit reached\n");
+    }
+
+    packet_unref(packet);
+    return;
+  }
+
+  // Hand the message to the radio loop.
+  if (spsc_ring_push(&rx_queue, &packet)) {
+    debug("rx enqueue %d\n", rx_payload->message.id);
+    post_event(EVENT_RX);
+  } else {
+    packet_unref(packet);
+    event_stats.rx_drops++;
+    stat_inc(STAT_RX_QUEUE_FULL);
+    // TODO: maybe drop the oldest message instead
+    error("rx queue is full, dropping message\n");
+  }
+}
+
+// Callback function for everytime an interrupt is detected on DIO1.
+void handle_dio1_callback(uint gpio, uint32_t events) {
+  // Get the irq status to learn why the interrupt was triggered.
+  // And clean the interrupt at the same time, since it is getting handled now.
+  sx126x_irq_mask_t irq = 0;
+  sx126x_get_and_clear_irq_status(&radio_context, &irq);
+
+  debug("%s\n", IRQ_STR[irq]);
+
+  // TODO: handle multiple interrupts at the same time
+  if (irq == SX126X_IRQ_TX_DONE) {
+    handle_tx_callback();
+  } else if (irq == SX126X_IRQ_RX_DONE) {
+    handle_rx_callback();
+  } else {
+    stat_inc(STAT_RX_ERRORS);
+    capture_frame(CAPTURE_IRQ, platform_now(), NULL, 0, irq, 0, 0);
+  }
+}
+
+// Nothing works without the radio, stop here.
+static void radio_halt() {
+  while (true) {
+    platform_wait(PLATFORM_END_OF_TIME);
+  }
+}
+
+void setup_sx126x() {
+  // Try to read a register with a known reset value from the radio.
+  // If this fails, either SPI connection is not setup correctly or the radio is not responding.
+  uint8_t reg = 0;
+  sx126x_read_register(&radio_context, 0x0740, &reg, 1);
+  if (reg != 0x14) {
+    error("sanity check failed: %d\n", reg);
+    radio_halt();
+  }
+
+  // The radio is using TCXO. The DIO3 pin needs to be setup as a voltage source for the TCXO.
+  // Before this step, the radio will fail to start the XOSC. This is expected so, we clear the
+  // errors.
+  sx126x_clear_device_errors(&radio_context);
+#ifndef PIN_CONFIG_v2
+  sx126x_set_dio3_as_tcxo_ctrl(&radio_context, SX126X_TCXO_CTRL_1_7V, 5 << 6);
+
+  // With the TCXO correctly configured now, re-calibrate all the clock on the chip.
+  sx126x_cal_mask_t calibration_mask = 0x7F;
+  sx126x_cal(&radio_context, calibration_mask);
+#endif
+
+  // Make sure the calibration succeeded.
+  sx126x_errors_mask_t errors = 0;
+  sx126x_chip_status_t status = {.chip_mode = 0, .cmd_status = 0};
+  sx126x_get_status(&radio_context, &status);
+  sx126x_get_device_errors(&radio_context, &errors);
+  if (!(status.chip_mode == SX126X_CHIP_MODE_STBY_RC &&
+        status.cmd_status == SX126X_CMD_STATUS_RFU && errors == 0)) {
+    error("calibration failed\n");
+    radio_halt();
+  }
+
+  // Setup the radio for LORA at 915MHz.
+  sx126x_set_standby(&radio_context, SX126X_STANDBY_CFG_RC);
+  sx126x_set_pkt_type(&radio_context, SX126X_PKT_TYPE_LORA);
+  sx126x_set_rf_freq(&radio_context, 915000000);
+
+  // Setup power amplifier settings for TX.
+  sx126x_pa_cfg_params_t pa_cfg = {
+      .pa_duty_cycle = 0x04,
+      .hp_max = 0x07,
+      .device_sel = 0x00,
+      .pa_lut = 0x01,
+  };
+  sx126x_set_pa_cfg(&radio_context, &pa_cfg);
+  sx126x_set_tx_params(&radio_context, 0x16, SX126X_RAMP_40_US);
+
+  // Initialize modulation parameters.
+  mod_params = MOD_PARAMS_DEFAULT;
+
+  // Setup the modulation parameters for LORA.
+  sx126x_set_lora_mod_params(&radio_context, &mod_params);
+
+  // Setup the packet parameters for LORA.
+  packet_params.preamble_len_in_symb = 0x10;
+  packet_params.header_type = SX126X_LORA_PKT_IMPLICIT;
+  packet_params.pld_len_in_bytes = sizeof(message_t);
+  packet_params.crc_is_on = true;
+  packet_params.invert_iq_is_on = false;
+
+  sx126x_set_lora_pkt_params(&radio_context, &packet_params);
+
+  // Setup the DIO1 pin to trigger for all interrupts.
+  sx126x_set_dio_irq_params(&radio_context, 0xFFFF, 0xFFFF, 0x0000, 0x0000);
+
+  debug("sx126x setup done\n");
+}
+
+// Transmit bytes over the radio.
+void transmit_bytes(uint8_t *bytes, uint8_t length) {
+  if (length > 255) {
+    error("payload too large\n");
+    return;
+  }
+
+  // Set the radio to standby mode, in case we are in receive.
+  sx126x_set_standby(&radio_context, SX126X_STANDBY_CFG_RC);
+
+  // Write the payload to the radio's buffer.
+  sx126x_write_buffer(&radio_context, 0, bytes, length);
+
+  // Setup the packet parameters for the transmission. Only length is needed to be updated.
+  sx126x_pkt_params_lora_t packet_params = {
+      .preamble_len_in_symb = 0x10,
+      .header_type = SX126X_LORA_PKT_EXPLICIT,
+      .pld_len_in_bytes = length,
+      .crc_is_on = true,
+      .invert_iq_is_on = false,
+  };
+  sx126x_set_lora_pkt_params(&radio_context, &packet_params);
+
+  debug("tx: %d bytes\n", length);
+
+  last_tx_start = platform_now();
+
+  // Start the transmission.
+  sx126x_set_tx(&radio_context, 0x0);
+
+  sx126x_chip_status_t status = {.chip_mode = 0, .cmd_status = 0};
+  sx126x_get_status(&radio_context, &status);
+  if (status.chip_mode != SX126X_CHIP_MODE_TX && status.cmd_status != SX126X_CMD_STATUS_RFU) {
+    error("tx status error (mode: %d | cmd: %d)\n", status.chip_mode, status.cmd_status);
+  }
+}
+
+// Transmit a string over the radio. Must be null terminated.
+void transmit_string(char *string) { transmit_bytes((uint8_t *)string, strlen(string)); }
+
+// Send a packet, once its backoff is over.
+void transmit_packet(message_history_t *packet) {
+  // This is the time spent in the tx_queue for this packet, backoff included.
+  // This is not the absolute tx delta, since `transmit_bytes` function also takes time configuring
+  // the transceiver. That part gets accounted for on the receiver side.
+  int64_t tx_delta = platform_diff_us(packet->time, platform_now());
+  debug("tx queue delta %" PRId64 " us\n", tx_delta);
+
+  if (packet->message.mtype == MTYPE_PING) {
+    // For pings, set the current time as the time field.
+    packet->message.time = platform_now();
+  } else if (packet->message.mtype == MTYPE_PONG) {
+    // For pongs, add time spent in tx_queue.
+    // This moves the reference to the future, making the difference smaller.
+    packet->message.time = packet->message.time + tx_delta;
+  }
+
+  debug_bytes("->", packet, sizeof(message_t));
+
+  debug("message sent from %s", uid_to_string(packet->message.src));
+  debug(" to %s\n", uid_to_string(packet->message.dst));
+
+  stat_inc(STAT_TX_FRAMES);
+  capture_frame(CAPTURE_TX, platform_now(), (uint8_t *)packet, sizeof(message_t), 0, 0, 0);
+  transmit_bytes((uint8_t *)packet, sizeof(message_t));
+}
+
+void receive_once() {
+  sx126x_pkt_params_lora_t packet_params = {
+      .preamble_len_in_symb = 0x10,
+      .header_type = SX126X_LORA_PKT_EXPLICIT,
+      .pld_len_in_bytes = 0x20,
+      .crc_is_on = true,
+      .invert_iq_is_on = false,
+  };
+  sx126x_set_lora_pkt_params(&radio_context, &packet_params);
+  sx126x_set_rx(&radio_context, 0);
+}
+
+void receive_cont() {
+  sx126x_pkt_params_lora_t packet_params = {
+      .preamble_len_in_symb = 0x10,
+      .header_type = SX126X_LORA_PKT_EXPLICIT,
+      .pld_len_in_bytes = 0x20,
+      .crc_is_on = true,
+      .invert_iq_is_on = false,
+  };
+  sx126x_set_lora_pkt_params(&radio_context, &packet_params);
+  sx126x_set_rx_with_timeout_in_rtc_step(&radio_context, SX126X_RX_CONTINUOUS);
+}
+
+// Start the protocol, before the first pass of the radio loop.
+void radio_start() { try_transmit(new_hello_message()); }
+
+// One pass of the radio loop, for the events posted since the last one.
+// Returns the time of the next timed work, nothing but an event needs the loop before then.
+absolute_time_t radio_step(uint32_t events) {
+  packet_t packet;
+  core_msg_t msg;
+
+  // Process one previously received message.
+  if (!STOP_PROCESSING && spsc_ring_pop(&rx_queue, &packet)) {
+    message_history_t *message = packet_get(packet);
+    debug("rx dequeue %d\n", message->message.id);
+
+    uint32_t latency = platform_diff_us(message->time, platform_now());
+    event_stats.rx_latency_us_last = latency;
+    histogram_add(HIST_RX_QUEUE, latency);
+    if (latency > event_stats.rx_latency_us_max) {
+      event_stats.rx_latency_us_max = latency;
+    }
+
+    // Update the message history with the received message.
+    // If the message is already received, ignore it.
+    if (!check_message_history(packet)) {
+      handle_message(message);
+
+      if (message->message.flags.ack_req) {
+        log_debug(LOG_ACK, "sending ack\n");
+        stat_inc(STAT_ACKS_SENT);
+        try_transmit(new_ack_message(message->message.src, message->message.id));
+      }
+    }
+    packet_unref(packet);
+  }
+
+  // Take the next message to send, unless one is already on the air or backing off.
+  if (tx_pending == PACKET_NONE && state != STATE_TX && mpsc_ring_pop(&tx_queue, &packet)) {
+    message_history_t *message = packet_get(packet);
+    debug("tx dequeue %d\n", message->message.id);
+    histogram_add(HIST_TX_QUEUE, platform_diff_us(message->time, platform_now()));
+
+    // Forwarded packets carry the time they were received, this is how long it took the radio
+    // loop to get to them. The backoff comes on top.
+    if (!is_my_uid(message->message.src)) {
+      uint32_t latency = platform_diff_us(message->time, platform_now());
+      event_stats.forwards++;
+      event_stats.forward_us_last = latency;
+      if (latency > event_stats.forward_us_max) {
+        event_stats.forward_us_max = latency;
+      }
+    }
+
+    if (message->message.flags.ack_req) {
+      // Add the message to the ack list to keep track of it.
+      ack_deadline = platform_earliest(ack_deadline, add_ack(packet));
+    }
+
+    // Wait for a random amount of time. The radio keeps receiving and the loop keeps running
+    // meanwhile, the deadline brings it back.
+    uint32_t backoff = get_backoff_ms();
+    debug("backing off for %d ms\n", backoff);
+    histogram_add(HIST_BACKOFF, backoff * 1000);
+    tx_pending = packet;
+    tx_due = platform_timeout_ms(backoff);
+  }
+
+  // Send the waiting message once its backoff is over.
+  if (tx_pending != PACKET_NONE && platform_reached(tx_due)) {
+    // Set TX state before calling transmit in case IRQ triggers before we finish.
+    // Otherwise, IRQ can overtake the control flow and set the state to TX_DONE,
+    // which we would overwrite back to TX.
+    state = STATE_TX;
+    debug("STATE = TX\n");
+    transmit_packet(packet_get(tx_pending));
+    packet_unref(tx_pending);
+    tx_pending = PACKET_NONE;
+    tx_due = PLATFORM_END_OF_TIME;
+  }
+
+  // If we are not actively transmitting, receive instead.
+  if (state == STATE_IDLE || state == STATE_TX_DONE) {
+    state = STATE_RX;
+    debug("STATE = RX\n");
+    receive_cont();
+  }
+
+  // Carry out what the UI core asked for, the radio is only accessed from here.
+  while (receive_on_radio(&msg)) {
+    if (msg.type == CORE_CMD_TRANSMIT) {
+      try_transmit(msg.transmit);
+    } else if (msg.type == CORE_CMD_RANGE) {
+      set_range(msg.range);
+    } else if (msg.type == CORE_CMD_PRINT) {
+      // Their packets are freed by this core, the console can't follow their handles from the
+      // other one.
+      if (msg.print == PRINT_MESSAGES) {
+        print_message_history();
+      } else if (msg.print == PRINT_NEIGHBOURS) {
+        print_neighbours();
+      } else if (msg.print == PRINT_ACKS) {
+        print_acks();
+      }
+    }
+  }
+
+  // Check the ack list for timeouts.
+  if (platform_reached(ack_deadline)) {
+    ack_deadline = check_ack_list();
+  }
+
+  // Write the read flags of the inbox.
+  if (events & EVENT_INBOX || platform_reached(inbox_deadline)) {
+    inbox_deadline = inbox_sync();
+  }
+
+  // Only one received message is handled per pass, come back for the rest without sleeping.
+  if (!STOP_PROCESSING && spsc_ring_level(&rx_queue) > 0) {
+    post_event(EVENT_RX);
+  }
+
+  return platform_earliest(platform_earliest(ack_deadline, inbox_deadline), tx_due);
+}
@@ -0,0 +1,44 @@
+#ifndef _RADIO_H
+#define _RADIO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+#include "sx126x_hal_context.h"
+
+#include "network.h"
+#include "platform.h"
+#include "utils.h"
+
+extern absolute_time_t last_tx_start;
+extern absolute_time_t last_tx_delta;
+
+extern bool STOP_PROCESSING;
+
+// Pins and SPI port of the radio, filled in by `setup_io`.
+extern sx126x_hal_context_t radio_context;
+
+void setup_sx126x();
+
+void set_range(mod_params_t param);
+mod_params_t get_range();
+uint32_t get_time_on_air_in_ms();
+uint32_t get_backoff_ms();
+
+void handle_tx_callback();
+void handle_rx_callback();
+void handle_dio1_callback(uint gpio, uint32_t events);
+
+void transmit_bytes(uint8_t *bytes, uint8_t length);
+void transmit_string(char *string);
+void transmit_packet(message_history_t *packet);
+
+void receive_once();
+void receive_cont();
+
+void radio_start();
+absolute_time_t radio_step(uint32_t events);
+
+#endif // _RADIO_H
@@ -0,0 +1,179 @@
+/**
+ * Lock-free rings
+ *
+ * Fixed size rings of fixed size slots, used in place: producers fill a reserved slot and commit
+ * it, the consumer uses the oldest slot where it is and releases it. Nothing is copied unless the
+ * push and pop helpers are used, and no lock is taken, so they can be used from interrupts and
+ * across cores.
+ *
+ * Indices run freely and wrap around at 2^32, the slot is the index masked by the ring size.
+ * Each index is a single word written by one side only, which is all the layout needs: the SRAM
+ * has no data cache, there are no cache lines to keep the two sides apart.
+ *
+ * The single producer ring only needs ordered loads and stores. The multiple producer ring also
+ * needs a compare and swap, RP2040 has no exclusive access instructions and the SDK implements it
+ * with a hardware spin lock, taken only for the swap itself.
+ */
+
+#include <string.h>
+
+#include "ring.h"
+
+void spsc_ring_init(spsc_ring_t *ring, void *slots, uint32_t slot_size, uint32_t count) {
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  ring->slots = slots;
+  ring->slot_size = slot_size;
+  ring->mask = count - 1;
+}
+
+// Get the next free slot to fill, or NULL if the ring is full.
+// The slot is only handed to the consumer once it is committed, until then it can be abandoned.
+void *spsc_ring_reserve(spsc_ring_t *ring) {
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  if (head - tail > ring->mask) {
+    return NULL;
+  }
+  return ring->slots + (head & ring->mask) * ring->slot_size;
+}
+
+// Hand the reserved slot to the consumer.
+void spsc_ring_commit(spsc_ring_t *ring) {
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+// Get the oldest committed slot, or NULL if the ring is empty.
+void *spsc_ring_peek(spsc_ring_t *ring) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  if (head == tail) {
+    return NULL;
+  }
+  return ring->slots + (tail & ring->mask) * ring->slot_size;
+}
+
+// Hand the oldest slot back to the producer, once it is no longer used.
+void spsc_ring_release(spsc_ring_t *ring) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+uint32_t spsc_ring_level(spsc_ring_t *ring) {
+  return atomic_load_explicit(&ring->head, memory_order_acquire) -
+         atomic_load_explicit(&ring->tail, memory_order_acquire);
+}
+
+// Copy an item into the ring, returns false if it is full.
+bool spsc_ring_push(spsc_ring_t *ring, const void *item) {
+  void *slot = spsc_ring_reserve(ring);
+  if (slot == NULL) {
+    return false;
+  }
+  memcpy(slot, item, ring->slot_size);
+  spsc_ring_commit(ring);
+  return true;
+}
+
+// Copy the oldest item out of the ring, returns false if it is empty.
+bool spsc_ring_pop(spsc_ring_t *ring, void *item) {
+  void *slot = spsc_ring_peek(ring);
+  if (slot == NULL) {
+    return false;
+  }
+  memcpy(item, slot, ring->slot_size);
+  spsc_ring_release(ring);
+  return true;
+}
+
+void mpsc_ring_init(mpsc_ring_t *ring, void *slots, atomic_uint_least32_t *seqs,
+                    uint32_t slot_size, uint32_t count) {
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  for (uint32_t i = 0; i < count; i++) {
+    atomic_init(&seqs[i], i);
+  }
+  ring->seqs = seqs;
+  ring->slots = slots;
+  ring->slot_size = slot_size;
+  ring->mask = count - 1;
+}
+
+// Claim the next free slot to fill, or NULL if the ring is full.
+// Every claimed slot has to be committed, the consumer waits for it.
+void *mpsc_ring_reserve(mpsc_ring_t *ring) {
+  uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  while (true) {
+    uint32_t index = head & ring->mask;
+    uint32_t seq = atomic_load_explicit(&ring->seqs[index], memory_order_acquire);
+    int32_t diff = (int32_t)(seq - head);
+    if (diff < 0) {
+      // Still held by the consumer from the previous lap.
+      return NULL;
+    }
+    if (diff > 0) {
+      // Another producer got it first.
+      head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+      continue;
+    }
+    if (atomic_compare_exchange_weak_explicit(&ring->head, &head, head + 1, memory_order_relaxed,
+                                              memory_order_relaxed)) {
+      return ring->slots + index * ring->slot_size;
+    }
+  }
+}
+
+// Hand a filled slot to the consumer.
+// Its sequence number is only written by its producer until then, one more marks it committed.
+void mpsc_ring_commit(mpsc_ring_t *ring, void *slot) {
+  uint32_t index = ((uint8_t *)slot - ring->slots) / ring->slot_size;
+  uint32_t seq = atomic_load_explicit(&ring->seqs[index], memory_order_relaxed);
+  atomic_store_explicit(&ring->seqs[index], seq + 1, memory_order_release);
+}
+
+// Get the oldest slot, or NULL if the ring is empty or the oldest slot isn't committed yet.
+void *mpsc_ring_peek(mpsc_ring_t *ring) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  uint32_t index = tail & ring->mask;
+  if (atomic_load_explicit(&ring->seqs[index], memory_order_acquire) != tail + 1) {
+    return NULL;
+  }
+  return ring->slots + index * ring->slot_size;
+}
+
+// Hand the oldest slot back to the producers, for the next lap.
+void mpsc_ring_release(mpsc_ring_t *ring) {
+  uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  atomic_store_explicit(&ring->seqs[tail & ring->mask], tail + ring->mask + 1,
+                        memory_order_release);
+  atomic_store_explicit(&ring->tail, tail + 1, memory_order_relaxed);
+}
+
+// Number of claimed slots, committed or not.
+uint32_t mpsc_ring_level(mpsc_ring_t *ring) {
+  return atomic_load_explicit(&ring->head, memory_order_relaxed) -
+         atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+// Copy an item into the ring, returns false if it is full.
+bool mpsc_ring_push(mpsc_ring_t *ring, const void *item) {
+  void *slot = mpsc_ring_reserve(ring);
+  if (slot == NULL) {
+    return false;
+  }
+  memcpy(slot, item, ring->slot_size);
+  mpsc_ring_commit(ring, slot);
+  return true;
+}
+
+// Copy the oldest committed item out of the ring, returns false if there is none.
+bool mpsc_ring_pop(mpsc_ring_t *ring, void *item) {
+  void *slot = mpsc_ring_peek(ring);
+  if (slot == NULL) {
+    return false;
+  }
+  memcpy(item, slot, ring->slot_size);
+  mpsc_ring_release(ring);
+  return true;
+}
@@ -0,0 +1,72 @@
+#ifndef _RING_H
+#define _RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Single producer / single consumer ring.
+// The producer reserves a slot, fills it in place and commits it. The consumer peeks at the oldest
+// slot, uses it in place and releases it.
+typedef struct {
+  // Index of the next slot to fill, only written by the producer.
+  atomic_uint_least32_t head;
+  // Index of the next slot to use, only written by the consumer.
+  atomic_uint_least32_t tail;
+  uint8_t *slots;
+  uint32_t slot_size;
+  // Number of slots minus one, the number of slots is a power of two.
+  uint32_t mask;
+} spsc_ring_t;
+
+// Multiple producer / single consumer ring.
+// Producers claim slots with a compare and swap on the head, and every slot has a sequence number
+// telling the consumer when it was committed, so producers can commit in any order.
+typedef struct {
+  atomic_uint_least32_t head;
+  atomic_uint_least32_t tail;
+  // Sequence number of every slot: its index when free, one more once committed.
+  atomic_uint_least32_t *seqs;
+  uint8_t *slots;
+  uint32_t slot_size;
+  uint32_t mask;
+} mpsc_ring_t;
+
+// Storage for a ring of `SIZE` slots of `TYPE`, `SIZE` must be a power of two.
+#define SPSC_RING_STORAGE(NAME, TYPE, SIZE) static TYPE NAME[SIZE]
+#define MPSC_RING_STORAGE(NAME, TYPE, SIZE)                                                        \
+  static TYPE NAME[SIZE];                                                                          \
+  static atomic_uint_least32_t NAME##_seqs[SIZE]
+
+// Static initializer of a single producer ring over its storage.
+#define SPSC_RING(NAME)                                                                            \
+  {                                                                                                \
+      .slots = (uint8_t *)NAME,                                                                    \
+      .slot_size = sizeof(NAME[0]),                                                                \
+      .mask = sizeof(NAME) / sizeof(NAME[0]) - 1,                                                  \
+  }
+
+void spsc_ring_init(spsc_ring_t *ring, void *slots, uint32_t slot_size, uint32_t count);
+void *spsc_ring_reserve(spsc_ring_t *ring);
+void spsc_ring_commit(spsc_ring_t *ring);
+void *spsc_ring_peek(spsc_ring_t *ring);
+void spsc_ring_release(spsc_ring_t *ring);
+uint32_t spsc_ring_level(spsc_ring_t *ring);
+bool spsc_ring_push(spsc_ring_t *ring, const void *item);
+bool spsc_ring_pop(spsc_ring_t *ring, void *item);
+
+// The sequence numbers of a multiple producer ring have to be set up at run time.
+#define MPSC_RING_INIT(RING, NAME)                                                                 \
+  mpsc_ring_init(RING, NAME, NAME##_seqs, sizeof(NAME[0]), sizeof(NAME) / sizeof(NAME[0]))
+
+void mpsc_ring_init(mpsc_ring_t *ring, void *slots, atomic_uint_least32_t *seqs,
+                    uint32_t slot_size, uint32_t count);
+void *mpsc_ring_reserve(mpsc_ring_t *ring);
+void mpsc_ring_commit(mpsc_ring_t *ring, void *slot);
+void *mpsc_ring_peek(mpsc_ring_t *ring);
+void mpsc_ring_release(mpsc_ring_t *ring);
+uint32_t mpsc_ring_level(mpsc_ring_t *ring);
+bool mpsc_ring_push(mpsc_ring_t *ring, const void *item);
+bool mpsc_ring_pop(mpsc_ring_t *ring, void *item);
+
+#endif // _RING_H
@@ -1,3 +1,6 @@
+#define LOG_CATEGORY LOG_UI
+
+#include "hardware/sync.h"
 #include "hardware/timer.h"
 #include "pico/multicore.h"
 #include "pico/time.h"
@@ -6,7 +9,11 @@
 #include "GUI_Paint.h"
 #include "pico_config.h"
 
+#include "channel.h"
+#include "inbox.h"
+#include "io.h"
 #include "network.h"
+#include "panel.h"
 #include "screen.h"
 #include "utils.h"
 #include "voidlink.h"
@@ -16,9 +23,6 @@ alarm_id_t alarm_id;
 screen_t screen = SCREEN_IDLE;
 display_t display = DISPLAY_HOME;
 
-uint8_t image[IMAGE_SIZE];
-uint8_t wakeup[IMAGE_SIZE];
-
 uint8_t message_Cursor = 0;
 uint8_t send_to_Cursor = 0;
 uint8_t neighbour_Cursor = 0;
@@ -32,10 +36,9 @@ uint8_t set_Info_Cursor = 0;
 uint8_t msg_Action_Cursor = 0;
 uint8_t temp_Cursor = 0;
 uint8_t received_Cursor = 0;
-uint8_t received_Page = 1;
+uint16_t received_Page = 1;
 uint8_t msg_received_Page = 1;
 uint8_t neighbour_received_Page = 1;
-uint8_t refresh_Counter = 0;
 uint32_t display_Timeout = 10000;
 volatile bool five_Seconds = true;
 uint8_t msg_Type = 0;
@@ -44,12 +47,15 @@ uint8_t msg_Type = 0;
 // add strings to send_Message
 char send_Message[MAX_MSG_SEND][255 + 4] = {"Ok", "No", "Over", "Out", "Go Ahead", "Stand By", "Come In", "Copy", "Repeat", "Break Break", "SOS", "Good Reception", "Bad Reception", "Stay Put", "Move"};
 char test[7];
-int new_Messages[16];
 
 uint32_t msg_Number = 0;
-uint32_t new_Msg = 0;
 
-//extern neighbour_table_t neighbour_table;
+// Copy of the neighbour table the UI works from, taken when the radio core reports a change.
+// The screens and the cursors stay consistent between two copies.
+neighbour_table_t ui_neighbours = {0};
+
+// Time the oldest message not shown on the screen yet was received, 0 if there is none.
+static absolute_time_t notify_time = 0;
 
 void setup_display() {
   DEV_Module_Init();
@@ -62,601 +68,585 @@ void setup_display() {
 
 void wakeup_Screen() {
   // Create a new display buffer
-  Paint_NewImage(wakeup, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
+  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
   // Paint the whole frame white
   Paint_Clear(WHITE);
 
   // Draw message selection screen
   Paint_DrawString(50, 50, "VoidLink", &Font24, BLACK, WHITE);
-  EPD_2in13_V4_Init_Fast();
-  EPD_2in13_V4_Display_Fast(wakeup);
-  busy_wait_ms(200);
+  invalidate_widgets();
+  present_frame();
+  start_refresh(REFRESH_FAST);
+  wait_for_refresh();
 }
+
 // Provide user feedback that their message is being sent
 void send_Animation() {
+  static const char *frames[] = {"Transmitting", "Transmitting .", "Transmitting ..",
+                                 "Transmitting ..."};
+
   cancel_alarm(alarm_id);
   // Reset flag and start a new alarm
   five_Seconds = false;
   // Create a new display buffer
   Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
+  invalidate_widgets();
 
-  // Draw message selection screen
-  Paint_DrawString(20, 50, "Transmitting", &Font20, BLACK, WHITE);
-  EPD_2in13_V4_Display_Partial(image);
-  Paint_Clear(WHITE);
-  busy_wait_ms(200);
-  Paint_DrawString(20, 50, "Transmitting .", &Font20, BLACK, WHITE);
-  EPD_2in13_V4_Display_Partial(image);
-  Paint_Clear(WHITE);
-  busy_wait_ms(200);
-  Paint_DrawString(20, 50, "Transmitting ..", &Font20, BLACK, WHITE);
-  EPD_2in13_V4_Display_Partial(image);
-  Paint_Clear(WHITE);
-  busy_wait_ms(200);
-  Paint_DrawString(20, 50, "Transmitting ...", &Font20, BLACK, WHITE);
-  EPD_2in13_V4_Display_Partial(image);
+  // Each frame is drawn while the previous one is still being refreshed on the panel.
+  for (int i = 0; i < sizeof(frames) / sizeof(frames[0]); i++) {
+    Paint_Clear(WHITE);
+    Paint_DrawString(20, 50, frames[i], &Font20, BLACK, WHITE);
+    present_frame();
+    start_refresh(REFRESH_PARTIAL);
+  }
   Paint_Clear(WHITE);
-  busy_wait_ms(200);
   Paint_DrawString(90, 50, "Sent!", &Font24, BLACK, WHITE);
-  EPD_2in13_V4_Display_Base(image);
-  busy_wait_ms(200);
+  present_frame();
+  start_refresh(choose_refresh());
   alarm_id = add_alarm_in_ms(display_Timeout, alarm_callback, NULL, false);
 }
 
-// Who will you send to?
-void send_To_Screen(){
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
+// Time since `time`, in seconds for the first minute and in minutes after that.
+static int time_ago(absolute_time_t time, char *unit) {
+  int seconds = absolute_time_diff_us(time, get_absolute_time()) / 1000 / 1000;
+  if (seconds > 60) {
+    *unit = 'm';
+    return seconds / 60;
+  }
+  *unit = 's';
+  return seconds;
+}
 
-  // Draw message selection screen
-  if (msg_Type == 0){ //msg_Type = 0 is text message
-    Paint_DrawString(45, 35, "Who to send to?", &Font16, BLACK, WHITE);
-    Paint_DrawString(0, 5, "Sending Message:", &Font12, BLACK, WHITE);
-    Paint_DrawString(115, 5, send_Message[message_Cursor + ((msg_received_Page - 1) * 3)], &Font16,
-                         BLACK, WHITE);
-  } else if (msg_Type == 1){ //msg_Type = 1 is request message
-    Paint_DrawString(15, 35, "Who to request from?", &Font16, BLACK, WHITE);
-    Paint_DrawString(0, 5, "Requesting Info:", &Font12, BLACK, WHITE);
-    if (neighbour_Request_Cursor == 0) {
-      Paint_DrawString(120, 5, "Version", &Font16,
-                         BLACK, WHITE);
-    } else if (neighbour_Request_Cursor == 1) {
-      Paint_DrawString(120, 5, "Uptime", &Font16,
-                         BLACK, WHITE);
-    }
-  } else if (msg_Type == 2){ //msg_Type = 2 is ping message
-    Paint_DrawString(40, 35, "Who do you want to ping?", &Font12, BLACK, WHITE);
-    Paint_DrawString(60, 5, "Sending ping.", &Font16, BLACK, WHITE);
+// Age of an inbox message, the time of the messages from before the last boot isn't known.
+static void show_ago(widget_t *label, inbox_entry_t *entry) {
+  if (!entry->this_boot) {
+    label->state.text = "earlier";
+    return;
   }
-  if (neighbour_table.count>0){
-    Paint_DrawString(190, 70, ">", &Font16, BLACK, WHITE);
-    Paint_DrawString(20, 70, "<", &Font16, BLACK, WHITE);
+  char unit;
+  int ago = time_ago(entry->time, &unit);
+  widget_printf(label, "%d%c ago", ago, unit);
+}
+
+// Three actions in a row, the one under the cursor is inverted.
+static void bind_actions(widget_t *actions, uint8_t cursor) {
+  for (int i = 0; i < 3; i++) {
+    actions[i].state.visible = cursor < 3;
+    actions[i].state.selected = cursor == i;
   }
-  char *src;
+}
+
+// Who will you send to?
+enum {
+  SEND_TO_TEXT_TITLE,
+  SEND_TO_TEXT_SUBTITLE,
+  SEND_TO_TEXT,
+  SEND_TO_REQUEST_TITLE,
+  SEND_TO_REQUEST_SUBTITLE,
+  SEND_TO_REQUEST,
+  SEND_TO_PING_TITLE,
+  SEND_TO_PING_SUBTITLE,
+  SEND_TO_NEXT,
+  SEND_TO_PREV,
+  SEND_TO_TARGET,
+  SEND_TO_HINT,
+};
+
+static widget_t send_to_widgets[] = {
+    [SEND_TO_TEXT_TITLE] = LABEL(45, 35, &Font16, "Who to send to?"),
+    [SEND_TO_TEXT_SUBTITLE] = LABEL(0, 5, &Font12, "Sending Message:"),
+    [SEND_TO_TEXT] = LABEL(115, 5, &Font16, NULL),
+    [SEND_TO_REQUEST_TITLE] = LABEL(15, 35, &Font16, "Who to request from?"),
+    [SEND_TO_REQUEST_SUBTITLE] = LABEL(0, 5, &Font12, "Requesting Info:"),
+    [SEND_TO_REQUEST] = LABEL(120, 5, &Font16, NULL),
+    [SEND_TO_PING_TITLE] = LABEL(40, 35, &Font12, "Who do you want to ping?"),
+    [SEND_TO_PING_SUBTITLE] = LABEL(60, 5, &Font16, "Sending ping."),
+    [SEND_TO_NEXT] = LABEL(190, 70, &Font16, ">"),
+    [SEND_TO_PREV] = LABEL(20, 70, &Font16, "<"),
+    [SEND_TO_TARGET] = LABEL_BUF(45, 70, &Font16, 20),
+    [SEND_TO_HINT] = LABEL(10, 105, &Font12, "Press the OK button to transmit."),
+};
+
+static void send_To_Screen(widget_t *w) {
+  // msg_Type = 0 is text message, 1 is request message, 2 is ping message
+  w[SEND_TO_TEXT_TITLE].state.visible = msg_Type == 0;
+  w[SEND_TO_TEXT_SUBTITLE].state.visible = msg_Type == 0;
+  w[SEND_TO_TEXT].state.visible = msg_Type == 0;
+  w[SEND_TO_TEXT].state.text = send_Message[message_Cursor + ((msg_received_Page - 1) * 3)];
+
+  w[SEND_TO_REQUEST_TITLE].state.visible = msg_Type == 1;
+  w[SEND_TO_REQUEST_SUBTITLE].state.visible = msg_Type == 1;
+  w[SEND_TO_REQUEST].state.visible = msg_Type == 1 && neighbour_Request_Cursor < 2;
+  w[SEND_TO_REQUEST].state.text = neighbour_Request_Cursor == 0 ? "Version" : "Uptime";
+
+  w[SEND_TO_PING_TITLE].state.visible = msg_Type == 2;
+  w[SEND_TO_PING_SUBTITLE].state.visible = msg_Type == 2;
+
+  w[SEND_TO_NEXT].state.visible = ui_neighbours.count > 0;
+  w[SEND_TO_PREV].state.visible = ui_neighbours.count > 0;
 
   if (send_to_Cursor == 0) {
-    Paint_DrawString(45, 70, "Broadcast to all", &Font16, WHITE, BLACK);
+    widget_printf(&w[SEND_TO_TARGET], "Broadcast to all");
+    w[SEND_TO_TARGET].state.selected = true;
   } else {
-    neighbour_t *neighbour_Node = &neighbour_table.neighbours[send_to_Cursor - 1];
-    src = uid_to_string(neighbour_Node->uid);
-    Paint_DrawString(45, 70, src, &Font16, BLACK, WHITE);
+    neighbour_t *neighbour_Node = &ui_neighbours.neighbours[send_to_Cursor - 1];
+    widget_printf(&w[SEND_TO_TARGET], "%s", uid_to_string(neighbour_Node->uid));
   }
-  Paint_DrawString(10, 105, "Press the OK button to transmit.", &Font12, BLACK, WHITE);
 }
 
-void msg_Screen() {
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-  Paint_DrawString(0, 0, "Select a Text Message:", &Font16, BLACK, WHITE);
-
-  // Draw message selection screen
+enum {
+  MSG_TITLE,
+  MSG_ROW,
+  MSG_CURSOR = MSG_ROW + 3,
+  MSG_UP,
+  MSG_DOWN,
+};
+
+static widget_t msg_widgets[] = {
+    [MSG_TITLE] = LABEL(0, 0, &Font16, "Select a Text Message:"),
+    [MSG_ROW + 0] = LABEL(40, 34, &Font16, NULL),
+    [MSG_ROW + 1] = LABEL(40, 58, &Font16, NULL),
+    [MSG_ROW + 2] = LABEL(40, 82, &Font16, NULL),
+    [MSG_CURSOR] = LABEL(5, 34, &Font16, ">"),
+    [MSG_UP] = LABEL(130, 25, &Font16, "^"),
+    [MSG_DOWN] = LABEL(130, 105, &Font16, "v"),
+};
+
+static void msg_Screen(widget_t *w) {
   for (int i = 0; i < 3; i++) {
-    // Display messages, sender and time received
-    if (i + ((msg_received_Page - 1) * 3) < MAX_MSG_SEND) {
-      Paint_DrawString(40, 34 + i * 24, send_Message[i + ((msg_received_Page - 1) * 3)], &Font16,
-                       BLACK, WHITE);
-    }
-    // Clear rest of screen if there aren't enough messages to fill it
-    else {
-      printf("Clearing Message\n");
-      Paint_DrawRectangle(0, 34 + i * 24, 170, 47 + i * 24, WHITE, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    }
-    for (int i = 0; i < 3; i++) {
-      Paint_ClearWindows(5, 34 + i * 24, 20, 58 + i * 24, WHITE);
-    }
-    Paint_DrawString(5, 34 + message_Cursor * 24, ">", &Font16, BLACK, WHITE);
+    int index = i + ((msg_received_Page - 1) * 3);
+    w[MSG_ROW + i].state.visible = index < MAX_MSG_SEND;
+    w[MSG_ROW + i].state.text = index < MAX_MSG_SEND ? send_Message[index] : NULL;
   }
+  w[MSG_CURSOR].state.y = 34 + message_Cursor * 24;
+
   // Display page indicators
-  if (msg_received_Page > 1) {
-    Paint_DrawString(130, 25, "^", &Font16, BLACK, WHITE);
-  }
-  if (msg_received_Page < ((float)MAX_MSG_SEND / 3)) {
-    Paint_DrawString(130, 105, "v", &Font16, BLACK, WHITE);
-  }
+  w[MSG_UP].state.visible = msg_received_Page > 1;
+  w[MSG_DOWN].state.visible = msg_received_Page < ((float)MAX_MSG_SEND / 3);
 }
 
-void received_msg_Details() {
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-  // Draw message selection screen
-  Paint_DrawString(0, 0, "Message Details:", &Font16, BLACK, WHITE);
-  message_t *msg = &message_history[received_Cursor + ((received_Page - 1) * 3)].message;
-  char *src = uid_to_string(msg->src);
-  printf("- [%d]: %s %s %d\r\n", received_Cursor + ((received_Page - 1) * 3), src, MTYPE_STR[msg->mtype], msg->id);
-
-  //Paint_DrawString(0, 25, saved_Messages[received_Cursor + ((received_Page - 1) * 3)], &Font16,
-                   //BLACK, WHITE); // OLD STATIC TEST
-  char data[255];
-  sprintf(data, "Data: %s", TEXT_MESSAGE_STR[msg->data[0]]);
-  Paint_DrawString(0, 25, data, &Font16,BLACK, WHITE);
-
-  char from[20];
-  sprintf(from, "From: %s",src); //Get node ID from network code
-  Paint_DrawString(0, 75, from, &Font12, BLACK, WHITE);
-  //Paint_DrawString(0, 75, "From: 11.22.33", &Font12, BLACK, WHITE); // OLD STATIC TEST
-
-  char type[20];
-  sprintf(type, "Msg Type: %s",MTYPE_STR[msg->mtype]); //Get node ID from network code
-  Paint_DrawString(0, 55, type, &Font12, BLACK, WHITE);
-  char buff[64];
-  int time = absolute_time_diff_us(message_history[received_Cursor + ((received_Page - 1) * 3)].time,get_absolute_time())/1000/1000;
-  if (time > 60) {
-    time = time / 60;
-    sprintf(buff, "%dm ago",time);
-  } else if (time > 60 * 60) {
-    time = (float)time / 60 / 60;
-    sprintf(buff, "%dh ago",time);
-  }else {
-    sprintf(buff, "%ds ago",time);
-  }
-  //sprintf(buff, "%ds ago",time); //Get time_Stamp from network code
-  Paint_DrawString(170, 75, buff, &Font12, BLACK, WHITE); // replace with new_String
-
-  if (msg_Action_Cursor == 0) {
-    Paint_DrawString(15, 100, "Text Reply", &Font16, WHITE, BLACK);
-    Paint_DrawString(130, 100, "Neighbours", &Font16, BLACK, WHITE);
-  } else if (msg_Action_Cursor == 1) {
-    Paint_DrawString(15, 100, "Text Reply", &Font16, BLACK, WHITE);
-    Paint_DrawString(130, 100, "Neighbours", &Font16, WHITE, BLACK);
-  }
+enum {
+  DETAILS_TITLE,
+  DETAILS_DATA,
+  DETAILS_FROM,
+  DETAILS_TYPE,
+  DETAILS_AGO,
+  DETAILS_REPLY,
+  DETAILS_NEIGHBOURS,
+};
+
+static widget_t details_widgets[] = {
+    [DETAILS_TITLE] = LABEL(0, 0, &Font16, "Message Details:"),
+    [DETAILS_DATA] = LABEL_BUF(0, 25, &Font16, 32),
+    [DETAILS_FROM] = LABEL_BUF(0, 75, &Font12, 20),
+    [DETAILS_TYPE] = LABEL_BUF(0, 55, &Font12, 20),
+    [DETAILS_AGO] = LABEL_BUF(170, 75, &Font12, 16),
+    [DETAILS_REPLY] = LABEL(15, 100, &Font16, "Text Reply"),
+    [DETAILS_NEIGHBOURS] = LABEL(130, 100, &Font16, "Neighbours"),
+};
+
+static void received_msg_Details(widget_t *w) {
+  inbox_entry_t entry = {0};
+  inbox_get(received_Cursor + ((received_Page - 1) * 3), &entry);
+  message_t *msg = &entry.message;
+
+  widget_printf(&w[DETAILS_DATA], "Data: %s", TEXT_MESSAGE_STR[msg->data[0]]);
+  widget_printf(&w[DETAILS_FROM], "From: %s", uid_to_string(msg->src));
+  widget_printf(&w[DETAILS_TYPE], "Msg Type: %s", MTYPE_STR[msg->mtype]);
+
+  show_ago(&w[DETAILS_AGO], &entry);
+
+  w[DETAILS_REPLY].state.visible = msg_Action_Cursor < 2;
+  w[DETAILS_REPLY].state.selected = msg_Action_Cursor == 0;
+  w[DETAILS_NEIGHBOURS].state.visible = msg_Action_Cursor < 2;
+  w[DETAILS_NEIGHBOURS].state.selected = msg_Action_Cursor == 1;
 }
 
-void received_Msgs() {
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-
-  // Paint_DrawString(0, 34, ">", &Font16, BLACK, WHITE);
-
-  // Draw message selection screen
-  Paint_DrawString(0, 10, "Received Messages:", &Font16, BLACK, WHITE);
-  printf("msg number: %d\n", message_history_count);
+enum {
+  RXMSG_TITLE,
+  RXMSG_TYPE,
+  RXMSG_FROM = RXMSG_TYPE + 3,
+  RXMSG_AGO = RXMSG_FROM + 3,
+  RXMSG_NEW = RXMSG_AGO + 3,
+  RXMSG_CURSOR = RXMSG_NEW + 3,
+  RXMSG_EMPTY,
+  RXMSG_UP,
+  RXMSG_DOWN,
+};
+
+#define RXMSG_ROW(I)                                                                               \
+  [RXMSG_TYPE + I] = LABEL(20, 34 + I * 24, &Font16, NULL),                                        \
+  [RXMSG_FROM + I] = LABEL_BUF(20, 47 + I * 24, &Font12, 16),                                      \
+  [RXMSG_AGO + I] = LABEL_BUF(130, 47 + I * 24, &Font12, 16),                                      \
+  [RXMSG_NEW + I] = LABEL(150, 34 + I * 24, &Font16, "*NEW*")
+
+static widget_t rxmsg_widgets[] = {
+    [RXMSG_TITLE] = LABEL(0, 10, &Font16, "Received Messages:"),
+    RXMSG_ROW(0),
+    RXMSG_ROW(1),
+    RXMSG_ROW(2),
+    [RXMSG_CURSOR] = LABEL(0, 34, &Font16, ">"),
+    [RXMSG_EMPTY] = LABEL(0, 34, &Font16, "No messages received."),
+    [RXMSG_UP] = LABEL(100, 30, &Font12, "^"),
+    [RXMSG_DOWN] = LABEL(100, 110, &Font12, "v"),
+};
+
+static void received_Msgs(widget_t *w) {
   for (int i = 0; i < 3; i++) {
-    // Display messages, sender and time received
-    if (i + ((received_Page - 1) * 3) < message_history_count) {
-      printf("Writing Message\n");
-      message_t *msg = &message_history[i + ((received_Page - 1) * 3)].message;
-      char *src = uid_to_string(msg->src);
-      printf("- [%d]: %s %s %d\r\n", i + ((received_Page - 1) * 3), src, MTYPE_STR[msg->mtype], msg->id);
-      
-      //Paint_DrawString(20, 34 + i * 24, saved_Messages[i + ((received_Page - 1) * 3)], &Font16,
-                       //BLACK, WHITE);
-      Paint_DrawString(20, 34 + i * 24, MTYPE_STR[msg->mtype], &Font16,
-                       BLACK, WHITE);
-      //get the message history from the network.c file and print it here
-      char buff [64];
-      sprintf(buff, "From: %s",src); //Get node ID from network code
-      Paint_DrawString(20, 47 + i * 24, buff, &Font12, BLACK,
-                       WHITE); // replace with new_String
-
-      int time = absolute_time_diff_us(message_history[i + ((received_Page - 1) * 3)].time,get_absolute_time())/1000/1000;
-      if (time > 60) {
-        time = time / 60;
-        sprintf(buff, "%dm ago",time);
-      } else if (time > 60 * 60) {
-        time = (float)time / 60 / 60;
-        sprintf(buff, "%dh ago",time);
-      }else {
-        sprintf(buff, "%ds ago",time);
+    inbox_entry_t entry;
+    bool shown = inbox_get(i + ((received_Page - 1) * 3), &entry);
+
+    w[RXMSG_TYPE + i].state.visible = shown;
+    w[RXMSG_FROM + i].state.visible = shown;
+    w[RXMSG_AGO + i].state.visible = shown;
+    w[RXMSG_NEW + i].state.visible = shown && entry.unread;
+    if (shown) {
+      message_t *msg = &entry.message;
+      w[RXMSG_TYPE + i].state.text = MTYPE_STR[msg->mtype];
+      widget_printf(&w[RXMSG_FROM + i], "From: %s", uid_to_string(msg->src));
+      show_ago(&w[RXMSG_AGO + i], &entry);
+
+      // Remove new message indicator once it was seen
+      if (entry.unread && received_Cursor == i) {
+        inbox_mark_read(&entry);
       }
-      Paint_DrawString(130, 47 + i * 24, buff, &Font12, BLACK,
-                       WHITE);
-    }
-    // Clear rest of screen if there aren't enough messages to fill it
-    else {
-      printf("Clearing Message\n");
-      Paint_DrawRectangle(0, 34 + i * 24, 170, 47 + i * 24, WHITE, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    }
-    // Remove new message indicator if it was seen
-    if (new_Messages[i + ((received_Page - 1) * 3)] == 1) {
-      Paint_DrawString(150, 34 + i * 24, "*NEW*", &Font16, BLACK, WHITE);
-      if (received_Cursor == i) {
-        new_Msg--;
-        new_Messages[i + ((received_Page - 1) * 3)] = 0;
-      }
-    }
-    for (int i = 0; i < 3; i++) {
-      Paint_ClearWindows(0, 34 + i * 24, 20, 58 + i * 24, WHITE);
     }
-    if (neighbour_table.count > 0){
-      Paint_DrawString(0, 34 + received_Cursor * 24, ">", &Font16, BLACK, WHITE);
-    }
-  }
-  if (message_history_count == 0) {
-    Paint_DrawString(0, 34, "No messages received.", &Font16, BLACK, WHITE);
   }
+  w[RXMSG_CURSOR].state.visible = inbox_count() > 0;
+  w[RXMSG_CURSOR].state.y = 34 + received_Cursor * 24;
+  w[RXMSG_EMPTY].state.visible = inbox_count() == 0;
+
   // Display page indicators
-  if (received_Page > 1) {
-    Paint_DrawString(100, 30, "^", &Font12, BLACK, WHITE);
-  }
-  if (received_Page < ((float)message_history_count / 3)) {
-    Paint_DrawString(100, 110, "v", &Font12, BLACK, WHITE);
-  }
+  w[RXMSG_UP].state.visible = received_Page > 1;
+  w[RXMSG_DOWN].state.visible = received_Page < ((float)inbox_count() / 3);
 }
 
-void broadcast() {
-  // Create a new display buffer
-  //Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  Paint_SelectImage(image);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-  // Draw message selection screen
-  Paint_DrawString(0, 0, "Select action to broadcast:", &Font12, BLACK, WHITE);
-  Paint_DrawString(0, 35, "You're action will broadcast to all neighbours within range.", &Font12, BLACK, WHITE);
-  char buffer[64];
-  sprintf(buffer, "Current known neighbours: %d.",neighbour_table.count);
-  Paint_DrawString(0, 70, buffer, &Font12, BLACK, WHITE);
-
-  if (broadcast_Action_Cursor == 0) {
-    Paint_DrawString(5, 100, "Text", &Font16, WHITE, BLACK);
-    Paint_DrawString(85, 100, "Ping", &Font16, BLACK, WHITE);
-    Paint_DrawString(165, 100, "Request", &Font16, BLACK, WHITE);
-  } else if (broadcast_Action_Cursor == 1) {
-    Paint_DrawString(5, 100, "Text", &Font16, BLACK, WHITE);
-    Paint_DrawString(85, 100, "Ping", &Font16, WHITE, BLACK);
-    Paint_DrawString(165, 100, "Request", &Font16, BLACK, WHITE);
-  } else if (broadcast_Action_Cursor == 2) {
-    Paint_DrawString(5, 100, "Text", &Font16, BLACK, WHITE);
-    Paint_DrawString(85, 100, "Ping", &Font16, BLACK, WHITE);
-    Paint_DrawString(165, 100, "Request", &Font16, WHITE, BLACK);
-  }
+enum {
+  BROADCAST_TITLE,
+  BROADCAST_INFO,
+  BROADCAST_COUNT,
+  BROADCAST_TEXT,
+  BROADCAST_PING,
+  BROADCAST_REQUEST,
+};
+
+static widget_t broadcast_widgets[] = {
+    [BROADCAST_TITLE] = LABEL(0, 0, &Font12, "Select action to broadcast:"),
+    [BROADCAST_INFO] = LABEL_WRAP(0, 35, 249, 69, &Font12,
+                                  "You're action will broadcast to all neighbours within range."),
+    [BROADCAST_COUNT] = LABEL_BUF(0, 70, &Font12, 40),
+    [BROADCAST_TEXT] = LABEL(5, 100, &Font16, "Text"),
+    [BROADCAST_PING] = LABEL(85, 100, &Font16, "Ping"),
+    [BROADCAST_REQUEST] = LABEL(165, 100, &Font16, "Request"),
+};
+
+static void broadcast(widget_t *w) {
+  widget_printf(&w[BROADCAST_COUNT], "Current known neighbours: %d.", ui_neighbours.count);
+  bind_actions(&w[BROADCAST_TEXT], broadcast_Action_Cursor);
 }
 
-void neighbours_Action() {
-  printf("ACTION.\n");
-  // Create a new display buffer
-  //Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  Paint_SelectImage(image);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-  // Draw message selection screen
-  Paint_DrawString(0, 0, "Neighbour Details:", &Font16, BLACK, WHITE);
-  if (neighbour_table.count == 0){
-    Paint_DrawString(0, 25, "No Neighbours Found.  Selected Action will broadcast.", &Font16, BLACK, WHITE);
-  } else{
-    printf("%d\n",neighbour_Table_Cursor + ((neighbour_received_Page - 1) * 3));
-    neighbour_t *neighbour_Node_Action = &neighbour_table.neighbours[neighbour_Table_Cursor + ((neighbour_received_Page - 1) * 3)];
-    char *src = uid_to_string(neighbour_Node_Action->uid);
-    //Paint_DrawString(0, 25, src, &Font16,BLACK, WHITE);
-    char buffer[64];
-    sprintf(buffer, "Neighbour: %s",src);
-    Paint_DrawString(0, 25, buffer, &Font16, BLACK, WHITE);
-  // Update last seen and change units based on time
-    int time_diff = absolute_time_diff_us(neighbour_Node_Action->last_seen,get_absolute_time())/1000/1000;
-    if (time_diff > 60) {
-      time_diff = time_diff / 60;
-      sprintf(buffer, "Last Seen: %dm",time_diff);
-    } else if (time_diff > 60 * 60) {
-      time_diff = (float)time_diff / 60 / 60;
-      sprintf(buffer, "Last Seen: %dh",time_diff);
-    }else {
-      sprintf(buffer, "Last Seen: %ds",time_diff);
-    }
-    Paint_DrawString(0, 55, buffer, &Font12, BLACK, WHITE);
-
-    if (neighbour_Node_Action->version_major == 0 && neighbour_Node_Action->version_minor == 0){
-      sprintf(buffer, "Version: Unk");
+enum {
+  ACTION_TITLE,
+  ACTION_NONE,
+  ACTION_NEIGHBOUR,
+  ACTION_SEEN,
+  ACTION_VERSION,
+  ACTION_RSSI,
+  ACTION_TEXT,
+  ACTION_PING,
+  ACTION_REQUEST,
+};
+
+static widget_t action_widgets[] = {
+    [ACTION_TITLE] = LABEL(0, 0, &Font16, "Neighbour Details:"),
+    [ACTION_NONE] = LABEL_WRAP(0, 25, 249, 99, &Font16,
+                               "No Neighbours Found. Selected Action will broadcast."),
+    [ACTION_NEIGHBOUR] = LABEL_BUF(0, 25, &Font16, 24),
+    [ACTION_SEEN] = LABEL_BUF(0, 55, &Font12, 24),
+    [ACTION_VERSION] = LABEL_BUF(165, 55, &Font12, 20),
+    [ACTION_RSSI] = LABEL_BUF(0, 75, &Font12, 16),
+    [ACTION_TEXT] = LABEL(5, 100, &Font16, "Text"),
+    [ACTION_PING] = LABEL(85, 100, &Font16, "Ping"),
+    [ACTION_REQUEST] = LABEL(165, 100, &Font16, "Request"),
+};
+
+static void neighbours_Action(widget_t *w) {
+  bool found = ui_neighbours.count > 0;
+  w[ACTION_NONE].state.visible = !found;
+  w[ACTION_NEIGHBOUR].state.visible = found;
+  w[ACTION_SEEN].state.visible = found;
+  w[ACTION_VERSION].state.visible = found;
+  w[ACTION_RSSI].state.visible = found;
+
+  if (found) {
+    neighbour_t *neighbour_Node_Action =
+        &ui_neighbours.neighbours[neighbour_Table_Cursor + ((neighbour_received_Page - 1) * 3)];
+    widget_printf(&w[ACTION_NEIGHBOUR], "Neighbour: %s",
+                  uid_to_string(neighbour_Node_Action->uid));
+
+    char unit;
+    int ago = time_ago(neighbour_Node_Action->last_seen, &unit);
+    widget_printf(&w[ACTION_SEEN], "Last Seen: %d%c", ago, unit);
+
+    if (neighbour_Node_Action->version_major == 0 && neighbour_Node_Action->version_minor == 0) {
+      widget_printf(&w[ACTION_VERSION], "Version: Unk");
     } else {
-      sprintf(buffer, "Version: %d.%d",neighbour_Node_Action->version_major,neighbour_Node_Action->version_minor);
+      widget_printf(&w[ACTION_VERSION], "Version: %d.%d", neighbour_Node_Action->version_major,
+                    neighbour_Node_Action->version_minor);
     }
-    Paint_DrawString(165, 55, buffer, &Font12, BLACK, WHITE);
-
-    sprintf(buffer, "RSSI: %d",neighbour_Node_Action->rssi);
-    Paint_DrawString(0, 75, buffer, &Font12, BLACK, WHITE);
-  }
-  if (neighbour_Action_Cursor == 0) {
-    Paint_DrawString(5, 100, "Text", &Font16, WHITE, BLACK);
-    Paint_DrawString(85, 100, "Ping", &Font16, BLACK, WHITE);
-    Paint_DrawString(165, 100, "Request", &Font16, BLACK, WHITE);
-  } else if (neighbour_Action_Cursor == 1) {
-    Paint_DrawString(5, 100, "Text", &Font16, BLACK, WHITE);
-    Paint_DrawString(85, 100, "Ping", &Font16, WHITE, BLACK);
-    Paint_DrawString(165, 100, "Request", &Font16, BLACK, WHITE);
-  } else if (neighbour_Action_Cursor == 2) {
-    Paint_DrawString(5, 100, "Text", &Font16, BLACK, WHITE);
-    Paint_DrawString(85, 100, "Ping", &Font16, BLACK, WHITE);
-    Paint_DrawString(165, 100, "Request", &Font16, WHITE, BLACK);
+    widget_printf(&w[ACTION_RSSI], "RSSI: %d", neighbour_Node_Action->rssi);
   }
+  bind_actions(&w[ACTION_TEXT], neighbour_Action_Cursor);
 }
 
-void neighbours_Table() {
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-  // Draw message selection screen
-  Paint_DrawString(0, 5, "Neighbours Table:", &Font16, BLACK, WHITE);
-  printf("neighbour table count: %d\n", neighbour_table.count);
+enum {
+  TABLE_TITLE,
+  TABLE_ROW,
+  TABLE_CURSOR = TABLE_ROW + 3,
+  TABLE_EMPTY,
+  TABLE_UP,
+  TABLE_DOWN,
+};
+
+static widget_t table_widgets[] = {
+    [TABLE_TITLE] = LABEL(0, 5, &Font16, "Neighbours Table:"),
+    [TABLE_ROW + 0] = LABEL_BUF(20, 34, &Font16, 12),
+    [TABLE_ROW + 1] = LABEL_BUF(20, 58, &Font16, 12),
+    [TABLE_ROW + 2] = LABEL_BUF(20, 82, &Font16, 12),
+    [TABLE_CURSOR] = LABEL(0, 34, &Font16, ">"),
+    [TABLE_EMPTY] = LABEL(0, 34, &Font16, "No Neighbours Found."),
+    [TABLE_UP] = LABEL(100, 30, &Font12, "^"),
+    [TABLE_DOWN] = LABEL(100, 110, &Font12, "v"),
+};
+
+static void neighbours_Table(widget_t *w) {
   for (int i = 0; i < 3; i++) {
-    // Display messages, sender and time received
-    if (i + ((neighbour_received_Page - 1) * 3) < neighbour_table.count) {
-      neighbour_t *neighbour_Node = &neighbour_table.neighbours[i + ((neighbour_received_Page - 1) * 3)];
-      char *src = uid_to_string(neighbour_Node->uid);
-      //printf("- [%d]: %s %s %d\r\n", i + ((received_Page - 1) * 3), src, MTYPE_STR[msg->mtype], msg->id);
-      
-      Paint_DrawString(20, 34 + i * 24, src, &Font16,
-                       BLACK, WHITE);
-    }
-    // Clear rest of screen if there aren't enough messages to fill it
-    else {
-      printf("Clearing Message\n");
-      Paint_DrawRectangle(0, 34 + i * 24, 170, 47 + i * 24, WHITE, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    }
-    for (int i = 0; i < 3; i++) {
-      Paint_ClearWindows(0, 34 + i * 24, 20, 58 + i * 24, WHITE);
+    int index = i + ((neighbour_received_Page - 1) * 3);
+    w[TABLE_ROW + i].state.visible = index < ui_neighbours.count;
+    if (index < ui_neighbours.count) {
+      widget_printf(&w[TABLE_ROW + i], "%s", uid_to_string(ui_neighbours.neighbours[index].uid));
     }
-    if (neighbour_table.count > 0){
-      Paint_DrawString(0, 34 + neighbour_Table_Cursor * 24, ">", &Font16, BLACK, WHITE);
-    }
-  }
-  if (neighbour_table.count == 0) {
-    Paint_DrawString(0, 34, "No Neighbours Found.", &Font16, BLACK, WHITE);
   }
+  w[TABLE_CURSOR].state.visible = ui_neighbours.count > 0;
+  w[TABLE_CURSOR].state.y = 34 + neighbour_Table_Cursor * 24;
+  w[TABLE_EMPTY].state.visible = ui_neighbours.count == 0;
+
   // Display page indicators
-  if (neighbour_received_Page > 1) {
-    Paint_DrawString(100, 30, "^", &Font12, BLACK, WHITE);
-  }
-  if (neighbour_received_Page < ((float)neighbour_table.count / 3)) {
-    Paint_DrawString(100, 110, "v", &Font12, BLACK, WHITE);
-  }
+  w[TABLE_UP].state.visible = neighbour_received_Page > 1;
+  w[TABLE_DOWN].state.visible = neighbour_received_Page < ((float)ui_neighbours.count / 3);
 }
 
-void neighbours_Request(){
-  printf("Requesting Neighbours/n");
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-  Paint_DrawString(0, 5, "Request:", &Font16, BLACK, WHITE);
-
-  // Draw message selection screen
-  if (neighbour_Request_Cursor == 0) {
-    // Version selected
-    Paint_DrawRectangle(15, 29, 210, 65, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(27, 39, "Version", &Font16, WHITE, WHITE);
-    Paint_DrawRectangle(15, 71, 210, 107, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(22, 81, "Uptime", &Font16, BLACK, WHITE);
-  }
-  if (neighbour_Request_Cursor == 1) {
-    // Uptime selected
-    Paint_DrawRectangle(15, 29, 210, 65, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(27, 39, "Version", &Font16, BLACK, WHITE);
-    Paint_DrawRectangle(15, 71, 210, 107, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(22, 81, "Uptime", &Font16, WHITE, WHITE);
-  }
+enum {
+  REQUEST_TITLE,
+  REQUEST_VERSION,
+  REQUEST_UPTIME,
+};
+
+static widget_t request_widgets[] = {
+    [REQUEST_TITLE] = LABEL(0, 5, &Font16, "Request:"),
+    [REQUEST_VERSION] = BOX(15, 29, 210, 65, DOT_PIXEL_2X2, 27, 39, &Font16, "Version"),
+    [REQUEST_UPTIME] = BOX(15, 71, 210, 107, DOT_PIXEL_2X2, 22, 81, &Font16, "Uptime"),
+};
+
+static void neighbours_Request(widget_t *w) {
+  w[REQUEST_VERSION].state.visible = neighbour_Request_Cursor < 2;
+  w[REQUEST_VERSION].state.selected = neighbour_Request_Cursor == 0;
+  w[REQUEST_UPTIME].state.visible = neighbour_Request_Cursor < 2;
+  w[REQUEST_UPTIME].state.selected = neighbour_Request_Cursor == 1;
 }
 
-void neighbours_Screen() {
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-
-  // Draw message selection screen
-  if (neighbour_Cursor == 0) {
-    // Neighbours table selected
-    Paint_DrawRectangle(15, 29, 210, 65, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(27, 39, "View Neighbours", &Font16, WHITE, WHITE);
-    Paint_DrawRectangle(15, 71, 210, 107, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(22, 81, "Broadcast To All", &Font16, BLACK, WHITE);
-  }
-  if (neighbour_Cursor == 1) {
-    // msg screen selected
-    Paint_DrawRectangle(15, 29, 210, 65, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(27, 39, "View Neighbours", &Font16, BLACK, WHITE);
-    Paint_DrawRectangle(15, 71, 210, 107, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(22, 81, "Broadcast To All", &Font16, WHITE, WHITE);
-  }
+enum {
+  NEIGHBOURS_TABLE,
+  NEIGHBOURS_BROADCAST,
+};
+
+static widget_t neighbours_widgets[] = {
+    [NEIGHBOURS_TABLE] = BOX(15, 29, 210, 65, DOT_PIXEL_2X2, 27, 39, &Font16, "View Neighbours"),
+    [NEIGHBOURS_BROADCAST] =
+        BOX(15, 71, 210, 107, DOT_PIXEL_2X2, 22, 81, &Font16, "Broadcast To All"),
+};
+
+static void neighbours_Screen(widget_t *w) {
+  w[NEIGHBOURS_TABLE].state.visible = neighbour_Cursor < 2;
+  w[NEIGHBOURS_TABLE].state.selected = neighbour_Cursor == 0;
+  w[NEIGHBOURS_BROADCAST].state.visible = neighbour_Cursor < 2;
+  w[NEIGHBOURS_BROADCAST].state.selected = neighbour_Cursor == 1;
 }
 
-void home_Screen() {
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90,
-                 WHITE); // Just do for first time setup
-  // Paint_SelectImage(image); //Do this for every other time
-  //  Paint the whole frame white
-  Paint_Clear(WHITE); // Just do for first time setup
-  // SETTINGS SELECTED
-  if (home_Cursor == 1) {
-    // select next screen
-    Paint_Clear(WHITE);
-    Paint_DrawRectangle(50, 50, 80, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(57, 57, "M", &Font20, BLACK, WHITE);
-    Paint_DrawString(37, 85, "Messages", &Font12, WHITE, WHITE);
-    Paint_DrawRectangle(150, 50, 180, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(157, 57, "N", &Font20, BLACK, WHITE);
-    Paint_DrawString(132, 85, "Neighbours", &Font12, WHITE, WHITE);
-    Paint_DrawRectangle(100, 50, 130, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(107, 57, "S", &Font20, WHITE, WHITE);
-    Paint_DrawString(86, 85, "Settings", &Font12, BLACK, WHITE);
-  }
-  // MESSAGES SELECTED
-  if (home_Cursor == 0) {
-    // select next screen
-    Paint_Clear(WHITE);
-    Paint_DrawRectangle(100, 50, 130, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(107, 57, "S", &Font20, BLACK, WHITE);
-    Paint_DrawString(83, 85, "Settings", &Font12, WHITE, WHITE);
-    Paint_DrawRectangle(150, 50, 180, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(157, 57, "N", &Font20, BLACK, WHITE);
-    Paint_DrawString(132, 85, "Neighbours", &Font12, WHITE, WHITE);
-    Paint_DrawRectangle(50, 50, 80, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(57, 57, "M", &Font20, WHITE, WHITE);
-    Paint_DrawString(37, 85, "Messages", &Font12, BLACK, WHITE);
-  }
-  // NEIGHBOURS SELECTED
-  if (home_Cursor == 2) {
-    Paint_Clear(WHITE);
-    Paint_DrawRectangle(50, 50, 80, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(57, 57, "M", &Font20, BLACK, WHITE);
-    Paint_DrawString(37, 85, "Messages", &Font12, WHITE, WHITE);
-    Paint_DrawRectangle(100, 50, 130, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(107, 57, "S", &Font20, BLACK, WHITE);
-    Paint_DrawString(83, 85, "Settings", &Font12, WHITE, WHITE);
-    Paint_DrawRectangle(150, 50, 180, 80, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(157, 57, "N", &Font20, WHITE, WHITE);
-    Paint_DrawString(132, 85, "Neighbours", &Font12, BLACK, WHITE);
-  }
-  if (new_Msg > 0) {
-    if (new_Msg == 1) {
-      Paint_DrawString(95, 110, " new message", &Font12, BLACK, WHITE);
-    } else {
-      Paint_DrawString(95, 110, " new messages", &Font12, BLACK, WHITE);
-    }
-    Paint_DrawNum(90, 110, new_Msg, &Font12, WHITE, BLACK);
-  }
-  #ifdef PIN_CONFIG_v2
-  // Draw Battery %
-  char bat[12];
-  sprintf(bat, "%.1f%%", (read_voltage())/3.3*100);
-  Paint_DrawString(185, 0, bat, &Font12, BLACK, WHITE);
-  #endif
+enum {
+  HOME_MESSAGES,
+  HOME_MESSAGES_LABEL,
+  HOME_SETTINGS,
+  HOME_SETTINGS_LABEL,
+  HOME_NEIGHBOURS,
+  HOME_NEIGHBOURS_LABEL,
+  HOME_NEW_MESSAGES,
+  HOME_NEW_COUNT,
+  HOME_BATTERY,
+  HOME_BATTERY_FRAME,
+  HOME_VERSION,
+  HOME_VERSION_FRAME,
+  HOME_NODES,
+  HOME_NODES_FRAME,
+};
+
+static widget_t home_widgets[] = {
+    [HOME_MESSAGES] = BOX(50, 50, 80, 80, DOT_PIXEL_2X2, 57, 57, &Font20, "M"),
+    [HOME_MESSAGES_LABEL] = LABEL(37, 85, &Font12, "Messages"),
+    [HOME_SETTINGS] = BOX(100, 50, 130, 80, DOT_PIXEL_2X2, 107, 57, &Font20, "S"),
+    [HOME_SETTINGS_LABEL] = LABEL(86, 85, &Font12, "Settings"),
+    [HOME_NEIGHBOURS] = BOX(150, 50, 180, 80, DOT_PIXEL_2X2, 157, 57, &Font20, "N"),
+    [HOME_NEIGHBOURS_LABEL] = LABEL(132, 85, &Font12, "Neighbours"),
+    [HOME_NEW_MESSAGES] = LABEL(95, 110, &Font12, NULL),
+    [HOME_NEW_COUNT] = LABEL_BUF(90, 110, &Font12, 12),
+    [HOME_BATTERY] = LABEL_BUF(185, 0, &Font12, 12),
+    [HOME_BATTERY_FRAME] = FRAME(182, 0, 230, 15, DOT_PIXEL_1X1),
+    [HOME_VERSION] = LABEL_BUF(0, 0, &Font12, 12),
+    [HOME_VERSION_FRAME] = FRAME(0, 0, 75, 15, DOT_PIXEL_1X1),
+    [HOME_NODES] = LABEL_BUF(80, 0, &Font12, 24),
+    [HOME_NODES_FRAME] = FRAME(75, 0, 182, 15, DOT_PIXEL_1X1),
+};
+
+static void home_Screen(widget_t *w) {
+  // Only the label of the selected item is shown
+  w[HOME_MESSAGES].state.selected = home_Cursor == 0;
+  w[HOME_MESSAGES_LABEL].state.visible = home_Cursor == 0;
+  w[HOME_SETTINGS].state.selected = home_Cursor == 1;
+  w[HOME_SETTINGS_LABEL].state.visible = home_Cursor == 1;
+  w[HOME_NEIGHBOURS].state.selected = home_Cursor == 2;
+  w[HOME_NEIGHBOURS_LABEL].state.visible = home_Cursor == 2;
+
+  uint32_t unread = inbox_unread();
+  w[HOME_NEW_MESSAGES].state.visible = unread > 0;
+  w[HOME_NEW_MESSAGES].state.text = unread == 1 ? " new message" : " new messages";
+  w[HOME_NEW_COUNT].state.visible = unread > 0;
+  widget_printf(&w[HOME_NEW_COUNT], "%d", unread);
 
-  #ifndef PIN_CONFIG_v2
   // Draw Battery %
-  Paint_DrawString(185, 0, "100%%", &Font12, BLACK, WHITE);
+  #ifdef PIN_CONFIG_v2
+  widget_printf(&w[HOME_BATTERY], "%.1f%%", (read_voltage())/3.3*100);
+  #else
+  w[HOME_BATTERY].state.text = "100%%";
   #endif
-  Paint_DrawRectangle(182, 0, 230, 15, BLACK, DOT_PIXEL_1X1, DRAW_FILL_EMPTY);
 
   // Draw version number
-  char version[12];
-  char neighbour_Count[64];
-  sprintf(version, "V/ink v%d.%d", VERSION_MAJOR, VERSION_MINOR);
-  Paint_DrawString(0, 0, version, &Font12, BLACK, WHITE);
-  Paint_DrawRectangle(0, 0, 75, 15, BLACK, DOT_PIXEL_1X1, DRAW_FILL_EMPTY);
-
-  // Draw nearby nodes, replace with network code
-  //Paint_DrawString(90, 0, "Nearby Nodes", &Font12, BLACK, WHITE);
-  // convert neighbour_table.count to string
-  sprintf(neighbour_Count, "%d Nearby Nodes", neighbour_table.count);
-  Paint_DrawString(80, 0, neighbour_Count, &Font12, BLACK, WHITE);
-  //printf("Found Nodes: %d\n",neighbour_table.count);
-  Paint_DrawRectangle(75, 0, 182, 15, BLACK, DOT_PIXEL_1X1, DRAW_FILL_EMPTY);
-}
-
-void settings_Info() {
-  Paint_SelectImage(image);
-  if (settings_Cursor == 0) {
-    // clear screen
-    Paint_ClearWindows(170, 34, 300, 50, WHITE);
-    // refresh display
-    EPD_2in13_V4_Display_Partial(image);
-    Paint_DrawString(200, 26, "^", &Font12, BLACK, WHITE);
-    Paint_DrawString(200, 44, "v", &Font12, BLACK, WHITE);
-    if (set_Info_Cursor == 0) {
-      Paint_DrawString(170, 34, "  Never", &Font12, BLACK, WHITE);
-    } else if (set_Info_Cursor == 1) {
-      Paint_DrawString(170, 34, "5 Seconds", &Font12, BLACK, WHITE);
-    } else if (set_Info_Cursor == 2) {
-      Paint_DrawString(170, 34, "10 Seconds", &Font12, BLACK, WHITE);
-    } else if (set_Info_Cursor == 3) {
-      Paint_DrawString(170, 34, "30 Seconds", &Font12, BLACK, WHITE);
-    } else if (set_Info_Cursor == 4) {
-      Paint_DrawString(170, 34, "1 Minute", &Font12, BLACK, WHITE);
-    } else if (set_Info_Cursor == 5) {
-      Paint_DrawString(170, 34, "2 Minutes", &Font12, BLACK, WHITE);
-    }
-  }
+  widget_printf(&w[HOME_VERSION], "V/ink v%d.%d", VERSION_MAJOR, VERSION_MINOR);
 
-  if (settings_Cursor == 1) {
-    // clear screen
-    Paint_ClearWindows(170, 63, 300, 100, WHITE);
-    // refresh display
-    EPD_2in13_V4_Display_Partial(image);
-    Paint_DrawString(200, 55, "^", &Font12, BLACK, WHITE);
-    Paint_DrawString(200, 73, "v", &Font12, BLACK, WHITE);
-    if (set_Info_Cursor == 0) {
-      Paint_DrawString(170, 63, " Default", &Font12, BLACK, WHITE);
-    } else if (set_Info_Cursor == 1) {
-      Paint_DrawString(170, 63, "   Fast", &Font12, BLACK, WHITE);
-    } else if (set_Info_Cursor>1) {
-      Paint_DrawString(170, 63, "Long Range", &Font12, BLACK, WHITE);
-      set_Info_Cursor = 5;
-    }
-  }
+  // Draw nearby nodes
+  widget_printf(&w[HOME_NODES], "%d Nearby Nodes", ui_neighbours.count);
 }
 
-void settings_Screen() {
-  // Create a new display buffer
-  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
-  // Paint the whole frame white
-  Paint_Clear(WHITE);
-
-  // Draw message selection screen
-  Paint_DrawString(0, 5, "Settings:", &Font16, BLACK, WHITE);
+enum {
+  SETTINGS_TITLE,
+  SETTINGS_TIMEOUT,
+  SETTINGS_MODE,
+  SETTINGS_UP,
+  SETTINGS_DOWN,
+  SETTINGS_VALUE,
+};
+
+static widget_t settings_widgets[] = {
+    [SETTINGS_TITLE] = LABEL(0, 5, &Font16, "Settings:"),
+    [SETTINGS_TIMEOUT] = BOX(5, 29, 155, 55, DOT_PIXEL_2X2, 10, 34, &Font16, "Sleep Timeout"),
+    [SETTINGS_MODE] = BOX(5, 58, 155, 84, DOT_PIXEL_2X2, 10, 63, &Font16, "Mode"),
+    [SETTINGS_UP] = LABEL(200, 26, &Font12, "^"),
+    [SETTINGS_DOWN] = LABEL(200, 44, &Font12, "v"),
+    [SETTINGS_VALUE] = LABEL(170, 34, &Font12, NULL),
+};
+
+static const char *TIMEOUT_STR[] = {
+    "  Never", "5 Seconds", "10 Seconds", "30 Seconds", "1 Minute", "2 Minutes",
+};
+
+// The value of the selected setting is only shown while it is being changed.
+static void settings_Info(widget_t *w) {
+  bool editing = display == DISPLAY_SETTINGS_INFO && settings_Cursor < 2;
+  w[SETTINGS_UP].state.visible = editing;
+  w[SETTINGS_DOWN].state.visible = editing;
+  w[SETTINGS_VALUE].state.visible = editing;
+  if (!editing) {
+    return;
+  }
+
+  uint16_t y = settings_Cursor == 0 ? 34 : 63;
+  w[SETTINGS_UP].state.y = y - 8;
+  w[SETTINGS_DOWN].state.y = y + 10;
+  w[SETTINGS_VALUE].state.y = y;
 
   if (settings_Cursor == 0) {
-    Paint_DrawRectangle(5, 29, 155, 55, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(10, 34, "Sleep Timeout", &Font16, WHITE, WHITE);
-    Paint_DrawRectangle(5, 58, 155, 84, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(10, 63, "Mode", &Font16, BLACK, WHITE);
-  }
-
-  if (settings_Cursor == 1) {
-    Paint_DrawRectangle(5, 29, 155, 55, BLACK, DOT_PIXEL_2X2, DRAW_FILL_EMPTY);
-    Paint_DrawString(10, 34, "Sleep Timeout", &Font16, BLACK, WHITE);
-    Paint_DrawRectangle(5, 58, 155, 84, BLACK, DOT_PIXEL_2X2, DRAW_FILL_FULL);
-    Paint_DrawString(10, 63, "Mode", &Font16, WHITE, WHITE);
+    w[SETTINGS_VALUE].state.visible = set_Info_Cursor < 6;
+    w[SETTINGS_VALUE].state.text = set_Info_Cursor < 6 ? TIMEOUT_STR[set_Info_Cursor] : NULL;
+  } else if (set_Info_Cursor == 0) {
+    w[SETTINGS_VALUE].state.text = " Default";
+  } else if (set_Info_Cursor == 1) {
+    w[SETTINGS_VALUE].state.text = "   Fast";
+  } else {
+    w[SETTINGS_VALUE].state.text = "Long Range";
+    set_Info_Cursor = 5;
   }
-  // Paint_DrawString(5, 82, "Mode", &Font16, BLACK, WHITE);
+}
 
-  // Display cursor
-  // Paint_DrawString(0, 34, ">", &Font16, BLACK, WHITE);
+static void settings_Screen(widget_t *w) {
+  w[SETTINGS_TIMEOUT].state.visible = settings_Cursor < 2;
+  w[SETTINGS_TIMEOUT].state.selected = settings_Cursor == 0;
+  w[SETTINGS_MODE].state.visible = settings_Cursor < 2;
+  w[SETTINGS_MODE].state.selected = settings_Cursor == 1;
+  settings_Info(w);
 }
 
+static widget_screen_t home = WIDGET_SCREEN(home_widgets, home_Screen);
+static widget_screen_t send_to = WIDGET_SCREEN(send_to_widgets, send_To_Screen);
+static widget_screen_t msg = WIDGET_SCREEN(msg_widgets, msg_Screen);
+static widget_screen_t rxmsg = WIDGET_SCREEN(rxmsg_widgets, received_Msgs);
+static widget_screen_t details = WIDGET_SCREEN(details_widgets, received_msg_Details);
+static widget_screen_t table = WIDGET_SCREEN(table_widgets, neighbours_Table);
+static widget_screen_t broadcast_screen = WIDGET_SCREEN(broadcast_widgets, broadcast);
+static widget_screen_t action = WIDGET_SCREEN(action_widgets, neighbours_Action);
+static widget_screen_t request = WIDGET_SCREEN(request_widgets, neighbours_Request);
+static widget_screen_t neighbours = WIDGET_SCREEN(neighbours_widgets, neighbours_Screen);
+static widget_screen_t settings = WIDGET_SCREEN(settings_widgets, settings_Screen);
+
+// Settings info is drawn on top of the settings screen, they share the widgets.
+static widget_screen_t *const screens[] = {
+    [DISPLAY_HOME] = &home,
+    [DISPLAY_SEND_TO] = &send_to,
+    [DISPLAY_MSG] = &msg,
+    [DISPLAY_RXMSG] = &rxmsg,
+    [DISPLAY_RXMSG_DETAILS] = &details,
+    [DISPLAY_NEIGHBOURS_TABLE] = &table,
+    [DISPLAY_BROADCAST] = &broadcast_screen,
+    [DISPLAY_NEIGHBOURS_ACTION] = &action,
+    [DISPLAY_NEIGHBOURS_REQUEST] = &request,
+    [DISPLAY_NEIGHBOURS] = &neighbours,
+    [DISPLAY_SETTINGS] = &settings,
+    [DISPLAY_SETTINGS_INFO] = &settings,
+};
+
+// Render the screen of the current display state into the image buffer.
+// Only the widgets that changed are redrawn, returns the area of the frame that changed.
+rect_t render_display() { return render_widgets(screens[display]); }
+
 void go_to_Sleep(){
   five_Seconds = true;
   cancel_alarm(alarm_id);
+  Paint_SelectImage(image);
   Paint_DrawString(225, 0, "SLP", &Font12, WHITE, BLACK);
-  EPD_2in13_V4_Display_Partial(image);
-  EPD_2in13_V4_Sleep();
+  invalidate_widgets();
+  present_frame();
+  start_refresh(REFRESH_PARTIAL);
+  sleep_panel();
 }
 
+// Runs from the alarm interrupt, on core0.
+// The display is owned by the UI core, so only queue an event for it.
 int64_t alarm_callback(alarm_id_t id, void *user_data) {
-  five_Seconds = true;
-  printf("%d Seconds of inactivity, sleeping display.\n", display_Timeout / 1000);
-  Paint_SelectImage(image);
-  // partial display refresh
-  Paint_DrawString(225, 0, "SLP", &Font12, WHITE, BLACK);
-  EPD_2in13_V4_Display_Partial(image);
-  busy_wait_ms(100);
-  EPD_2in13_V4_Sleep();
-  busy_wait_ms(100);
+  post_ui_event(UI_EVENT_TIMEOUT);
   return 0; // Returning 0 cancels the alarm
 }
 
 // Function to reset the alarm when the flag is set
 void set_flag_and_reset_alarm() {
-  printf("Flag set! Resetting alarm.\n");
+  debug("Flag set! Resetting alarm.\n");
   // Cancel the previous alarm
   cancel_alarm(alarm_id);
   // Reset flag and start a new alarm
@@ -664,38 +654,61 @@ void set_flag_and_reset_alarm() {
   alarm_id = add_alarm_in_ms(display_Timeout, alarm_callback, NULL, false);
 }
 
+// Show that a message arrived, its latency is measured until the frame showing it is sent.
+void notify_message(absolute_time_t time) {
+  if (notify_time == 0) {
+    notify_time = time;
+  }
+  screen = SCREEN_DRAW_READY;
+}
+
+// UI loop running on the UI core.
+// Handles the UI events queued by the interrupts, the console and the records from the radio core,
+// renders and refreshes the display.
 void screen_draw_loop() {
   while (true) {
-    uint32_t flag = multicore_fifo_pop_blocking();
+    // Sleep until an event arrives.
+    while (!ui_event_pending() && screen != SCREEN_DRAW_READY) {
+      __wfe();
+    }
 
-    printf("five_Seconds: %d\n", five_Seconds);
-    if (new_Msg>0){
+    // Let the running refresh finish first, so that every event arriving in the meantime is
+    // coalesced into the next frame.
+    wait_for_refresh();
+    handle_ui_events();
+
+    if (screen != SCREEN_DRAW_READY) {
+      continue;
+    }
+    screen = SCREEN_DRAW;
+
+    debug("five_Seconds: %d\n", five_Seconds);
+    if (inbox_unread() > 0) {
       gpio_put(PIN_STATUS_LED,0);
     } else {
       gpio_put(PIN_STATUS_LED,1);
     }
 
-    if (flag == 0) {
-      // Fast refresh on display wakup
-      if (five_Seconds) {
-        printf("Waking display.\n");
-        EPD_2in13_V4_Init_Fast();
-        Paint_ClearWindows(250, 0, 350, 20, WHITE);
-        EPD_2in13_V4_Display_Fast(image);
-      }
-      if (refresh_Counter == 15) {
-        EPD_2in13_V4_Display_Base(image);
-        refresh_Counter = 0;
-      } else {
-        EPD_2in13_V4_Display_Partial(image);
-        refresh_Counter++;
+    rect_t dirty = render_display();
+
+    // The panel kept its image while asleep, the first frame after waking up can be partial too.
+    if (five_Seconds) {
+      debug("Waking display.\n");
+      wake_panel();
+    }
+    present_frame_rect(dirty);
+    start_refresh(choose_refresh());
+
+    if (notify_time != 0) {
+      uint32_t latency = absolute_time_diff_us(notify_time, get_absolute_time());
+      channel_stats.notify_us_last = latency;
+      if (latency > channel_stats.notify_us_max) {
+        channel_stats.notify_us_max = latency;
       }
-      // printf("Updating Image\n");
-      sleep_ms(100);
-      //busy_wait_ms(100);
-      // Set alarm to sleep display after x seconds of inactivity
-      set_flag_and_reset_alarm();
-      multicore_fifo_push_blocking_inline(0);
+      notify_time = 0;
     }
+    // Set alarm to sleep display after x seconds of inactivity
+    set_flag_and_reset_alarm();
+    screen = SCREEN_IDLE;
   }
 }
@@ -4,7 +4,10 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "inbox.h"
 #include "network.h"
+#include "panel.h"
+#include "widget.h"
 
 // Screen state machine
 typedef enum {
@@ -15,6 +18,8 @@ typedef enum {
 
 extern screen_t screen;
 
+extern neighbour_table_t ui_neighbours;
+
 // display screens state machine
 typedef enum {
   DISPLAY_HOME,
@@ -33,12 +38,6 @@ typedef enum {
 
 extern display_t display;
 
-// ((EPD_2in13_V4_WIDTH % 8 == 0) ? (EPD_2in13_V4_WIDTH / 8) : (EPD_2in13_V4_WIDTH / 8 + 1)) *
-// EPD_2in13_V4_HEIGHT = 4080
-#define IMAGE_SIZE 4080
-extern uint8_t image[IMAGE_SIZE];
-extern uint8_t wakeup[IMAGE_SIZE];
-
 extern uint8_t message_Cursor;
 extern uint8_t send_to_Cursor;
 extern uint8_t neighbour_Cursor;
@@ -52,10 +51,9 @@ extern uint8_t set_Info_Cursor;
 extern uint8_t msg_Action_Cursor;
 extern uint8_t temp_Cursor;
 extern uint8_t received_Cursor;
-extern uint8_t received_Page;
+extern uint16_t received_Page;
 extern uint8_t msg_received_Page;
 extern uint8_t neighbour_received_Page;
-extern uint8_t refresh_Counter;
 extern uint32_t display_Timeout;
 extern volatile bool five_Seconds;
 extern uint8_t msg_Type;
@@ -64,33 +62,21 @@ extern uint8_t msg_Type;
 #define MAX_MSG_SEND 15
 extern char send_Message[MAX_MSG_SEND][255 + 4];
 extern char test[7];
-extern int new_Messages[16];
 
 // number of messages received
 extern uint32_t msg_Number;
-extern uint32_t new_Msg;
 
 void setup_display();
 
 void wakeup_Screen();
 void send_Animation();
-void send_To_Screen();
-void msg_Screen();
-void received_msg_Details();
-void received_Msgs();
-void broadcast();
-void neighbours_Action();
-void neighbours_Table();
-void neighbours_Request();
-void neighbours_Screen();
-void home_Screen();
-void settings_Info();
-void settings_Screen();
+rect_t render_display();
 void go_to_Sleep();
 
 int64_t alarm_callback(alarm_id_t id, void *user_data);
 void set_flag_and_reset_alarm();
 
+void notify_message(absolute_time_t time);
 void screen_draw_loop();
 
 #endif // _SCREEN_H
@@ -0,0 +1,48 @@
+/**
+ * Statistics
+ *
+ * Counters of what the protocol core did with every packet: received, rejected, forwarded, dropped
+ * on a full queue, duplicated, retried or given up on, and the airtime it spent. Each context
+ * counts into a set of its own (see `platform_context`), the DIO1 interrupt and the radio loop
+ * never write the same word, and nothing is locked. A counter is the sum of its sets.
+ *
+ * Resetting doesn't touch the sets, the other core may be counting into them. It keeps the sums of
+ * the moment instead and counts from there, the unsigned difference survives the counters
+ * wrapping around.
+ *
+ * `get stats` prints them and `set stats reset` starts them over. Other nodes ask for one with a
+ * request for INFO_STATS, the index of the counter in the second byte.
+ */
+
+#define LOG_CATEGORY LOG_CONSOLE
+
+#include "stats.h"
+#include "utils.h"
+
+uint32_t stats_slots[STATS_SLOTS][STATS] = {0};
+
+// Sums at the last reset, only written by the UI core.
+static uint32_t stats_base[STATS] = {0};
+
+static uint32_t stat_sum(stat_t stat) {
+  uint32_t sum = 0;
+  for (int i = 0; i < STATS_SLOTS; i++) {
+    sum += stats_slots[i][stat];
+  }
+  return sum;
+}
+
+// A counter since the last reset.
+uint32_t stat_get(stat_t stat) { return stat_sum(stat) - stats_base[stat]; }
+
+void stats_reset() {
+  for (int i = 0; i < STATS; i++) {
+    stats_base[i] = stat_sum(i);
+  }
+}
+
+void print_stats() {
+  for (int i = 0; i < STATS; i++) {
+    reply("%s: %u\n", STAT_STR[i], stat_get(i));
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdint.h>
+
+#include "platform.h"
+
+// Counters of the protocol core, one for every drop and decision on the way of a packet.
+typedef enum {
+  // Frames read out of the radio.
+  STAT_RX_FRAMES,
+  // Receive interrupts without a frame, like CRC or header errors.
+  STAT_RX_ERRORS,
+  // Frames the decoder rejected, see `decode_rejects` for why.
+  STAT_RX_REJECTED,
+  // Frames of this node, heard back from a neighbour forwarding them.
+  STAT_RX_OWN,
+  STAT_RX_QUEUE_FULL,
+  // Frames for other nodes sent on, and those out of hops.
+  STAT_FORWARDED,
+  STAT_HOP_LIMIT,
+  // Messages received before, and the new ones handed to the protocol.
+  STAT_DUPLICATES,
+  STAT_DELIVERED,
+  STAT_ACKS_SENT,
+  STAT_ACKS_RECEIVED,
+  STAT_TX_FRAMES,
+  STAT_TX_QUEUE_FULL,
+  // Messages sent again for a missing ack, and those given up on after the last retry.
+  STAT_RETRIES,
+  STAT_GIVEN_UP,
+  // Packets lost to an empty packet pool or a full neighbour table.
+  STAT_NO_PACKET,
+  STAT_NEIGHBOURS_FULL,
+  // Time spent sending, in milliseconds.
+  STAT_AIRTIME_MS,
+  STATS,
+} stat_t;
+
+// A set of counters for every context that writes them: the thread and the interrupt handlers of
+// each core. No two writers ever share a counter, so counting is a plain add.
+#define STATS_SLOTS 4
+
+extern uint32_t stats_slots[STATS_SLOTS][STATS];
+
+static inline void stat_add(stat_t stat, uint32_t value) {
+  stats_slots[platform_context()][stat] += value;
+}
+
+static inline void stat_inc(stat_t stat) { stat_add(stat, 1); }
+
+uint32_t stat_get(stat_t stat);
+void stats_reset();
+void print_stats();
+
+#endif // _STATS_H
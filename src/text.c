@@ -0,0 +1,257 @@
+/**
+ * Text layout
+ *
+ * Text is laid out in a box: lines are wrapped between words, and at the box edge for words longer
+ * than a line, then clipped to the bottom of the box. Leading spaces are kept, the spaces a line
+ * was wrapped at are dropped.
+ *
+ * Every laid out line is drawn as runs of pre-rendered glyphs. A run is rendered once into columns
+ * of pixels, in the layout the frame uses for the rotated screen, and kept in a small LRU cache
+ * keyed by its characters and font. Drawing a cached run is a few byte operations per column
+ * instead of a pixel at a time.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "EPD_2in13_V4.h"
+#include "GUI_Paint.h"
+
+#include "text.h"
+
+// Landscape size of the panel, as the screens draw it.
+#define SCREEN_WIDTH EPD_2in13_V4_HEIGHT
+#define SCREEN_HEIGHT EPD_2in13_V4_WIDTH
+
+text_stats_t text_stats = {0};
+
+// A rendered run of characters.
+// Every column holds the glyph rows from the bottom one at the most significant bit, which is
+// the order they are in along a line of the frame.
+typedef struct {
+  sFONT *font;
+  uint8_t length;
+  char text[TEXT_RUN_CHARS];
+  // Last use of the run, 0 if the entry is free.
+  uint32_t used;
+  uint32_t columns[TEXT_RUN_COLUMNS];
+} text_run_t;
+
+static text_run_t cache[TEXT_CACHE_RUNS];
+static uint32_t run_clock = 0;
+
+static const rect_t EMPTY_RECT = {1, 1, 0, 0};
+
+// Find the end of the line starting at `text`, at most `columns` characters long.
+// Returns the start of the next line, the length of this one is set in `length`.
+static const char *next_line(const char *text, int columns, int *length) {
+  int last_space = -1;
+  int i;
+  for (i = 0; text[i] != '\0' && text[i] != '\n'; i++) {
+    if (text[i] == ' ' && i > 0 && text[i - 1] != ' ') {
+      last_space = i;
+    }
+    if (i == columns) {
+      break;
+    }
+  }
+
+  if (text[i] == '\0') {
+    *length = i;
+    return text + i;
+  }
+  if (text[i] == '\n') {
+    *length = i;
+    return text + i + 1;
+  }
+
+  // Too long, break at the last word that fits, or in the middle of a word longer than a line.
+  if (text[i] == ' ' || last_space <= 0) {
+    *length = i;
+  } else {
+    *length = last_space;
+    i = last_space;
+  }
+  while (text[i] == ' ') {
+    i++;
+  }
+  return text + i;
+}
+
+// Limit a box to the screen.
+static rect_t clip_box(rect_t box) {
+  if (box.x1 >= SCREEN_WIDTH) {
+    box.x1 = SCREEN_WIDTH - 1;
+  }
+  if (box.y1 >= SCREEN_HEIGHT) {
+    box.y1 = SCREEN_HEIGHT - 1;
+  }
+  return box;
+}
+
+// Render the glyphs of a run into its columns.
+static void render_run(text_run_t *run) {
+  sFONT *font = run->font;
+  uint16_t row_bytes = font->Width / 8 + (font->Width % 8 ? 1 : 0);
+
+  memset(run->columns, 0, sizeof(run->columns));
+  for (int c = 0; c < run->length; c++) {
+    const uint8_t *glyph = &font->table[(run->text[c] - ' ') * font->Height * row_bytes];
+    uint32_t *columns = &run->columns[c * font->Width];
+    for (int row = 0; row < font->Height; row++) {
+      uint32_t bit = 1u << (32 - font->Height + row);
+      for (int column = 0; column < font->Width; column++) {
+        if (glyph[row * row_bytes + column / 8] & (0x80 >> (column % 8))) {
+          columns[column] |= bit;
+        }
+      }
+    }
+  }
+}
+
+// Returns the rendered run for the characters, rendering it if it isn't cached.
+static text_run_t *get_run(const char *text, int length, sFONT *font) {
+  text_stats.lookups++;
+  run_clock++;
+
+  text_run_t *victim = &cache[0];
+  for (int i = 0; i < TEXT_CACHE_RUNS; i++) {
+    text_run_t *run = &cache[i];
+    if (run->used != 0 && run->font == font && run->length == length &&
+        memcmp(run->text, text, length) == 0) {
+      text_stats.hits++;
+      run->used = run_clock;
+      return run;
+    }
+    if (run->used < victim->used) {
+      victim = run;
+    }
+  }
+
+  if (victim->used != 0) {
+    text_stats.evictions++;
+  }
+  victim->font = font;
+  victim->length = length;
+  memcpy(victim->text, text, length);
+  victim->used = run_clock;
+  render_run(victim);
+  return victim;
+}
+
+// Copy the columns of a run into the frame, the screen is rotated by 90 degrees.
+// Only `rows` rows from the top and `width` columns from the left are drawn.
+static void blit_run(text_run_t *run, UWORD x, UWORD y, int width, int rows, UWORD foreground,
+                     UWORD background) {
+  sFONT *font = run->font;
+  // Screen row y is at WidthMemory - 1 - y along a line, the bottom row of the glyphs is first.
+  int first = Paint.WidthMemory - y - font->Height;
+  uint32_t mask = 0;
+  for (int row = 0; row < rows; row++) {
+    mask |= 1u << (32 - font->Height + row);
+  }
+
+  int start = first < 0 ? 0 : first / 8;
+  int shift = first < 0 ? 0 : first % 8;
+  for (int column = 0; column < width; column++) {
+    uint8_t *line = Paint.Image + (x + column) * Paint.WidthByte;
+    uint64_t pixels = (uint64_t)(run->columns[column] & mask) << 32;
+    uint64_t cell = (uint64_t)mask << 32;
+    if (first < 0) {
+      pixels <<= -first;
+      cell <<= -first;
+    } else {
+      pixels >>= shift;
+      cell >>= shift;
+    }
+
+    for (int b = 0; b < 5 && start + b < Paint.WidthByte; b++) {
+      uint8_t set = pixels >> (56 - 8 * b);
+      uint8_t all = cell >> (56 - 8 * b);
+      if (background != FONT_BACKGROUND) {
+        line[start + b] = background == BLACK ? line[start + b] & ~all : line[start + b] | all;
+      }
+      line[start + b] = foreground == BLACK ? line[start + b] & ~set : line[start + b] | set;
+    }
+  }
+}
+
+// Draw a line of text, split into runs that fit the cache.
+static void draw_line(UWORD x, UWORD y, const char *text, int length, sFONT *font, rect_t box,
+                      UWORD foreground, UWORD background) {
+  // The run cache only covers the rotated black and white frame the screens use.
+  if (Paint.Rotate != ROTATE_90 || Paint.Scale != 2 || Paint.Mirror != MIRROR_NONE) {
+    for (int i = 0; i < length; i++) {
+      Paint_DrawChar(x + i * font->Width, y, text[i], font, foreground, background);
+    }
+    return;
+  }
+
+  int rows = box.y1 - y + 1 < font->Height ? box.y1 - y + 1 : font->Height;
+  int per_run = TEXT_RUN_COLUMNS / font->Width;
+  if (per_run > TEXT_RUN_CHARS) {
+    per_run = TEXT_RUN_CHARS;
+  }
+
+  while (length > 0) {
+    int chars = length < per_run ? length : per_run;
+    int width = chars * font->Width;
+    if (x + width - 1 > box.x1) {
+      width = box.x1 - x + 1;
+    }
+    blit_run(get_run(text, chars, font), x, y, width, rows, foreground, background);
+
+    x += chars * font->Width;
+    text += chars;
+    length -= chars;
+  }
+}
+
+// Lay out `text` and draw the lines, or only measure them if `draw` is false.
+static rect_t layout(rect_t box, const char *text, sFONT *font, bool draw, UWORD foreground,
+                     UWORD background) {
+  box = clip_box(box);
+  if (text == NULL || *text == '\0' || box.x0 > box.x1 || box.y0 > box.y1) {
+    return EMPTY_RECT;
+  }
+
+  int columns = (box.x1 - box.x0 + 1) / font->Width;
+  if (columns == 0) {
+    return EMPTY_RECT;
+  }
+
+  rect_t area = EMPTY_RECT;
+  UWORD y = box.y0;
+  while (*text != '\0' && y <= box.y1) {
+    int length;
+    const char *next = next_line(text, columns, &length);
+    if (length > 0) {
+      if (draw) {
+        draw_line(box.x0, y, text, length, font, box, foreground, background);
+      }
+
+      UWORD x1 = box.x0 + length * font->Width - 1;
+      UWORD y1 = y + font->Height - 1 > box.y1 ? box.y1 : y + font->Height - 1;
+      if (area.x0 > area.x1) {
+        area = (rect_t){box.x0, y, x1, y1};
+      } else {
+        area.x1 = x1 > area.x1 ? x1 : area.x1;
+        area.y1 = y1;
+      }
+    }
+    text = next;
+    y += font->Height;
+  }
+  return area;
+}
+
+// Area the text covers when laid out in `box`, starting at its top left corner.
+rect_t text_measure(rect_t box, const char *text, sFONT *font) {
+  return layout(box, text, font, false, BLACK, WHITE);
+}
+
+// Draw the text laid out in `box`, starting at its top left corner. Returns the area it covers.
+// Like `Paint_DrawString`, a white background is transparent.
+rect_t text_draw(rect_t box, const char *text, sFONT *font, UWORD foreground, UWORD background) {
+  return layout(box, text, font, true, foreground, background);
+}
@@ -0,0 +1,30 @@
+#ifndef _TEXT_H
+#define _TEXT_H
+
+#include <stdint.h>
+
+#include "GUI_Paint.h"
+
+#include "panel.h"
+
+// Columns of a cached text run, longer lines are split into several runs.
+#define TEXT_RUN_COLUMNS 64
+// Characters of a cached text run, enough for the narrowest font.
+#define TEXT_RUN_CHARS 16
+// Number of text runs kept rendered. Every screen together uses about 130, a smaller cache than
+// that keeps evicting the runs of the screen shown next.
+#define TEXT_CACHE_RUNS 144
+
+// Text run cache statistics.
+typedef struct {
+  uint32_t lookups;
+  uint32_t hits;
+  uint32_t evictions;
+} text_stats_t;
+
+extern text_stats_t text_stats;
+
+rect_t text_measure(rect_t box, const char *text, sFONT *font);
+rect_t text_draw(rect_t box, const char *text, sFONT *font, UWORD foreground, UWORD background);
+
+#endif // _TEXT_H
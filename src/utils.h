@@ -3,21 +3,91 @@
 
 #include <stdio.h>
 
+#include "histogram.h"
+#include "log.h"
 #include "network.h"
+#include "stats.h"
 #include "sx126x.h"
 
-#define DEBUG
+// Category of the lines of a file, defined at its top before the includes.
+#ifndef LOG_CATEGORY
+#define LOG_CATEGORY LOG_CONSOLE
+#endif
+
+// Lines of any category and level, checked against the level of the category at run time and
+// against LOG_FLOOR when built.
+// Debug output is deferred to the UI core unless `log_mode` is LOG_DIRECT, see log.c.
+#if LOG_FLOOR <= LOG_LEVEL_DEBUG
+#define log_debug(CATEGORY, ...)                                                                   \
+  do {                                                                                             \
+    if (log_enabled(CATEGORY, LOG_LEVEL_DEBUG)) {                                                  \
+      if (log_mode == LOG_DIRECT) {                                                                \
+        printf(__VA_ARGS__);                                                                       \
+      } else {                                                                                     \
+        LOG_RECORD(__VA_ARGS__);                                                                   \
+      }                                                                                            \
+    }                                                                                              \
+  } while (0)
+
+// Bytes as hex after a label, on one line.
+#define log_bytes(CATEGORY, LABEL, DATA, LENGTH)                                                   \
+  do {                                                                                             \
+    if (log_enabled(CATEGORY, LOG_LEVEL_DEBUG)) {                                                  \
+      if (log_mode == LOG_DIRECT) {                                                                \
+        printf(LABEL);                                                                             \
+        for (int i_ = 0; i_ < (LENGTH); i_++) {                                                    \
+          printf(" %02x", ((const uint8_t *)(DATA))[i_]);                                          \
+        }                                                                                          \
+        printf("\n");                                                                              \
+      } else {                                                                                     \
+        LOG_RECORD_BYTES(LABEL, DATA, LENGTH);                                                     \
+      }                                                                                            \
+    }                                                                                              \
+  } while (0)
+#else
+#define log_debug(CATEGORY, ...)                                                                   \
+  do {                                                                                             \
+  } while (0)
+#define log_bytes(CATEGORY, LABEL, DATA, LENGTH)                                                   \
+  do {                                                                                             \
+  } while (0)
+#endif
+
+#if LOG_FLOOR <= LOG_LEVEL_INFO
+#define log_info(CATEGORY, ...)                                                                    \
+  do {                                                                                             \
+    if (log_enabled(CATEGORY, LOG_LEVEL_INFO)) {                                                   \
+      printf(__VA_ARGS__);                                                                         \
+    }                                                                                              \
+  } while (0)
+#else
+#define log_info(CATEGORY, ...)                                                                    \
+  do {                                                                                             \
+  } while (0)
+#endif
 
-// only print if DEBUG is enabled
-#ifdef DEBUG
-#define debug(...) printf(__VA_ARGS__)
+#if LOG_FLOOR <= LOG_LEVEL_ERROR
+#define log_error(CATEGORY, ...)                                                                   \
+  do {                                                                                             \
+    if (log_enabled(CATEGORY, LOG_LEVEL_ERROR)) {                                                  \
+      printf(__VA_ARGS__);                                                                         \
+    }                                                                                              \
+  } while (0)
 #else
-#define debug(...)
+#define log_error(CATEGORY, ...)                                                                   \
+  do {                                                                                             \
+  } while (0)
 #endif
 
-#define info(...) printf(__VA_ARGS__)
+// Lines of the category of the file.
+#define debug(...) log_debug(LOG_CATEGORY, __VA_ARGS__)
+#define debug_bytes(LABEL, DATA, LENGTH) log_bytes(LOG_CATEGORY, LABEL, DATA, LENGTH)
+#define info(...) log_info(LOG_CATEGORY, __VA_ARGS__)
+#define error(...) log_error(LOG_CATEGORY, __VA_ARGS__)
 
-#define error(...) printf(__VA_ARGS__)
+// Reply to a console command, printed whatever the levels and the floor are. Only the diagnostic
+// output above is filtered, `set log all off` leaves the console working.
+#define reply(...) printf(__VA_ARGS__)
 
 #define _PRINT_DEFINE(x) #x
 #define PRINT_DEFINE(x) _PRINT_DEFINE(x)
@@ -84,6 +154,67 @@ static const char *INFO_STR[] = {
     [INFO_BATTERY] = "BATTERY",
     [INFO_UPTIME] = "UPTIME",
     [INFO_CALLSIGN] = "CALLSIGN",
+    [INFO_STATS] = "STATS",
+};
+
+static const char *STAT_STR[] = {
+    [STAT_RX_FRAMES] = "rx frames",
+    [STAT_RX_ERRORS] = "rx errors",
+    [STAT_RX_REJECTED] = "rx rejected",
+    [STAT_RX_OWN] = "rx own",
+    [STAT_RX_QUEUE_FULL] = "rx queue full",
+    [STAT_FORWARDED] = "forwarded",
+    [STAT_HOP_LIMIT] = "hop limit",
+    [STAT_DUPLICATES] = "duplicates",
+    [STAT_DELIVERED] = "delivered",
+    [STAT_ACKS_SENT] = "acks sent",
+    [STAT_ACKS_RECEIVED] = "acks received",
+    [STAT_TX_FRAMES] = "tx frames",
+    [STAT_TX_QUEUE_FULL] = "tx queue full",
+    [STAT_RETRIES] = "retries",
+    [STAT_GIVEN_UP] = "given up",
+    [STAT_NO_PACKET] = "no packet",
+    [STAT_NEIGHBOURS_FULL] = "neighbours full",
+    [STAT_AIRTIME_MS] = "airtime ms",
+};
+
+static const char *HISTOGRAM_STR[] = {
+    [HIST_RX_QUEUE] = "rx queue",
+    [HIST_TX_QUEUE] = "tx queue",
+    [HIST_BACKOFF] = "backoff",
+    [HIST_AIRTIME] = "airtime",
+    [HIST_DIO1] = "dio1 irq",
+    [HIST_SPI] = "spi",
+    [HIST_ACK_RTT] = "ack rtt",
+};
+
+static const char *LOG_CATEGORY_STR[] = {
+    [LOG_RADIO] = "radio",
+    [LOG_NET] = "net",
+    [LOG_ACK] = "ack",
+    [LOG_UI] = "ui",
+    [LOG_CONSOLE] = "console",
+};
+
+static const char *LOG_LEVEL_STR[] = {
+    [LOG_LEVEL_DEBUG] = "debug",
+    [LOG_LEVEL_INFO] = "info",
+    [LOG_LEVEL_ERROR] = "error",
+    [LOG_LEVEL_OFF] = "off",
+};
+
+static const char *LOG_MODE_STR[] = {
+    [LOG_DIRECT] = "direct",
+    [LOG_TEXT] = "text",
+    [LOG_BINARY] = "binary",
+};
+
+static const char *DECODE_STR[] = {
+    [DECODE_OK] = "OK",
+    [DECODE_LENGTH] = "LENGTH",
+    [DECODE_SRC] = "SRC",
+    [DECODE_MTYPE] = "MTYPE",
+    [DECODE_DATA] = "DATA",
 };
 
 static const char *IRQ_STR[] = {
@@ -6,36 +6,38 @@
 #include "pico/types.h"
 
 #include "network.h"
+#include "radio.h"
 #include "utils.h"
 
-extern absolute_time_t last_tx_start;
-extern absolute_time_t last_tx_delta;
+// Core running the radio: the SX126x and its interrupt, the protocol, forwarding and the ack
+// scheduler. The other core runs the display, the buttons and the console.
+#ifndef RADIO_CORE
+#define RADIO_CORE 0
+#endif
 
-extern bool STOP_PROCESSING;
+// Interrupt handler timing.
+typedef struct {
+  uint32_t count;
+  uint32_t last_us;
+  uint32_t max_us;
+} irq_stats_t;
 
-void set_range(mod_params_t param);
-uint32_t get_time_on_air_in_ms();
+extern irq_stats_t button_irq_stats;
+extern irq_stats_t dio1_irq_stats;
 
-void handle_tx_callback();
-void handle_rx_callback();
-
-void handle_dio1_callback(uint gpio, uint32_t events);
 void handle_button_callback(uint gpio, uint32_t events);
 void handle_irq_callback(uint gpio, uint32_t events);
 
 void setup_io();
 void setup_display();
-void setup_sx126x();
 
 float read_voltage();
+float read_temperature();
 
-void transmit_bytes(uint8_t *bytes, uint8_t length);
-void transmit_string(char *string);
-void transmit_packet(message_history_t *packet);
-
-void receive_once();
-void receive_cont();
+void setup_radio_irq();
+void setup_ui_irq();
 
-void core1_entry();
+void radio_entry();
+void ui_entry();
 
 #endif // _VOIDLINK_H
@@ -0,0 +1,319 @@
+/**
+ * Widgets
+ *
+ * Screens are static tables of widgets. On every render the screen binds its widgets to the UI
+ * state, and only the widgets whose state changed since the last render are redrawn. Any other
+ * widget overlapping the redrawn area is redrawn with them, in table order, so the frame ends up
+ * the same as if the whole screen was drawn from scratch.
+ *
+ * This relies on the back buffer holding the last rendered frame, which `present_frame` takes
+ * care of. Anything drawing into the frame outside of the widgets has to call
+ * `invalidate_widgets`.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/timer.h"
+
+#include "EPD_2in13_V4.h"
+#include "GUI_Paint.h"
+
+#include "text.h"
+#include "widget.h"
+
+// Landscape size of the panel, as the screens draw it.
+#define SCREEN_WIDTH EPD_2in13_V4_HEIGHT
+#define SCREEN_HEIGHT EPD_2in13_V4_WIDTH
+
+render_stats_t render_stats = {0};
+
+// Screen drawn into the frame, NULL if the frame has to be drawn from scratch.
+static widget_screen_t *current = NULL;
+
+static const rect_t EMPTY_RECT = {1, 1, 0, 0};
+static const rect_t SCREEN_RECT = {0, 0, SCREEN_WIDTH - 1, SCREEN_HEIGHT - 1};
+
+static bool rect_empty(rect_t r) { return r.x0 > r.x1 || r.y0 > r.y1; }
+
+static uint32_t rect_area(rect_t r) {
+  return rect_empty(r) ? 0 : (uint32_t)(r.x1 - r.x0 + 1) * (r.y1 - r.y0 + 1);
+}
+
+static bool rect_intersects(rect_t a, rect_t b) {
+  return !rect_empty(a) && !rect_empty(b) && a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 &&
+         b.y0 <= a.y1;
+}
+
+static rect_t rect_union(rect_t a, rect_t b) {
+  if (rect_empty(a)) {
+    return b;
+  }
+  if (rect_empty(b)) {
+    return a;
+  }
+  return (rect_t){
+      .x0 = a.x0 < b.x0 ? a.x0 : b.x0,
+      .y0 = a.y0 < b.y0 ? a.y0 : b.y0,
+      .x1 = a.x1 > b.x1 ? a.x1 : b.x1,
+      .y1 = a.y1 > b.y1 ? a.y1 : b.y1,
+  };
+}
+
+static rect_t rect_clip(int x0, int y0, int x1, int y1) {
+  rect_t r = {
+      .x0 = x0 < 0 ? 0 : x0,
+      .y0 = y0 < 0 ? 0 : y0,
+      .x1 = x1 > SCREEN_RECT.x1 ? SCREEN_RECT.x1 : x1,
+      .y1 = y1 > SCREEN_RECT.y1 ? SCREEN_RECT.y1 : y1,
+  };
+  return (x1 < 0 || y1 < 0) ? EMPTY_RECT : r;
+}
+
+// Fill an area of the frame, the screen is rotated by 90 degrees.
+// A screen column is a line of the frame, filled a byte at a time.
+static void fill_rect(rect_t r, UWORD color) {
+  if (rect_empty(r)) {
+    return;
+  }
+  // Screen rows y0 to y1 are bits WidthMemory - 1 - y1 to WidthMemory - 1 - y0 along a line.
+  int first = Paint.WidthMemory - 1 - r.y1;
+  int last = Paint.WidthMemory - 1 - r.y0;
+  int start = first / 8;
+  int end = last / 8;
+  uint8_t head = 0xFF >> (first % 8);
+  uint8_t tail = 0xFF << (7 - last % 8);
+  if (start == end) {
+    head &= tail;
+  }
+  uint8_t fill = color == WHITE ? 0xFF : 0x00;
+
+  for (int x = r.x0; x <= r.x1; x++) {
+    uint8_t *line = Paint.Image + x * Paint.WidthByte;
+    line[start] = (line[start] & ~head) | (fill & head);
+    if (end > start) {
+      memset(line + start + 1, fill, end - start - 1);
+      line[end] = (line[end] & ~tail) | (fill & tail);
+    }
+  }
+}
+
+// Draw the frame of a box as `Paint_DrawRectangle` does, a filled one as one area.
+// Lines are drawn with dots of 2 * line - 1 pixels, from line pixels before the point.
+static void draw_frame(rect_t frame, int line, bool filled) {
+  int before = line;
+  int after = line - 2;
+  if (filled) {
+    // Filled line by line, down to the line before the bottom.
+    int bottom = frame.y1 - 1 + after;
+    fill_rect(rect_clip(frame.x0 - before, frame.y0 - before, frame.x1 + after, bottom), BLACK);
+    return;
+  }
+  fill_rect(rect_clip(frame.x0 - before, frame.y0 - before, frame.x1 + after, frame.y0 + after),
+            BLACK);
+  fill_rect(rect_clip(frame.x0 - before, frame.y1 - before, frame.x1 + after, frame.y1 + after),
+            BLACK);
+  fill_rect(rect_clip(frame.x0 - before, frame.y0 - before, frame.x0 + after, frame.y1 + after),
+            BLACK);
+  fill_rect(rect_clip(frame.x1 - before, frame.y0 - before, frame.x1 + after, frame.y1 + after),
+            BLACK);
+}
+
+// Merge overlapping rectangles in place until none of them overlap, returns how many are left.
+static int merge_rects(rect_t *rects, int count) {
+  bool merged = true;
+  while (merged) {
+    merged = false;
+    for (int i = 0; i < count; i++) {
+      for (int j = i + 1; j < count; j++) {
+        if (rect_empty(rects[j]) || rect_intersects(rects[i], rects[j]) || rect_empty(rects[i])) {
+          rects[i] = rect_union(rects[i], rects[j]);
+          rects[j--] = rects[--count];
+          merged = true;
+        }
+      }
+    }
+  }
+  return count;
+}
+
+// Format the widget's text into its own buffer.
+void widget_printf(widget_t *widget, const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vsnprintf(widget->buf, widget->buf_size, format, args);
+  va_end(args);
+  widget->state.text = widget->buf;
+}
+
+// Box the widget's text is laid out in, from its position to the end of its box.
+// Without a box the text can use the rest of the screen.
+static rect_t text_box(widget_t *widget) {
+  return (rect_t){
+      .x0 = widget->state.x,
+      .y0 = widget->state.y,
+      .x1 = widget->box.x1 != 0 ? widget->box.x1 : SCREEN_RECT.x1,
+      .y1 = widget->box.y1 != 0 ? widget->box.y1 : SCREEN_RECT.y1,
+  };
+}
+
+// Area the widget covers in its current state.
+static rect_t widget_area(widget_t *widget) {
+  widget_state_t *state = &widget->state;
+  if (!state->visible) {
+    return EMPTY_RECT;
+  }
+
+  rect_t area = text_measure(text_box(widget), state->text, widget->font);
+  if (widget->kind == WIDGET_BOX) {
+    // Lines are drawn with dots centered around the points.
+    rect_t frame = rect_clip(widget->frame.x0 - widget->line, widget->frame.y0 - widget->line,
+                             widget->frame.x1 + widget->line, widget->frame.y1 + widget->line);
+    area = rect_union(area, frame);
+  }
+  return area;
+}
+
+// FNV-1a over everything that changes how the widget looks.
+static uint32_t widget_hash(widget_t *widget) {
+  widget_state_t *state = &widget->state;
+  uint32_t hash = 2166136261u;
+  uint8_t fields[] = {state->visible, state->selected, state->x & 0xFF, state->x >> 8,
+                      state->y & 0xFF, state->y >> 8};
+  for (int i = 0; i < sizeof(fields); i++) {
+    hash = (hash ^ fields[i]) * 16777619u;
+  }
+  for (const char *c = state->text; c != NULL && *c != '\0'; c++) {
+    hash = (hash ^ (uint8_t)*c) * 16777619u;
+  }
+  return hash;
+}
+
+static void draw_widget(widget_t *widget) {
+  widget_state_t *state = &widget->state;
+  if (!state->visible) {
+    return;
+  }
+
+  switch (widget->kind) {
+  case WIDGET_LABEL:
+    if (state->selected) {
+      text_draw(text_box(widget), state->text, widget->font, WHITE, BLACK);
+    } else {
+      text_draw(text_box(widget), state->text, widget->font, BLACK, WHITE);
+    }
+    break;
+  case WIDGET_BOX:
+    draw_frame(widget->frame, widget->line, state->selected);
+    if (state->text != NULL) {
+      text_draw(text_box(widget), state->text, widget->font, state->selected ? WHITE : BLACK,
+                WHITE);
+    }
+    break;
+  }
+}
+
+// Redraw the whole frame on the next render.
+void invalidate_widgets() { current = NULL; }
+
+// Render a screen into the back buffer and return the area of the frame that changed.
+rect_t render_widgets(widget_screen_t *screen) {
+  uint64_t start = time_us_64();
+
+  widget_t *widgets = screen->widgets;
+  uint8_t count = screen->count < WIDGET_MAX ? screen->count : WIDGET_MAX;
+
+  Paint_NewImage(image, EPD_2in13_V4_WIDTH, EPD_2in13_V4_HEIGHT, 90, WHITE);
+
+  for (int i = 0; i < count; i++) {
+    widgets[i].state = (widget_state_t){
+        .visible = true,
+        .selected = false,
+        .x = widgets[i].x,
+        .y = widgets[i].y,
+        .text = widgets[i].text,
+    };
+  }
+  screen->bind(widgets);
+
+  // New area of every widget, and whether it has to be redrawn.
+  rect_t areas[WIDGET_MAX];
+  bool redraw[WIDGET_MAX];
+  rect_t dirty = EMPTY_RECT;
+  uint8_t redrawn = 0;
+
+  if (screen != current) {
+    Paint_Clear(WHITE);
+    for (int i = 0; i < count; i++) {
+      areas[i] = widget_area(&widgets[i]);
+      redraw[i] = true;
+    }
+    dirty = SCREEN_RECT;
+    current = screen;
+  } else {
+    // Areas to clear: where the changed widgets were and where they will be.
+    rect_t damage[WIDGET_MAX * 2];
+    int damaged = 0;
+    for (int i = 0; i < count; i++) {
+      // An unchanged widget covers the area it did, without laying its text out again.
+      redraw[i] = widget_hash(&widgets[i]) != widgets[i].drawn;
+      areas[i] = redraw[i] ? widget_area(&widgets[i]) : widgets[i].area;
+      if (redraw[i]) {
+        damage[damaged++] = widgets[i].area;
+        damage[damaged++] = areas[i];
+      }
+    }
+
+    // Unchanged widgets overlapping the damage are redrawn too, and their area is cleared with
+    // it, until nothing else overlaps.
+    bool grown = damaged > 0;
+    while (grown) {
+      grown = false;
+      for (int i = 0; i < count; i++) {
+        if (redraw[i]) {
+          continue;
+        }
+        for (int d = 0; d < damaged; d++) {
+          if (rect_intersects(areas[i], damage[d])) {
+            redraw[i] = true;
+            damage[damaged++] = areas[i];
+            grown = true;
+            break;
+          }
+        }
+      }
+    }
+
+    for (int d = 0; d < damaged; d++) {
+      dirty = rect_union(dirty, damage[d]);
+    }
+
+    // Merged, the damage is cleared once however many widgets it came from, and never more than
+    // the whole frame.
+    damaged = merge_rects(damage, damaged);
+    for (int d = 0; d < damaged; d++) {
+      fill_rect(damage[d], WHITE);
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    if (redraw[i]) {
+      draw_widget(&widgets[i]);
+      widgets[i].drawn = widget_hash(&widgets[i]);
+      widgets[i].area = areas[i];
+      redrawn++;
+    }
+  }
+
+  uint32_t elapsed = time_us_64() - start;
+  render_stats.count++;
+  render_stats.last_us = elapsed;
+  if (elapsed > render_stats.max_us) {
+    render_stats.max_us = elapsed;
+  }
+  render_stats.last_widgets = redrawn;
+  render_stats.last_area = rect_area(dirty);
+
+  return dirty;
+}
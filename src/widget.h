@@ -0,0 +1,105 @@
+#ifndef _WIDGET_H
+#define _WIDGET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "GUI_Paint.h"
+
+#include "panel.h"
+
+// Most widgets a single screen can have.
+#define WIDGET_MAX 32
+
+// Widget kinds.
+typedef enum {
+  // Text, drawn inverted when selected.
+  WIDGET_LABEL,
+  // Framed box with optional text inside, filled when selected.
+  WIDGET_BOX,
+} widget_kind_t;
+
+// What a widget shows.
+// Reset to the widget's defaults before every render, then updated by the screen's bind function.
+typedef struct {
+  bool visible;
+  bool selected;
+  uint16_t x;
+  uint16_t y;
+  const char *text;
+} widget_state_t;
+
+typedef struct {
+  widget_kind_t kind;
+  sFONT *font;
+  // Default text position and text.
+  uint16_t x;
+  uint16_t y;
+  const char *text;
+  // Bottom right corner of the box the text wraps in, the screen's if not set.
+  rect_t box;
+  // Frame and line width of a box.
+  rect_t frame;
+  DOT_PIXEL line;
+  // Storage for formatted text, see `widget_printf`.
+  char *buf;
+  uint8_t buf_size;
+
+  widget_state_t state;
+  // Hash of the state and the area it covered when the widget was last drawn.
+  uint32_t drawn;
+  rect_t area;
+} widget_t;
+
+// A screen is a static table of widgets and a function that binds them to the UI state.
+typedef struct {
+  widget_t *widgets;
+  uint8_t count;
+  void (*bind)(widget_t *widgets);
+} widget_screen_t;
+
+// Redraw statistics, for the last render.
+typedef struct {
+  uint32_t count;
+  uint32_t last_us;
+  uint32_t max_us;
+  uint8_t last_widgets;
+  uint32_t last_area;
+} render_stats_t;
+
+extern render_stats_t render_stats;
+
+#define LABEL(X, Y, FONT, TEXT)                                                                    \
+  { .kind = WIDGET_LABEL, .font = (FONT), .x = (X), .y = (Y), .text = (TEXT) }
+
+// Label wrapping its text within a box.
+#define LABEL_WRAP(X0, Y0, X1, Y1, FONT, TEXT)                                                     \
+  {                                                                                                \
+    .kind = WIDGET_LABEL, .font = (FONT), .x = (X0), .y = (Y0), .text = (TEXT),                    \
+    .box = {(X0), (Y0), (X1), (Y1)}                                                                \
+  }
+
+// Label with its own buffer for formatted text.
+#define LABEL_BUF(X, Y, FONT, SIZE)                                                                \
+  {                                                                                                \
+    .kind = WIDGET_LABEL, .font = (FONT), .x = (X), .y = (Y), .text = "",                          \
+    .buf = (char[SIZE]){0}, .buf_size = (SIZE)                                                     \
+  }
+
+#define BOX(X0, Y0, X1, Y1, LINE, X, Y, FONT, TEXT)                                                \
+  {                                                                                                \
+    .kind = WIDGET_BOX, .font = (FONT), .x = (X), .y = (Y), .text = (TEXT),                        \
+    .frame = {(X0), (Y0), (X1), (Y1)}, .line = (LINE)                                              \
+  }
+
+#define FRAME(X0, Y0, X1, Y1, LINE) BOX(X0, Y0, X1, Y1, LINE, 0, 0, NULL, NULL)
+
+#define WIDGET_SCREEN(WIDGETS, BIND)                                                               \
+  { .widgets = (WIDGETS), .count = sizeof(WIDGETS) / sizeof((WIDGETS)[0]), .bind = (BIND) }
+
+void widget_printf(widget_t *widget, const char *format, ...);
+
+rect_t render_widgets(widget_screen_t *screen);
+void invalidate_widgets();
+
+#endif // _WIDGET_H